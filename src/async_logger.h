@@ -0,0 +1,465 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "binary_log.h"
+#include "print_tuple.h"
+
+// One formatted line, written in place into a ring slot. Everything past
+// the slot's capacity is cut off and the line marked truncated.
+class LogLine {
+public:
+    LogLine(char* data, size_t capacity) : data(data), capacity(capacity) {}
+
+    void append(std::string_view s) {
+        size_t n = std::min(s.size(), capacity - length);
+        std::memcpy(data + length, s.data(), n);
+        length += n;
+        if (n < s.size()) truncated = true;
+    }
+
+    void append(char c) {
+        if (length < capacity) {
+            data[length++] = c;
+        }
+        else {
+            truncated = true;
+        }
+    }
+
+    template<typename T>
+    void append_number(T value) {
+        char buf[32];
+        auto result = std::to_chars(buf, buf + sizeof(buf), value);
+        append(std::string_view(buf, static_cast<size_t>(result.ptr - buf)));
+    }
+
+    size_t size() const { return length; }
+    bool was_truncated() const { return truncated; }
+
+private:
+    char* data;
+    size_t capacity;
+    size_t length = 0;
+    bool truncated = false;
+};
+
+namespace async_logger_detail {
+
+// streambuf over a LogLine, for types that only know operator<<
+class LineBuf : public std::streambuf {
+public:
+    explicit LineBuf(LogLine& line) : line(line) {}
+
+protected:
+    int_type overflow(int_type c) override {
+        if (c != traits_type::eof()) line.append(static_cast<char>(c));
+        return c;
+    }
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        line.append(std::string_view(s, static_cast<size_t>(n)));
+        return n;
+    }
+
+private:
+    LogLine& line;
+};
+
+template<typename T, typename = void>
+struct has_view : std::false_type {};
+template<typename T>
+struct has_view<T, std::void_t<decltype(std::declval<const T&>().view())>> : std::true_type {};
+
+}   // namespace async_logger_detail
+
+// Appends one log argument. Strings and numbers are copied or converted
+// directly; anything else goes through its operator<<, which is slower, so
+// keep those to sampled or rare lines.
+template<typename T>
+void log_append(LogLine& line, const T& value) {
+    using namespace async_logger_detail;
+    if constexpr (std::is_same_v<T, char>) {
+        line.append(value);
+    }
+    else if constexpr (std::is_same_v<T, bool>) {
+        line.append(value ? std::string_view("true") : std::string_view("false"));
+    }
+    else if constexpr (std::is_arithmetic_v<T>) {
+        line.append_number(value);
+    }
+    else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        line.append(std::string_view(value));
+    }
+    else if constexpr (has_view<T>::value) {
+        line.append(value.view());
+    }
+    else {
+        LineBuf buf(line);
+        std::ostream os(&buf);
+        os << value;
+    }
+}
+
+// Appends `format` with each {} replaced by the next argument, the same way
+// the binary log decoder renders a record.
+template<typename... Args>
+void log_format_site(LogLine& line, std::string_view format, const Args&... args) {
+    size_t pos = 0;
+    utils::tuple::for_each(std::forward_as_tuple(args...), [&](const auto& arg) {
+        size_t brace = format.find("{}", pos);
+        if (brace == std::string_view::npos) {
+            // More arguments than placeholders: append them after the text
+            line.append(format.substr(pos));
+            pos = format.size();
+            line.append(' ');
+        }
+        else {
+            line.append(format.substr(pos, brace - pos));
+            pos = brace + 2;
+        }
+        log_append(line, arg);
+    });
+    line.append(format.substr(pos));
+}
+
+// Records one argument raw for a binary log. Types without a binary form
+// are rendered to text in place, as log_append() would.
+template<typename T>
+void encode_log_arg(LogArgWriter& w, const T& value) {
+    using namespace async_logger_detail;
+    if constexpr (std::is_same_v<T, char>) {
+        w.scalar(LogArgTag::Char, value);
+    }
+    else if constexpr (std::is_same_v<T, bool>) {
+        w.scalar(LogArgTag::Bool, static_cast<uint8_t>(value));
+    }
+    else if constexpr (std::is_floating_point_v<T>) {
+        w.scalar(LogArgTag::Double, static_cast<double>(value));
+    }
+    else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        w.scalar(LogArgTag::Signed, static_cast<int64_t>(value));
+    }
+    else if constexpr (std::is_integral_v<T>) {
+        w.scalar(LogArgTag::Unsigned, static_cast<uint64_t>(value));
+    }
+    else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        w.string(std::string_view(value));
+    }
+    else if constexpr (has_view<T>::value) {
+        w.string(value.view());
+    }
+    else {
+        size_t room = 0;
+        char* data = w.begin_string(room);
+        if (!data) return;
+        LogLine line(data, std::min<size_t>(room, UINT16_MAX));
+        log_append(line, value);
+        w.commit_string(line.size());
+        if (line.was_truncated()) w.mark_truncated();
+    }
+}
+
+// Lets through one call in every `every`. Not thread-safe: give each thread
+// its own, so sampling costs a counter increment and no shared cache line.
+class LogSampler {
+public:
+    explicit LogSampler(uint64_t every) : every(std::max<uint64_t>(every, 1)) {}
+
+    bool sample() { return count++ % every == 0; }
+
+private:
+    uint64_t every;
+    uint64_t count = 0;
+};
+
+// ---------------------------
+// Lock-free asynchronous logger
+// ---------------------------
+// Each thread that logs gets its own single-producer ring of fixed-size
+// records. A log call checks the level, formats straight into the next free
+// slot and publishes it with one release store: no locks, no allocation and
+// no system calls. If the ring is full the line is dropped and counted, so
+// a stalled output can never stall ingest.
+//
+// A background thread drains the rings in turn and writes the lines to
+// `out`, prefixed with a UTC time and a level letter. Lines from one thread
+// stay in order; lines from different threads are interleaved by drain
+// order, not strictly by time.
+//
+// A thread registers its ring on its first log call (the only time it
+// takes a lock). When the thread exits its ring is handed to the next new
+// thread once drained.
+//
+// With LogOutput::Binary, calls through a LogSite skip formatting
+// altogether: the record holds the site's id and the raw arguments, and
+// `out` receives a binary log (binary_log.h) for log_decoder to render
+// later. Lines logged without a site are formatted and stored as one
+// string argument.
+enum class LogOutput {
+    Text,
+    Binary
+};
+
+class AsyncLogger {
+public:
+    static constexpr size_t line_capacity = 240;
+
+    explicit AsyncLogger(std::ostream& out, LogLevel level = LogLevel::Info, size_t ring_capacity = 1024,
+                         LogOutput output = LogOutput::Text)
+        : out(out), output(output), ring_capacity(round_up_pow2(ring_capacity)), min_level(level),
+          id(next_id().fetch_add(1, std::memory_order_relaxed) + 1), writer([this]() { run(); }) {}
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    ~AsyncLogger() { stop(); }
+
+    bool enabled(LogLevel level) const { return level >= min_level.load(std::memory_order_relaxed); }
+    void set_level(LogLevel level) { min_level.store(level, std::memory_order_relaxed); }
+
+    // Logs the arguments one after another.
+    template<typename... Args>
+    void log(LogLevel level, const Args&... args) {
+        if (!enabled(level)) return;
+        Record* record = claim();
+        if (!record) return;
+
+        if (output == LogOutput::Text) {
+            LogLine line(record->text, line_capacity);
+            (log_append(line, args), ...);
+            publish(*record, level, 0, line.size(), line.was_truncated());
+        }
+        else {
+            LogArgWriter w(record->text, line_capacity);
+            // begin_string() sets room, so it must run before room is read
+            size_t room = 0;
+            char* data = w.begin_string(room);
+            LogLine line(data, room);
+            (log_append(line, args), ...);
+            w.commit_string(line.size());
+            publish(*record, level, 0, w.size(), line.was_truncated());
+        }
+    }
+
+    // Logs the site's format with each {} replaced by the next argument.
+    template<typename... Args>
+    void log(LogLevel level, LogSite& site, const Args&... args) {
+        if (!enabled(level)) return;
+        Record* record = claim();
+        if (!record) return;
+
+        if (output == LogOutput::Text) {
+            LogLine line(record->text, line_capacity);
+            log_format_site(line, site.text(), args...);
+            publish(*record, level, 0, line.size(), line.was_truncated());
+        }
+        else {
+            LogArgWriter w(record->text, line_capacity);
+            utils::tuple::for_each(std::forward_as_tuple(args...), [&w](const auto& arg) { encode_log_arg(w, arg); });
+            publish(*record, level, site.id(), w.size(), w.was_truncated());
+        }
+    }
+
+    template<typename... Args> void debug(Args&&... args) { log(LogLevel::Debug, std::forward<Args>(args)...); }
+    template<typename... Args> void info(Args&&... args) { log(LogLevel::Info, std::forward<Args>(args)...); }
+    template<typename... Args> void warn(Args&&... args) { log(LogLevel::Warn, std::forward<Args>(args)...); }
+    template<typename... Args> void error(Args&&... args) { log(LogLevel::Error, std::forward<Args>(args)...); }
+
+    // Blocks until every line logged before the call has been written out.
+    void flush() {
+        std::vector<std::pair<std::shared_ptr<Ring>, size_t>> targets;
+        {
+            std::lock_guard<std::mutex> lock(rings_mutex);
+            for (auto& ring : rings) targets.emplace_back(ring, ring->tail.load(std::memory_order_acquire));
+        }
+        for (auto& [ring, tail] : targets) {
+            while (ring->head.load(std::memory_order_acquire) < tail && running.load(std::memory_order_acquire)) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+    }
+
+    // Writes out what's left and stops the background thread. Later log
+    // calls are accepted but never written.
+    void stop() {
+        if (running.exchange(false)) writer.join();
+    }
+
+    uint64_t dropped() const { return dropped_lines.load(std::memory_order_relaxed); }
+    uint64_t written() const { return written_lines.load(std::memory_order_relaxed); }
+
+    size_t ring_count() {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        return rings.size();
+    }
+
+    // The background writer thread, for pinning it to a core
+    std::thread::native_handle_type native_handle() { return writer.native_handle(); }
+
+private:
+    struct Record {
+        int64_t time_ns;
+        uint32_t format_id;   // Binary output only; 0 for a preformatted line
+        LogLevel level;
+        bool truncated;
+        uint16_t length;
+        char text[line_capacity];   // The line, or the encoded arguments
+    };
+
+    // The calling thread's next free slot, or nullptr (counted as a drop)
+    // if its ring is full.
+    Record* claim() {
+        Ring& ring = local_ring();
+        size_t tail = ring.tail.load(std::memory_order_relaxed);
+        if (tail - ring.head.load(std::memory_order_acquire) >= ring.slots.size()) {
+            dropped_lines.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &ring.slots[tail & (ring.slots.size() - 1)];
+    }
+
+    // Hands the slot claim() returned to the writer thread.
+    void publish(Record& record, LogLevel level, uint32_t format_id, size_t length, bool truncated) {
+        record.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::system_clock::now().time_since_epoch()).count();
+        record.format_id = format_id;
+        record.level = level;
+        record.truncated = truncated;
+        record.length = static_cast<uint16_t>(length);
+        Ring& ring = local_ring();
+        ring.tail.store(ring.tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    struct Ring {
+        explicit Ring(size_t capacity) : slots(capacity) {}
+
+        std::vector<Record> slots;
+        alignas(64) std::atomic<size_t> head{0};   // Next slot to write out
+        alignas(64) std::atomic<size_t> tail{0};   // Next slot to fill
+        std::atomic<bool> abandoned{false};
+    };
+
+    // The calling thread's ring for this logger. Logger ids are never reused,
+    // so a ring cached for a destroyed logger can't be mistaken for ours.
+    struct LocalRing {
+        uint64_t owner = 0;
+        std::shared_ptr<Ring> ring;
+
+        ~LocalRing() {
+            if (ring) ring->abandoned.store(true, std::memory_order_release);
+        }
+    };
+
+    Ring& local_ring() {
+        thread_local LocalRing local;
+        if (local.owner != id) {
+            if (local.ring) local.ring->abandoned.store(true, std::memory_order_release);
+            local.ring = acquire_ring();
+            local.owner = id;
+        }
+        return *local.ring;
+    }
+
+    std::shared_ptr<Ring> acquire_ring() {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        for (auto& ring : rings) {
+            if (ring->abandoned.load(std::memory_order_acquire) &&
+                ring->head.load(std::memory_order_acquire) == ring->tail.load(std::memory_order_relaxed)) {
+                ring->abandoned.store(false, std::memory_order_relaxed);
+                return ring;
+            }
+        }
+        rings.push_back(std::make_shared<Ring>(ring_capacity));
+        return rings.back();
+    }
+
+    void run() {
+        if (output == LogOutput::Binary) write_binary_log_header(out);
+        std::vector<std::shared_ptr<Ring>> snapshot;
+        while (true) {
+            bool stopping = !running.load(std::memory_order_acquire);
+            {
+                std::lock_guard<std::mutex> lock(rings_mutex);
+                snapshot = rings;
+            }
+            size_t count = 0;
+            for (auto& ring : snapshot) count += drain(*ring);
+            if (stopping) return;
+            if (count == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    size_t drain(Ring& ring) {
+        size_t head = ring.head.load(std::memory_order_relaxed);
+        size_t tail = ring.tail.load(std::memory_order_acquire);
+        if (head == tail) return 0;
+
+        for (size_t i = head; i != tail; ++i) write(ring.slots[i & (ring.slots.size() - 1)]);
+        out.flush();
+        ring.head.store(tail, std::memory_order_release);
+        written_lines.fetch_add(tail - head, std::memory_order_relaxed);
+        return tail - head;
+    }
+
+    void write(const Record& r) {
+        if (output == LogOutput::Binary) {
+            // Each format goes out once, ahead of its first record
+            if (r.format_id != 0 && (r.format_id >= formats_written.size() || !formats_written[r.format_id])) {
+                if (r.format_id >= formats_written.size()) formats_written.resize(r.format_id + 1);
+                const char* format = LogSite::format_of(r.format_id);
+                write_binary_log_format(out, r.format_id, format ? format : "");
+                formats_written[r.format_id] = true;
+            }
+            write_binary_log_record(out, r.time_ns, r.level, r.truncated, r.format_id, r.text, r.length);
+            return;
+        }
+
+        // Messages such as PQerrorMessage() carry their own newline
+        size_t length = r.length;
+        while (length > 0 && r.text[length - 1] == '\n') --length;
+        char prefix[32];
+        out.write(prefix, static_cast<std::streamsize>(format_log_prefix(prefix, r.time_ns, r.level)));
+        out.write(r.text, static_cast<std::streamsize>(length));
+        if (r.truncated) out.write("...", 3);
+        out.put('\n');
+    }
+
+    static size_t round_up_pow2(size_t n) {
+        size_t p = 2;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    static std::atomic<uint64_t>& next_id() {
+        static std::atomic<uint64_t> ids{0};
+        return ids;
+    }
+
+    std::ostream& out;
+    LogOutput output;
+    std::vector<bool> formats_written;   // Writer thread only
+    size_t ring_capacity;
+    std::atomic<LogLevel> min_level;
+    uint64_t id;
+
+    std::mutex rings_mutex;
+    std::vector<std::shared_ptr<Ring>> rings;
+
+    std::atomic<uint64_t> dropped_lines{0};
+    std::atomic<uint64_t> written_lines{0};
+    std::atomic<bool> running{true};
+    std::thread writer;   // Last, so it starts after everything it uses
+};
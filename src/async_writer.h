@@ -0,0 +1,247 @@
+#pragma once
+#include <libpq-fe.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "latency_histogram.h"
+#include "mpmc_queue.h"
+#include "pipeline_sink.h"
+#include "trade.h"
+
+// Outcome of one trade's write, published on AsyncWriter's completion queue.
+struct WriteCompletion {
+    FixedString<16> control_id;
+    FixedString<12> cusip;
+    FixedString<4> side;
+    bool ok = false;
+    uint32_t latency_us = 0;   // From send to the server's reply
+    TradeStamps stamps;        // The trade's own, for end-to-end latency
+    uint64_t written = 0;      // TscClock stamp of the server's reply
+};
+
+// -------------------------------------------
+// Non-blocking trade writer over many connections
+// -------------------------------------------
+// One thread drives several connections, each a PipelineSink in
+// non-blocking mode. pump() takes trades from a source queue only while
+// some connection has pipeline room, then sleeps in epoll_wait() until a
+// socket is readable (results) or writable (a send that didn't fit). So the
+// queue drains as fast as the database as a whole accepts trades, and one
+// slow connection or query doesn't hold up the others.
+//
+// Every finished trade is pushed to a completion queue that another thread
+// reads with next_completion(). If that queue is full the completion is
+// dropped and counted rather than stalling the writer.
+//
+// A lost connection fails whatever it had in flight and is left out of
+// pump() until reconnect() reopens it. The caller decides how often to try.
+class AsyncWriter {
+public:
+    static constexpr size_t COMPLETION_CAPACITY = 8192;
+
+    explicit AsyncWriter(size_t max_in_flight_per_connection)
+        : max_in_flight(max_in_flight_per_connection), epoll_fd(epoll_create1(EPOLL_CLOEXEC)) {}
+
+    ~AsyncWriter() {
+        for (auto& c : connections) close(*c);
+        if (epoll_fd >= 0) ::close(epoll_fd);
+    }
+
+    AsyncWriter(const AsyncWriter&) = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    // Opens `count` connections and starts a pipeline on each. Those that
+    // don't come up are left for reconnect(). Returns false only if the
+    // writer can't run at all.
+    bool connect(const std::string& conninfo, size_t count) {
+        if (epoll_fd < 0) {
+            std::cerr << "epoll_create1 failed\n";
+            return false;
+        }
+
+        this->conninfo = conninfo;
+        connections.clear();
+        for (size_t i = 0; i < count; ++i) connections.push_back(std::make_unique<Connection>());
+        reconnect();
+        return true;
+    }
+
+    // Reopens every connection that is down. Returns how many are up.
+    size_t reconnect() {
+        for (size_t i = 0; i < connections.size(); ++i) {
+            Connection& c = *connections[i];
+            if (c.sink && c.sink->alive()) continue;
+            close(c);
+            open(c, i + 1);
+        }
+        return connection_count();
+    }
+
+    // One round of the event loop: hand queued trades to connections with
+    // room, then wait up to timeout_ms for socket activity and process it.
+    // Returns the number of trades taken from `source`, or -1 once every
+    // connection is down.
+    template<typename Queue>
+    long pump(Queue& source, int timeout_ms) {
+        long taken = 0;
+        Trade trade;
+        for (Connection* c = least_loaded(); c && source.dequeue(trade); c = least_loaded()) {
+            c->sink->add(trade);
+            ++taken;
+        }
+
+        bool any_alive = false;
+        bool busy = false;
+        for (auto& c : connections) {
+            if (!c->sink) continue;
+            if (!c->sink->alive()) {
+                unwatch(*c);
+                continue;
+            }
+            any_alive = true;
+            busy = busy || c->sink->in_flight() > 0;
+            watch(*c);
+        }
+        if (!any_alive) return -1;
+
+        // With nothing in flight only new trades can make progress, so
+        // don't sleep on sockets that won't fire.
+        epoll_event events[16];
+        int n = epoll_wait(epoll_fd, events, 16, busy && taken == 0 ? timeout_ms : 0);
+        for (int i = 0; i < n; ++i) {
+            static_cast<Connection*>(events[i].data.ptr)->sink->poll();
+        }
+        return taken;
+    }
+
+    // Pops the next completion, if any. Unlike the rest of the class, this
+    // and completions_dropped() may be called from other threads.
+    bool next_completion(WriteCompletion& out) {
+        return completions.dequeue(out);
+    }
+
+    // Connections that are up
+    size_t connection_count() const {
+        size_t up = 0;
+        for (const auto& c : connections) up += c->sink && c->sink->alive();
+        return up;
+    }
+
+    size_t in_flight() const {
+        size_t total = 0;
+        for (const auto& c : connections) {
+            if (c->sink) total += c->sink->in_flight();
+        }
+        return total;
+    }
+
+    uint64_t completions_dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Connection {
+        PGconn* conn = nullptr;
+        std::unique_ptr<PipelineSink> sink;
+        uint32_t watched = EPOLLIN;   // Events currently registered
+        bool registered = false;
+    };
+
+    // Connects `c` and starts its pipeline. `number` is for log lines.
+    void open(Connection& c, size_t number) {
+        c.conn = PQconnectdb(conninfo.c_str());
+        if (PQstatus(c.conn) != CONNECTION_OK) {
+            std::cerr << "[Writer] DB connection " << number << " failed: " << PQerrorMessage(c.conn) << "\n";
+            close(c);
+            return;
+        }
+
+        c.sink = std::make_unique<PipelineSink>(
+            c.conn, max_in_flight,
+            [this](const Trade& trade, const char* error, PipelineSink::Clock::duration latency) {
+                on_complete(trade, error, latency);
+            });
+        if (!c.sink->start()) {
+            close(c);
+            return;
+        }
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = &c;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c.sink->socket(), &ev) < 0) {
+            std::cerr << "[Writer] epoll_ctl failed for connection " << number << "\n";
+            close(c);
+            return;
+        }
+        c.watched = EPOLLIN;
+        c.registered = true;
+    }
+
+    void close(Connection& c) {
+        if (c.registered) {
+            int sock = c.sink->socket();
+            if (sock >= 0) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, sock, nullptr);
+            c.registered = false;
+        }
+        c.sink.reset();   // Drains in-flight inserts while the connection is open
+        PQfinish(c.conn);
+        c.conn = nullptr;
+    }
+
+    // Spreads trades over the connections with the fewest in flight.
+    Connection* least_loaded() {
+        Connection* best = nullptr;
+        for (auto& c : connections) {
+            if (!c->sink || !c->sink->alive() || c->sink->full()) continue;
+            if (!best || c->sink->in_flight() < best->sink->in_flight()) best = c.get();
+        }
+        return best;
+    }
+
+    // Level-triggered, so EPOLLOUT is only registered while libpq has
+    // unsent data or it would fire continuously.
+    void watch(Connection& c) {
+        uint32_t wanted = EPOLLIN | (c.sink->wants_write() ? EPOLLOUT : 0u);
+        if (wanted == c.watched) return;
+        epoll_event ev{};
+        ev.events = wanted;
+        ev.data.ptr = &c;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c.sink->socket(), &ev) == 0) c.watched = wanted;
+    }
+
+    void unwatch(Connection& c) {
+        if (!c.registered) return;
+        int sock = c.sink->socket();
+        if (sock >= 0) epoll_ctl(epoll_fd, EPOLL_CTL_DEL, sock, nullptr);
+        c.registered = false;
+        std::cerr << "[Writer] DB connection lost\n";
+    }
+
+    void on_complete(const Trade& trade, const char* error, PipelineSink::Clock::duration latency) {
+        if (error) PipelineSink::report(trade, error);
+
+        WriteCompletion done;
+        done.control_id = trade.control_id;
+        done.cusip = trade.cusip;
+        done.side = trade.side;
+        done.ok = error == nullptr;
+        done.stamps = trade.stamps;
+        done.written = TscClock::now();
+        done.latency_us = static_cast<uint32_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+        if (!completions.enqueue(done)) dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t max_in_flight;
+    int epoll_fd;
+    std::string conninfo;
+    std::vector<std::unique_ptr<Connection>> connections;
+    MPMCQueue<WriteCompletion, COMPLETION_CAPACITY> completions;
+    std::atomic<uint64_t> dropped{0};
+};
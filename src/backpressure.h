@@ -0,0 +1,139 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// What producers do while the queues are overloaded.
+// - Pause: stop reading their sockets. The kernel's receive buffer fills,
+//   TCP's window closes and the feed's sender is held back, so nothing is
+//   lost but the sender sees the stall.
+// - Shed: keep reading and drop what arrives, counting every dropped line,
+//   for when staying current matters more than completeness.
+enum class OverloadPolicy {
+    Pause,
+    Shed
+};
+
+inline const char* overload_policy_name(OverloadPolicy policy) {
+    return policy == OverloadPolicy::Shed ? "shed" : "pause";
+}
+
+inline bool parse_overload_policy(std::string_view name, OverloadPolicy& policy) {
+    if (name == "pause") policy = OverloadPolicy::Pause;
+    else if (name == "shed") policy = OverloadPolicy::Shed;
+    else return false;
+    return true;
+}
+
+// Totals over all feeds
+struct BackpressureStats {
+    uint64_t episodes = 0;   // Times the queues crossed the high watermark
+    uint64_t pauses = 0;     // Times a producer stopped reading
+    uint64_t paused_ns = 0;  // Time producers spent paused, summed
+    uint64_t shed = 0;       // Lines dropped under the Shed policy
+
+    BackpressureStats since(const BackpressureStats& earlier) const {
+        return {episodes - earlier.episodes, pauses - earlier.pauses, paused_ns - earlier.paused_ns,
+                shed - earlier.shed};
+    }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const BackpressureStats& s) {
+    return os << s.episodes << " overloads, " << s.pauses << " pauses for " << s.paused_ns / 1000000 << " ms, "
+              << s.shed << " shed";
+}
+
+// ----------------------------
+// Queue watermarks for ingest
+// ----------------------------
+// Tells producers when the queues downstream of them are too full. Fill is
+// a fraction of capacity, the fullest queue's when there are several. The
+// pipeline becomes overloaded once fill reaches the high watermark and
+// stays so until it drains to the low one, so producers don't flap between
+// reading and pausing around a single threshold.
+//
+// The overloaded flag is shared; the counters are per feed, one cache line
+// each, and only that feed's producer writes them.
+class Backpressure {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct alignas(64) FeedCounters {
+        std::atomic<uint64_t> pauses{0};
+        std::atomic<uint64_t> paused_ns{0};
+        std::atomic<uint64_t> shed{0};
+
+        void add(std::atomic<uint64_t>& counter, uint64_t n) {
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+    };
+
+    Backpressure(double high_watermark, double low_watermark, OverloadPolicy policy, size_t feeds)
+        : high(high_watermark),
+          low(std::min(low_watermark, high_watermark)),
+          overload_policy(policy),
+          counters(std::max<size_t>(feeds, 1)) {}
+
+    OverloadPolicy policy() const { return overload_policy; }
+
+    // Whether producers should hold back at the given fill. Returns true from
+    // the moment fill reaches the high watermark until it falls to the low.
+    bool overloaded(double fill) {
+        bool on = active.load(std::memory_order_relaxed);
+        if (!on && fill >= high) {
+            if (active.compare_exchange_strong(on, true, std::memory_order_relaxed)) {
+                episodes.fetch_add(1, std::memory_order_relaxed);
+            }
+            return true;
+        }
+        if (on && fill <= low) {
+            active.compare_exchange_strong(on, false, std::memory_order_relaxed);
+            return false;
+        }
+        return on;
+    }
+
+    bool is_overloaded() const { return active.load(std::memory_order_relaxed); }
+
+    // Blocks feed `i`'s producer until the overload clears, polling `fill`
+    // every `poll`. Returns at once if not overloaded.
+    template<typename Fill>
+    void wait_for_room(size_t i, Fill&& fill, std::chrono::microseconds poll = std::chrono::microseconds(100)) {
+        if (!overloaded(fill())) return;
+        auto start = Clock::now();
+        while (overloaded(fill())) std::this_thread::sleep_for(poll);
+        FeedCounters& c = counters[i];
+        c.add(c.pauses, 1);
+        c.add(c.paused_ns, static_cast<uint64_t>(std::chrono::nanoseconds(Clock::now() - start).count()));
+    }
+
+    // Counts a line feed `i` dropped under the Shed policy
+    void record_shed(size_t i) { counters[i].add(counters[i].shed, 1); }
+
+    BackpressureStats stats() const {
+        BackpressureStats s;
+        s.episodes = episodes.load(std::memory_order_relaxed);
+        for (const FeedCounters& c : counters) {
+            s.pauses += c.pauses.load(std::memory_order_relaxed);
+            s.paused_ns += c.paused_ns.load(std::memory_order_relaxed);
+            s.shed += c.shed.load(std::memory_order_relaxed);
+        }
+        return s;
+    }
+
+    const FeedCounters& feed(size_t i) const { return counters[i]; }
+
+private:
+    double high;
+    double low;
+    OverloadPolicy overload_policy;
+    std::atomic<bool> active{false};
+    std::atomic<uint64_t> episodes{0};
+    std::vector<FeedCounters> counters;
+};
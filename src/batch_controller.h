@@ -0,0 +1,193 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Why a batch was sent.
+// - Full: it reached the controller's current target size.
+// - Deadline: its oldest trade would miss the latency SLO if it waited longer.
+// - Idle: the queue is empty and nothing has arrived for a while, so waiting
+//   for more would only add latency.
+enum class FlushReason {
+    None,
+    Full,
+    Deadline,
+    Idle
+};
+
+constexpr size_t FLUSH_REASON_COUNT = 4;
+
+inline const char* flush_reason_name(FlushReason reason) {
+    switch (reason) {
+        case FlushReason::Full: return "full";
+        case FlushReason::Deadline: return "deadline";
+        case FlushReason::Idle: return "idle";
+        default: return "none";
+    }
+}
+
+// What a controller has done since it was created (or since reset()).
+// Batch sizes are counted in power-of-two buckets: bucket i holds batches
+// of [2^i, 2^(i+1)) trades.
+struct BatchStats {
+    static constexpr size_t size_buckets = 16;
+
+    uint64_t trades = 0;
+    uint64_t batches = 0;
+    uint64_t flushes[FLUSH_REASON_COUNT] = {};
+    uint64_t sizes[size_buckets] = {};
+    size_t largest = 0;
+    size_t target = 0;
+    std::chrono::microseconds db_latency{0};
+
+    void record(size_t rows, FlushReason reason) {
+        trades += rows;
+        ++batches;
+        ++flushes[static_cast<size_t>(reason)];
+        size_t bucket = 0;
+        while (bucket + 1 < size_buckets && (size_t(2) << bucket) <= rows) ++bucket;
+        ++sizes[bucket];
+        largest = std::max(largest, rows);
+    }
+};
+
+// One line: totals, the current target and DB latency, flushes by reason
+// and the non-empty size buckets.
+inline std::ostream& operator<<(std::ostream& os, const BatchStats& s) {
+    os << s.trades << " trades in " << s.batches << " batches (target " << s.target << ", largest " << s.largest
+       << ", db " << s.db_latency.count() << " us); flushes:";
+    for (size_t r = 1; r < FLUSH_REASON_COUNT; ++r) {
+        os << ' ' << flush_reason_name(static_cast<FlushReason>(r)) << ' ' << s.flushes[r];
+    }
+    os << "; sizes:";
+    for (size_t b = 0; b < BatchStats::size_buckets; ++b) {
+        if (s.sizes[b] == 0) continue;
+        os << ' ' << (size_t(1) << b) << "+:" << s.sizes[b];
+    }
+    return os;
+}
+
+// ----------------------------------
+// Adaptive micro-batching controller
+// ----------------------------------
+// Picks when a consumer sends its buffered trades. A fixed batch size is
+// wrong at both ends: at one trade a second every trade waits out the full
+// timeout, and during bursts small batches pay a round trip each and the
+// queue backs up.
+//
+// The controller keeps a target batch size between min_batch and
+// max_batch:
+// - After a flush that leaves at least a target's worth of trades queued,
+//   the target doubles. Trades that queued up during the flush are what a
+//   slow database costs, so rising DB latency grows batches the same way.
+// - Deadline and idle flushes halve it, since batches aren't filling.
+// - It never exceeds what the database can write in half the SLO, judged
+//   from the smoothed per-trade cost of recent flushes.
+//
+// Independently of the target, a batch is sent once its oldest trade has
+// waited the SLO minus the expected flush time, so no trade that reaches
+// the controller is held past the SLO by batching.
+//
+// One controller per consumer thread; it isn't thread-safe.
+class BatchController {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    BatchController(size_t min_batch, size_t max_batch, std::chrono::microseconds latency_slo,
+                    std::chrono::microseconds idle_gap = std::chrono::microseconds(1000))
+        : min_batch(std::max<size_t>(min_batch, 1)),
+          max_batch(std::max(max_batch, this->min_batch)),
+          latency_slo(latency_slo),
+          idle_gap(idle_gap),
+          target_size(this->min_batch) {
+        stats.target = target_size;
+    }
+
+    // Call for each trade added to the batch.
+    void on_add(Clock::time_point now = Clock::now()) {
+        if (pending == 0) oldest = now;
+        last_add = now;
+        ++pending;
+    }
+
+    // Whether to flush now, given how many trades are still queued.
+    FlushReason check(size_t queue_depth, Clock::time_point now = Clock::now()) const {
+        if (pending == 0) return FlushReason::None;
+        if (pending >= target_size) return FlushReason::Full;
+        if (now - oldest + flush_estimate() >= latency_slo) return FlushReason::Deadline;
+        if (queue_depth == 0 && now - last_add >= idle_gap) return FlushReason::Idle;
+        return FlushReason::None;
+    }
+
+    // Call after sending the batch, with how long the send took and how many
+    // trades were queued once it finished.
+    void on_flush(FlushReason reason, Clock::duration latency, size_t queue_depth) {
+        if (pending == 0) return;
+
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+        double per_trade = static_cast<double>(us) / static_cast<double>(pending);
+        if (flushes == 0) {
+            latency_us = static_cast<double>(us);
+            per_trade_us = per_trade;
+        }
+        else {
+            latency_us += (static_cast<double>(us) - latency_us) / 8;
+            per_trade_us += (per_trade - per_trade_us) / 8;
+        }
+        ++flushes;
+
+        stats.record(pending, reason);
+        if (queue_depth >= target_size) {
+            target_size *= 2;
+        }
+        else if (reason == FlushReason::Deadline || reason == FlushReason::Idle) {
+            target_size /= 2;
+        }
+        target_size = std::clamp(target_size, min_batch, slo_cap());
+        stats.target = target_size;
+        stats.db_latency = std::chrono::microseconds(static_cast<int64_t>(latency_us));
+        pending = 0;
+    }
+
+    size_t target() const { return target_size; }
+    size_t pending_count() const { return pending; }
+    const BatchStats& statistics() const { return stats; }
+
+    // Clears the counters (not the target or latency estimates), for
+    // interval reports.
+    void reset_stats() {
+        stats = BatchStats{};
+        stats.target = target_size;
+        stats.db_latency = std::chrono::microseconds(static_cast<int64_t>(latency_us));
+    }
+
+private:
+    // Expected time to send the current batch
+    std::chrono::microseconds flush_estimate() const {
+        return std::chrono::microseconds(static_cast<int64_t>(std::max(latency_us, per_trade_us * static_cast<double>(pending))));
+    }
+
+    // Largest batch the database should write within half the SLO
+    size_t slo_cap() const {
+        if (per_trade_us <= 0) return max_batch;
+        double cap = static_cast<double>(latency_slo.count()) / 2 / per_trade_us;
+        return cap >= static_cast<double>(max_batch) ? max_batch : std::max(min_batch, static_cast<size_t>(cap));
+    }
+
+    size_t min_batch;
+    size_t max_batch;
+    std::chrono::microseconds latency_slo;
+    std::chrono::microseconds idle_gap;
+    size_t target_size;
+
+    size_t pending = 0;
+    Clock::time_point oldest;
+    Clock::time_point last_add;
+
+    uint64_t flushes = 0;
+    double latency_us = 0;     // Smoothed time per flush
+    double per_trade_us = 0;   // Smoothed time per flushed trade
+    BatchStats stats;
+};
@@ -0,0 +1,353 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// ------------------------------------------
+// Log records: levels, call sites and formats
+// ------------------------------------------
+// Shared by AsyncLogger, which writes records, and the offline decoder,
+// which reads binary logs back as text.
+
+enum class LogLevel : uint8_t {
+    Debug,
+    Info,
+    Warn,
+    Error
+};
+
+inline char log_level_letter(LogLevel level) {
+    static const char letters[] = {'D', 'I', 'W', 'E'};
+    return letters[static_cast<size_t>(level) & 3];
+}
+
+// "HH:MM:SS.uuuuuu L " in UTC. `out` needs room for 32 bytes.
+inline size_t format_log_prefix(char* out, int64_t time_ns, LogLevel level) {
+    std::time_t seconds = static_cast<std::time_t>(time_ns / 1000000000);
+    std::tm tm{};
+    gmtime_r(&seconds, &tm);
+    int n = std::snprintf(out, 32, "%02d:%02d:%02d.%06lld %c ", tm.tm_hour, tm.tm_min, tm.tm_sec,
+                          static_cast<long long>(time_ns % 1000000000 / 1000), log_level_letter(level));
+    return n > 0 ? static_cast<size_t>(n) : 0;
+}
+
+// A log statement with a fixed format, where each {} is replaced by the
+// next argument. Declare it static at the call site:
+//
+//   static LogSite badCusip("[Producer {}] Invalid CUSIP {}, dropping trade");
+//   logger.warn(badCusip, producerId, trade.cusip);
+//
+// In binary mode the logger records only the site's id and the raw
+// arguments; the format is written to the log once, the first time the
+// site is used.
+class LogSite {
+public:
+    constexpr explicit LogSite(const char* format) : format(format) {}
+
+    LogSite(const LogSite&) = delete;
+    LogSite& operator=(const LogSite&) = delete;
+
+    const char* text() const { return format; }
+
+    uint32_t id() {
+        uint32_t v = site_id.load(std::memory_order_acquire);
+        return v != 0 ? v : assign_id();
+    }
+
+    // Format of a registered id, or nullptr
+    static const char* format_of(uint32_t id) {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        return id < registry().size() ? registry()[id] : nullptr;
+    }
+
+private:
+    uint32_t assign_id() {
+        std::lock_guard<std::mutex> lock(registry_mutex());
+        uint32_t v = site_id.load(std::memory_order_relaxed);
+        if (v == 0) {
+            v = static_cast<uint32_t>(registry().size());
+            registry().push_back(format);
+            site_id.store(v, std::memory_order_release);
+        }
+        return v;
+    }
+
+    // Id 0 is the plain-text format used for lines logged without a site
+    static std::vector<const char*>& registry() {
+        static std::vector<const char*> formats{"{}"};
+        return formats;
+    }
+
+    static std::mutex& registry_mutex() {
+        static std::mutex m;
+        return m;
+    }
+
+    const char* format;
+    std::atomic<uint32_t> site_id{0};
+};
+
+// ---------------------------
+// Binary argument encoding
+// ---------------------------
+// Each argument is a one-byte tag and its raw value in host byte order:
+// integers widened to 8 bytes, doubles as their bits, strings as a 2-byte
+// length and the bytes. A record's arguments fill a fixed-size payload;
+// whatever doesn't fit is cut and the record marked truncated.
+enum class LogArgTag : uint8_t {
+    Signed = 1,
+    Unsigned = 2,
+    Double = 3,
+    String = 4,
+    Bool = 5,
+    Char = 6
+};
+
+class LogArgWriter {
+public:
+    LogArgWriter(char* data, size_t capacity) : data(data), capacity(capacity) {}
+
+    template<typename T>
+    void scalar(LogArgTag tag, T value) {
+        if (length + 1 + sizeof(T) > capacity) {
+            truncated = true;
+            return;
+        }
+        data[length++] = static_cast<char>(tag);
+        std::memcpy(data + length, &value, sizeof(T));
+        length += sizeof(T);
+    }
+
+    void string(std::string_view s) {
+        if (length + 3 > capacity) {
+            truncated = true;
+            return;
+        }
+        size_t n = std::min(s.size(), capacity - length - 3);
+        if (n < s.size()) truncated = true;
+        uint16_t n16 = static_cast<uint16_t>(n);
+        data[length++] = static_cast<char>(LogArgTag::String);
+        std::memcpy(data + length, &n16, 2);
+        std::memcpy(data + length + 2, s.data(), n);
+        length += 2 + n;
+    }
+
+    // Reserves a string argument to be filled in place; see commit_string().
+    char* begin_string(size_t& room) {
+        if (length + 3 > capacity) {
+            truncated = true;
+            room = 0;
+            return nullptr;
+        }
+        room = capacity - length - 3;
+        return data + length + 3;
+    }
+
+    void commit_string(size_t n) {
+        uint16_t n16 = static_cast<uint16_t>(n);
+        data[length] = static_cast<char>(LogArgTag::String);
+        std::memcpy(data + length + 1, &n16, 2);
+        length += 3 + n;
+    }
+
+    size_t size() const { return length; }
+    bool was_truncated() const { return truncated; }
+    void mark_truncated() { truncated = true; }
+
+private:
+    char* data;
+    size_t capacity;
+    size_t length = 0;
+    bool truncated = false;
+};
+
+// Renders the arguments in `payload` into `format`. Placeholders beyond the
+// last argument are left as they are and extra arguments are appended.
+inline bool render_log_message(std::string_view format, std::string_view payload, std::string& out) {
+    auto next_arg = [&](std::string& arg) {
+        if (payload.empty()) return false;
+        auto tag = static_cast<LogArgTag>(payload[0]);
+        payload.remove_prefix(1);
+        char buf[32];
+        auto take = [&](void* dst, size_t n) {
+            if (payload.size() < n) return false;
+            std::memcpy(dst, payload.data(), n);
+            payload.remove_prefix(n);
+            return true;
+        };
+        auto number = [&](auto v) {
+            auto r = std::to_chars(buf, buf + sizeof(buf), v);
+            arg.assign(buf, r.ptr);
+        };
+        switch (tag) {
+            case LogArgTag::Signed: { int64_t v; if (!take(&v, 8)) return false; number(v); return true; }
+            case LogArgTag::Unsigned: { uint64_t v; if (!take(&v, 8)) return false; number(v); return true; }
+            case LogArgTag::Double: { double v; if (!take(&v, 8)) return false; number(v); return true; }
+            case LogArgTag::Bool: { uint8_t v; if (!take(&v, 1)) return false; arg = v ? "true" : "false"; return true; }
+            case LogArgTag::Char: { char v; if (!take(&v, 1)) return false; arg.assign(1, v); return true; }
+            case LogArgTag::String: {
+                uint16_t n;
+                if (!take(&n, 2) || payload.size() < n) return false;
+                arg.assign(payload.data(), n);
+                payload.remove_prefix(n);
+                return true;
+            }
+        }
+        return false;
+    };
+
+    std::string arg;
+    size_t pos = 0;
+    bool ok = true;
+    while (pos < format.size()) {
+        size_t brace = format.find("{}", pos);
+        if (brace == std::string_view::npos) break;
+        if (!next_arg(arg)) {
+            ok = payload.empty();
+            break;
+        }
+        out.append(format.substr(pos, brace - pos));
+        out += arg;
+        pos = brace + 2;
+    }
+    out.append(format.substr(pos));
+    while (ok && !payload.empty()) {
+        if (!next_arg(arg)) return false;
+        out += ' ';
+        out += arg;
+    }
+    return ok;
+}
+
+// -------------------------
+// Binary log file framing
+// -------------------------
+// A header, then frames in host byte order:
+// - 'F': u32 format id, u16 length, format text. Written before the first
+//   record that uses the format.
+// - 'R': i64 time in ns since the epoch, u8 level, u8 flags (1 = truncated),
+//   u32 format id, u16 payload length, payload.
+constexpr char BINARY_LOG_MAGIC[8] = {'T', 'R', 'B', 'I', 'N', 'L', 'O', 'G'};
+constexpr uint32_t BINARY_LOG_VERSION = 1;
+
+inline void write_binary_log_header(std::ostream& out) {
+    out.write(BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC));
+    out.write(reinterpret_cast<const char*>(&BINARY_LOG_VERSION), 4);
+}
+
+inline void write_binary_log_format(std::ostream& out, uint32_t id, std::string_view format) {
+    uint16_t n = static_cast<uint16_t>(std::min<size_t>(format.size(), UINT16_MAX));
+    out.put('F');
+    out.write(reinterpret_cast<const char*>(&id), 4);
+    out.write(reinterpret_cast<const char*>(&n), 2);
+    out.write(format.data(), n);
+}
+
+inline void write_binary_log_record(std::ostream& out, int64_t time_ns, LogLevel level, bool truncated,
+                                    uint32_t id, const char* payload, uint16_t length) {
+    char header[1 + 8 + 1 + 1 + 4 + 2];
+    header[0] = 'R';
+    std::memcpy(header + 1, &time_ns, 8);
+    header[9] = static_cast<char>(level);
+    header[10] = truncated ? 1 : 0;
+    std::memcpy(header + 11, &id, 4);
+    std::memcpy(header + 15, &length, 2);
+    out.write(header, sizeof(header));
+    out.write(payload, length);
+}
+
+// Decodes a binary log into the same lines the text logger writes. Stops
+// with an error at anything malformed, including a frame cut short by a
+// crash, after writing every complete record before it.
+inline bool decode_binary_log(std::istream& in, std::ostream& out, std::string& error) {
+    char magic[8];
+    uint32_t version = 0;
+    if (!in.read(magic, 8) || std::memcmp(magic, BINARY_LOG_MAGIC, 8) != 0 ||
+        !in.read(reinterpret_cast<char*>(&version), 4)) {
+        error = "not a binary log";
+        return false;
+    }
+    if (version != BINARY_LOG_VERSION) {
+        error = "unsupported binary log version " + std::to_string(version);
+        return false;
+    }
+
+    std::vector<std::string> formats;
+    std::vector<bool> known;
+    std::string payload, line;
+    uint64_t records = 0;
+    int kind;
+    while ((kind = in.get()) != std::char_traits<char>::eof()) {
+        if (kind == 'F') {
+            uint32_t id;
+            uint16_t n;
+            std::string text;
+            if (!in.read(reinterpret_cast<char*>(&id), 4) || !in.read(reinterpret_cast<char*>(&n), 2)) break;
+            text.resize(n);
+            if (!in.read(text.data(), n)) break;
+            if (id >= formats.size()) {
+                formats.resize(id + 1);
+                known.resize(id + 1);
+            }
+            formats[id] = std::move(text);
+            known[id] = true;
+        }
+        else if (kind == 'R') {
+            char header[16];
+            if (!in.read(header, sizeof(header))) break;
+            int64_t time_ns;
+            uint32_t id;
+            uint16_t n;
+            std::memcpy(&time_ns, header, 8);
+            auto level = static_cast<LogLevel>(header[8]);
+            bool truncated = header[9] & 1;
+            std::memcpy(&id, header + 10, 4);
+            std::memcpy(&n, header + 14, 2);
+            payload.resize(n);
+            if (!in.read(payload.data(), n)) break;
+
+            std::string_view format = id == 0 ? std::string_view("{}") : std::string_view();
+            if (id != 0) {
+                if (id >= known.size() || !known[id]) {
+                    error = "record " + std::to_string(records) + " uses undefined format " + std::to_string(id);
+                    return false;
+                }
+                format = formats[id];
+            }
+
+            char prefix[32];
+            line.assign(prefix, format_log_prefix(prefix, time_ns, level));
+            if (!render_log_message(format, payload, line)) {
+                error = "record " + std::to_string(records) + " has malformed arguments";
+                return false;
+            }
+            while (!line.empty() && line.back() == '\n') line.pop_back();
+            if (truncated) line += "...";
+            line += '\n';
+            out << line;
+            ++records;
+        }
+        else {
+            error = "unknown frame after record " + std::to_string(records);
+            return false;
+        }
+    }
+    if (kind != std::char_traits<char>::eof()) {
+        // Left the loop on a short read
+        error = "log ends mid-frame after record " + std::to_string(records);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+// ---------------------
+// Tool command lines
+// ---------------------
+// The flag parsing shared by trace_generator and pipeline_bench. Flags are
+// "--name value" pairs, plus value-less switches and --help.
+
+// A non-negative number
+inline bool parse_number(std::string_view s, double& out) {
+    std::string text(s);
+    char* end = nullptr;
+    errno = 0;
+    double v = std::strtod(text.c_str(), &end);
+    if (text.empty() || *end != '\0' || errno != 0 || v < 0) return false;
+    out = v;
+    return true;
+}
+
+// A non-negative whole number
+template<typename T>
+bool parse_count(std::string_view s, T& out) {
+    double v = 0;
+    if (!parse_number(s, v) || v != static_cast<double>(static_cast<uint64_t>(v))) return false;
+    out = static_cast<T>(v);
+    return true;
+}
+
+// Walks argv. --help and -h set `help`. `on_switch(flag)` returns true if
+// it took `flag` as a switch. Any other flag needs a value, and
+// `on_value(flag, value, ok)` returns false for a flag it doesn't know,
+// or sets `ok` false for a bad value.
+template<typename OnSwitch, typename OnValue>
+bool parse_flags(int argc, char** argv, bool& help, std::string& error, OnSwitch on_switch, OnValue on_value) {
+    for (int i = 1; i < argc; ++i) {
+        std::string_view flag = argv[i];
+        if (flag == "--help" || flag == "-h") {
+            help = true;
+            continue;
+        }
+        if (on_switch(flag)) continue;
+        if (i + 1 >= argc) {
+            error = std::string(flag) + " needs a value";
+            return false;
+        }
+        std::string_view value = argv[++i];
+        bool ok = true;
+        if (!on_value(flag, value, ok)) {
+            error = "unknown option " + std::string(flag);
+            return false;
+        }
+        if (!ok) {
+            error = "bad value for " + std::string(flag) + ": " + std::string(value);
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,253 @@
+#pragma once
+#include <libpq-fe.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// ------------------------------
+// PostgreSQL connection pool
+// ------------------------------
+// A fixed number of connections shared by any number of threads, so writer
+// threads and connections can be sized separately. A thread holds a Lease
+// for as long as it needs one connection (one insert, one COPY batch, or a
+// whole pipeline session) and the connection goes back when the Lease is
+// destroyed.
+//
+// Connections heal themselves:
+// - A connection returned broken (or left mid-transaction, or in pipeline
+//   or non-blocking mode) is closed and reopened on its next use.
+// - A connection idle for health_interval is checked with a trivial query
+//   before it's handed out.
+// - Failed connects back off per slot, doubling from 100 ms to max_backoff,
+//   while other slots keep serving.
+//
+// Each connection remembers which statements have been prepared on it, so
+// Lease::prepare() costs a round trip only the first time per session.
+class ConnectionPool {
+    struct Slot {
+        PGconn* conn = nullptr;
+        bool busy = false;
+        uint64_t session = 0;
+        std::unordered_set<std::string> prepared;
+        std::chrono::milliseconds backoff{0};
+        std::chrono::steady_clock::time_point retry_at{};
+        std::chrono::steady_clock::time_point last_used{};
+    };
+
+public:
+    using Clock = std::chrono::steady_clock;
+
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept : pool(std::exchange(other.pool, nullptr)), index(other.index) {}
+        Lease& operator=(Lease&& other) noexcept {
+            if (this != &other) {
+                release();
+                pool = std::exchange(other.pool, nullptr);
+                index = other.index;
+            }
+            return *this;
+        }
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { release(); }
+
+        explicit operator bool() const { return pool != nullptr; }
+        PGconn* get() const { return pool ? pool->slots[index].conn : nullptr; }
+
+        // Changes every time the connection is reopened, so callers can tell
+        // when session state such as temp tables has to be set up again.
+        uint64_t session() const { return pool ? pool->slots[index].session : 0; }
+
+        // Prepares `sql` as `name` unless this session already has it.
+        bool prepare(const char* name, const std::string& sql, int param_count, const Oid* param_types) {
+            if (!pool) return false;
+            Slot& slot = pool->slots[index];
+            if (slot.prepared.count(name)) return true;
+
+            PGresult* res = PQprepare(slot.conn, name, sql.c_str(), param_count, param_types);
+            bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+            if (ok) {
+                slot.prepared.insert(name);
+            }
+            else {
+                std::cerr << "Prepare of " << name << " failed: " << PQerrorMessage(slot.conn) << "\n";
+            }
+            PQclear(res);
+            return ok;
+        }
+
+        // Returns the connection to be closed and reopened, for when the
+        // caller has left it in a state nobody else should inherit.
+        void discard() {
+            if (pool) pool->close(pool->slots[index]);
+            release();
+        }
+
+        void release() {
+            if (pool) pool->release(index);
+            pool = nullptr;
+        }
+
+    private:
+        friend class ConnectionPool;
+        Lease(ConnectionPool* pool, size_t index) : pool(pool), index(index) {}
+
+        ConnectionPool* pool = nullptr;
+        size_t index = 0;
+    };
+
+    ConnectionPool(std::string conninfo, size_t size,
+                   std::chrono::milliseconds max_backoff = std::chrono::seconds(5),
+                   std::chrono::seconds health_interval = std::chrono::seconds(30))
+        : conninfo(std::move(conninfo)),
+          slots(std::max<size_t>(size, 1)),
+          max_backoff(max_backoff),
+          health_interval(health_interval) {}
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    ~ConnectionPool() {
+        for (Slot& slot : slots) close(slot);
+    }
+
+    // Opens every connection up front and returns how many succeeded. The
+    // rest are retried by acquire().
+    size_t connect_all() {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t healthy = 0;
+        for (Slot& slot : slots) {
+            if (!slot.conn && !slot.busy) connect(slot);
+            if (slot.conn) ++healthy;
+        }
+        return healthy;
+    }
+
+    // Waits up to `timeout` for a healthy connection. Returns an empty Lease
+    // if none became available, for example while the database is down.
+    Lease acquire(std::chrono::milliseconds timeout = std::chrono::milliseconds(1000)) {
+        auto deadline = Clock::now() + timeout;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            auto now = Clock::now();
+            Clock::time_point next_retry = deadline;
+            size_t reconnect = slots.size();
+
+            for (size_t i = 0; i < slots.size(); ++i) {
+                Slot& slot = slots[i];
+                if (slot.busy) continue;
+                if (slot.conn) {
+                    slot.busy = true;
+                    if (now - slot.last_used < health_interval) return Lease(this, i);
+
+                    // Idle a while: make sure the server still answers
+                    lock.unlock();
+                    bool alive = healthy(slot.conn);
+                    lock.lock();
+                    if (alive) return Lease(this, i);
+                    close(slot);
+                    slot.busy = false;
+                    reconnect = std::min(reconnect, i);
+                }
+                else if (slot.retry_at <= now) {
+                    reconnect = std::min(reconnect, i);
+                }
+                else {
+                    next_retry = std::min(next_retry, slot.retry_at);
+                }
+            }
+
+            if (reconnect < slots.size()) {
+                Slot& slot = slots[reconnect];
+                slot.busy = true;
+                lock.unlock();
+                bool ok = connect(slot);
+                lock.lock();
+                if (ok) return Lease(this, reconnect);
+                slot.busy = false;
+                next_retry = std::min(next_retry, slot.retry_at);
+                continue;
+            }
+
+            if (Clock::now() >= deadline) return Lease();
+            released.wait_until(lock, next_retry);
+        }
+    }
+
+    size_t size() const { return slots.size(); }
+    uint64_t reconnect_count() const { return reconnects.load(std::memory_order_relaxed); }
+
+private:
+    static bool healthy(PGconn* conn) {
+        if (PQstatus(conn) != CONNECTION_OK) return false;
+        PGresult* res = PQexec(conn, "SELECT 1");
+        bool ok = PQresultStatus(res) == PGRES_TUPLES_OK;
+        PQclear(res);
+        return ok;
+    }
+
+    // Opens slot's connection. Called either under the mutex or with the
+    // slot marked busy, so nobody else touches it meanwhile.
+    bool connect(Slot& slot) {
+        PGconn* conn = PQconnectdb(conninfo.c_str());
+        auto now = Clock::now();
+        if (PQstatus(conn) != CONNECTION_OK) {
+            slot.backoff = std::clamp<std::chrono::milliseconds>(slot.backoff * 2, std::chrono::milliseconds(100),
+                                                                 max_backoff);
+            slot.retry_at = now + slot.backoff;
+            std::cerr << "[Pool] DB connection failed, retrying in " << slot.backoff.count()
+                      << " ms: " << PQerrorMessage(conn);
+            PQfinish(conn);
+            return false;
+        }
+        if (slot.session != 0) reconnects.fetch_add(1, std::memory_order_relaxed);
+        slot.conn = conn;
+        slot.session = sessions.fetch_add(1, std::memory_order_relaxed) + 1;
+        slot.backoff = std::chrono::milliseconds(0);
+        slot.last_used = now;
+        return true;
+    }
+
+    void close(Slot& slot) {
+        if (slot.conn) PQfinish(slot.conn);
+        slot.conn = nullptr;
+        slot.prepared.clear();
+        slot.retry_at = Clock::now();
+    }
+
+    void release(size_t index) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Slot& slot = slots[index];
+            if (slot.conn && (PQstatus(slot.conn) != CONNECTION_OK ||
+                              PQtransactionStatus(slot.conn) != PQTRANS_IDLE ||
+                              PQpipelineStatus(slot.conn) != PQ_PIPELINE_OFF || PQisnonblocking(slot.conn))) {
+                close(slot);
+            }
+            slot.last_used = Clock::now();
+            slot.busy = false;
+        }
+        released.notify_one();
+    }
+
+    std::string conninfo;
+    std::vector<Slot> slots;
+    std::chrono::milliseconds max_backoff;
+    std::chrono::seconds health_interval;
+
+    std::mutex mutex;
+    std::condition_variable released;
+    std::atomic<uint64_t> sessions{0};
+    std::atomic<uint64_t> reconnects{0};
+};
@@ -0,0 +1,302 @@
+#pragma once
+#include <libpq-fe.h>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "trade.h"
+
+// -------------------------------
+// COPY text format for trade rows
+// -------------------------------
+// One row per line, columns separated by tabs in TRADE_COLUMNS order. NULL
+// is \N, and backslash, tab, newline and carriage return inside values are
+// backslash-escaped. Numbers use the shortest form that round-trips, so a
+// price of 101.25 is sent as "101.25" and stored exactly in numeric columns.
+
+inline void append_copy_text(std::string& out, std::string_view value) {
+    for (char c : value) {
+        switch (c) {
+            case '\\': out += "\\\\"; break;
+            case '\t': out += "\\t"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            default: out += c;
+        }
+    }
+}
+
+template<typename T>
+void append_copy_number(std::string& out, T value, bool present) {
+    if (!present) {
+        out += "\\N";
+        return;
+    }
+    char buf[32];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    out.append(buf, result.ptr);
+}
+
+inline void append_copy_row(std::string& out, const Trade& t) {
+    append_copy_text(out, t.control_id.view());                 out += '\t';
+    append_copy_number(out, t.coupon, t.has_coupon);            out += '\t';
+    append_copy_text(out, t.cusip.view());                      out += '\t';
+    append_copy_number(out, t.dealer_id, t.has_dealer_id);      out += '\t';
+    append_copy_text(out, t.exec_time.view());                  out += '\t';
+    append_copy_text(out, t.industry.view());                   out += '\t';
+    append_copy_text(out, t.issuer.view());                     out += '\t';
+    append_copy_text(out, t.maturity.view());                   out += '\t';
+    append_copy_text(out, t.modifier3.view());                  out += '\t';
+    append_copy_number(out, t.price, t.has_price);              out += '\t';
+    append_copy_text(out, t.rating.view());                     out += '\t';
+    append_copy_text(out, t.report_time.view());                out += '\t';
+    append_copy_text(out, t.reporting_capacity.view());         out += '\t';
+    append_copy_text(out, t.side.view());                       out += '\t';
+    append_copy_number(out, t.volume, t.has_volume);            out += '\n';
+}
+
+// ---------------------------
+// Batched COPY sink for trades
+// ---------------------------
+// Trades are formatted into one buffer as they arrive and sent with a single
+// COPY trades FROM STDIN once the batch is full or the oldest trade has
+// waited max_latency, whichever comes first. The caller drives the deadline
+// by calling flush_if_due() while it has nothing else to do.
+//
+// A COPY is all-or-nothing, so a batch the server rejects is split in half
+// and each half retried, down to single rows. Only rows the server rejects
+// on their own are dropped, counted as failed and listed by rejected(), so
+// one bad trade costs that trade rather than its whole batch. Rows that
+// haven't been sent because there's no working connection stay buffered,
+// so the caller can retry them after use()-ing another one, or discard()
+// them before closing the dead connection.
+//
+// COPY has no ON CONFLICT clause. With CopyConflicts::Skip, each batch is
+// copied into a temporary staging table instead and moved over with
+// INSERT ... SELECT ... ON CONFLICT DO NOTHING in one transaction, so rows
+// that hit a unique index on trades are skipped rather than failing the
+// batch. That makes replays and redundant feeds idempotent, given an index
+// such as:
+//
+//   CREATE UNIQUE INDEX ON trades (control_id, side, dealer_id, exec_time);
+enum class CopyConflicts {
+    Fail,
+    Skip
+};
+
+class CopySink {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    CopySink(PGconn* conn, size_t batch_size, std::chrono::microseconds max_latency,
+             CopyConflicts conflicts = CopyConflicts::Fail)
+        : conn(conn), batch_size(batch_size), max_latency(max_latency), conflicts(conflicts) {
+        buffer.reserve(batch_size * 160);
+    }
+
+    CopySink(const CopySink&) = delete;
+    CopySink& operator=(const CopySink&) = delete;
+
+    ~CopySink() { flush(); }
+
+    // Switches to another connection, e.g. one leased from a pool for this
+    // batch. `session` identifies the connection's lifetime; when it changes,
+    // per-session setup such as the staging table is redone.
+    void use(PGconn* conn, uint64_t session) {
+        this->conn = conn;
+        if (session != this->session) {
+            this->session = session;
+            staging_ready = false;
+        }
+    }
+
+    // Buffers a trade, flushing if that fills the batch. Returns false if a
+    // flush was attempted and failed.
+    bool add(const Trade& trade) {
+        if (rows == 0) oldest = Clock::now();
+        append_copy_row(buffer, trade);
+        ++rows;
+        return rows < batch_size || flush();
+    }
+
+    bool flush_if_due(Clock::time_point now = Clock::now()) {
+        return rows == 0 || now - oldest < max_latency || flush();
+    }
+
+    // Sends everything buffered. Returns true if every row was written or
+    // skipped, including when there was nothing to send. Returns false with
+    // rows still pending() if the connection failed before they were sent.
+    bool flush() {
+        if (rows == 0) return true;
+        if (batch_sent == 0) rejected_rows.clear();
+
+        // Runs of rows still to send, in reverse order so the next is last
+        struct Run {
+            size_t offset;
+            size_t rows;
+        };
+        std::vector<Run> runs{{0, rows}};
+        size_t done = 0;   // Rows of this call's buffer that are dealt with
+        while (!runs.empty()) {
+            Run run = runs.back();
+            runs.pop_back();
+            size_t end = runs.empty() ? buffer.size() : runs.back().offset;
+            std::string_view data(buffer.data() + run.offset, end - run.offset);
+
+            size_t in_conflict = 0;
+            bool ok = conflicts == CopyConflicts::Skip ? send_skipping_conflicts(data, in_conflict)
+                                                       : send("trades", data);
+            if (!ok && (!conn || PQstatus(conn) != CONNECTION_OK)) {
+                // Never reached the server, or lost it mid-batch: keep the
+                // rows not yet sent
+                if (!last_error.empty()) std::cerr << "COPY failed: " << last_error;
+                buffer.erase(0, run.offset);
+                rows -= done;
+                batch_sent += done;
+                return false;
+            }
+            if (ok) {
+                rows_written += run.rows - in_conflict;
+                rows_skipped += in_conflict;
+            }
+            else if (run.rows == 1) {
+                std::cerr << "COPY rejected a trade, dropping it: " << last_error;
+                rejected_rows.push_back(batch_sent + done);
+                ++rows_failed;
+            }
+            else {
+                if (run.rows == rows) {
+                    std::cerr << "COPY of " << rows << " trades rejected, retrying in smaller batches: "
+                              << last_error;
+                }
+                size_t half = run.rows / 2;
+                size_t split = run.offset;
+                for (size_t i = 0; i < half; ++i) split = buffer.find('\n', split) + 1;
+                runs.push_back({split, run.rows - half});
+                runs.push_back({run.offset, half});
+                continue;
+            }
+            done += run.rows;
+        }
+
+        ++batches;
+        buffer.clear();
+        rows = 0;
+        batch_sent = 0;
+        return rejected_rows.empty();
+    }
+
+    // Drops buffered rows without sending them, e.g. because the caller will
+    // replay them from its own log on the next connection.
+    void discard() {
+        buffer.clear();
+        rows = 0;
+        batch_sent = 0;
+        rejected_rows.clear();
+    }
+
+    // Positions, in the order they were added, of the rows the last batch
+    // dropped because the server rejected them
+    const std::vector<size_t>& rejected() const { return rejected_rows; }
+
+    size_t pending() const { return rows; }
+    uint64_t written() const { return rows_written; }
+    uint64_t failed() const { return rows_failed; }
+    uint64_t skipped() const { return rows_skipped; }
+    uint64_t batch_count() const { return batches; }
+
+private:
+    // COPYs `data`, whole rows from the buffer, into `table`. On failure
+    // last_error says why.
+    bool send(const char* table, std::string_view data) {
+        last_error.clear();
+        if (!conn) return false;
+
+        std::string statement = std::string("COPY ") + table + " (" + TRADE_COLUMNS + ") FROM STDIN";
+        PGresult* res = PQexec(conn, statement.c_str());
+        if (PQresultStatus(res) != PGRES_COPY_IN) {
+            last_error = PQerrorMessage(conn);
+            PQclear(res);
+            return false;
+        }
+        PQclear(res);
+
+        bool sent = PQputCopyData(conn, data.data(), static_cast<int>(data.size())) == 1;
+        if (PQputCopyEnd(conn, sent ? nullptr : "client failed to send rows") != 1) {
+            sent = false;
+        }
+
+        bool ok = sent;
+        while ((res = PQgetResult(conn)) != nullptr) {
+            if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+                last_error = PQresultErrorMessage(res);
+                ok = false;
+            }
+            PQclear(res);
+        }
+        if (!ok && last_error.empty()) last_error = PQerrorMessage(conn);
+        return ok;
+    }
+
+    bool exec(const char* sql, std::string* affected = nullptr) {
+        PGresult* res = PQexec(conn, sql);
+        bool ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+        if (!ok) {
+            last_error = PQerrorMessage(conn);
+        }
+        else if (affected) {
+            *affected = PQcmdTuples(res);
+        }
+        PQclear(res);
+        return ok;
+    }
+
+    // Sets `in_conflict` to how many of the rows in `data` were skipped
+    bool send_skipping_conflicts(std::string_view data, size_t& in_conflict) {
+        last_error.clear();
+        if (!conn) return false;
+        if (!staging_ready) {
+            staging_ready = exec("CREATE TEMP TABLE IF NOT EXISTS trades_staging "
+                                 "(LIKE trades INCLUDING DEFAULTS) ON COMMIT DELETE ROWS");
+            if (!staging_ready) return false;
+        }
+
+        std::string insert = std::string("INSERT INTO trades (") + TRADE_COLUMNS + ") SELECT " + TRADE_COLUMNS +
+                             " FROM trades_staging ON CONFLICT DO NOTHING";
+        std::string inserted;
+        if (exec("BEGIN") && send("trades_staging", data) && exec(insert.c_str(), &inserted) && exec("COMMIT")) {
+            size_t count = static_cast<size_t>(std::count(data.begin(), data.end(), '\n'));
+            in_conflict = count - std::min<size_t>(count, std::strtoull(inserted.c_str(), nullptr, 10));
+            return true;
+        }
+        if (PQstatus(conn) == CONNECTION_OK) {
+            std::string error = std::move(last_error);
+            exec("ROLLBACK");
+            last_error = std::move(error);
+        }
+        return false;
+    }
+
+    PGconn* conn;
+    size_t batch_size;
+    std::chrono::microseconds max_latency;
+    CopyConflicts conflicts;
+    uint64_t session = 0;
+    bool staging_ready = false;
+    std::string buffer;
+    size_t rows = 0;
+    size_t batch_sent = 0;   // Rows of the held batch sent before its connection failed
+    std::vector<size_t> rejected_rows;
+    std::string last_error;
+    Clock::time_point oldest;
+    uint64_t rows_written = 0;
+    uint64_t rows_failed = 0;
+    uint64_t rows_skipped = 0;
+    uint64_t batches = 0;
+};
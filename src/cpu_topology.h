@@ -0,0 +1,289 @@
+#pragma once
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// -----------------------------
+// CPU and NUMA topology (Linux)
+// -----------------------------
+// Read from sysfs rather than libnuma, so there's nothing extra to link:
+// /sys/devices/system/cpu/online lists the CPUs, each CPU's topology/
+// directory gives its package (socket) and core, and
+// /sys/devices/system/node/nodeN/cpulist says which CPUs belong to NUMA
+// node N. Machines without node directories are reported as one node.
+
+struct CpuInfo {
+    int cpu = 0;
+    int core = 0;
+    int package = 0;
+    int node = 0;
+};
+
+// Parses a kernel CPU list such as "0-3,8,10-11".
+inline bool parse_cpu_ranges(std::string_view text, std::vector<int>& cpus) {
+    cpus.clear();
+    while (!text.empty() && (text.back() == '\n' || text.back() == ' ')) text.remove_suffix(1);
+    while (!text.empty()) {
+        size_t comma = text.find(',');
+        std::string_view range = text.substr(0, comma);
+        text = comma == std::string_view::npos ? std::string_view() : text.substr(comma + 1);
+
+        size_t dash = range.find('-');
+        int first = 0, last = 0;
+        auto number = [](std::string_view s, int& out) {
+            if (s.empty() || s.size() > 6) return false;
+            out = 0;
+            for (char c : s) {
+                if (c < '0' || c > '9') return false;
+                out = out * 10 + (c - '0');
+            }
+            return true;
+        };
+        if (!number(range.substr(0, dash), first)) return false;
+        last = first;
+        if (dash != std::string_view::npos && !number(range.substr(dash + 1), last)) return false;
+        if (last < first) return false;
+        for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+    }
+    return true;
+}
+
+class CpuTopology {
+public:
+    // Reads the topology under `root`, normally /sys/devices/system.
+    static CpuTopology detect(const std::string& root = "/sys/devices/system") {
+        CpuTopology t;
+        std::vector<int> online;
+        if (!parse_cpu_ranges(read_file(root + "/cpu/online"), online) || online.empty()) {
+            long n = sysconf(_SC_NPROCESSORS_ONLN);
+            for (int cpu = 0; cpu < std::max(1L, n); ++cpu) online.push_back(cpu);
+        }
+        for (int cpu : online) {
+            CpuInfo info;
+            info.cpu = cpu;
+            std::string dir = root + "/cpu/cpu" + std::to_string(cpu) + "/topology/";
+            info.core = read_int(dir + "core_id", cpu);
+            info.package = read_int(dir + "physical_package_id", 0);
+            t.cpu_list.push_back(info);
+        }
+
+        std::vector<int> nodes;
+        if (parse_cpu_ranges(read_file(root + "/node/online"), nodes)) {
+            for (int node : nodes) {
+                std::vector<int> cpus;
+                if (!parse_cpu_ranges(read_file(root + "/node/node" + std::to_string(node) + "/cpulist"), cpus)) {
+                    continue;
+                }
+                for (CpuInfo& info : t.cpu_list) {
+                    if (std::find(cpus.begin(), cpus.end(), info.cpu) != cpus.end()) info.node = node;
+                }
+                t.node_count = std::max(t.node_count, node + 1);
+            }
+        }
+        return t;
+    }
+
+    const std::vector<CpuInfo>& cpus() const { return cpu_list; }
+    int nodes() const { return node_count; }
+
+    int packages() const {
+        int n = 0;
+        for (const CpuInfo& info : cpu_list) n = std::max(n, info.package + 1);
+        return n;
+    }
+
+    // nullptr if `cpu` isn't online
+    const CpuInfo* find(int cpu) const {
+        for (const CpuInfo& info : cpu_list) {
+            if (info.cpu == cpu) return &info;
+        }
+        return nullptr;
+    }
+
+    // Node of `cpu`, or -1 if it isn't online
+    int node_of(int cpu) const {
+        const CpuInfo* info = find(cpu);
+        return info ? info->node : -1;
+    }
+
+    std::vector<int> cpus_on_node(int node) const {
+        std::vector<int> out;
+        for (const CpuInfo& info : cpu_list) {
+            if (info.node == node) out.push_back(info.cpu);
+        }
+        return out;
+    }
+
+private:
+    static std::string read_file(const std::string& path) {
+        std::ifstream in(path);
+        std::string text;
+        std::getline(in, text);
+        return text;
+    }
+
+    static int read_int(const std::string& path, int fallback) {
+        std::string text = read_file(path);
+        if (text.empty()) return fallback;
+        char* end = nullptr;
+        long v = std::strtol(text.c_str(), &end, 10);
+        return end != text.c_str() ? static_cast<int>(v) : fallback;
+    }
+
+    std::vector<CpuInfo> cpu_list;
+    int node_count = 1;
+};
+
+// Compact "0-3,8" rendering of a sorted CPU list, for reports
+inline std::string format_cpu_ranges(const std::vector<int>& cpus) {
+    std::string out;
+    for (size_t i = 0; i < cpus.size();) {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) ++j;
+        if (!out.empty()) out += ',';
+        out += std::to_string(cpus[i]);
+        if (j > i) out += '-' + std::to_string(cpus[j]);
+        i = j + 1;
+    }
+    return out;
+}
+
+// Nodes with their CPUs, one line each
+inline std::ostream& operator<<(std::ostream& os, const CpuTopology& t) {
+    os << t.cpus().size() << " CPUs in " << t.packages() << " package(s), " << t.nodes() << " NUMA node(s)";
+    for (int node = 0; node < t.nodes(); ++node) {
+        std::vector<int> cpus = t.cpus_on_node(node);
+        if (!cpus.empty()) os << "\n  node " << node << ": CPUs " << format_cpu_ranges(cpus);
+    }
+    return os;
+}
+
+// ------------
+// CPU pinning
+// ------------
+// Pin a thread from inside it, before it allocates anything: Linux places
+// memory on the node of the CPU that first touches it, so buffers a pinned
+// thread allocates for itself end up local to it.
+
+inline bool pin_thread(pthread_t thread, int cpu, std::string& error) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        error = "no CPU " + std::to_string(cpu);
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int rc = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (rc != 0) {
+        error = "can't pin to CPU " + std::to_string(cpu) + ": " + std::strerror(rc);
+        return false;
+    }
+    return true;
+}
+
+inline bool pin_current_thread(int cpu, std::string& error) {
+    return pin_thread(pthread_self(), cpu, error);
+}
+
+// CPUs the current thread is allowed to run on
+inline std::vector<int> current_thread_cpus() {
+    std::vector<int> out;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) out.push_back(cpu);
+        }
+    }
+    return out;
+}
+
+// ---------------------------
+// NUMA-local object placement
+// ---------------------------
+// Holds one T in its own anonymous mapping, with the kernel asked to place
+// its pages on a given node before anything touches them. Meant for large
+// shared structures such as the trade queue, whose slots otherwise land
+// wherever the constructing thread happened to run.
+//
+// The policy is MPOL_PREFERRED, so a full node falls back to others rather
+// than failing. If the kernel refuses the policy (no NUMA support, or a
+// sandbox) the object is still created, just without placement; bound()
+// tells which.
+template<typename T>
+class NodeLocal {
+public:
+    NodeLocal() = default;
+    NodeLocal(const NodeLocal&) = delete;
+    NodeLocal& operator=(const NodeLocal&) = delete;
+    ~NodeLocal() { reset(); }
+
+    // Constructs the object, preferring memory on `node` (-1 for no
+    // preference). Returns false only if the mapping itself failed.
+    template<typename... Args>
+    bool create(int node, Args&&... args) {
+        reset();
+        bytes = (sizeof(T) + page_size() - 1) / page_size() * page_size();
+        void* mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) return false;
+        on_node = node >= 0 && prefer_node(mem, bytes, node) ? node : -1;
+        object = new (mem) T(std::forward<Args>(args)...);
+        return true;
+    }
+
+    void reset() {
+        if (!object) return;
+        object->~T();
+        munmap(object, bytes);
+        object = nullptr;
+    }
+
+    T* get() const { return object; }
+    T& operator*() const { return *object; }
+    T* operator->() const { return object; }
+    explicit operator bool() const { return object != nullptr; }
+
+    // Node the memory was placed on, or -1 if unplaced
+    int bound() const { return on_node; }
+    size_t size_bytes() const { return bytes; }
+
+private:
+    static size_t page_size() {
+        long n = sysconf(_SC_PAGESIZE);
+        return n > 0 ? static_cast<size_t>(n) : 4096;
+    }
+
+    static bool prefer_node(void* addr, size_t len, int node) {
+#ifdef SYS_mbind
+        constexpr int MPOL_PREFERRED_MODE = 1;
+        constexpr size_t bits = 8 * sizeof(unsigned long);
+        if (node >= 1024) return false;
+        unsigned long mask[1024 / bits] = {};
+        mask[static_cast<size_t>(node) / bits] = 1UL << (static_cast<size_t>(node) % bits);
+        return syscall(SYS_mbind, addr, len, MPOL_PREFERRED_MODE, mask, 1024UL, 0) == 0;
+#else
+        (void)addr;
+        (void)len;
+        (void)node;
+        return false;
+#endif
+    }
+
+    T* object = nullptr;
+    size_t bytes = 0;
+    int on_node = -1;
+};
@@ -0,0 +1,176 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// 64-bit string hash that consumes 8 bytes per step instead of one.
+// Issuer names are short (mostly < 24 bytes), so this is a handful of
+// multiplies per key. The final avalanche step makes the low bits usable
+// directly as a table index after masking. A different seed gives an
+// independent hash function, which perfect hashing relies on.
+inline uint64_t hash_string(std::string_view key, uint64_t seed = 0) {
+    constexpr uint64_t mul = 0x9E3779B97F4A7C15ull;
+    const char* p = key.data();
+    size_t n = key.size();
+    uint64_t h = (static_cast<uint64_t>(n) ^ seed) * mul;
+
+    while (n >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        h = (h ^ word) * mul;
+        h ^= h >> 32;
+        p += 8;
+        n -= 8;
+    }
+    if (n > 0) {
+        uint64_t word = 0;
+        std::memcpy(&word, p, n);
+        h = (h ^ word) * mul;
+        h ^= h >> 32;
+    }
+
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+    return h;
+}
+
+// Open-addressing hash map from strings to V, designed for small read-mostly
+// reference tables that sit on the producer hot path.
+//
+// Compared to std::unordered_map<std::string, V>:
+// - All slots live in one contiguous array, so a lookup is usually a single
+//   cache miss instead of bucket -> node -> string heap buffer.
+// - Each slot stores the full 64-bit hash, so mismatches are rejected without
+//   touching key bytes and growing never rehashes a string.
+// - Keys up to InlineKey bytes are stored inside the slot. Longer keys go to a
+//   shared arena so the slot size stays fixed.
+// - find() takes a std::string_view, so callers don't need to build a
+//   std::string just to do a lookup.
+//
+// Entries are never erased. Reference data is rebuilt wholesale instead, which
+// keeps linear probing simple (no tombstones).
+template<typename V, size_t InlineKey = 24>
+class FlatStringMap {
+    static_assert(InlineKey > 0, "InlineKey must be > 0");
+
+public:
+    explicit FlatStringMap(size_t expected = 0) {
+        reserve(expected);
+    }
+
+    // Makes sure that `count` entries fit without growing.
+    void reserve(size_t count) {
+        size_t needed = min_capacity;
+        // Keep the load factor at or below 1/2 so probe chains stay short.
+        while (needed < count * 2) {
+            needed <<= 1;
+        }
+        if (needed > slots.size()) {
+            rehash(needed);
+        }
+    }
+
+    V& insert_or_assign(std::string_view key, V value) {
+        if ((count + 1) * 2 > slots.size()) {
+            rehash(slots.empty() ? min_capacity : slots.size() * 2);
+        }
+
+        uint64_t h = slot_hash(key);
+        size_t mask = slots.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask) {
+            Slot& slot = slots[i];
+            if (slot.hash == 0) {
+                slot.hash = h;
+                slot.key_size = static_cast<uint32_t>(key.size());
+                if (key.size() > InlineKey) {
+                    slot.key_offset = static_cast<uint32_t>(arena.size());
+                    arena.insert(arena.end(), key.begin(), key.end());
+                }
+                else if (!key.empty()) {
+                    std::memcpy(slot.inline_key, key.data(), key.size());
+                }
+                slot.value = std::move(value);
+                ++count;
+                return slot.value;
+            }
+            if (slot.hash == h && key_equals(slot, key)) {
+                slot.value = std::move(value);
+                return slot.value;
+            }
+        }
+    }
+
+    // Returns nullptr when the key is not present.
+    const V* find(std::string_view key) const {
+        if (count == 0) return nullptr;
+
+        uint64_t h = slot_hash(key);
+        size_t mask = slots.size() - 1;
+        for (size_t i = h & mask;; i = (i + 1) & mask) {
+            const Slot& slot = slots[i];
+            if (slot.hash == 0) return nullptr;
+            if (slot.hash == h && key_equals(slot, key)) return &slot.value;
+        }
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t capacity() const { return slots.size(); }
+
+    void clear() {
+        slots.clear();
+        arena.clear();
+        count = 0;
+    }
+
+private:
+    static constexpr size_t min_capacity = 16;
+
+    struct Slot {
+        uint64_t hash = 0;   // 0 marks an empty slot
+        uint32_t key_size = 0;
+        uint32_t key_offset = 0;   // Only used for keys longer than InlineKey
+        char inline_key[InlineKey] = {};
+        V value{};
+    };
+
+    // Hash 0 is reserved for empty slots.
+    static uint64_t slot_hash(std::string_view key) {
+        uint64_t h = hash_string(key);
+        return h != 0 ? h : 1;
+    }
+
+    const char* key_data(const Slot& slot) const {
+        return slot.key_size <= InlineKey ? slot.inline_key : arena.data() + slot.key_offset;
+    }
+
+    bool key_equals(const Slot& slot, std::string_view key) const {
+        return slot.key_size == key.size() &&
+               (key.empty() || std::memcmp(key_data(slot), key.data(), key.size()) == 0);
+    }
+
+    void rehash(size_t new_capacity) {
+        std::vector<Slot> old = std::move(slots);
+        slots.clear();
+        slots.resize(new_capacity);
+
+        // Stored hashes mean we never touch the key bytes here.
+        size_t mask = new_capacity - 1;
+        for (Slot& slot : old) {
+            if (slot.hash == 0) continue;
+            size_t i = slot.hash & mask;
+            while (slots[i].hash != 0) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = std::move(slot);
+        }
+    }
+
+    std::vector<Slot> slots;
+    std::vector<char> arena;
+    size_t count = 0;
+};
@@ -0,0 +1,253 @@
+#pragma once
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "flat_string_map.h"
+#include "issuer_table.h"
+#include "mapped_file.h"
+
+// On-disk snapshot of a perfect-hash IssuerTable.
+//
+// The file is the table's lookup arrays written out verbatim, so on the next
+// start it can be mmap()ed and served in place. There's no parsing and no
+// copying, and startup costs a checksum pass instead of a database
+// round-trip. Layout:
+//
+//   IssuerSnapshotHeader
+//   pilots            uint32_t[]
+//   remap             uint32_t[]
+//   slots             PerfectStringMap<IssuerCodes>::Slot[]
+//   keys              char[]
+//   rating offsets    uint32_t[]  (count + 1)
+//   rating chars      char[]
+//   industry offsets  uint32_t[]  (count + 1)
+//   industry chars    char[]
+//
+// Each section starts on an 8-byte boundary and is described by an
+// {offset, size} pair in the header. Files are written in native byte order,
+// and readers reject anything with a different version, byte order, size or
+// checksum.
+
+constexpr uint32_t ISSUER_SNAPSHOT_VERSION = 1;
+
+struct IssuerSnapshotSection {
+    uint64_t offset;
+    uint64_t size;   // Bytes
+};
+
+struct IssuerSnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;   // 0x01020304 as written by the producer
+    uint64_t file_size;
+    uint64_t checksum;     // hash_string() of every byte after the header
+    uint64_t created_unix;
+    uint64_t seed;
+    uint64_t positions_count;
+    IssuerSnapshotSection pilots;
+    IssuerSnapshotSection remap;
+    IssuerSnapshotSection slots;
+    IssuerSnapshotSection keys;
+    IssuerSnapshotSection rating_offsets;
+    IssuerSnapshotSection rating_chars;
+    IssuerSnapshotSection industry_offsets;
+    IssuerSnapshotSection industry_chars;
+};
+
+namespace issuer_snapshot_detail {
+
+constexpr char magic[8] = {'T', 'R', 'I', 'S', 'S', 'U', 'E', 'R'};
+constexpr uint32_t byte_order = 0x01020304;
+
+// The slot layout is part of the file format.
+static_assert(sizeof(IssuerTable::Index::Slot) == 12, "issuer snapshot slot layout changed, bump ISSUER_SNAPSHOT_VERSION");
+
+inline IssuerSnapshotSection append(std::vector<char>& image, const void* data, size_t size) {
+    image.resize((image.size() + 7) & ~size_t(7));
+    IssuerSnapshotSection section{image.size(), size};
+    if (size > 0) {
+        const char* bytes = static_cast<const char*>(data);
+        image.insert(image.end(), bytes, bytes + size);
+    }
+    return section;
+}
+
+// Checks a section is inside the file, aligned for T and a whole number of T.
+template<typename T>
+bool section_ok(const IssuerSnapshotSection& s, uint64_t file_size) {
+    return s.offset <= file_size && s.size <= file_size - s.offset &&
+           s.offset % alignof(T) == 0 && s.size % sizeof(T) == 0;
+}
+
+template<typename T>
+const T* section_data(const char* base, const IssuerSnapshotSection& s) {
+    return reinterpret_cast<const T*>(base + s.offset);
+}
+
+}   // namespace issuer_snapshot_detail
+
+// Writes `table` to `path` atomically: the image goes to a temporary file
+// that is fsync()ed and then renamed over the old snapshot, so readers see
+// either the old file or the new one. Only PerfectHash tables can be saved.
+inline bool write_issuer_snapshot(const IssuerTable& table, const std::string& path, std::string& error) {
+    namespace detail = issuer_snapshot_detail;
+    if (table.mode() != IssuerIndexMode::PerfectHash) {
+        error = "only perfect-hash issuer tables can be snapshotted";
+        return false;
+    }
+
+    const auto& index = table.index_view();
+    const auto& ratings = table.rating_view();
+    const auto& industries = table.industry_view();
+
+    IssuerSnapshotHeader header{};
+    std::memcpy(header.magic, detail::magic, sizeof(header.magic));
+    header.version = ISSUER_SNAPSHOT_VERSION;
+    header.byte_order = detail::byte_order;
+    header.created_unix = static_cast<uint64_t>(std::time(nullptr));
+    header.seed = index.seed;
+    header.positions_count = index.positions_count;
+
+    std::vector<char> image(sizeof(header));
+    header.pilots = detail::append(image, index.pilots, index.pilot_count * sizeof(uint32_t));
+    header.remap = detail::append(image, index.remap, index.remap_count * sizeof(uint32_t));
+    header.slots = detail::append(image, index.slots, index.slot_count * sizeof(IssuerTable::Index::Slot));
+    header.keys = detail::append(image, index.keys, index.keys_size);
+    header.rating_offsets = detail::append(image, ratings.offsets, (ratings.count + 1) * sizeof(uint32_t));
+    header.rating_chars = detail::append(image, ratings.chars, ratings.chars_size);
+    header.industry_offsets = detail::append(image, industries.offsets, (industries.count + 1) * sizeof(uint32_t));
+    header.industry_chars = detail::append(image, industries.chars, industries.chars_size);
+
+    header.file_size = image.size();
+    header.checksum = hash_string(std::string_view(image.data() + sizeof(header), image.size() - sizeof(header)));
+    std::memcpy(image.data(), &header, sizeof(header));
+
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = tmp + ": " + std::strerror(errno);
+        return false;
+    }
+
+    size_t written = 0;
+    while (written < image.size()) {
+        ssize_t n = ::write(fd, image.data() + written, image.size() - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            error = tmp + ": " + std::strerror(errno);
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+
+    if (fsync(fd) < 0 || ::close(fd) < 0) {
+        error = tmp + ": " + std::strerror(errno);
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) < 0) {
+        error = path + ": " + std::strerror(errno);
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Maps a snapshot written by write_issuer_snapshot() and returns a table
+// that serves lookups straight from the mapping. Returns nullptr (with the
+// reason in `error`) if the file is missing, from another version, or fails
+// any size, bounds or checksum check.
+inline std::unique_ptr<IssuerTable> map_issuer_snapshot(const std::string& path, std::string& error) {
+    namespace detail = issuer_snapshot_detail;
+    using Slot = IssuerTable::Index::Slot;
+
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(path, error)) return nullptr;
+
+    if (file->size() < sizeof(IssuerSnapshotHeader)) {
+        error = path + ": truncated header";
+        return nullptr;
+    }
+    IssuerSnapshotHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    if (std::memcmp(header.magic, detail::magic, sizeof(header.magic)) != 0) {
+        error = path + ": not an issuer snapshot";
+        return nullptr;
+    }
+    if (header.version != ISSUER_SNAPSHOT_VERSION) {
+        error = path + ": snapshot version " + std::to_string(header.version) +
+                ", expected " + std::to_string(ISSUER_SNAPSHOT_VERSION);
+        return nullptr;
+    }
+    if (header.byte_order != detail::byte_order) {
+        error = path + ": written with a different byte order";
+        return nullptr;
+    }
+    if (header.file_size != file->size()) {
+        error = path + ": size " + std::to_string(file->size()) + ", header says " + std::to_string(header.file_size);
+        return nullptr;
+    }
+
+    uint64_t size = header.file_size;
+    if (!detail::section_ok<uint32_t>(header.pilots, size) ||
+        !detail::section_ok<uint32_t>(header.remap, size) ||
+        !detail::section_ok<Slot>(header.slots, size) ||
+        !detail::section_ok<char>(header.keys, size) ||
+        !detail::section_ok<uint32_t>(header.rating_offsets, size) || header.rating_offsets.size == 0 ||
+        !detail::section_ok<char>(header.rating_chars, size) ||
+        !detail::section_ok<uint32_t>(header.industry_offsets, size) || header.industry_offsets.size == 0 ||
+        !detail::section_ok<char>(header.industry_chars, size)) {
+        error = path + ": section out of bounds";
+        return nullptr;
+    }
+
+    std::string_view payload(file->data() + sizeof(header), file->size() - sizeof(header));
+    if (hash_string(payload) != header.checksum) {
+        error = path + ": checksum mismatch";
+        return nullptr;
+    }
+
+    const char* base = file->data();
+    IssuerTable::Index::View index;
+    index.seed = header.seed;
+    index.positions_count = header.positions_count;
+    index.pilots = detail::section_data<uint32_t>(base, header.pilots);
+    index.pilot_count = header.pilots.size / sizeof(uint32_t);
+    index.remap = detail::section_data<uint32_t>(base, header.remap);
+    index.remap_count = header.remap.size / sizeof(uint32_t);
+    index.slots = detail::section_data<Slot>(base, header.slots);
+    index.slot_count = header.slots.size / sizeof(Slot);
+    index.keys = base + header.keys.offset;
+    index.keys_size = header.keys.size;
+
+    NameDictionary::View ratings;
+    ratings.offsets = detail::section_data<uint32_t>(base, header.rating_offsets);
+    ratings.count = header.rating_offsets.size / sizeof(uint32_t) - 1;
+    ratings.chars = base + header.rating_chars.offset;
+    ratings.chars_size = header.rating_chars.size;
+
+    NameDictionary::View industries;
+    industries.offsets = detail::section_data<uint32_t>(base, header.industry_offsets);
+    industries.count = header.industry_offsets.size / sizeof(uint32_t) - 1;
+    industries.chars = base + header.industry_chars.offset;
+    industries.chars_size = header.industry_chars.size;
+
+    auto table = std::make_unique<IssuerTable>(IssuerIndexMode::PerfectHash);
+    if (!table->attach(index, ratings, industries, std::move(file))) {
+        error = path + ": inconsistent index";
+        return nullptr;
+    }
+    return table;
+}
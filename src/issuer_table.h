@@ -0,0 +1,188 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "flat_string_map.h"
+#include "perfect_string_map.h"
+
+// Compact enrichment record. Ratings and industries repeat across thousands
+// of issuers, so each entry stores small ids into shared dictionaries
+// instead of its own strings.
+struct IssuerCodes {
+    uint16_t rating_id;
+    uint16_t industry_id;
+};
+
+// How IssuerTable indexes issuer names.
+// - Flat: open-addressing FlatStringMap, cheap to build and update.
+// - PerfectHash: minimal perfect hash built once at load time. Lookups are
+//   one hash plus one key compare with no probing.
+enum class IssuerIndexMode {
+    Flat,
+    PerfectHash
+};
+
+// Id -> name dictionary with 16-bit ids. Names are stored back to back, and
+// offsets[id]..offsets[id + 1] is the range for one name. Like
+// PerfectStringMap, reads go through a View that can point at external
+// memory.
+class NameDictionary {
+public:
+    struct View {
+        const uint32_t* offsets = nullptr;   // count + 1 entries
+        size_t count = 0;
+        const char* chars = nullptr;
+        size_t chars_size = 0;
+    };
+
+    NameDictionary() { refresh_view(); }
+
+    NameDictionary(const NameDictionary&) = delete;
+    NameDictionary& operator=(const NameDictionary&) = delete;
+
+    // Returns the id for `name`, adding it if needed. Returns false once the
+    // 16-bit id space is used up.
+    bool intern(std::string_view name, uint16_t& id) {
+        if (const uint16_t* existing = ids.find(name)) {
+            id = *existing;
+            return true;
+        }
+        if (offsets.size() - 1 > UINT16_MAX) return false;
+
+        id = static_cast<uint16_t>(offsets.size() - 1);
+        chars.insert(chars.end(), name.begin(), name.end());
+        offsets.push_back(static_cast<uint32_t>(chars.size()));
+        ids.insert_or_assign(name, id);
+        refresh_view();
+        return true;
+    }
+
+    // Reads names from arrays owned by someone else. Offsets are checked so
+    // a corrupt source can't cause out-of-range reads.
+    bool attach(const View& external) {
+        if (external.count > size_t(UINT16_MAX) + 1 || external.offsets[0] != 0) return false;
+        for (size_t i = 0; i < external.count; ++i) {
+            if (external.offsets[i] > external.offsets[i + 1]) return false;
+        }
+        if (external.offsets[external.count] > external.chars_size) return false;
+
+        offsets.clear();
+        chars.clear();
+        ids.clear();
+        table = external;
+        return true;
+    }
+
+    std::string_view name(uint16_t id) const {
+        return std::string_view(table.chars + table.offsets[id], table.offsets[id + 1] - table.offsets[id]);
+    }
+
+    size_t size() const { return table.count; }
+    const View& view() const { return table; }
+
+private:
+    void refresh_view() {
+        table.offsets = offsets.data();
+        table.count = offsets.size() - 1;
+        table.chars = chars.data();
+        table.chars_size = chars.size();
+    }
+
+    std::vector<uint32_t> offsets{0};
+    std::vector<char> chars;
+    FlatStringMap<uint16_t> ids;
+    View table;
+};
+
+// In-memory issuer reference data used to enrich trades.
+//
+// Fill it with add() and then call finalize() once before publishing it.
+// After that it's immutable and safe to read from any number of threads.
+// A perfect-hash table can also be attached to external storage (a mapped
+// snapshot file), in which case it holds `backing` alive until destroyed.
+class IssuerTable {
+public:
+    using Index = PerfectStringMap<IssuerCodes>;
+
+    explicit IssuerTable(IssuerIndexMode mode = IssuerIndexMode::PerfectHash, size_t expected = 0)
+        : index_mode(mode) {
+        if (index_mode == IssuerIndexMode::Flat) {
+            flat.reserve(expected);
+        }
+        else {
+            perfect.reserve(expected);
+        }
+    }
+
+    // Returns false if a dictionary overflows its 16-bit id space.
+    bool add(std::string_view issuer, std::string_view rating, std::string_view industry) {
+        IssuerCodes codes{};
+        if (!ratings.intern(rating, codes.rating_id) || !industries.intern(industry, codes.industry_id)) {
+            return false;
+        }
+
+        if (index_mode == IssuerIndexMode::Flat) {
+            flat.insert_or_assign(issuer, codes);
+        }
+        else {
+            perfect.insert(issuer, codes);
+        }
+        return true;
+    }
+
+    // Builds the lookup index. Returns false if the perfect hash couldn't be
+    // constructed.
+    bool finalize() {
+        return index_mode == IssuerIndexMode::Flat || perfect.build();
+    }
+
+    // Serves a perfect-hash table from external arrays. Every entry's ids are
+    // checked against the dictionaries. Returns false if anything is
+    // inconsistent.
+    bool attach(const Index::View& index, const NameDictionary::View& rating_names,
+                const NameDictionary::View& industry_names, std::shared_ptr<const void> storage) {
+        index_mode = IssuerIndexMode::PerfectHash;
+        if (!perfect.attach(index) || !ratings.attach(rating_names) || !industries.attach(industry_names)) {
+            return false;
+        }
+        for (size_t i = 0; i < index.slot_count; ++i) {
+            const IssuerCodes& codes = index.slots[i].value;
+            if (codes.rating_id >= ratings.size() || codes.industry_id >= industries.size()) return false;
+        }
+        backing = std::move(storage);
+        return true;
+    }
+
+    // Returns nullptr for unknown issuers.
+    const IssuerCodes* find(std::string_view issuer) const {
+        return index_mode == IssuerIndexMode::Flat ? flat.find(issuer) : perfect.find(issuer);
+    }
+
+    std::string_view rating(const IssuerCodes& codes) const { return ratings.name(codes.rating_id); }
+    std::string_view industry(const IssuerCodes& codes) const { return industries.name(codes.industry_id); }
+
+    size_t size() const {
+        return index_mode == IssuerIndexMode::Flat ? flat.size() : perfect.size();
+    }
+
+    IssuerIndexMode mode() const { return index_mode; }
+
+    // Raw arrays, used to write snapshots. Only meaningful in PerfectHash mode.
+    const Index::View& index_view() const { return perfect.view(); }
+    const NameDictionary::View& rating_view() const { return ratings.view(); }
+    const NameDictionary::View& industry_view() const { return industries.view(); }
+
+    // True when lookups are served from external storage.
+    bool is_attached() const { return backing != nullptr; }
+
+private:
+    IssuerIndexMode index_mode;
+    FlatStringMap<IssuerCodes> flat;
+    Index perfect;
+    NameDictionary ratings;
+    NameDictionary industries;
+    std::shared_ptr<const void> backing;
+};
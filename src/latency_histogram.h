@@ -0,0 +1,262 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// ----------
+// TSC clock
+// ----------
+// Timestamps cheap enough to take several times per trade: on x86 a read of
+// the time-stamp counter costs a few nanoseconds against tens for a clock
+// call. The counter is only used when the CPU says it ticks at a constant
+// rate and keeps ticking in idle states (constant_tsc and nonstop_tsc),
+// which also means it agrees across cores. Anywhere else, or on other
+// architectures, ticks are steady_clock nanoseconds.
+//
+// The tick rate is measured once against steady_clock, the first time it's
+// needed. Call TscClock::calibrate() at startup to take that 20 ms then.
+class TscClock {
+public:
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        if (state().use_tsc) return __rdtsc();
+#endif
+        return steady_ns();
+    }
+
+    static void calibrate() { (void)state(); }
+
+    // Nanoseconds between two stamps; 0 if either is missing or out of order
+    static uint64_t elapsed_ns(uint64_t from, uint64_t to) {
+        if (from == 0 || to <= from) return 0;
+        return static_cast<uint64_t>(static_cast<double>(to - from) * state().ns_per_tick);
+    }
+
+    static bool uses_tsc() { return state().use_tsc; }
+    static double ticks_per_ns() { return 1.0 / state().ns_per_tick; }
+
+private:
+    struct State {
+        bool use_tsc = false;
+        double ns_per_tick = 1.0;
+    };
+
+    static uint64_t steady_ns() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now().time_since_epoch())
+                                         .count());
+    }
+
+    static bool invariant_tsc() {
+        std::ifstream in("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.compare(0, 5, "flags") != 0) continue;
+            return line.find(" constant_tsc") != std::string::npos && line.find(" nonstop_tsc") != std::string::npos;
+        }
+        return false;
+    }
+
+    static const State& state() {
+        static const State s = [] {
+            State st;
+#if defined(__x86_64__) || defined(__i386__)
+            if (invariant_tsc()) {
+                uint64_t ns0 = steady_ns();
+                uint64_t t0 = __rdtsc();
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                uint64_t ns1 = steady_ns();
+                uint64_t t1 = __rdtsc();
+                if (t1 > t0 && ns1 > ns0) {
+                    st.use_tsc = true;
+                    st.ns_per_tick = static_cast<double>(ns1 - ns0) / static_cast<double>(t1 - t0);
+                }
+            }
+#endif
+            return st;
+        }();
+        return s;
+    }
+};
+
+// -------------------------
+// Log-linear latency buckets
+// -------------------------
+// HDR-style: values below 64 ns get a bucket each, and every power of two
+// above that is split into 32 equal buckets, so any value is known to
+// within about 3%. Up to 2^40 ns (18 minutes) fits in 1152 buckets; longer
+// values share the last one, though the exact maximum is still kept.
+namespace latency_detail {
+
+constexpr int sub_bits = 5;
+constexpr uint64_t linear = uint64_t{1} << (sub_bits + 1);   // 64
+constexpr uint64_t per_octave = uint64_t{1} << sub_bits;     // 32
+constexpr int top_exponent = 40;
+constexpr size_t bucket_count = linear + (top_exponent - sub_bits - 1) * per_octave;
+
+inline size_t bucket_of(uint64_t ns) {
+    if (ns < linear) return static_cast<size_t>(ns);
+    int e = 63 - __builtin_clzll(ns);
+    if (e >= top_exponent) return bucket_count - 1;
+    return static_cast<size_t>(linear + (e - sub_bits - 1) * per_octave + ((ns >> (e - sub_bits)) - per_octave));
+}
+
+// Largest value that lands in bucket `i`
+inline uint64_t bucket_top(size_t i) {
+    if (i < linear) return i;
+    uint64_t octave = (i - linear) / per_octave;
+    uint64_t top = per_octave + (i - linear) % per_octave;
+    return ((top + 1) << (octave + 1)) - 1;
+}
+
+}   // namespace latency_detail
+
+// A histogram's counts at one moment. Snapshots merge, so per-thread
+// histograms add up to a stage's, and subtract, for an interval's.
+struct LatencySnapshot {
+    std::vector<uint64_t> counts = std::vector<uint64_t>(latency_detail::bucket_count);
+    uint64_t count = 0;
+    uint64_t sum_ns = 0;
+    uint64_t max_ns = 0;
+
+    void merge(const LatencySnapshot& other) {
+        for (size_t i = 0; i < counts.size(); ++i) counts[i] += other.counts[i];
+        count += other.count;
+        sum_ns += other.sum_ns;
+        max_ns = std::max(max_ns, other.max_ns);
+    }
+
+    // What was recorded after `earlier`. The exact maximum isn't known per
+    // interval, so it's the top of the highest bucket used.
+    LatencySnapshot since(const LatencySnapshot& earlier) const {
+        LatencySnapshot d;
+        size_t highest = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            d.counts[i] = counts[i] - earlier.counts[i];
+            if (d.counts[i]) highest = i;
+        }
+        d.count = count - earlier.count;
+        d.sum_ns = sum_ns - earlier.sum_ns;
+        d.max_ns = d.count ? std::min(max_ns, latency_detail::bucket_top(highest)) : 0;
+        return d;
+    }
+
+    // Value at or below which a fraction `q` of samples fall, as the top of
+    // its bucket, so it never understates
+    uint64_t percentile(double q) const {
+        if (count == 0) return 0;
+        uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * static_cast<double>(count))));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            seen += counts[i];
+            if (seen >= rank) return std::min(latency_detail::bucket_top(i), max_ns);
+        }
+        return max_ns;
+    }
+
+    double mean_ns() const { return count ? static_cast<double>(sum_ns) / static_cast<double>(count) : 0.0; }
+};
+
+// Writes a duration in the largest unit that keeps it readable
+inline std::ostream& print_latency(std::ostream& os, uint64_t ns) {
+    char buf[32];
+    if (ns < 10000) std::snprintf(buf, sizeof(buf), "%llu ns", static_cast<unsigned long long>(ns));
+    else if (ns < 10000000) std::snprintf(buf, sizeof(buf), "%.1f us", ns / 1e3);
+    else if (ns < 10000000000) std::snprintf(buf, sizeof(buf), "%.1f ms", ns / 1e6);
+    else std::snprintf(buf, sizeof(buf), "%.1f s", ns / 1e9);
+    return os << buf;
+}
+
+// "[Latency queue] 184195 trades, p50 812 us, p99 4.1 ms, p99.9 9.8 ms, max 14.2 ms"
+inline void print_latency_summary(std::ostream& os, const std::string& name, const LatencySnapshot& s) {
+    os << "[Latency " << name << "] " << s.count << " trades, p50 ";
+    print_latency(os, s.percentile(0.5)) << ", p99 ";
+    print_latency(os, s.percentile(0.99)) << ", p99.9 ";
+    print_latency(os, s.percentile(0.999)) << ", max ";
+    print_latency(os, s.max_ns);
+}
+
+// -----------------
+// Latency histogram
+// -----------------
+// One writer thread records into it with relaxed atomics, so there are no
+// locks or read-modify-write instructions on the hot path, and any thread
+// may take a snapshot while it's being written.
+class LatencyHistogram {
+public:
+    void record(uint64_t ns) {
+        bump(counts[latency_detail::bucket_of(ns)], 1);
+        bump(count, 1);
+        bump(sum_ns, ns);
+        if (ns > max_ns.load(std::memory_order_relaxed)) max_ns.store(ns, std::memory_order_relaxed);
+    }
+
+    void add_to(LatencySnapshot& s) const {
+        for (size_t i = 0; i < latency_detail::bucket_count; ++i) s.counts[i] += counts[i].load(std::memory_order_relaxed);
+        s.count += count.load(std::memory_order_relaxed);
+        s.sum_ns += sum_ns.load(std::memory_order_relaxed);
+        s.max_ns = std::max(s.max_ns, max_ns.load(std::memory_order_relaxed));
+    }
+
+    LatencySnapshot snapshot() const {
+        LatencySnapshot s;
+        add_to(s);
+        return s;
+    }
+
+private:
+    static void bump(std::atomic<uint64_t>& counter, uint64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> counts[latency_detail::bucket_count] = {};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+};
+
+// -------------------------------
+// Per-thread histograms by stage
+// -------------------------------
+// A histogram for each stage on each recording thread, so threads never
+// share a cache line. Stages are indexed as passed to the constructor;
+// snapshot() merges one stage across threads.
+class LatencyRecorder {
+public:
+    LatencyRecorder(std::vector<std::string> stages, size_t threads)
+        : stage_names(std::move(stages)), slots(std::max<size_t>(threads, 1)) {
+        for (Slot& slot : slots) slot.histograms = std::vector<LatencyHistogram>(stage_names.size());
+    }
+
+    // Histogram for `stage` on thread `thread`; only that thread may record
+    LatencyHistogram& at(size_t thread, size_t stage) { return slots[thread].histograms[stage]; }
+
+    const std::vector<std::string>& stages() const { return stage_names; }
+    size_t threads() const { return slots.size(); }
+
+    LatencySnapshot snapshot(size_t stage) const {
+        LatencySnapshot s;
+        for (const Slot& slot : slots) slot.histograms[stage].add_to(s);
+        return s;
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::vector<LatencyHistogram> histograms;
+    };
+
+    std::vector<std::string> stage_names;
+    std::vector<Slot> slots;
+};
@@ -0,0 +1,33 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "binary_log.h"
+
+// ---------------------------
+// Offline binary log decoder
+// ---------------------------
+// Renders a log written with LogOutput::Binary as the same text lines the
+// text logger would have printed.
+//
+//   log_decoder pipeline.binlog > pipeline.log
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <binary log>\n";
+        return 2;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open " << argv[1] << "\n";
+        return 1;
+    }
+
+    std::ios::sync_with_stdio(false);
+    std::string error;
+    if (!decode_binary_log(in, std::cout, error)) {
+        std::cout.flush();
+        std::cerr << argv[1] << ": " << error << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -1,31 +1,359 @@
 #include <arpa/inet.h>
+#include <signal.h>
 #include <libpq-fe.h>
+#include <sys/select.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <string_view>
 #include <thread>
+#include <tuple>
 #include <unistd.h>
-#include <unordered_map>
 #include <vector>
+#include "async_logger.h"
+#include "async_writer.h"
+#include "backpressure.h"
+#include "batch_controller.h"
+#include "connection_pool.h"
+#include "copy_sink.h"
+#include "cpu_topology.h"
+#include "issuer_snapshot_file.h"
+#include "latency_histogram.h"
+#include "issuer_table.h"
+#include "metrics.h"
+#include "metrics_server.h"
 #include "mpmc_queue.h"
+#include "pipeline_config.h"
+#include "pipeline_sink.h"
+#include "pipeline_stage.h"
+#include "rcu_snapshot.h"
+#include "security_master.h"
+#include "trade.h"
+#include "trade_dedupe.h"
+#include "trade_ingest.h"
+#include "trade_journal.h"
+#include "trade_params.h"
 
 using json = nlohmann::json;
 
+// -------
+// Logging
+// -------
+// Producers and consumers log through an asynchronous logger, so writing
+// to the terminal never holds up ingest. Per-trade lines are sampled: each
+// consumer logs one trade in every TRADE_LOG_SAMPLE.
+//
+// With LOG_OUTPUT set to Binary, lines go to BINARY_LOG_PATH as raw
+// arguments instead of text, and log_decoder turns the file back into text.
+constexpr LogLevel LOG_LEVEL = LogLevel::Info;
+constexpr uint64_t TRADE_LOG_SAMPLE = 1000;
+constexpr LogOutput LOG_OUTPUT = LogOutput::Text;
+const char* const BINARY_LOG_PATH = "ingest.binlog";
+
+std::ostream& logStream() {
+    if (LOG_OUTPUT == LogOutput::Text) return std::cout;
+    static std::ofstream file(BINARY_LOG_PATH, std::ios::binary | std::ios::trunc);
+    return file;
+}
+
+AsyncLogger logger(logStream(), LOG_LEVEL, 1024, LOG_OUTPUT);
+
+// -------------
+// Configuration
+// -------------
+// Set from the command line and --config file before any thread starts,
+// and read-only after that. See pipeline_config.h.
+PipelineConfig config;
+
 // -----------------
 // Shared MPMC Queue
 // -----------------
-constexpr size_t QUEUE_CAPACITY = 16384;
-MPMCQueue<json, QUEUE_CAPACITY> tradeQueue;
+// Compiled at the largest capacity we allow; config.queue_capacity caps how
+// much of it producers fill. main() creates it on the NUMA node of the
+// threads that use it, before starting any of them.
+constexpr size_t MAX_QUEUE_CAPACITY = 65536;
+using TradeQueue = MPMCQueue<Trade, MAX_QUEUE_CAPACITY>;
+NodeLocal<TradeQueue> tradeQueue;
+
+// ----------------
+// Thread placement
+// ----------------
+// Every thread can be pinned to one core (config.*_cpus) so it doesn't
+// migrate away from its caches or its node. A thread pins itself before
+// doing anything else, so the buffers it allocates land on its own node.
+// Background threads take config.background_cpus in turn.
+std::atomic<size_t> nextBackgroundCpu{0};
+
+int cpuAt(const std::vector<int>& cpus, size_t index) {
+    return index < cpus.size() ? cpus[index] : -1;
+}
+
+int backgroundCpu() {
+    if (config.background_cpus.empty()) return -1;
+    size_t i = nextBackgroundCpu.fetch_add(1, std::memory_order_relaxed);
+    return config.background_cpus[i % config.background_cpus.size()];
+}
+
+// Starts `f(args...)` on a new thread pinned to `cpu`, or unpinned if -1
+template<typename F, typename... Args>
+std::thread startThread(std::string name, int cpu, F f, Args... args) {
+    auto bound = std::make_tuple(std::move(args)...);
+    return std::thread([name = std::move(name), cpu, f = std::move(f), bound = std::move(bound)]() mutable {
+        // Named for the thread CPU metrics; Linux allows 15 characters
+        pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+        std::string error;
+        if (cpu >= 0 && !pin_current_thread(cpu, error)) {
+            std::cerr << "[" << name << "] " << error << ", running unpinned\n";
+        }
+        std::apply(f, std::move(bound));
+    });
+}
+
+// Checks that the pinned CPUs exist and the queue's node has CPUs, and
+// picks the node for the queue when it's left to us
+bool placeThreads(const CpuTopology& topology, int& queueNode, std::string& error) {
+    for (const auto* list : {&config.producer_cpus, &config.consumer_cpus, &config.background_cpus,
+                             &config.parse_cpus, &config.enrich_cpus}) {
+        for (int cpu : *list) {
+            if (!topology.find(cpu)) {
+                error = "CPU " + std::to_string(cpu) + " is not online";
+                return false;
+            }
+        }
+    }
+    queueNode = config.queue_node;
+    if (queueNode >= 0 && topology.cpus_on_node(queueNode).empty()) {
+        error = "NUMA node " + std::to_string(queueNode) + " has no CPUs";
+        return false;
+    }
+    if (queueNode < 0 && !config.consumer_cpus.empty()) queueNode = topology.node_of(config.consumer_cpus[0]);
+    if (queueNode < 0 && !config.producer_cpus.empty()) queueNode = topology.node_of(config.producer_cpus[0]);
+    return true;
+}
+
+// Startup report: the machine, where each thread will run and where the
+// queue lives, with a warning for anything that crosses nodes
+void reportTopology(const CpuTopology& topology, size_t consumerThreads) {
+    std::ostringstream os;
+    os << "[Topology] " << topology << "\n";
+
+    std::vector<int> nodesUsed;
+    auto describe = [&](const std::string& name, int cpu) {
+        os << "  " << name << ": ";
+        if (cpu < 0) {
+            os << "unpinned\n";
+            return;
+        }
+        int node = topology.node_of(cpu);
+        os << "CPU " << cpu << " (node " << node << ")\n";
+        nodesUsed.push_back(node);
+    };
+    for (size_t i = 0; i < config.feeds.size(); ++i) {
+        describe("Producer " + std::to_string(i + 1) + " (" + config.feeds[i].host + ":" +
+                     std::to_string(config.feeds[i].port) + ")",
+                 cpuAt(config.producer_cpus, i));
+    }
+    if (config.staged) {
+        for (size_t i = 0; i < config.parse_threads; ++i) {
+            describe("Parse " + std::to_string(i + 1), cpuAt(config.parse_cpus, i));
+        }
+        for (size_t i = 0; i < config.enrich_threads; ++i) {
+            describe("Enrich " + std::to_string(i + 1), cpuAt(config.enrich_cpus, i));
+        }
+    }
+    for (size_t i = 0; i < consumerThreads; ++i) {
+        describe("Consumer " + std::to_string(i + 1), cpuAt(config.consumer_cpus, i));
+    }
+    os << "  Background threads: "
+       << (config.background_cpus.empty() ? "unpinned" : "CPUs " + format_cpu_ranges(config.background_cpus))
+       << "\n";
+
+    os << "  Queue: " << (tradeQueue.size_bytes() >> 20) << " MiB, ";
+    if (tradeQueue.bound() >= 0) {
+        os << "node " << tradeQueue.bound() << "\n";
+    }
+    else {
+        os << "placed by the OS\n";
+    }
+
+    std::sort(nodesUsed.begin(), nodesUsed.end());
+    nodesUsed.erase(std::unique(nodesUsed.begin(), nodesUsed.end()), nodesUsed.end());
+    if (nodesUsed.size() > 1) {
+        os << "  Warning: producers and consumers span " << nodesUsed.size()
+           << " NUMA nodes, so queue slots cross between them\n";
+    }
+    std::cout << os.str();
+}
+
+// ----------------
+// Duplicate filter
+// ----------------
+// Producers drop a trade whose control_id, side and dealer_id were already
+// seen within DEDUPE_WINDOW, before it takes a queue slot.
+constexpr std::chrono::minutes DEDUPE_WINDOW{10};
+TradeDedupe tradeDedupe(DEDUPE_WINDOW);
+
+// -----------
+// Trade sink
+// -----------
+// config.sink picks how consumers write trades; the sinks are described in
+// pipeline_config.h. These settings are fixed for every sink.
+constexpr std::chrono::microseconds BATCH_IDLE_GAP{1000};   // Quiet time before a partial batch goes
+constexpr std::chrono::seconds BATCH_STATS_INTERVAL{10};
+// Load COPY batches through a staging table with ON CONFLICT DO NOTHING, so
+// trades already in the table (a replayed journal, a feed that resent) are
+// skipped instead of failing the batch. Needs a unique index on trades.
+constexpr CopyConflicts COPY_CONFLICTS = CopyConflicts::Skip;
+// Consumers share config.db_connections connections, however many of them
+// there are. A broken connection is reopened with backoff up to
+// DB_MAX_BACKOFF.
+constexpr std::chrono::seconds DB_MAX_BACKOFF{5};
+constexpr std::chrono::milliseconds DB_ACQUIRE_TIMEOUT{1000};
+constexpr uint64_t JOURNAL_SEGMENT_BYTES = 64ull << 20;
+constexpr size_t JOURNAL_COMMIT_BATCH = 256;   // Max trades per consumer per fdatasync
+constexpr size_t JOURNAL_REPLAY_BATCH = 5000;
+constexpr std::chrono::seconds JOURNAL_MAX_BACKOFF{5};
 
 // --------------------------
 // In-memory issuer info map
 // --------------------------
-struct IssuerInfo {
-    std::string rating;
-    std::string industry;
-};
+// Issuers are looked up straight from the parsed JSON string without
+// allocating a key. The issuer universe is small and changes rarely, so by
+// default each load builds a minimal perfect hash over it. Switch to
+// IssuerIndexMode::Flat to use the open-addressing map instead.
+constexpr IssuerIndexMode ISSUER_INDEX_MODE = IssuerIndexMode::PerfectHash;
+
+// The table is published as an immutable RCU snapshot so it can be rebuilt
+// in the background while producers keep reading it without locks.
+RcuSnapshot<IssuerTable> issuerSnapshot;
+
+// How often the reloader refreshes issuer_info when no NOTIFY arrives.
+constexpr std::chrono::seconds ISSUER_RELOAD_INTERVAL{60};
+
+// Channel the reloader LISTENs on. Fire it from a trigger on issuer_info,
+// or by hand with: NOTIFY issuer_info_changed;
+constexpr const char* ISSUER_NOTIFY_CHANNEL = "issuer_info_changed";
+
+// Every successful load is saved here, and the next start maps it instead
+// of waiting on Postgres. Bump ISSUER_SNAPSHOT_VERSION if the layout changes.
+constexpr const char* ISSUER_SNAPSHOT_PATH = "issuer_info.snapshot";
+
+// ------------------------------------------
+// Stream query results one row at a time
+// ------------------------------------------
+// Single-row mode hands us each row as it comes off the wire instead of
+// materializing the whole result set first, so memory stays flat and rows
+// can be decoded straight from libpq's buffer into their final storage.
+// onRow gets a result holding exactly one row (row 0) and returns false to
+// stop processing. Remaining rows are still drained so the connection stays
+// usable.
+template<typename OnRow>
+bool streamQuery(PGconn* conn, const char* sql, OnRow&& onRow) {
+    if (!PQsendQuery(conn, sql) || !PQsetSingleRowMode(conn)) {
+        std::cerr << "Query failed: " << PQerrorMessage(conn) << "\n";
+        return false;
+    }
+
+    bool ok = true;
+    while (PGresult* res = PQgetResult(conn)) {
+        ExecStatusType status = PQresultStatus(res);
+        if (status == PGRES_SINGLE_TUPLE) {
+            if (ok && !onRow(res)) ok = false;
+        }
+        else if (status != PGRES_TUPLES_OK) {
+            std::cerr << "Query failed: " << PQresultErrorMessage(res) << "\n";
+            ok = false;
+        }
+        PQclear(res);
+    }
+    return ok;
+}
+
+// Planner's row estimate for a table, used to presize lookup tables before
+// streaming. Returns 0 if the table has never been analyzed.
+size_t estimateRows(PGconn* conn, const char* table) {
+    const char* params[1] = {table};
+    PGresult* res = PQexecParams(conn,
+        "SELECT reltuples::bigint FROM pg_class WHERE oid = $1::regclass;",
+        1, nullptr, params, nullptr, nullptr, 0);
+    long long estimate = 0;
+    if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1) {
+        estimate = std::strtoll(PQgetvalue(res, 0, 0), nullptr, 10);
+    }
+    PQclear(res);
+    return estimate > 0 ? static_cast<size_t>(estimate) : 0;
+}
 
-std::unordered_map<std::string, IssuerInfo> issuerMap;
+// ---------------------------------
+// Query issuer_info from PostgreSQL
+// ---------------------------------
+// Each row is decoded directly into the table: the issuer bytes are copied
+// once into the index's key storage, and ratings/industries only allocate
+// the first time a new one is seen.
+std::unique_ptr<IssuerTable> queryIssuerTable(PGconn* conn) {
+    auto table = std::make_unique<IssuerTable>(ISSUER_INDEX_MODE, estimateRows(conn, "issuer_info"));
+
+    bool ok = streamQuery(conn, "SELECT issuer, rating, industry FROM issuer_info;", [&](const PGresult* row) {
+        std::string_view issuer(PQgetvalue(row, 0, 0), PQgetlength(row, 0, 0));
+        std::string_view rating(PQgetvalue(row, 0, 1), PQgetlength(row, 0, 1));
+        std::string_view industry(PQgetvalue(row, 0, 2), PQgetlength(row, 0, 2));
+        if (!table->add(issuer, rating, industry)) {
+            std::cerr << "Too many distinct ratings or industries in issuer_info\n";
+            return false;
+        }
+        return true;
+    });
+    if (!ok) return nullptr;
+
+    if (!table->finalize()) {
+        std::cerr << "Failed to build issuer index\n";
+        return nullptr;
+    }
+    return table;
+}
+
+// ----------------------------------------
+// Publish a freshly loaded issuer table
+// ----------------------------------------
+// Saves the table for the next cold start, then swaps it in for producers.
+void publishIssuerTable(std::unique_ptr<IssuerTable> table) {
+    if (table->mode() == IssuerIndexMode::PerfectHash) {
+        std::string error;
+        if (!write_issuer_snapshot(*table, ISSUER_SNAPSHOT_PATH, error)) {
+            std::cerr << "Failed to write issuer snapshot: " << error << "\n";
+        }
+    }
+    issuerSnapshot.publish(std::move(table));
+}
+
+// ------------------------------------
+// Map issuer snapshot for fast startup
+// ------------------------------------
+bool mapIssuerSnapshot() {
+    auto start = std::chrono::steady_clock::now();
+    std::string error;
+    auto table = map_issuer_snapshot(ISSUER_SNAPSHOT_PATH, error);
+    if (!table) {
+        std::cerr << "No usable issuer snapshot (" << error << ")\n";
+        return false;
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Mapped " << table->size() << " issuers from " << ISSUER_SNAPSHOT_PATH
+              << " in " << elapsed.count() << " ms\n";
+    issuerSnapshot.publish(std::move(table));
+    return true;
+}
 
 // --------------------------------
 // Load issuer_info from PostgreSQL
@@ -38,25 +366,114 @@ bool loadIssuerInfo(const std::string& conninfo) {
         return false;
     }
 
-    PGresult* res = PQexec(conn, "SELECT issuer, rating, industry FROM issuer_info;");
-    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        std::cerr << "SELECT failed: " << PQerrorMessage(conn) << "\n";
+    auto table = queryIssuerTable(conn);
+    PQfinish(conn);
+    if (!table) return false;
+
+    std::cout << "Loaded " << table->size() << " issuers into memory\n";
+    publishIssuerTable(std::move(table));
+
+    return true;
+}
+
+// ------------------------------------------
+// Issuer Reloader Thread (background writer)
+// ------------------------------------------
+// Rebuilds the issuer table on every NOTIFY and at least once per interval,
+// then swaps it in. Producers never wait on this thread. Also reloads right
+// after every reconnect, since notifications may have been missed, and
+// right after the first connect when `refreshNow` is set (startup was served
+// from a possibly stale snapshot).
+void issuerReloader(const std::string& conninfo, std::chrono::seconds interval, bool refreshNow) {
+    bool reloadNow = refreshNow;
+    while (true) {
+        PGconn* conn = PQconnectdb(conninfo.c_str());
+        if (PQstatus(conn) != CONNECTION_OK) {
+            std::cerr << "[Reloader] DB connection failed: " << PQerrorMessage(conn) << "\n";
+            PQfinish(conn);
+            std::this_thread::sleep_for(interval);
+            continue;
+        }
+
+        std::string listen = std::string("LISTEN ") + ISSUER_NOTIFY_CHANNEL + ";";
+        PGresult* res = PQexec(conn, listen.c_str());
+        if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+            std::cerr << "[Reloader] LISTEN failed: " << PQerrorMessage(conn) << "\n";
+        }
         PQclear(res);
+
+        while (PQstatus(conn) == CONNECTION_OK) {
+            if (!reloadNow) {
+                // Sleep until a notification arrives or the interval runs out.
+                int sock = PQsocket(conn);
+                fd_set readable;
+                FD_ZERO(&readable);
+                FD_SET(sock, &readable);
+                timeval timeout{static_cast<time_t>(interval.count()), 0};
+                if (select(sock + 1, &readable, nullptr, nullptr, &timeout) < 0) break;
+
+                if (!PQconsumeInput(conn)) break;
+                while (PGnotify* notify = PQnotifies(conn)) {
+                    PQfreemem(notify);
+                }
+            }
+            reloadNow = false;
+
+            auto table = queryIssuerTable(conn);
+            if (!table) continue;
+
+            size_t count = table->size();
+            publishIssuerTable(std::move(table));
+            std::cout << "[Reloader] Reloaded " << count << " issuers (version "
+                      << issuerSnapshot.version() << ")\n";
+        }
+
+        std::cerr << "[Reloader] Lost DB connection, reconnecting\n";
+        reloadNow = true;
+        PQfinish(conn);
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+}
+
+// ------------------------------
+// CUSIP-level security master
+// ------------------------------
+// Coupon and maturity are static per security. Reference terms are loaded
+// from Postgres at startup, before the producers run, and learned from the
+// feed for anything new.
+constexpr size_t SECURITY_MASTER_CAPACITY = 1 << 20;
+SecurityMaster securityMaster(SECURITY_MASTER_CAPACITY);
+
+// -------------------------------------
+// Load security_master from PostgreSQL
+// -------------------------------------
+bool loadSecurityMaster(const std::string& conninfo) {
+    PGconn* conn = PQconnectdb(conninfo.c_str());
+    if (PQstatus(conn) != CONNECTION_OK) {
+        std::cerr << "Connection to database failed: " << PQerrorMessage(conn) << "\n";
         PQfinish(conn);
         return false;
     }
 
-    int rows = PQntuples(res);
-    for (int i = 0; i < rows; ++i) {
-        std::string issuer = PQgetvalue(res, i, 0);
-        std::string rating = PQgetvalue(res, i, 1);
-        std::string industry = PQgetvalue(res, i, 2);
-        issuerMap[issuer] = {rating, industry};
+    size_t rejected = 0;
+    bool ok = streamQuery(conn, "SELECT cusip, coupon::float8, maturity::text FROM security_master;", [&](const PGresult* row) {
+        std::string_view cusip(PQgetvalue(row, 0, 0), PQgetlength(row, 0, 0));
+        std::string_view maturity(PQgetvalue(row, 0, 2), PQgetlength(row, 0, 2));
+        if (!is_valid_cusip(cusip) ||
+            securityMaster.check_or_learn(cusip, std::strtod(PQgetvalue(row, 0, 1), nullptr), maturity) != SecurityCheck::Learned) {
+            ++rejected;
+        }
+        return true;
+    });
+    if (!ok) {
+        PQfinish(conn);
+        return false;
     }
 
-    PQclear(res);
     PQfinish(conn);
-    std::cout << "Loaded " << issuerMap.size() << " issuers into memory\n";
+    std::cout << "Loaded " << securityMaster.size() << " securities into memory";
+    if (rejected > 0) std::cout << " (" << rejected << " rejected)";
+    std::cout << "\n";
 
     return true;
 }
@@ -64,40 +481,41 @@ bool loadIssuerInfo(const std::string& conninfo) {
 // ---------------------------------------
 // Insert trade into PostgreSQL hypertable
 // ---------------------------------------
-bool insertTrade(PGconn* conn, const json& msg) {
+// The insert is prepared once per connection, so each trade only sends the
+// statement name and its parameters in binary.
+bool prepareInsertTrade(PGconn* conn) {
+    PGresult* res = PQprepare(conn, INSERT_TRADE_STATEMENT, insert_trade_sql().c_str(),
+                              TRADE_COLUMN_COUNT, TRADE_PARAM_TYPES);
+    if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+        std::cerr << "Prepare failed: " << PQerrorMessage(conn) << "\n";
+        PQclear(res);
+        return false;
+    }
+
+    PQclear(res);
+    return true;
+}
+
+bool prepareInsertTrade(ConnectionPool::Lease& conn) {
+    return conn.prepare(INSERT_TRADE_STATEMENT, insert_trade_sql(), TRADE_COLUMN_COUNT, TRADE_PARAM_TYPES);
+}
+
+bool insertTrade(PGconn* conn, const Trade& trade) {
     if (!conn) return false;
 
-    const char* sql =
-        "INSERT INTO trades (control_id, coupon, cusip, dealer_id, exec_time, "
-        "industry, issuer, maturity, modifier3, price, rating, report_time, "
-        "reporting_capacity, side, volume) "
-        "VALUES ($1,$2,$3,$4,$5,$6,$7,$8,$9,$10,$11,$12,$13,$14,$15);";
-
-    std::vector<std::string> paramsStr(15);
-    paramsStr[0]  = msg.value("control_id", "");
-    paramsStr[1]  = msg.contains("coupon") ? std::to_string(msg["coupon"].get<double>()) : "";
-    paramsStr[2]  = msg.value("cusip", "");
-    paramsStr[3]  = msg.contains("dealer_id") ? std::to_string(msg["dealer_id"].get<int>()) : "";
-    paramsStr[4]  = msg.value("exec_time", "");
-    paramsStr[5]  = msg.value("industry", "");
-    paramsStr[6]  = msg.value("issuer", "");
-    paramsStr[7]  = msg.value("maturity", "");
-    paramsStr[8]  = msg.value("modifier3", "");
-    paramsStr[9]  = msg.contains("price") ? std::to_string(msg["price"].get<double>()) : "";
-    paramsStr[10] = msg.value("rating", "");
-    paramsStr[11] = msg.value("report_time", "");
-    paramsStr[12] = msg.value("reporting_capacity", "");
-    paramsStr[13] = msg.value("side", "");
-    paramsStr[14] = msg.contains("volume") ? std::to_string(msg["volume"].get<long long>()) : "";
-
-    const char* paramValues[15];
-    for (size_t i = 0; i < 15; ++i) {
-        paramValues[i] = paramsStr[i].c_str();
-    }
-
-    PGresult* res = PQexecParams(conn, sql, 15, nullptr, paramValues, nullptr, nullptr, 0);
+    TradeParams params;
+    std::string error;
+    if (!params.encode(trade, error)) {
+        static LogSite badParams("Insert failed: {} in trade {}");
+        logger.error(badParams, error, trade.control_id);
+        return false;
+    }
+
+    PGresult* res = PQexecPrepared(conn, INSERT_TRADE_STATEMENT, TRADE_COLUMN_COUNT,
+                                   params.values, params.lengths, params.formats, 0);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-        std::cerr << "Insert failed: " << PQerrorMessage(conn) << "\n";
+        static LogSite insertFailed("Insert failed: {}");
+        logger.error(insertFailed, PQerrorMessage(conn));
         PQclear(res);
         return false;
     }
@@ -106,6 +524,254 @@ bool insertTrade(PGconn* conn, const json& msg) {
     return true;
 }
 
+// ------
+// Ingest
+// ------
+// Producers read their feeds and queue trades through TradeIngest
+// (trade_ingest.h), inline or, with config.staged, through parse and enrich
+// stages on their own thread pools. Every STAGE_STATS_INTERVAL each stage
+// logs its throughput, how busy its threads were and how full its queue
+// is, along with the consumers as the persist stage.
+//
+// Ingest counts into ThreadCounters, one block per thread, summed only
+// when metrics are scraped.
+constexpr std::chrono::seconds STAGE_STATS_INTERVAL{10};
+
+std::unique_ptr<ThreadCounters> feedCounters;
+ThreadCounters ingestCounters(INGEST_COUNTERS);
+
+using Ingest = TradeIngest<TradeQueue>;
+std::unique_ptr<Ingest> ingest;
+
+// Consumers record what they write here, one slot per consumer
+std::unique_ptr<StageMeter> persistMeter;
+
+// ------------
+// Backpressure
+// ------------
+// Producers check how full the queues after them are before each read.
+// Past config.high_watermark they stop reading until the queues drain to
+// config.low_watermark, so a slow database ends up stalling the feeds'
+// senders through TCP flow control instead of producers spinning on a full
+// queue. With OverloadPolicy::Shed they keep reading and drop lines instead.
+std::unique_ptr<Backpressure> backpressure;
+
+// -----------------
+// End-to-end latency
+// -----------------
+// Trades are stamped with TscClock as they come off the socket, after
+// parsing, on entering the trade queue and on leaving it. When a consumer
+// has written a trade it records the time between each pair of stamps, and
+// from receipt to the write, into its own histograms. The stage reporter
+// logs each stage's percentiles for the interval, and the totals since
+// startup are logged at shutdown.
+//
+// A trade counts as written when its INSERT or COPY batch has committed,
+// or when the server replies to it for pipelined inserts and the async
+// writer. The journal sink counts a trade once it's durable in the journal.
+enum LatencyStage : size_t {
+    LATENCY_PARSE,     // Received -> parsed
+    LATENCY_ENRICH,    // Parsed -> queued, including stage queues and backpressure
+    LATENCY_QUEUE,     // Queued -> taken by a consumer
+    LATENCY_PERSIST,   // Taken -> written
+    LATENCY_TOTAL      // Received -> written
+};
+
+std::unique_ptr<LatencyRecorder> latency;
+
+void recordLatency(size_t consumer, const TradeStamps& stamps, uint64_t written) {
+    if (stamps.received == 0) return;
+    latency->at(consumer, LATENCY_PARSE).record(TscClock::elapsed_ns(stamps.received, stamps.parsed));
+    latency->at(consumer, LATENCY_ENRICH).record(TscClock::elapsed_ns(stamps.parsed, stamps.enqueued));
+    latency->at(consumer, LATENCY_QUEUE).record(TscClock::elapsed_ns(stamps.enqueued, stamps.dequeued));
+    latency->at(consumer, LATENCY_PERSIST).record(TscClock::elapsed_ns(stamps.dequeued, written));
+    latency->at(consumer, LATENCY_TOTAL).record(TscClock::elapsed_ns(stamps.received, written));
+}
+
+// Each consumer's database writes: how long every flush (a COPY batch, an
+// INSERT or a journal commit) took and how many trades it carried. The
+// batch histogram counts trades rather than nanoseconds.
+enum DbWriteHistogram : size_t {
+    DB_FLUSH_TIME,
+    DB_BATCH_SIZE
+};
+
+std::unique_ptr<LatencyRecorder> dbWrites;
+
+void recordDbWrite(size_t consumer, std::chrono::nanoseconds took, size_t trades) {
+    dbWrites->at(consumer, DB_FLUSH_TIME).record(static_cast<uint64_t>(took.count()));
+    dbWrites->at(consumer, DB_BATCH_SIZE).record(trades);
+}
+
+// Logs each stage's latency since `last`, or since startup if `last` is empty
+void reportLatency(std::vector<LatencySnapshot>& last) {
+    for (size_t stage = 0; stage < latency->stages().size(); ++stage) {
+        LatencySnapshot now = latency->snapshot(stage);
+        LatencySnapshot delta = stage < last.size() ? now.since(last[stage]) : now;
+        if (delta.count > 0) {
+            std::ostringstream line;
+            print_latency_summary(line, latency->stages()[stage], delta);
+            logger.info(line.str());
+        }
+        if (stage < last.size()) last[stage] = std::move(now);
+        else last.push_back(std::move(now));
+    }
+}
+
+void reportStages(std::chrono::steady_clock::duration interval, std::vector<StageStats>& last,
+                  BackpressureStats& lastPressure) {
+    std::vector<StageStats> now;
+    if (ingest->parse_stage()) now.push_back(ingest->parse_stage()->stats());
+    if (ingest->enrich_stage()) now.push_back(ingest->enrich_stage()->stats());
+    if (persistMeter) {
+        now.push_back(persistMeter->snapshot());
+        now.back().depth = tradeQueue->size_approx();
+        now.back().capacity = config.queue_capacity;
+    }
+    for (size_t i = 0; i < now.size(); ++i) {
+        StageStats delta = i < last.size() ? now[i].since(last[i]) : now[i];
+        if (delta.items == 0) continue;
+        std::ostringstream line;
+        print_stage_stats(line, delta, interval);
+        logger.info(line.str());
+    }
+    last = std::move(now);
+
+    BackpressureStats pressure = backpressure->stats();
+    BackpressureStats delta = pressure.since(lastPressure);
+    if (delta.episodes || delta.pauses || delta.shed) {
+        std::ostringstream line;
+        line << "[Backpressure] " << delta;
+        logger.warn(line.str());
+    }
+    lastPressure = pressure;
+}
+
+// -------
+// Metrics
+// -------
+// With config.metrics_port set, a MetricsServer serves these at /metrics in
+// Prometheus text format. Everything is read from counters the pipeline
+// threads already keep for themselves, so a scrape never touches their
+// cache lines for writing or makes them wait.
+const std::vector<double> BATCH_SIZE_BOUNDS = {1, 4, 16, 64, 256, 1024, 4096, 16384};
+const std::vector<double> FLUSH_SECONDS_BOUNDS = {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+                                                  0.05,   0.1,     0.25,   0.5,   1,      2.5,   5,    10};
+
+void writeMetrics(std::ostream& out) {
+    MetricsWriter w(out);
+
+    struct FeedMetric {
+        const char* name;
+        const char* help;
+        FeedCounter counter;
+    };
+    const FeedMetric feedMetrics[] = {
+        {"trace_feed_messages_total", "Lines read from the feed", FEED_MESSAGES},
+        {"trace_feed_bytes_total", "Bytes read from the feed", FEED_BYTES},
+        {"trace_feed_errors_total", "Lines that were not a usable trade", FEED_ERRORS},
+        {"trace_enrichment_misses_total", "Trades whose issuer was not in the issuer table", FEED_ENRICH_MISSES},
+        {"trace_feed_duplicates_total", "Trades dropped as duplicates of ones already queued", FEED_DUPLICATES},
+    };
+    for (const FeedMetric& m : feedMetrics) {
+        w.family(m.name, "counter", m.help);
+        for (size_t i = 0; i < config.feeds.size(); ++i) {
+            MetricLabels labels = {{"feed", std::to_string(i + 1)},
+                                   {"source", config.feeds[i].host + ":" + std::to_string(config.feeds[i].port)}};
+            w.sample(m.name, labels, static_cast<double>(feedCounters->total(i * FEED_COUNTERS + m.counter)));
+        }
+    }
+
+    w.family("trace_queue_depth", "gauge", "Trades waiting in each queue");
+    w.family("trace_queue_capacity", "gauge", "Trades each queue holds before writers wait");
+    std::vector<StageStats> stages;
+    if (ingest->parse_stage()) stages.push_back(ingest->parse_stage()->stats());
+    if (ingest->enrich_stage()) stages.push_back(ingest->enrich_stage()->stats());
+    w.sample("trace_queue_depth", {{"queue", "trade"}}, static_cast<double>(tradeQueue->size_approx()));
+    w.sample("trace_queue_capacity", {{"queue", "trade"}}, static_cast<double>(config.queue_capacity));
+    for (const StageStats& s : stages) {
+        w.sample("trace_queue_depth", {{"queue", s.name}}, static_cast<double>(s.depth));
+        w.sample("trace_queue_capacity", {{"queue", s.name}}, static_cast<double>(s.capacity));
+    }
+    w.family("trace_queue_full_total", "counter", "Writes that found a queue full and waited");
+    w.sample("trace_queue_full_total", {{"queue", "trade"}}, static_cast<double>(ingestCounters.total(QUEUE_FULL)));
+    for (const StageStats& s : stages) {
+        w.sample("trace_queue_full_total", {{"queue", s.name}}, static_cast<double>(s.full_waits));
+    }
+
+    stages.push_back(persistMeter->snapshot());
+    w.family("trace_stage_items_total", "counter", "Items each stage has handled");
+    for (const StageStats& s : stages) w.sample("trace_stage_items_total", {{"stage", s.name}}, s.items);
+    w.family("trace_stage_dropped_total", "counter", "Items each stage rejected");
+    for (const StageStats& s : stages) w.sample("trace_stage_dropped_total", {{"stage", s.name}}, s.dropped);
+    w.family("trace_stage_busy_seconds_total", "counter", "Time each stage's threads spent working");
+    for (const StageStats& s : stages) {
+        w.sample("trace_stage_busy_seconds_total", {{"stage", s.name}}, static_cast<double>(s.busy_ns) / 1e9);
+    }
+
+    BackpressureStats pressure = backpressure->stats();
+    w.family("trace_backpressure_overloads_total", "counter", "Times the ingest queues reached the high watermark");
+    w.sample("trace_backpressure_overloads_total", static_cast<double>(pressure.episodes));
+    w.family("trace_backpressure_pauses_total", "counter", "Times a producer stopped reading its feed");
+    w.sample("trace_backpressure_pauses_total", static_cast<double>(pressure.pauses));
+    w.family("trace_backpressure_paused_seconds_total", "counter", "Time producers spent not reading, summed");
+    w.sample("trace_backpressure_paused_seconds_total", static_cast<double>(pressure.paused_ns) / 1e9);
+    w.family("trace_backpressure_shed_total", "counter", "Lines dropped by the shed overload policy");
+    w.sample("trace_backpressure_shed_total", static_cast<double>(pressure.shed));
+
+    w.family("trace_db_batch_size", "histogram", "Trades per database write");
+    w.histogram("trace_db_batch_size", {}, dbWrites->snapshot(DB_BATCH_SIZE), BATCH_SIZE_BOUNDS);
+    w.family("trace_db_flush_seconds", "histogram", "Time per database write (COPY batch, INSERT or journal commit)");
+    w.histogram("trace_db_flush_seconds", {}, dbWrites->snapshot(DB_FLUSH_TIME), FLUSH_SECONDS_BOUNDS, 1e9);
+
+    w.family("trace_latency_seconds", "summary", "Time trades spend in each step, from socket to database");
+    for (size_t stage = 0; stage < latency->stages().size(); ++stage) {
+        w.summary("trace_latency_seconds", {{"stage", latency->stages()[stage]}}, latency->snapshot(stage),
+                  {0.5, 0.99, 0.999}, 1e9);
+    }
+
+    w.family("trace_thread_cpu_seconds_total", "counter", "CPU time used by each thread");
+    for (const ThreadCpu& t : thread_cpu_times()) {
+        w.sample("trace_thread_cpu_seconds_total", {{"thread", t.name}, {"tid", std::to_string(t.tid)}}, t.seconds);
+    }
+}
+
+// --------
+// Shutdown
+// --------
+// SIGINT and SIGTERM only write a byte to shutdownPipe, which is all a
+// signal handler can safely do. A thread waiting on the pipe logs latency
+// totals since startup, flushes the log and exits.
+int shutdownPipe[2] = {-1, -1};
+
+extern "C" void onShutdownSignal(int) {
+    char c = 0;
+    ssize_t n = write(shutdownPipe[1], &c, 1);
+    (void)n;
+}
+
+bool installShutdownHandler() {
+    if (pipe(shutdownPipe) < 0) return false;
+    struct sigaction action{};
+    action.sa_handler = onShutdownSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    return sigaction(SIGINT, &action, nullptr) == 0 && sigaction(SIGTERM, &action, nullptr) == 0;
+}
+
+void shutdownOnSignal() {
+    char c;
+    while (read(shutdownPipe[0], &c, 1) < 0 && errno == EINTR) {
+    }
+    logger.info("Shutting down, latency since startup:");
+    std::vector<LatencySnapshot> sinceStartup;
+    reportLatency(sinceStartup);
+    logger.stop();
+    logStream().flush();
+    std::cout.flush();
+    std::_Exit(0);
+}
+
 // ----------------------------
 // TCP Reader Thread (Producer)
 // ----------------------------
@@ -119,7 +785,11 @@ void tcpReader(const std::string& host, int port, int producerId) {
     sockaddr_in server_addr{};
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(port);
-    inet_pton(AF_INET, host.c_str(), &server_addr.sin_addr);
+    if (inet_pton(AF_INET, host.c_str(), &server_addr.sin_addr) != 1) {
+        std::cerr << "[Producer " << producerId << "] Feed host must be an IPv4 address: " << host << "\n";
+        close(sock);
+        return;
+    }
 
     if (connect(sock, (sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
         perror("Connect failed");
@@ -129,105 +799,520 @@ void tcpReader(const std::string& host, int port, int producerId) {
 
     std::cout << "[Producer " << producerId << "] Connected to TRACE feed on port " << port << "\n";
 
-    std::string buffer;
-    char readBuf[1024];
-    while (true) {
-        ssize_t n = read(sock, readBuf, sizeof(readBuf));
-        if (n <= 0) break;
+    ingest->read_feed(sock, producerId);
 
-        buffer.append(readBuf, n);
+    close(sock);
+    std::cout << "[Producer " << producerId << "] TCP connection closed\n";
+}
 
-        size_t pos;
-        while ((pos = buffer.find('\n')) != std::string::npos) {
-            std::string line = buffer.substr(0, pos);
-            buffer.erase(0, pos + 1);
+// ---------------
+// Consumer Thread
+// ---------------
+// Consumers borrow connections from the pool rather than owning one, so a
+// dropped connection is replaced instead of ending the consumer.
+void consumer(int consumerId, ConnectionPool& pool) {
+    using Clock = std::chrono::steady_clock;
+    static LogSite gotTrade("[Consumer {}] Got trade: {}");
+    LogSampler tradeSample(TRADE_LOG_SAMPLE);
+    size_t slot = static_cast<size_t>(consumerId - 1);
+    StageMeter::Counters& meter = persistMeter->thread(slot);
+    if (config.sink == TradeSink::Insert) {
+        while (true) {
+            Trade trade;
+            while (!tradeQueue->dequeue(trade)) {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+            trade.stamps.dequeued = TscClock::now();
 
-            try {
-                auto msg = json::parse(line);
+            if (tradeSample.sample()) logger.info(gotTrade, consumerId, trade);
 
-                // Enrich with issuer info
-                if (msg.contains("issuer")) {
-                    auto it = issuerMap.find(msg["issuer"].get<std::string>());
-                    if (it != issuerMap.end()) {
-                        msg["rating"] = it->second.rating;
-                        msg["industry"] = it->second.industry;
+            // Insert into DB, retrying once on a fresh connection if this one
+            // turns out to be dead
+            auto start = Clock::now();
+            bool inserted = false;
+            for (int attempt = 0; attempt < 2 && !inserted;) {
+                // While the database is down, hold the trade rather than drop it
+                ConnectionPool::Lease conn = pool.acquire(DB_ACQUIRE_TIMEOUT);
+                if (!conn) continue;
+                ++attempt;
+                inserted = prepareInsertTrade(conn) && insertTrade(conn.get(), trade);
+                if (PQstatus(conn.get()) == CONNECTION_OK) break;
+            }
+            auto took = Clock::now() - start;
+            meter.record(took, inserted);
+            if (inserted) {
+                recordLatency(slot, trade.stamps, TscClock::now());
+                recordDbWrite(slot, took, 1);
+            }
+            if (!inserted) {
+                logger.error("[Consumer ", consumerId, "] Failed to insert trade");
+            }
+        }
+    }
+    else if (config.sink == TradeSink::Pipeline) {
+        // A pipeline keeps its connection for as long as it stays healthy
+        while (true) {
+            ConnectionPool::Lease conn = pool.acquire(DB_ACQUIRE_TIMEOUT);
+            if (!conn || !prepareInsertTrade(conn)) continue;
+            // Trades are counted as the server replies to each insert
+            PipelineSink sink(conn.get(), config.pipeline_max_in_flight,
+                              [&](const Trade& trade, const char* error, PipelineSink::Clock::duration took) {
+                                  meter.record_batch(1, std::chrono::nanoseconds::zero(), error ? 1 : 0);
+                                  if (error) {
+                                      PipelineSink::report(trade, error);
+                                      return;
+                                  }
+                                  recordLatency(slot, trade.stamps, TscClock::now());
+                                  recordDbWrite(slot, took, 1);
+                              });
+            if (!sink.start(false)) continue;
+
+            while (sink.alive()) {
+                Trade trade;
+                if (tradeQueue->dequeue(trade)) {
+                    trade.stamps.dequeued = TscClock::now();
+                    if (tradeSample.sample()) logger.info(gotTrade, consumerId, trade);
+                    auto start = Clock::now();
+                    bool sent = sink.add(trade);
+                    meter.record_batch(0, Clock::now() - start);
+                    if (!sent) {
+                        logger.error("[Consumer ", consumerId, "] Failed to send trade");
                     }
                 }
-
-                // Enqueue into MPMC queue
-                while (!tradeQueue.enqueue(msg)) {
+                else {
+                    // Nothing queued: collect results while we wait
+                    sink.poll();
                     std::this_thread::sleep_for(std::chrono::microseconds(50));
                 }
-
-            } 
-            catch (json::parse_error& e) {
-                std::cerr << "[Producer " << producerId << "] JSON parse error: " << e.what() << "\n";
             }
+            logger.warn("[Consumer ", consumerId, "] Pipeline connection lost, reconnecting");
         }
     }
+    else {
+        // The sink never flushes on its own; the controller decides when
+        CopySink sink(nullptr, config.batch_max + 1, std::chrono::microseconds::max(), COPY_CONFLICTS);
+        BatchController batches(config.batch_min, config.batch_max, config.latency_slo, BATCH_IDLE_GAP);
+        std::vector<TradeStamps> batchStamps;
+        batchStamps.reserve(config.batch_max + 1);
+        auto lastReport = std::chrono::steady_clock::now();
+        while (true) {
+            // Stop taking trades while a batch is waiting for a connection
+            Trade trade;
+            bool got = sink.pending() < config.batch_max && tradeQueue->dequeue(trade);
+            auto now = std::chrono::steady_clock::now();
+            if (got) {
+                trade.stamps.dequeued = TscClock::now();
+                if (tradeSample.sample()) logger.info(gotTrade, consumerId, trade);
+                sink.add(trade);
+                batchStamps.push_back(trade.stamps);
+                batches.on_add(now);
+            }
 
-    close(sock);
-    std::cout << "[Producer " << producerId << "] TCP connection closed\n";
+            FlushReason reason = batches.check(tradeQueue->size_approx(), now);
+            if (reason != FlushReason::None) {
+                ConnectionPool::Lease conn = pool.acquire(DB_ACQUIRE_TIMEOUT);
+                sink.use(conn.get(), conn.session());
+                bool ok = sink.flush();
+                sink.use(nullptr, conn.session());
+                conn.release();
+
+                if (sink.pending() > 0) {
+                    // No connection took the batch: hold it, still overdue,
+                    // and try again shortly
+                    logger.warn("[Consumer ", consumerId, "] No DB connection, holding ", sink.pending(), " trades");
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                }
+                else {
+                    // Only trades the server rejected on their own are lost
+                    const std::vector<size_t>& rejected = sink.rejected();
+                    auto took = Clock::now() - now;
+                    meter.record_batch(batches.pending_count(), took, rejected.size());
+                    recordDbWrite(slot, took, batches.pending_count());
+                    batches.on_flush(reason, took, tradeQueue->size_approx());
+                    uint64_t written = TscClock::now();
+                    auto next = rejected.begin();
+                    for (size_t i = 0; i < batchStamps.size(); ++i) {
+                        if (next != rejected.end() && *next == i) ++next;
+                        else recordLatency(slot, batchStamps[i], written);
+                    }
+                    batchStamps.clear();
+                    if (!ok) {
+                        logger.error("[Consumer ", consumerId, "] Dropped ", rejected.size(),
+                                     " trades the server rejected");
+                    }
+                }
+            }
+            else if (!got) {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+
+            if (now - lastReport >= BATCH_STATS_INTERVAL) {
+                if (batches.statistics().batches > 0) {
+                    logger.info("[Consumer ", consumerId, "] ", batches.statistics());
+                }
+                batches.reset_stats();
+                lastReport = now;
+            }
+        }
+    }
 }
 
-// ---------------
-// Consumer Thread
-// ---------------
-void consumer(int consumerId, const char* conninfo) {
-    PGconn* dbConn = PQconnectdb(conninfo);
-    if (PQstatus(dbConn) != CONNECTION_OK) {
-        std::cerr << "[Consumer " << consumerId << "] DB connection failed: " << PQerrorMessage(dbConn) << "\n";
-        PQfinish(dbConn);
+// ------------------------------------------
+// Async Writer Thread (replaces consumers)
+// ------------------------------------------
+// Drains tradeQueue into several connections from one thread. A reporter
+// thread reads the completion queue, records each trade's latency as
+// consumer 1 and logs throughput and worst-case write latency once a second.
+// Lost connections are reopened with backoff up to DB_MAX_BACKOFF, and the
+// writer keeps draining through those still up; with none up, trades wait
+// in the queue.
+void asyncWriter(const char* conninfo) {
+    using Clock = std::chrono::steady_clock;
+    auto writer = std::make_unique<AsyncWriter>(config.pipeline_max_in_flight);
+    if (!writer->connect(conninfo, config.async_writer_connections)) {
+        std::cerr << "[Writer] Can't start the writer, not writing trades\n";
         return;
     }
+    std::cout << "[Writer] Writing over " << writer->connection_count() << " connections\n";
 
+    std::atomic<bool> running{true};
+    StageMeter::Counters& meter = persistMeter->thread(0);
+    std::thread reporter = startThread("Reporter", backgroundCpu(), [&writer, &running, &meter]() {
+        while (running.load(std::memory_order_relaxed)) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+
+            uint64_t written = 0;
+            uint64_t failed = 0;
+            uint32_t maxLatency = 0;
+            WriteCompletion done;
+            while (writer->next_completion(done)) {
+                meter.record_batch(1, std::chrono::nanoseconds::zero(), done.ok ? 0 : 1);
+                if (done.ok) {
+                    ++written;
+                    recordLatency(0, done.stamps, done.written);
+                    recordDbWrite(0, std::chrono::microseconds(done.latency_us), 1);
+                }
+                else {
+                    ++failed;
+                }
+                maxLatency = std::max(maxLatency, done.latency_us);
+            }
+            if (written + failed > 0) {
+                std::cout << "[Writer] " << written << " written, " << failed << " failed, max latency "
+                          << maxLatency << " us\n";
+            }
+        }
+    });
+
+    const size_t wanted = config.async_writer_connections;
+    std::chrono::milliseconds backoff{100};
+    auto retryAt = Clock::now();
     while (true) {
-        json msg;
-        while (!tradeQueue.dequeue(msg)) {
+        size_t up = writer->connection_count();
+        if (up == wanted) {
+            backoff = std::chrono::milliseconds{100};
+        }
+        else if (Clock::now() >= retryAt) {
+            up = writer->reconnect();
+            if (up < wanted) {
+                std::cerr << "[Writer] " << up << " of " << wanted << " DB connections up, retrying in "
+                          << backoff.count() << " ms\n";
+                retryAt = Clock::now() + backoff;
+                backoff = std::min<std::chrono::milliseconds>(backoff * 2, DB_MAX_BACKOFF);
+            }
+        }
+        if (up == 0) {
+            std::this_thread::sleep_until(retryAt);
+            continue;
+        }
+
+        long taken = writer->pump(*tradeQueue, 1);
+        if (taken <= 0 && writer->in_flight() == 0) {
             std::this_thread::sleep_for(std::chrono::microseconds(50));
         }
+    }
 
-        std::cout << "[Consumer " << consumerId << "] Got trade: " << msg.dump() << "\n";
+    running = false;
+    reporter.join();
+}
+
+// ------------------------------------
+// Journal Consumer Thread (no database)
+// ------------------------------------
+// Appends whatever is queued, then waits once for all of it to be durable.
+// Commits from all consumers are grouped, so a busy pipeline needs far
+// fewer fdatasync() calls than trades.
+void journalConsumer(int consumerId, TradeJournal& journal) {
+    size_t slot = static_cast<size_t>(consumerId - 1);
+    StageMeter::Counters& meter = persistMeter->thread(slot);
+    std::vector<TradeStamps> batchStamps;
+    batchStamps.reserve(JOURNAL_COMMIT_BATCH);
+    while (true) {
+        uint64_t ticket = 0;
+        size_t appended = 0;
+        Trade trade;
+        auto start = std::chrono::steady_clock::now();
+        batchStamps.clear();
+        while (appended < JOURNAL_COMMIT_BATCH && tradeQueue->dequeue(trade)) {
+            trade.stamps.dequeued = TscClock::now();
+            batchStamps.push_back(trade.stamps);
+            ticket = journal.append(trade);
+            ++appended;
+        }
 
-        // Insert into DB
-        if (!insertTrade(dbConn, msg)) {
-            std::cerr << "[Consumer " << consumerId << "] Failed to insert trade\n";
+        if (appended == 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            continue;
+        }
+        if (!journal.wait_durable(ticket)) {
+            logger.error("[Consumer ", consumerId, "] Journal write failed: ", journal.error());
+            return;
         }
+        auto took = std::chrono::steady_clock::now() - start;
+        meter.record_batch(appended, took);
+        recordDbWrite(slot, took, appended);
+        uint64_t written = TscClock::now();
+        for (const TradeStamps& stamps : batchStamps) recordLatency(slot, stamps, written);
     }
+}
 
-    PQfinish(dbConn);
+// -----------------------------------------
+// Journal Replayer Thread (journal -> DB)
+// -----------------------------------------
+// Copies durable trades into Postgres in batches and checkpoints after
+// each batch commits. If the database is unreachable it reconnects with
+// exponential backoff and resumes from the checkpoint. The sink retries a
+// batch the server rejects in smaller pieces, so one bad trade is logged
+// and skipped instead of blocking the journal forever.
+void journalReplayer(TradeJournal& journal, const char* conninfo) {
+    const std::string dir = journal.directory();
+    JournalPosition checkpoint = load_journal_checkpoint(dir);
+    JournalReader reader(dir, checkpoint);
+    std::chrono::milliseconds backoff{100};
+
+    while (true) {
+        PGconn* conn = PQconnectdb(conninfo);
+        if (PQstatus(conn) != CONNECTION_OK) {
+            std::cerr << "[Replayer] DB unavailable, retrying in " << backoff.count() << " ms\n";
+            PQfinish(conn);
+            std::this_thread::sleep_for(backoff);
+            backoff = std::min<std::chrono::milliseconds>(backoff * 2, JOURNAL_MAX_BACKOFF);
+            continue;
+        }
+        backoff = std::chrono::milliseconds{100};
+
+        // Flushes only when told to, so a batch is exactly what's between
+        // two checkpoints
+        CopySink sink(conn, JOURNAL_REPLAY_BATCH + 1, std::chrono::microseconds::max(), COPY_CONFLICTS);
+        while (PQstatus(conn) == CONNECTION_OK) {
+            Trade trade;
+            JournalPosition limit = journal.durable();
+            while (sink.pending() < JOURNAL_REPLAY_BATCH && reader.next(trade, limit)) {
+                sink.add(trade);
+            }
+            if (sink.pending() == 0) {
+                if (!reader.error().empty()) {
+                    std::cerr << "[Replayer] " << reader.error() << "\n";
+                    reader.seek(checkpoint);
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
+                }
+                else {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                }
+                continue;
+            }
+
+            JournalPosition batchEnd = reader.position();
+            if (!sink.flush() && sink.pending() > 0) break;
+
+            checkpoint = batchEnd;
+            std::string error;
+            if (!save_journal_checkpoint(dir, checkpoint, error)) {
+                std::cerr << "[Replayer] " << error << "\n";
+            }
+            remove_journal_segments_before(dir, checkpoint);
+        }
+
+        // The rows the sink still holds are replayed from the checkpoint, and
+        // it outlives conn, so it mustn't flush through it on destruction
+        sink.discard();
+        sink.use(nullptr, 0);
+        std::cerr << "[Replayer] DB connection lost, resuming from checkpoint\n";
+        reader.seek(checkpoint);
+        PQfinish(conn);
+    }
 }
 
 // -------------
 // Main Function
 // -------------
-int main() {
-    const std::string host = "127.0.0.1";
-    const std::vector<int> ports = {5555, 5556, 5557};
-    const int numConsumers = 2;
-    const char* conninfo = "dbname=finance user=douglas host=/var/run/postgresql";
-
-    // Load issuer info
-    if (!loadIssuerInfo(conninfo)) {
+int main(int argc, char* argv[]) {
+    ConfigAction action;
+    std::string configError;
+    if (!parse_config_args(argc, argv, config, action, configError) ||
+        (action == ConfigAction::Run &&
+         !validate_config(config, MAX_QUEUE_CAPACITY, RcuSnapshot<IssuerTable>::max_readers, configError))) {
+        std::cerr << configError << "\n\n" << config_usage();
+        return 2;
+    }
+    if (action == ConfigAction::Help) {
+        std::cout << "Usage: " << argv[0] << " [options]\n" << config_usage();
+        return 0;
+    }
+    if (action == ConfigAction::PrintConfig) {
+        std::cout << config_to_json(config).dump(2) << "\n";
+        return 0;
+    }
+    const char* conninfo = config.conninfo.c_str();
+
+    // Place the queue before any thread touches it, and report where
+    // everything will run
+    CpuTopology topology = CpuTopology::detect();
+    int queueNode = -1;
+    if (!placeThreads(topology, queueNode, configError)) {
+        std::cerr << configError << "\n";
+        return 2;
+    }
+    if (!tradeQueue.create(queueNode)) {
+        std::cerr << "Failed to allocate the trade queue. Exiting.\n";
+        return 1;
+    }
+    bool oneWriter = config.sink == TradeSink::Async;
+    reportTopology(topology, oneWriter ? 1 : config.consumers);
+
+    // Measure the TSC rate now rather than on the first trade
+    TscClock::calibrate();
+    if (TscClock::uses_tsc()) {
+        std::cout << "[Latency] Timestamps from the TSC at " << TscClock::ticks_per_ns() << " GHz\n";
+    }
+    else {
+        std::cout << "[Latency] No invariant TSC, timestamps from steady_clock\n";
+    }
+
+    std::string pinError;
+    int loggerCpu = backgroundCpu();
+    if (loggerCpu >= 0 && !pin_thread(logger.native_handle(), loggerCpu, pinError)) {
+        std::cerr << "[Logger] " << pinError << ", running unpinned\n";
+    }
+    pthread_setname_np(logger.native_handle(), "Logger");
+
+    // Load issuer info, from the last snapshot if there is one. The reloader
+    // then refreshes it from Postgres in the background.
+    bool fromSnapshot = mapIssuerSnapshot();
+    if (!fromSnapshot && !loadIssuerInfo(conninfo)) {
         std::cerr << "Failed to load issuer info. Exiting.\n";
         return 1;
     }
 
+    // Open the local trade journal, recovering anything left from last run
+    std::unique_ptr<TradeJournal> journal;
+    if (config.sink == TradeSink::Journal) {
+        journal = std::make_unique<TradeJournal>(config.journal_dir, JOURNAL_SEGMENT_BYTES);
+        std::string error;
+        if (!journal->open(error)) {
+            std::cerr << "Failed to open trade journal: " << error << ". Exiting.\n";
+            return 1;
+        }
+        std::cout << "Opened trade journal with " << journal->recovered() << " trades in its last segment\n";
+    }
+
+    // Keep issuer reference data fresh without restarting the pipeline
+    std::thread reloader = startThread("Reloader", backgroundCpu(), issuerReloader, std::string(conninfo),
+                                       ISSUER_RELOAD_INTERVAL, fromSnapshot);
+
+    // Load known securities before any producer starts. The first terms
+    // seen for a CUSIP become its reference, so reference data must get
+    // there ahead of the feed. Not fatal since the master also learns from
+    // the feed.
+    if (!loadSecurityMaster(conninfo)) {
+        std::cerr << "Failed to load security master, learning from feed only.\n";
+    }
+
+    // Start the parse and enrich stages ahead of the producers feeding them,
+    // and report every stage's progress periodically
+    persistMeter = std::make_unique<StageMeter>("persist", config.consumers);
+    latency = std::make_unique<LatencyRecorder>(
+        std::vector<std::string>{"parse", "enrich", "queue", "persist", "total"}, config.consumers);
+    dbWrites = std::make_unique<LatencyRecorder>(std::vector<std::string>{"flush", "batch"}, config.consumers);
+    feedCounters = std::make_unique<ThreadCounters>(config.feeds.size() * FEED_COUNTERS);
+    backpressure = std::make_unique<Backpressure>(config.high_watermark / 100.0, config.low_watermark / 100.0,
+                                                  config.overload, config.feeds.size());
+    ingest = std::make_unique<Ingest>(*tradeQueue, config.queue_capacity, securityMaster, issuerSnapshot, tradeDedupe,
+                                      *backpressure, *feedCounters, ingestCounters, logger);
+    if (config.staged) {
+        ingest->start_stages(config.parse_threads, config.enrich_threads, config.parse_cpus, config.enrich_cpus,
+                             queueNode);
+    }
+    std::thread stageReporter = startThread("Stage reporter", backgroundCpu(), []() {
+        std::vector<StageStats> last;
+        BackpressureStats lastPressure;
+        std::vector<LatencySnapshot> lastLatency;
+        while (true) {
+            std::this_thread::sleep_for(STAGE_STATS_INTERVAL);
+            reportStages(STAGE_STATS_INTERVAL, last, lastPressure);
+            reportLatency(lastLatency);
+        }
+    });
+    // Serve metrics once everything they read exists
+    MetricsServer metrics(writeMetrics);
+    if (config.metrics_port > 0) {
+        std::string metricsError;
+        if (metrics.start(config.metrics_address, static_cast<int>(config.metrics_port), metricsError)) {
+            std::cout << "[Metrics] Serving http://" << config.metrics_address << ":" << metrics.port()
+                      << "/metrics\n";
+        }
+        else {
+            std::cerr << "[Metrics] " << metricsError << ", not serving metrics\n";
+        }
+    }
+
+    std::thread shutdown;
+    if (installShutdownHandler()) {
+        shutdown = startThread("Shutdown", backgroundCpu(), shutdownOnSignal);
+    }
+    else {
+        std::cerr << "Can't install signal handlers, latency totals won't be logged at exit\n";
+    }
+
     // Launch producers
     std::vector<std::thread> producers;
-    for (size_t i = 0; i < ports.size(); ++i) {
-        producers.emplace_back(tcpReader, host, ports[i], static_cast<int>(i + 1));
+    for (size_t i = 0; i < config.feeds.size(); ++i) {
+        int id = static_cast<int>(i + 1);
+        producers.push_back(startThread("Producer " + std::to_string(id), cpuAt(config.producer_cpus, i), tcpReader,
+                                        config.feeds[i].host, config.feeds[i].port, id));
     }
 
     // Launch consumers
+    ConnectionPool pool(conninfo, config.db_connections, DB_MAX_BACKOFF);
     std::vector<std::thread> consumers;
-    for (int i = 0; i < numConsumers; ++i) {
-        consumers.emplace_back(consumer, i + 1, conninfo);
+    if (config.sink == TradeSink::Async) {
+        consumers.push_back(startThread("Writer", cpuAt(config.consumer_cpus, 0), asyncWriter, conninfo));
+    }
+    else if (config.sink == TradeSink::Journal) {
+        consumers.push_back(startThread("Replayer", backgroundCpu(), journalReplayer, std::ref(*journal), conninfo));
+        for (size_t i = 0; i < config.consumers; ++i) {
+            int id = static_cast<int>(i + 1);
+            consumers.push_back(startThread("Consumer " + std::to_string(id), cpuAt(config.consumer_cpus, i),
+                                            journalConsumer, id, std::ref(*journal)));
+        }
+    }
+    else {
+        if (pool.connect_all() == 0) {
+            std::cerr << "No DB connections yet, consumers will keep retrying\n";
+        }
+        for (size_t i = 0; i < config.consumers; ++i) {
+            int id = static_cast<int>(i + 1);
+            consumers.push_back(startThread("Consumer " + std::to_string(id), cpuAt(config.consumer_cpus, i), consumer,
+                                            id, std::ref(pool)));
+        }
     }
 
     // Join threads
     for (auto& t : producers) t.join();
     for (auto& t : consumers) t.join();
+    reloader.join();
+    stageReporter.join();
+    if (shutdown.joinable()) shutdown.join();
 
     return 0;
 }
@@ -0,0 +1,64 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+// Read-only memory mapping of a whole file.
+// The mapping is private, so pages are shared with the page cache and are
+// only read from disk on first touch. Closing the descriptor right after
+// mmap() is fine since the mapping keeps its own reference to the file.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    ~MappedFile() {
+        if (base) munmap(base, length);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps `path`. On failure returns false and describes why in `error`.
+    bool open(const std::string& path, std::string& error) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            error = path + ": " + std::strerror(errno);
+            return false;
+        }
+
+        struct stat st{};
+        if (fstat(fd, &st) < 0) {
+            error = path + ": " + std::strerror(errno);
+            ::close(fd);
+            return false;
+        }
+        if (st.st_size == 0) {
+            error = path + ": empty file";
+            ::close(fd);
+            return false;
+        }
+
+        void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            error = path + ": mmap failed: " + std::strerror(errno);
+            return false;
+        }
+
+        base = p;
+        length = static_cast<size_t>(st.st_size);
+        return true;
+    }
+
+    const char* data() const { return static_cast<const char*>(base); }
+    size_t size() const { return length; }
+
+private:
+    void* base = nullptr;
+    size_t length = 0;
+};
@@ -0,0 +1,243 @@
+#pragma once
+#include <dirent.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "latency_histogram.h"
+
+// --------------------
+// Per-thread counters
+// --------------------
+// A fixed set of counters that any thread may add to without sharing a
+// cache line with another: each thread gets its own block the first time
+// it adds, and only that thread writes it, with relaxed atomics. Readers
+// (a metrics scrape) sum the blocks. Registering a block takes a lock, but
+// only once per thread.
+//
+//   ThreadCounters counters(FEED_COUNTERS * feeds);
+//   counters.add(feed * FEED_COUNTERS + FEED_BYTES, n);   // On any thread
+//   uint64_t bytes = counters.total(feed * FEED_COUNTERS + FEED_BYTES);
+class ThreadCounters {
+public:
+    explicit ThreadCounters(size_t width) : width(std::max<size_t>(width, 1)), id(next_id().fetch_add(1) + 1) {}
+
+    ThreadCounters(const ThreadCounters&) = delete;
+    ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+    void add(size_t counter, uint64_t n = 1) {
+        std::atomic<uint64_t>& c = at(local(), counter);
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    uint64_t total(size_t counter) const {
+        std::lock_guard<std::mutex> lock(blocks_mutex);
+        uint64_t sum = 0;
+        for (const auto& block : blocks) sum += at(block->lines.get(), counter).load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    size_t size() const { return width; }
+
+    // Threads that have added anything
+    size_t threads() const {
+        std::lock_guard<std::mutex> lock(blocks_mutex);
+        return blocks.size();
+    }
+
+private:
+    // A block is whole cache lines, allocated line-aligned, so however
+    // narrow the set no two threads' counters share a line.
+    struct alignas(64) Line {
+        static constexpr size_t size = 64 / sizeof(std::atomic<uint64_t>);
+        std::atomic<uint64_t> values[size] = {};
+    };
+
+    struct Block {
+        explicit Block(size_t n) : lines(new Line[(n + Line::size - 1) / Line::size]) {}
+        std::unique_ptr<Line[]> lines;
+    };
+
+    static std::atomic<uint64_t>& at(Line* lines, size_t counter) {
+        return lines[counter / Line::size].values[counter % Line::size];
+    }
+
+    // This thread's block. Each thread caches its blocks by counter set id;
+    // ids are never reused, so a stale entry from a destroyed set is never
+    // matched.
+    Line* local() {
+        thread_local std::vector<std::pair<uint64_t, Line*>> cache;
+        for (const auto& [owner, lines] : cache) {
+            if (owner == id) return lines;
+        }
+        Line* lines;
+        {
+            std::lock_guard<std::mutex> lock(blocks_mutex);
+            blocks.push_back(std::make_unique<Block>(width));
+            lines = blocks.back()->lines.get();
+        }
+        cache.emplace_back(id, lines);
+        return lines;
+    }
+
+    static std::atomic<uint64_t>& next_id() {
+        static std::atomic<uint64_t> n{0};
+        return n;
+    }
+
+    size_t width;
+    uint64_t id;
+    mutable std::mutex blocks_mutex;
+    std::vector<std::unique_ptr<Block>> blocks;
+};
+
+// ----------------
+// Thread CPU time
+// ----------------
+// CPU time of each of this process's threads, by name, from
+// /proc/self/task/*/stat. Name threads with pthread_setname_np() to tell
+// them apart.
+struct ThreadCpu {
+    std::string name;
+    int tid = 0;
+    double seconds = 0;   // User plus system
+};
+
+inline std::vector<ThreadCpu> thread_cpu_times(const std::string& task_dir = "/proc/self/task") {
+    std::vector<ThreadCpu> out;
+    DIR* dir = opendir(task_dir.c_str());
+    if (!dir) return out;
+    double tick = 1.0 / static_cast<double>(std::max(1L, sysconf(_SC_CLK_TCK)));
+    while (dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] < '0' || entry->d_name[0] > '9') continue;
+        std::ifstream in(task_dir + "/" + entry->d_name + "/stat");
+        std::string stat;
+        if (!std::getline(in, stat)) continue;
+
+        // "tid (name) state ppid ...", where the name may hold spaces or
+        // parentheses, so it ends at the last ')'. utime and stime are the
+        // 14th and 15th fields.
+        size_t open = stat.find('(');
+        size_t close = stat.rfind(')');
+        if (open == std::string::npos || close == std::string::npos || close < open) continue;
+        std::istringstream rest(stat.substr(close + 1));
+        std::string field;
+        unsigned long long utime = 0, stime = 0;
+        for (int i = 3; i <= 15 && rest >> field; ++i) {
+            if (i == 14) utime = std::strtoull(field.c_str(), nullptr, 10);
+            if (i == 15) stime = std::strtoull(field.c_str(), nullptr, 10);
+        }
+        ThreadCpu t;
+        t.name = stat.substr(open + 1, close - open - 1);
+        t.tid = std::atoi(entry->d_name);
+        t.seconds = static_cast<double>(utime + stime) * tick;
+        out.push_back(std::move(t));
+    }
+    closedir(dir);
+    std::sort(out.begin(), out.end(), [](const ThreadCpu& a, const ThreadCpu& b) { return a.tid < b.tid; });
+    return out;
+}
+
+// ---------------------------------
+// Prometheus text exposition format
+// ---------------------------------
+// Writes metric families in the text format Prometheus scrapes (version
+// 0.0.4): a HELP and TYPE line per family, then one line per sample.
+//
+//   MetricsWriter w(out);
+//   w.family("trace_feed_bytes_total", "counter", "Bytes read from each feed");
+//   w.sample("trace_feed_bytes_total", {{"feed", "1"}}, 123456);
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+class MetricsWriter {
+public:
+    explicit MetricsWriter(std::ostream& out) : out(out) {}
+
+    void family(std::string_view name, std::string_view type, std::string_view help) {
+        out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+    }
+
+    void sample(std::string_view name, const MetricLabels& labels, double value) {
+        out << name;
+        write_labels(labels);
+        out << ' ';
+        write_value(value);
+        out << '\n';
+    }
+
+    void sample(std::string_view name, double value) { sample(name, {}, value); }
+
+    // Samples of a histogram family from a log-linear snapshot: a cumulative
+    // count for each upper bound, then +Inf, _sum and _count. Values are
+    // divided by `scale` (1e9 turns nanoseconds into seconds). Counts at a
+    // bound are exact to the snapshot's bucket precision.
+    void histogram(std::string_view name, const MetricLabels& labels, const LatencySnapshot& s,
+                   const std::vector<double>& bounds, double scale = 1.0) {
+        std::string bucket = std::string(name) + "_bucket";
+        size_t i = 0;
+        uint64_t cumulative = 0;
+        for (double bound : bounds) {
+            while (i < s.counts.size() && static_cast<double>(latency_detail::bucket_top(i)) <= bound * scale) {
+                cumulative += s.counts[i++];
+            }
+            MetricLabels with = labels;
+            with.emplace_back("le", format_value(bound));
+            sample(bucket, with, static_cast<double>(cumulative));
+        }
+        MetricLabels inf = labels;
+        inf.emplace_back("le", "+Inf");
+        sample(bucket, inf, static_cast<double>(s.count));
+        sample(std::string(name) + "_sum", labels, static_cast<double>(s.sum_ns) / scale);
+        sample(std::string(name) + "_count", labels, static_cast<double>(s.count));
+    }
+
+    // Samples of a summary family: the given quantiles, _sum and _count
+    void summary(std::string_view name, const MetricLabels& labels, const LatencySnapshot& s,
+                 const std::vector<double>& quantiles, double scale = 1.0) {
+        for (double q : quantiles) {
+            MetricLabels with = labels;
+            with.emplace_back("quantile", format_value(q));
+            sample(name, with, static_cast<double>(s.percentile(q)) / scale);
+        }
+        sample(std::string(name) + "_sum", labels, static_cast<double>(s.sum_ns) / scale);
+        sample(std::string(name) + "_count", labels, static_cast<double>(s.count));
+    }
+
+    static std::string format_value(double v) {
+        std::ostringstream os;
+        os.precision(15);
+        os << v;
+        return os.str();
+    }
+
+private:
+    void write_labels(const MetricLabels& labels) {
+        if (labels.empty()) return;
+        out << '{';
+        for (size_t i = 0; i < labels.size(); ++i) {
+            if (i) out << ',';
+            out << labels[i].first << "=\"";
+            for (char c : labels[i].second) {
+                if (c == '\\' || c == '"') out << '\\' << c;
+                else if (c == '\n') out << "\\n";
+                else out << c;
+            }
+            out << '"';
+        }
+        out << '}';
+    }
+
+    void write_value(double v) { out << format_value(v); }
+
+    std::ostream& out;
+};
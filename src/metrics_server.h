@@ -0,0 +1,148 @@
+#pragma once
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// ----------------------
+// Metrics HTTP listener
+// ----------------------
+// Just enough HTTP/1.0 for Prometheus to scrape: GET /metrics returns
+// whatever the render function writes, as text exposition format; any other
+// path is a 404. One connection at a time on one thread, closed after each
+// response, which is plenty for a scrape every few seconds and keeps the
+// listener off the ingest threads entirely.
+//
+// Listens on loopback by default. Port 0 picks a free port; port() says
+// which.
+class MetricsServer {
+public:
+    using Render = std::function<void(std::ostream&)>;
+
+    explicit MetricsServer(Render render) : render(std::move(render)) {}
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    ~MetricsServer() { stop(); }
+
+    bool start(const std::string& address, int port, std::string& error) {
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+            error = "metrics address must be an IPv4 address: " + address;
+            return false;
+        }
+        listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int one = 1;
+        if (listen_fd < 0 || setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+            bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listen_fd, 16) < 0) {
+            error = "can't listen on " + address + ":" + std::to_string(port) + ": " + std::strerror(errno);
+            close_listener();
+            return false;
+        }
+        socklen_t len = sizeof(addr);
+        getsockname(listen_fd, reinterpret_cast<sockaddr*>(&addr), &len);
+        bound_port = ntohs(addr.sin_port);
+
+        running = true;
+        worker = std::thread(&MetricsServer::run, this);
+        return true;
+    }
+
+    void stop() {
+        if (running.exchange(false)) worker.join();
+        close_listener();
+    }
+
+    int port() const { return bound_port; }
+    uint64_t scrapes() const { return scrape_count.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t max_request = 8192;
+
+    void run() {
+        pthread_setname_np(pthread_self(), "Metrics");
+        pollfd pfd{listen_fd, POLLIN, 0};
+        while (running.load(std::memory_order_acquire)) {
+            // Wake now and then to notice stop()
+            if (poll(&pfd, 1, 200) <= 0) continue;
+            int client = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0) continue;
+            serve(client);
+            ::close(client);
+        }
+    }
+
+    void serve(int client) {
+        // Don't let a client that never finishes its request hold us up
+        timeval timeout{1, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+        std::string request;
+        char buf[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < max_request) {
+            ssize_t n = ::read(client, buf, sizeof(buf));
+            if (n <= 0) break;
+            request.append(buf, static_cast<size_t>(n));
+        }
+
+        std::string_view line(request);
+        line = line.substr(0, line.find("\r\n"));
+        if (line.substr(0, 4) != "GET ") {
+            respond(client, "405 Method Not Allowed", "text/plain", "GET only\n");
+            return;
+        }
+        std::string_view path = line.substr(4, line.find(' ', 4) - 4);
+        path = path.substr(0, path.find('?'));
+        if (path != "/metrics") {
+            respond(client, "404 Not Found", "text/plain", "Metrics are at /metrics\n");
+            return;
+        }
+
+        std::ostringstream body;
+        render(body);
+        scrape_count.fetch_add(1, std::memory_order_relaxed);
+        respond(client, "200 OK", "text/plain; version=0.0.4; charset=utf-8", body.str());
+    }
+
+    static void respond(int client, std::string_view status, std::string_view type, const std::string& body) {
+        std::string response = "HTTP/1.0 " + std::string(status) + "\r\nContent-Type: " + std::string(type) +
+                               "\r\nContent-Length: " + std::to_string(body.size()) +
+                               "\r\nConnection: close\r\n\r\n" + body;
+        const char* p = response.data();
+        size_t left = response.size();
+        while (left > 0) {
+            ssize_t n = ::send(client, p, left, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return;
+            p += n;
+            left -= static_cast<size_t>(n);
+        }
+    }
+
+    void close_listener() {
+        if (listen_fd >= 0) ::close(listen_fd);
+        listen_fd = -1;
+    }
+
+    Render render;
+    int listen_fd = -1;
+    int bound_port = 0;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> scrape_count{0};
+    std::thread worker;
+};
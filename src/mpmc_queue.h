@@ -20,8 +20,6 @@ class MPMCQueue {
     // Otherwise need std::hardware_destructive_interference_size,
     // which requires additional compiler flags.
     static constexpr size_t cache_line = 64;
-    static constexpr size_t data_size = sizeof(std::atomic<size_t>) + sizeof(T);
-    static constexpr size_t padding_size = (data_size < cache_line) ? (cache_line - data_size) : 0;
 
 public:
     MPMCQueue() {
@@ -108,15 +106,25 @@ public:
         return true;
     }
 
+    // Number of claimed slots not yet dequeued. Head and tail are read
+    // separately while other threads move them, so this is only an estimate,
+    // good for sizing decisions and stats but not for synchronization.
+    size_t size_approx() const {
+        size_t h = head.value.load(std::memory_order_relaxed);
+        size_t t = tail.value.load(std::memory_order_relaxed);
+        if (t <= h) return 0;
+        return t - h < Capacity ? t - h : Capacity;
+    }
+
 private:
     // We want to maximize performance by preventing false sharing and having
-    // our data cache-line aligned. This is why we have char padding if necessary.
+    // our data cache-line aligned. alignas rounds each Data up to a whole
+    // number of cache lines, including when T is bigger than one line.
     // The PaddedAtomic struct ensures that head and tail are cache-line isolated.
     
     struct alignas(cache_line) Data {
         std::atomic<size_t> sequence;
         T value;
-        char padding[padding_size > 0 ? padding_size : 0];
     };
 
     struct alignas(cache_line) PaddedAtomic {
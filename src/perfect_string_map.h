@@ -0,0 +1,322 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "flat_string_map.h"
+
+// Immutable string -> V map backed by a minimal perfect hash.
+//
+// Keys are staged with insert() and the hash function is computed once by
+// build(). After that every key maps to its own slot in an array of exactly
+// size() slots, so a lookup is one string hash, one pilot load, one slot load
+// and one key compare. There is no probing and no empty slots.
+//
+// The construction is hash-and-displace (as in CHD/PTHash):
+// - Keys are split into buckets by their hash, about 4 keys per bucket.
+// - Buckets are placed largest first. For each one we search for a "pilot"
+//   value that, mixed into each key's hash, sends every key in the bucket to
+//   a free position.
+// - Positions range over ~1% more than size() so the last buckets don't need
+//   millions of attempts to hit the final free spots. The few keys that land
+//   past the end are remapped to the holes left below it, which keeps the
+//   slot array minimal.
+// - The pilot per bucket (plus the small remap table) is all we keep. Lookup
+//   recomputes the position from the key's hash and its bucket's pilot.
+//
+// Because any string hashes to *some* slot, find() must still compare the
+// key to reject strings that were never inserted.
+//
+// Lookups only ever go through a View of plain arrays. After build() it
+// points at the map's own storage, but attach() can point it at memory the
+// map doesn't own, such as a memory-mapped snapshot file.
+template<typename V>
+class PerfectStringMap {
+public:
+    struct Slot {
+        uint32_t key_offset;
+        uint32_t key_size;
+        V value;
+    };
+
+    // Everything find() needs.
+    struct View {
+        uint64_t seed = 0;
+        uint64_t positions_count = 0;
+        const uint32_t* pilots = nullptr;
+        size_t pilot_count = 0;
+        const uint32_t* remap = nullptr;
+        size_t remap_count = 0;
+        const Slot* slots = nullptr;
+        size_t slot_count = 0;
+        const char* keys = nullptr;
+        size_t keys_size = 0;
+    };
+
+    PerfectStringMap() = default;
+
+    // The view points into our own vectors, so copies would alias the
+    // original. Moves are fine since vector moves keep their buffers.
+    PerfectStringMap(const PerfectStringMap&) = delete;
+    PerfectStringMap& operator=(const PerfectStringMap&) = delete;
+    PerfectStringMap(PerfectStringMap&&) = default;
+    PerfectStringMap& operator=(PerfectStringMap&&) = default;
+
+    // Stages a key for the next build(). A repeated key keeps the last value.
+    void insert(std::string_view key, V value) {
+        if (table.slots == slots.data() && !slots.empty()) {
+            // Adding to a built map re-stages the existing keys.
+            pending = std::move(slots);
+            slots.clear();
+        }
+        table = View{};
+        pending.push_back({static_cast<uint32_t>(arena.size()), static_cast<uint32_t>(key.size()), std::move(value)});
+        arena.insert(arena.end(), key.begin(), key.end());
+    }
+
+    void reserve(size_t count) {
+        pending.reserve(count);
+    }
+
+    // Computes the perfect hash over all staged keys. Returns false only if
+    // no seed worked, which in practice needs adversarial input.
+    bool build() {
+        dedupe();
+
+        for (uint64_t attempt = 0; attempt < max_seeds; ++attempt) {
+            if (try_build(0x5851F42D4C957F2Dull * (attempt + 1))) {
+                table.seed = seed;
+                table.positions_count = positions_count;
+                table.pilots = pilots.data();
+                table.pilot_count = pilots.size();
+                table.remap = remap.data();
+                table.remap_count = remap.size();
+                table.slots = slots.data();
+                table.slot_count = slots.size();
+                table.keys = arena.data();
+                table.keys_size = arena.size();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Serves lookups from arrays owned by someone else, who must keep them
+    // alive for as long as this map is used. The view is bounds-checked
+    // first so a corrupt source can't cause out-of-range reads. Returns false
+    // (and leaves the map empty) if it's inconsistent.
+    bool attach(const View& external) {
+        static_assert(std::is_trivially_copyable<V>::value, "attached values must be trivially copyable");
+
+        table = View{};
+        slots.clear();
+        pending.clear();
+        arena.clear();
+
+        if (external.slot_count > 0) {
+            if (external.pilot_count == 0 ||
+                external.positions_count > UINT32_MAX ||
+                external.positions_count < external.slot_count ||
+                external.remap_count != external.positions_count - external.slot_count) {
+                return false;
+            }
+            for (size_t i = 0; i < external.remap_count; ++i) {
+                if (external.remap[i] >= external.slot_count) return false;
+            }
+            for (size_t i = 0; i < external.slot_count; ++i) {
+                const Slot& slot = external.slots[i];
+                if (static_cast<uint64_t>(slot.key_offset) + slot.key_size > external.keys_size) return false;
+            }
+        }
+
+        table = external;
+        return true;
+    }
+
+    // Returns nullptr when the key is not present (or the map isn't built).
+    const V* find(std::string_view key) const {
+        if (table.slot_count == 0) return nullptr;
+
+        uint64_t h = hash_string(key, table.seed);
+        size_t pos = position_for(h, table.pilots[bucket_for(h, table.pilot_count)], table.positions_count);
+        if (pos >= table.slot_count) pos = table.remap[pos - table.slot_count];
+
+        const Slot& slot = table.slots[pos];
+        if (slot.key_size != key.size()) return nullptr;
+        if (!key.empty() && std::memcmp(table.keys + slot.key_offset, key.data(), key.size()) != 0) {
+            return nullptr;
+        }
+        return &slot.value;
+    }
+
+    const View& view() const { return table; }
+    size_t size() const { return table.slot_count; }
+    bool empty() const { return size() == 0; }
+    size_t bucket_count() const { return table.pilot_count; }
+
+private:
+    static constexpr size_t keys_per_bucket = 4;
+    static constexpr uint64_t max_seeds = 16;
+    static constexpr uint32_t max_pilot = 1u << 20;
+
+    // Maps the top 32 bits of x onto [0, n) with a multiply instead of a
+    // modulo. n always fits in 32 bits since slots use 32-bit offsets.
+    static size_t fast_range(uint64_t x, size_t n) {
+        return static_cast<size_t>(((x >> 32) * static_cast<uint64_t>(n)) >> 32);
+    }
+
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 31;
+        x *= 0x7FB5D329728EA185ull;
+        x ^= x >> 27;
+        x *= 0x81DADEF4BC2DD44Dull;
+        x ^= x >> 33;
+        return x;
+    }
+
+    static size_t bucket_for(uint64_t h, size_t bucket_count) {
+        // Buckets come from the low half of the hash, positions from the
+        // mixed hash, so the two are independent.
+        return fast_range(h << 32, bucket_count);
+    }
+
+    static size_t position_for(uint64_t h, uint32_t pilot, size_t positions) {
+        return fast_range(mix(h ^ (pilot * 0x9E3779B97F4A7C15ull)), positions);
+    }
+
+    std::string_view pending_key(const Slot& s) const {
+        return std::string_view(arena.data() + s.key_offset, s.key_size);
+    }
+
+    // Keeps the last value for any key staged more than once.
+    void dedupe() {
+        FlatStringMap<size_t> last;
+        last.reserve(pending.size());
+        for (size_t i = 0; i < pending.size(); ++i) {
+            last.insert_or_assign(pending_key(pending[i]), i);
+        }
+        if (last.size() == pending.size()) return;
+
+        std::vector<Slot> unique;
+        unique.reserve(last.size());
+        for (size_t i = 0; i < pending.size(); ++i) {
+            if (*last.find(pending_key(pending[i])) == i) {
+                unique.push_back(std::move(pending[i]));
+            }
+        }
+        pending = std::move(unique);
+    }
+
+    bool try_build(uint64_t candidate_seed) {
+        size_t n = pending.size();
+        seed = candidate_seed;
+        slots.clear();
+        remap.clear();
+        pilots.assign(n / keys_per_bucket + 1, 0);
+        positions_count = n + n / 100 + 1;
+        if (n == 0) return true;
+
+        std::vector<uint64_t> hashes(n);
+        for (size_t i = 0; i < n; ++i) {
+            hashes[i] = hash_string(pending_key(pending[i]), seed);
+        }
+
+        // Group key indices by bucket with a counting sort into one flat
+        // array (no per-bucket allocations, so build time scales linearly to
+        // millions of keys). bucket_start[b]..bucket_start[b+1] are bucket b.
+        size_t nb = pilots.size();
+        std::vector<uint32_t> bucket_start(nb + 1, 0);
+        for (size_t i = 0; i < n; ++i) {
+            ++bucket_start[bucket_for(hashes[i], nb) + 1];
+        }
+        size_t largest = 0;
+        for (size_t b = 0; b < nb; ++b) {
+            largest = std::max<size_t>(largest, bucket_start[b + 1]);
+            bucket_start[b + 1] += bucket_start[b];
+        }
+        std::vector<uint32_t> members(n);
+        std::vector<uint32_t> fill(bucket_start.begin(), bucket_start.end() - 1);
+        for (size_t i = 0; i < n; ++i) {
+            members[fill[bucket_for(hashes[i], nb)]++] = static_cast<uint32_t>(i);
+        }
+
+        // Place the largest buckets first while the table is still mostly
+        // empty. Bucket sizes are small, so this is another counting sort.
+        std::vector<uint32_t> by_size_start(largest + 2, 0);
+        for (size_t b = 0; b < nb; ++b) {
+            ++by_size_start[largest - (bucket_start[b + 1] - bucket_start[b]) + 1];
+        }
+        for (size_t k = 0; k <= largest; ++k) {
+            by_size_start[k + 1] += by_size_start[k];
+        }
+        std::vector<uint32_t> order(nb);
+        for (size_t b = 0; b < nb; ++b) {
+            order[by_size_start[largest - (bucket_start[b + 1] - bucket_start[b])]++] = static_cast<uint32_t>(b);
+        }
+
+        std::vector<bool> taken(positions_count, false);
+        std::vector<uint32_t> placed(positions_count, 0);
+        std::vector<size_t> positions;
+
+        for (uint32_t b : order) {
+            const uint32_t* bucket = members.data() + bucket_start[b];
+            size_t bucket_size = bucket_start[b + 1] - bucket_start[b];
+            if (bucket_size == 0) break;
+
+            bool found = false;
+            for (uint32_t pilot = 0; pilot < max_pilot && !found; ++pilot) {
+                positions.clear();
+                found = true;
+                for (size_t k = 0; k < bucket_size; ++k) {
+                    size_t pos = position_for(hashes[bucket[k]], pilot, positions_count);
+                    if (taken[pos] || std::find(positions.begin(), positions.end(), pos) != positions.end()) {
+                        found = false;
+                        break;
+                    }
+                    positions.push_back(pos);
+                }
+                if (found) {
+                    pilots[b] = pilot;
+                    for (size_t k = 0; k < bucket_size; ++k) {
+                        taken[positions[k]] = true;
+                        placed[positions[k]] = bucket[k];
+                    }
+                }
+            }
+            if (!found) return false;
+        }
+
+        // Keys placed at or past n move into the free positions below n.
+        // There are exactly as many of one as the other.
+        remap.assign(positions_count - n, 0);
+        size_t hole = 0;
+        for (size_t pos = n; pos < positions_count; ++pos) {
+            if (!taken[pos]) continue;
+            while (taken[hole]) ++hole;
+            taken[hole] = true;
+            placed[hole] = placed[pos];
+            remap[pos - n] = static_cast<uint32_t>(hole);
+        }
+
+        slots.reserve(n);
+        for (size_t pos = 0; pos < n; ++pos) {
+            slots.push_back(std::move(pending[placed[pos]]));
+        }
+        pending.clear();
+        pending.shrink_to_fit();
+        return true;
+    }
+
+    View table;
+    uint64_t seed = 0;
+    size_t positions_count = 0;
+    std::vector<uint32_t> pilots;
+    std::vector<uint32_t> remap;
+    std::vector<Slot> slots;
+    std::vector<Slot> pending;
+    std::vector<char> arena;
+};
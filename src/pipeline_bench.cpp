@@ -0,0 +1,609 @@
+#include <arpa/inet.h>
+#include <libpq-fe.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "async_logger.h"
+#include "backpressure.h"
+#include "command_line.h"
+#include "copy_sink.h"
+#include "issuer_table.h"
+#include "latency_histogram.h"
+#include "metrics.h"
+#include "mpmc_queue.h"
+#include "rcu_snapshot.h"
+#include "security_master.h"
+#include "trace_generator.h"
+#include "trade.h"
+#include "trade_dedupe.h"
+#include "trade_ingest.h"
+
+// -----------------------------
+// End-to-end pipeline benchmark
+// -----------------------------
+// Runs the ingest path main.cpp runs, from socket to sink, against
+// generated feeds and reports what it sustained. Producers and stages are
+// main's own TradeIngest (trade_ingest.h), backpressure included, so a
+// change to ingest shows up here:
+//
+//   feed threads --TCP--> producers: split lines, parse, enrich
+//                         (or parse and enrich stages, with --staged)
+//                   --> trade queue --> consumers --> sink
+//
+// Each feed is a TraceGenerator sending over loopback TCP, at a fixed rate
+// or as fast as the producer reads, with the generator's jitter and burst
+// options. Sinks are "null" (consumers only take trades off the queue),
+// "file" (COPY rows appended to a file) or "postgres" (COPY batches into
+// the trades table, as the copy sink does).
+//
+// After a warmup, one measurement window is taken and written as JSON:
+// messages and trades per second, CPU seconds per message for the pipeline's
+// threads (the feed threads are reported separately), and latency
+// percentiles for each stage, so results can be compared between builds.
+//
+//   pipeline_bench --feeds 3 --consumers 2 --sink null --duration 10 --label $(git rev-parse --short HEAD)
+//   pipeline_bench --rate 20000 --burst 100000 --burst-interval 5 --sink postgres --conninfo "dbname=finance"
+namespace {
+
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+enum class BenchSink {
+    Null,
+    File,
+    Postgres
+};
+
+const char* bench_sink_name(BenchSink sink) {
+    switch (sink) {
+        case BenchSink::Null: return "null";
+        case BenchSink::File: return "file";
+        case BenchSink::Postgres: return "postgres";
+    }
+    return "unknown";
+}
+
+bool parse_bench_sink(std::string_view name, BenchSink& sink) {
+    for (BenchSink s : {BenchSink::Null, BenchSink::File, BenchSink::Postgres}) {
+        if (name == bench_sink_name(s)) {
+            sink = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+// -------
+// Options
+// -------
+constexpr size_t MAX_QUEUE_CAPACITY = 65536;
+
+struct BenchArgs {
+    size_t feeds = 3;
+    double rate = 0;              // Per feed per second; 0 for as fast as it's read
+    double rate_jitter = 0;
+    size_t burst = 0;
+    long burst_interval = 10;
+    bool pairs = false;
+    double pair_prob = 0.3;
+    uint64_t seed = 1;
+    bool staged = false;
+    size_t parse_threads = 2;
+    size_t enrich_threads = 1;
+    size_t consumers = 2;
+    size_t queue_capacity = MAX_QUEUE_CAPACITY;
+    size_t high_watermark = 90;   // Percent of queue capacity, as in main
+    size_t low_watermark = 50;
+    OverloadPolicy overload = OverloadPolicy::Pause;
+    BenchSink sink = BenchSink::Null;
+    size_t batch_size = 1000;     // Rows per write for the file and postgres sinks
+    std::string out_file = "pipeline_bench.copy";
+    std::string conninfo = "dbname=finance user=douglas host=/var/run/postgresql";
+    double warmup = 2;            // Seconds
+    double duration = 10;
+    std::string label;
+    std::string json_file;        // Results go here; stdout if empty
+};
+
+const char* usage() {
+    return "Options:\n"
+           "  --feeds N                generated feeds, one producer each (default 3)\n"
+           "  --rate N                 messages per second per feed; 0 for as fast as they're read\n"
+           "  --rate-jitter F          vary the rate by up to this fraction (0.0-1.0)\n"
+           "  --burst N                extra messages per feed in each burst\n"
+           "  --burst-interval S       seconds between bursts (default 10)\n"
+           "  --pairs                  emit both legs of some trades\n"
+           "  --pair-prob F            probability of a paired trade (default 0.3)\n"
+           "  --seed N                 random seed for the feeds (default 1)\n"
+           "  --staged                 parse and enrich on their own thread pools\n"
+           "  --parse-threads N        parse stage threads (with --staged)\n"
+           "  --enrich-threads N       enrich stage threads (with --staged)\n"
+           "  --consumers N            consumer threads (default 2)\n"
+           "  --queue-capacity N       trades queued before producers wait (at most 65536)\n"
+           "  --high-watermark PCT     queue fill at which producers stop reading feeds (default 90)\n"
+           "  --low-watermark PCT      queue fill at which they start again (default 50)\n"
+           "  --overload NAME          pause (stop reading) or shed (drop lines) when overloaded\n"
+           "  --sink NAME              null, file or postgres (default null)\n"
+           "  --batch-size N           rows per file write or COPY (default 1000)\n"
+           "  --out-file FILE          file for the file sink (default pipeline_bench.copy)\n"
+           "  --conninfo STRING        libpq connection string for the postgres sink\n"
+           "  --warmup S               seconds to run before measuring (default 2)\n"
+           "  --duration S             seconds to measure (default 10)\n"
+           "  --label TEXT             recorded in the results, e.g. a commit id\n"
+           "  --json FILE              write results to FILE instead of stdout\n"
+           "  --help                   show this message\n";
+}
+
+bool parse_args(int argc, char** argv, BenchArgs& args, bool& help, std::string& error) {
+    auto on_switch = [&](std::string_view flag) {
+        if (flag == "--pairs") args.pairs = true;
+        else if (flag == "--staged") args.staged = true;
+        else return false;
+        return true;
+    };
+    auto on_value = [&](std::string_view flag, std::string_view value, bool& ok) {
+        if (flag == "--feeds") ok = parse_count(value, args.feeds);
+        else if (flag == "--rate") ok = parse_number(value, args.rate);
+        else if (flag == "--rate-jitter") ok = parse_number(value, args.rate_jitter) && args.rate_jitter <= 1.0;
+        else if (flag == "--burst") ok = parse_count(value, args.burst);
+        else if (flag == "--burst-interval") ok = parse_count(value, args.burst_interval) && args.burst_interval > 0;
+        else if (flag == "--pair-prob") ok = parse_number(value, args.pair_prob) && args.pair_prob <= 1.0;
+        else if (flag == "--seed") ok = parse_count(value, args.seed);
+        else if (flag == "--parse-threads") ok = parse_count(value, args.parse_threads);
+        else if (flag == "--enrich-threads") ok = parse_count(value, args.enrich_threads);
+        else if (flag == "--consumers") ok = parse_count(value, args.consumers);
+        else if (flag == "--queue-capacity") ok = parse_count(value, args.queue_capacity);
+        else if (flag == "--high-watermark") ok = parse_count(value, args.high_watermark);
+        else if (flag == "--low-watermark") ok = parse_count(value, args.low_watermark);
+        else if (flag == "--overload") ok = parse_overload_policy(value, args.overload);
+        else if (flag == "--sink") ok = parse_bench_sink(value, args.sink);
+        else if (flag == "--batch-size") ok = parse_count(value, args.batch_size);
+        else if (flag == "--out-file") {
+            ok = !value.empty();
+            args.out_file.assign(value);
+        }
+        else if (flag == "--conninfo") {
+            ok = !value.empty();
+            args.conninfo.assign(value);
+        }
+        else if (flag == "--warmup") ok = parse_number(value, args.warmup);
+        else if (flag == "--duration") ok = parse_number(value, args.duration) && args.duration > 0;
+        else if (flag == "--label") args.label.assign(value);
+        else if (flag == "--json") {
+            ok = !value.empty();
+            args.json_file.assign(value);
+        }
+        else return false;
+        return true;
+    };
+    if (!parse_flags(argc, argv, help, error, on_switch, on_value)) return false;
+    if (args.feeds == 0 || args.consumers == 0) error = "need at least one feed and one consumer";
+    else if (args.staged && (args.parse_threads == 0 || args.enrich_threads == 0)) error = "stages need threads";
+    else if (args.queue_capacity == 0 || args.queue_capacity > MAX_QUEUE_CAPACITY) {
+        error = "queue capacity must be 1 to " + std::to_string(MAX_QUEUE_CAPACITY);
+    }
+    else if (args.low_watermark >= args.high_watermark || args.high_watermark > 100) {
+        error = "need low watermark < high watermark <= 100";
+    }
+    else if (args.batch_size == 0) error = "batch size must be positive";
+    else if (args.feeds + (args.staged ? args.enrich_threads : 0) > RcuSnapshot<IssuerTable>::max_readers) {
+        error = "at most " + std::to_string(RcuSnapshot<IssuerTable>::max_readers) + " feeds plus enrich threads";
+    }
+    return error.empty();
+}
+
+// --------------
+// Pipeline state
+// --------------
+// The same structures main.cpp ingests with, set up without a database:
+// the issuer table holds the generator's issuers and the security master
+// learns terms from the feed. Ingest warnings go to stderr.
+BenchArgs args;
+AsyncLogger logger(std::cerr, LogLevel::Warn);
+
+using TradeQueue = MPMCQueue<Trade, MAX_QUEUE_CAPACITY>;
+std::unique_ptr<TradeQueue> tradeQueue;
+
+SecurityMaster securityMaster(1 << 20);
+TradeDedupe tradeDedupe(std::chrono::minutes(10));
+RcuSnapshot<IssuerTable> issuerSnapshot;
+
+std::unique_ptr<ThreadCounters> feedCounters;
+ThreadCounters ingestCounters(INGEST_COUNTERS);
+std::unique_ptr<Backpressure> backpressure;
+
+using Ingest = TradeIngest<TradeQueue>;
+std::unique_ptr<Ingest> ingest;
+
+enum SinkCounter : size_t {
+    WRITTEN,         // Trades the sink took
+    WRITE_FAILED,
+    SINK_COUNTERS
+};
+
+ThreadCounters sinkCounters(SINK_COUNTERS);
+
+enum LatencyStage : size_t {
+    LATENCY_PARSE,
+    LATENCY_ENRICH,
+    LATENCY_QUEUE,
+    LATENCY_PERSIST,
+    LATENCY_TOTAL
+};
+
+std::unique_ptr<LatencyRecorder> latency;
+
+void recordLatency(size_t consumer, const TradeStamps& stamps, uint64_t written) {
+    latency->at(consumer, LATENCY_PARSE).record(TscClock::elapsed_ns(stamps.received, stamps.parsed));
+    latency->at(consumer, LATENCY_ENRICH).record(TscClock::elapsed_ns(stamps.parsed, stamps.enqueued));
+    latency->at(consumer, LATENCY_QUEUE).record(TscClock::elapsed_ns(stamps.enqueued, stamps.dequeued));
+    latency->at(consumer, LATENCY_PERSIST).record(TscClock::elapsed_ns(stamps.dequeued, written));
+    latency->at(consumer, LATENCY_TOTAL).record(TscClock::elapsed_ns(stamps.received, written));
+}
+
+std::unique_ptr<IssuerTable> makeIssuerTable() {
+    constexpr const char* ratings[] = {"AAA", "AA+", "AA", "A+", "A", "BBB"};
+    constexpr const char* industries[] = {"Technology", "Financials", "Health Care", "Industrials", "Consumer"};
+    auto table = std::make_unique<IssuerTable>(IssuerIndexMode::PerfectHash, trace_generator_detail::issuer_count);
+    for (size_t i = 0; i < trace_generator_detail::issuer_count; ++i) {
+        table->add(trace_generator_detail::issuers[i], ratings[i % std::size(ratings)],
+                   industries[i % std::size(industries)]);
+    }
+    if (!table->finalize()) return nullptr;
+    return table;
+}
+
+// -----
+// Feeds
+// -----
+std::atomic<bool> generating{true};
+
+void feedSender(int sock, size_t feed) {
+    std::string name = "Gen " + std::to_string(feed);
+    pthread_setname_np(pthread_self(), name.c_str());
+    TraceGeneratorOptions options;
+    options.pair_prob = args.pairs ? args.pair_prob : 0.0;
+    options.seed = args.seed + feed;
+    TraceGenerator generator(options);
+    RatePacer pacer(args.rate, args.rate_jitter, args.burst, std::chrono::seconds(args.burst_interval),
+                    args.seed + feed);
+    uint64_t sent = 0;
+    write_trade_lines(generator, pacer, sent, 0, [] { return generating.load(std::memory_order_relaxed); },
+                      [&](const std::string& lines, size_t) { return send_all(sock, lines); });
+    ::close(sock);
+}
+
+// Ingests the feed as main.cpp's tcpReader() does
+void feedReader(int sock, size_t feed) {
+    std::string name = "Producer " + std::to_string(feed + 1);
+    pthread_setname_np(pthread_self(), name.c_str());
+    ingest->read_feed(sock, static_cast<int>(feed + 1));
+    ::close(sock);
+}
+
+// A connected loopback pair: the feed's end and the producer's
+bool connectFeed(int& feedSock, int& readerSock, std::string& error) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    readerSock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool ok = listener >= 0 && readerSock >= 0 && bind(listener, reinterpret_cast<sockaddr*>(&addr), len) == 0 &&
+              listen(listener, 1) == 0 && getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len) == 0 &&
+              connect(readerSock, reinterpret_cast<sockaddr*>(&addr), len) == 0 &&
+              (feedSock = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC)) >= 0;
+    if (!ok) error = std::string("loopback feed: ") + std::strerror(errno);
+    if (listener >= 0) ::close(listener);
+    return ok;
+}
+
+// ---------
+// Consumers
+// ---------
+std::atomic<bool> ingestDone{false};
+FILE* sinkFile = nullptr;
+
+// Takes trades off the queue and hands them to the sink in batches, writing
+// a partial batch whenever the queue runs dry so quiet feeds aren't held.
+void consumer(size_t slot, PGconn* conn) {
+    std::string name = "Consumer " + std::to_string(slot + 1);
+    pthread_setname_np(pthread_self(), name.c_str());
+
+    std::unique_ptr<CopySink> copy;
+    if (conn) copy = std::make_unique<CopySink>(conn, args.batch_size + 1, std::chrono::microseconds::max(),
+                                                CopyConflicts::Skip);
+    std::string rows;
+    std::vector<TradeStamps> batchStamps;
+    batchStamps.reserve(args.batch_size);
+
+    // A failed write loses the whole batch, except that COPY only loses
+    // the trades the server rejected on their own
+    std::vector<size_t> rejected;
+    auto flush = [&]() {
+        bool ok = true;
+        rejected.clear();
+        if (copy) {
+            ok = copy->flush();
+            if (copy->pending() == 0) rejected = copy->rejected();
+            else copy->discard();
+        }
+        else if (sinkFile) {
+            ok = std::fwrite(rows.data(), 1, rows.size(), sinkFile) == rows.size();
+        }
+        if (!ok && rejected.empty()) {
+            for (size_t i = 0; i < batchStamps.size(); ++i) rejected.push_back(i);
+        }
+        uint64_t written = TscClock::now();
+        auto next = rejected.begin();
+        for (size_t i = 0; i < batchStamps.size(); ++i) {
+            if (next != rejected.end() && *next == i) ++next;
+            else recordLatency(slot, batchStamps[i], written);
+        }
+        sinkCounters.add(WRITTEN, batchStamps.size() - rejected.size());
+        sinkCounters.add(WRITE_FAILED, rejected.size());
+        batchStamps.clear();
+        rows.clear();
+    };
+
+    Trade trade;
+    while (true) {
+        if (!tradeQueue->dequeue(trade)) {
+            if (!batchStamps.empty()) flush();
+            else if (ingestDone.load(std::memory_order_acquire) && tradeQueue->size_approx() == 0) break;
+            else std::this_thread::sleep_for(std::chrono::microseconds(50));
+            continue;
+        }
+        trade.stamps.dequeued = TscClock::now();
+        if (args.sink == BenchSink::Null) {
+            recordLatency(slot, trade.stamps, TscClock::now());
+            sinkCounters.add(WRITTEN);
+            continue;
+        }
+        if (copy) copy->add(trade);
+        else append_copy_row(rows, trade);
+        batchStamps.push_back(trade.stamps);
+        if (batchStamps.size() >= args.batch_size) flush();
+    }
+}
+
+// -------
+// Results
+// -------
+struct Sample {
+    Clock::time_point at;
+    uint64_t feed[FEED_COUNTERS] = {};   // Summed over feeds
+    uint64_t queue_full = 0;
+    uint64_t sink[SINK_COUNTERS] = {};
+    BackpressureStats pressure;
+    double pipeline_cpu = 0;   // Seconds, every thread but the feeds'
+    double feed_cpu = 0;
+    std::vector<LatencySnapshot> latency;
+};
+
+Sample takeSample() {
+    Sample s;
+    s.at = Clock::now();
+    for (size_t feed = 0; feed < args.feeds; ++feed) {
+        for (size_t i = 0; i < FEED_COUNTERS; ++i) s.feed[i] += feedCounters->total(feed * FEED_COUNTERS + i);
+    }
+    s.queue_full = ingestCounters.total(QUEUE_FULL);
+    for (size_t i = 0; i < SINK_COUNTERS; ++i) s.sink[i] = sinkCounters.total(i);
+    s.pressure = backpressure->stats();
+    for (const ThreadCpu& t : thread_cpu_times()) {
+        (t.name.compare(0, 4, "Gen ") == 0 ? s.feed_cpu : s.pipeline_cpu) += t.seconds;
+    }
+    for (size_t stage = 0; stage < latency->stages().size(); ++stage) s.latency.push_back(latency->snapshot(stage));
+    return s;
+}
+
+json latencyJson(const LatencySnapshot& s) {
+    return {{"count", s.count},
+            {"mean", s.mean_ns()},
+            {"p50", s.percentile(0.5)},
+            {"p90", s.percentile(0.9)},
+            {"p99", s.percentile(0.99)},
+            {"p999", s.percentile(0.999)},
+            {"max", s.max_ns}};
+}
+
+json resultsJson(const Sample& start, const Sample& end) {
+    double seconds = std::chrono::duration<double>(end.at - start.at).count();
+    auto feedDelta = [&](FeedCounter c) { return end.feed[c] - start.feed[c]; };
+    auto sinkDelta = [&](SinkCounter c) { return end.sink[c] - start.sink[c]; };
+    uint64_t messages = feedDelta(FEED_MESSAGES);
+    BackpressureStats pressure = end.pressure.since(start.pressure);
+    double cpu = end.pipeline_cpu - start.pipeline_cpu;
+
+    json latencies = json::object();
+    for (size_t stage = 0; stage < end.latency.size(); ++stage) {
+        latencies[latency->stages()[stage]] = latencyJson(end.latency[stage].since(start.latency[stage]));
+    }
+
+    char host[256] = {};
+    gethostname(host, sizeof(host) - 1);
+    return {
+        {"benchmark", "pipeline"},
+        {"label", args.label},
+        {"host", host},
+        {"hardware_threads", std::thread::hardware_concurrency()},
+        {"tsc_clock", TscClock::uses_tsc()},
+        {"config",
+         {{"feeds", args.feeds},
+          {"rate", args.rate},
+          {"rate_jitter", args.rate_jitter},
+          {"burst", args.burst},
+          {"burst_interval", args.burst_interval},
+          {"pair_prob", args.pairs ? args.pair_prob : 0.0},
+          {"staged", args.staged},
+          {"parse_threads", args.staged ? args.parse_threads : 0},
+          {"enrich_threads", args.staged ? args.enrich_threads : 0},
+          {"consumers", args.consumers},
+          {"queue_capacity", args.queue_capacity},
+          {"high_watermark", args.high_watermark},
+          {"low_watermark", args.low_watermark},
+          {"overload", overload_policy_name(args.overload)},
+          {"sink", bench_sink_name(args.sink)},
+          {"batch_size", args.batch_size},
+          {"warmup_seconds", args.warmup},
+          {"duration_seconds", args.duration}}},
+        {"results",
+         {{"seconds", seconds},
+          {"messages", messages},
+          {"trades_written", sinkDelta(WRITTEN)},
+          {"msgs_per_sec", static_cast<double>(messages) / seconds},
+          {"trades_per_sec", static_cast<double>(sinkDelta(WRITTEN)) / seconds},
+          {"bytes", feedDelta(FEED_BYTES)},
+          {"parse_errors", feedDelta(FEED_ERRORS)},
+          {"duplicates", feedDelta(FEED_DUPLICATES)},
+          {"enrich_misses", feedDelta(FEED_ENRICH_MISSES)},
+          {"queue_full_waits", end.queue_full - start.queue_full},
+          {"backpressure_pauses", pressure.pauses},
+          {"backpressure_paused_seconds", static_cast<double>(pressure.paused_ns) / 1e9},
+          {"shed", pressure.shed},
+          {"write_failures", sinkDelta(WRITE_FAILED)},
+          {"cpu_seconds", cpu},
+          {"cpu_ns_per_msg", messages ? cpu * 1e9 / static_cast<double>(messages) : 0.0},
+          {"feed_cpu_seconds", end.feed_cpu - start.feed_cpu},
+          {"latency_ns", latencies}}},
+    };
+}
+
+// One line per result for whoever is watching, on stderr so stdout stays JSON
+void printSummary(const json& r) {
+    const json& res = r["results"];
+    std::cerr << "[Bench] " << res["messages"].get<uint64_t>() << " messages in " << res["seconds"].get<double>()
+              << " s: " << static_cast<uint64_t>(res["msgs_per_sec"].get<double>()) << " msgs/s, "
+              << static_cast<uint64_t>(res["cpu_ns_per_msg"].get<double>()) << " ns CPU per msg\n";
+    for (const std::string& stage : latency->stages()) {
+        const json& s = res["latency_ns"][stage];
+        std::cerr << "[Bench] " << stage << ": p50 ";
+        print_latency(std::cerr, s["p50"].get<uint64_t>()) << ", p99 ";
+        print_latency(std::cerr, s["p99"].get<uint64_t>()) << ", p99.9 ";
+        print_latency(std::cerr, s["p999"].get<uint64_t>()) << ", max ";
+        print_latency(std::cerr, s["max"].get<uint64_t>()) << "\n";
+    }
+}
+
+void sleepSeconds(double s) {
+    std::this_thread::sleep_for(std::chrono::duration<double>(s));
+}
+
+}   // namespace
+
+int main(int argc, char** argv) {
+    bool help = false;
+    std::string error;
+    if (!parse_args(argc, argv, args, help, error)) {
+        std::cerr << argv[0] << ": " << error << "\n\n" << usage();
+        return 2;
+    }
+    if (help) {
+        std::cout << "Usage: " << argv[0] << " [options]\n\n" << usage();
+        return 0;
+    }
+    TscClock::calibrate();
+
+    std::unique_ptr<IssuerTable> issuers = makeIssuerTable();
+    if (!issuers) {
+        std::cerr << "Couldn't build the issuer table\n";
+        return 1;
+    }
+    issuerSnapshot.publish(std::move(issuers));
+    tradeQueue = std::make_unique<TradeQueue>();
+    latency = std::make_unique<LatencyRecorder>(std::vector<std::string>{"parse", "enrich", "queue", "persist", "total"},
+                                                args.consumers);
+
+    // Sinks: a shared file, or a connection per consumer
+    std::vector<PGconn*> conns(args.consumers, nullptr);
+    if (args.sink == BenchSink::File) {
+        sinkFile = std::fopen(args.out_file.c_str(), "w");
+        if (!sinkFile) {
+            std::cerr << "Can't open " << args.out_file << ": " << std::strerror(errno) << "\n";
+            return 1;
+        }
+    }
+    else if (args.sink == BenchSink::Postgres) {
+        for (PGconn*& conn : conns) {
+            conn = PQconnectdb(args.conninfo.c_str());
+            if (PQstatus(conn) != CONNECTION_OK) {
+                std::cerr << "Connection to database failed: " << PQerrorMessage(conn) << "\n";
+                for (PGconn* c : conns) PQfinish(c);
+                return 1;
+            }
+        }
+    }
+
+    feedCounters = std::make_unique<ThreadCounters>(args.feeds * FEED_COUNTERS);
+    backpressure = std::make_unique<Backpressure>(args.high_watermark / 100.0, args.low_watermark / 100.0,
+                                                  args.overload, args.feeds);
+    ingest = std::make_unique<Ingest>(*tradeQueue, args.queue_capacity, securityMaster, issuerSnapshot, tradeDedupe,
+                                      *backpressure, *feedCounters, ingestCounters, logger);
+    if (args.staged) ingest->start_stages(args.parse_threads, args.enrich_threads);
+
+    std::vector<int> feedSocks(args.feeds), readerSocks(args.feeds);
+    for (size_t i = 0; i < args.feeds; ++i) {
+        if (!connectFeed(feedSocks[i], readerSocks[i], error)) {
+            std::cerr << error << "\n";
+            return 1;
+        }
+    }
+
+    std::cerr << "[Bench] " << args.feeds << " feeds at "
+              << (args.rate > 0 ? std::to_string(static_cast<uint64_t>(args.rate)) + " msgs/s each" : "full speed")
+              << ", " << (args.staged ? "staged" : "inline") << " ingest, " << args.consumers << " consumers, "
+              << bench_sink_name(args.sink) << " sink; " << args.warmup << " s warmup, " << args.duration
+              << " s measured\n";
+
+    std::vector<std::thread> consumers, readers, senders;
+    for (size_t i = 0; i < args.consumers; ++i) consumers.emplace_back(consumer, i, conns[i]);
+    for (size_t i = 0; i < args.feeds; ++i) readers.emplace_back(feedReader, readerSocks[i], i);
+    for (size_t i = 0; i < args.feeds; ++i) senders.emplace_back(feedSender, feedSocks[i], i);
+
+    sleepSeconds(args.warmup);
+    Sample start = takeSample();
+    sleepSeconds(args.duration);
+    Sample end = takeSample();
+
+    // Stop the feeds and let everything already sent drain through
+    generating = false;
+    for (auto& t : senders) t.join();
+    for (auto& t : readers) t.join();
+    ingest->stop_stages();
+    ingestDone = true;
+    for (auto& t : consumers) t.join();
+    for (PGconn* conn : conns) PQfinish(conn);
+    if (sinkFile) std::fclose(sinkFile);
+
+    json results = resultsJson(start, end);
+    printSummary(results);
+    if (args.json_file.empty()) {
+        std::cout << results.dump(2) << std::endl;
+    }
+    else {
+        std::ofstream out(args.json_file);
+        out << results.dump(2) << "\n";
+        if (!out) {
+            std::cerr << "Can't write " << args.json_file << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,609 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <initializer_list>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "backpressure.h"
+
+// -----------
+// Trade sink
+// -----------
+// - Insert: one prepared INSERT round-trip per trade, for the lowest
+//   per-trade latency.
+// - Pipeline: the same per-trade inserts in libpq pipeline mode, with up to
+//   pipeline_max_in_flight of them outstanding per connection.
+// - Copy: batches trades into COPY trades FROM STDIN. A BatchController
+//   sizes each batch between batch_min and batch_max from queue depth and
+//   DB latency, and flushes early so no trade waits longer than latency_slo.
+// - Async: instead of consumer threads, one writer thread runs pipelined
+//   inserts over async_writer_connections non-blocking connections and
+//   reports completions to a second thread.
+// - Journal: consumers only append to a durable local journal in
+//   journal_dir, and a replayer thread copies it into Postgres whenever the
+//   database is reachable. Nothing is lost while Postgres is slow or down.
+enum class TradeSink {
+    Insert,
+    Pipeline,
+    Copy,
+    Async,
+    Journal
+};
+
+inline const char* trade_sink_name(TradeSink sink) {
+    switch (sink) {
+        case TradeSink::Insert: return "insert";
+        case TradeSink::Pipeline: return "pipeline";
+        case TradeSink::Copy: return "copy";
+        case TradeSink::Async: return "async";
+        case TradeSink::Journal: return "journal";
+    }
+    return "copy";
+}
+
+inline bool parse_trade_sink(std::string_view name, TradeSink& sink) {
+    for (TradeSink s : {TradeSink::Insert, TradeSink::Pipeline, TradeSink::Copy, TradeSink::Async,
+                        TradeSink::Journal}) {
+        if (name == trade_sink_name(s)) {
+            sink = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+struct FeedConfig {
+    std::string host;   // IPv4 address
+    int port = 0;
+};
+
+// ------------------------
+// Pipeline configuration
+// ------------------------
+// Everything that depends on the host and its load: where the feeds are,
+// how many threads do what, how big the queue and batches get, which cores
+// threads run on and where trades end up. The defaults are the settings
+// the pipeline always had, so running without a config behaves as before.
+//
+// Settings come from a JSON file (--config) and then command-line flags,
+// which override the file. See config_usage() for the flags and
+// config_to_json() for the file layout; any subset of keys may be given.
+struct PipelineConfig {
+    std::vector<FeedConfig> feeds = {{"127.0.0.1", 5555}, {"127.0.0.1", 5556}, {"127.0.0.1", 5557}};
+    std::string conninfo = "dbname=finance user=douglas host=/var/run/postgresql";
+    TradeSink sink = TradeSink::Copy;
+
+    size_t consumers = 2;
+
+    // Staged ingest: producers only split the feed into lines, and separate
+    // thread pools parse and enrich them. Off, producers do all three.
+    bool staged = false;
+    size_t parse_threads = 2;
+    size_t enrich_threads = 1;
+    size_t db_connections = 2;             // Pool shared by the consumers
+    size_t async_writer_connections = 4;
+
+    // Trades held in the queue before producers wait. At most the queue's
+    // compiled capacity.
+    size_t queue_capacity = 16384;
+
+    // NUMA node to place the queue's memory on. -1 picks the node of the
+    // first pinned consumer (or producer), or leaves placement to the OS
+    // when nothing is pinned.
+    int queue_node = -1;
+
+    // Backpressure: once the fullest ingest queue reaches high_watermark
+    // percent of its capacity, producers stop reading their feeds (or, with
+    // OverloadPolicy::Shed, drop what they read) until it drains to
+    // low_watermark percent.
+    size_t high_watermark = 90;
+    size_t low_watermark = 50;
+    OverloadPolicy overload = OverloadPolicy::Pause;
+
+    size_t batch_min = 16;
+    size_t batch_max = 5000;
+    std::chrono::microseconds latency_slo{20000};
+    size_t pipeline_max_in_flight = 512;
+    std::string journal_dir = "trade_journal";
+
+    // Prometheus metrics served over HTTP at /metrics. Port 0 turns the
+    // listener off.
+    size_t metrics_port = 0;
+    std::string metrics_address = "127.0.0.1";
+
+    // Cores to pin threads to, by thread number. Empty or short lists leave
+    // the remaining threads unpinned. Background threads (logger, issuer
+    // reloader, journal replayer, writer reporter) take background_cpus in
+    // turn, sharing them if there are more threads than CPUs.
+    std::vector<int> producer_cpus;
+    std::vector<int> consumer_cpus;
+    std::vector<int> background_cpus;
+    std::vector<int> parse_cpus;
+    std::vector<int> enrich_cpus;
+};
+
+namespace config_detail {
+
+inline bool parse_size(std::string_view text, size_t& out) {
+    if (text.empty() || text.size() > 18) return false;
+    size_t v = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') return false;
+        v = v * 10 + static_cast<size_t>(c - '0');
+    }
+    out = v;
+    return true;
+}
+
+// "host:port", or just "port" for localhost
+inline bool parse_feed(std::string_view text, FeedConfig& feed) {
+    size_t colon = text.rfind(':');
+    std::string_view host = colon == std::string_view::npos ? "127.0.0.1" : text.substr(0, colon);
+    std::string_view port = colon == std::string_view::npos ? text : text.substr(colon + 1);
+    size_t p;
+    if (host.empty() || !parse_size(port, p) || p == 0 || p > 65535) return false;
+    feed.host.assign(host);
+    feed.port = static_cast<int>(p);
+    return true;
+}
+
+// Whether `j` is an integer from 0 to `max`
+inline bool is_count(const nlohmann::json& j, int64_t max = INT64_MAX) {
+    return j.is_number_integer() && j.get<int64_t>() >= 0 && j.get<int64_t>() <= max;
+}
+
+// A node number, or "auto" (-1)
+inline bool parse_node(std::string_view text, int& node) {
+    size_t n;
+    if (text == "auto") {
+        node = -1;
+        return true;
+    }
+    if (!parse_size(text, n) || n > 1023) return false;
+    node = static_cast<int>(n);
+    return true;
+}
+
+// "0,2,4"
+inline bool parse_cpu_list(std::string_view text, std::vector<int>& cpus) {
+    cpus.clear();
+    while (!text.empty()) {
+        size_t comma = text.find(',');
+        size_t cpu;
+        if (!parse_size(text.substr(0, comma), cpu) || cpu > 4095) return false;
+        cpus.push_back(static_cast<int>(cpu));
+        text = comma == std::string_view::npos ? std::string_view() : text.substr(comma + 1);
+    }
+    return true;
+}
+
+// Reads config[key] into `out` if present, where T is size_t or std::string.
+template<typename T>
+bool read_value(const nlohmann::json& section, const char* key, T& out, const std::string& path, std::string& error) {
+    auto it = section.find(key);
+    if (it == section.end()) return true;
+    if constexpr (std::is_same_v<T, std::string>) {
+        if (!it->is_string()) {
+            error = path + key + " must be a string";
+            return false;
+        }
+        out = it->get<std::string>();
+    }
+    else {
+        if (!is_count(*it)) {
+            error = path + key + " must be a non-negative integer";
+            return false;
+        }
+        out = it->get<T>();
+    }
+    return true;
+}
+
+inline bool read_cpus(const nlohmann::json& section, const char* key, std::vector<int>& out, std::string& error) {
+    auto it = section.find(key);
+    if (it == section.end()) return true;
+    std::vector<int> cpus;
+    if (it->is_array()) {
+        for (const auto& cpu : *it) {
+            if (!is_count(cpu, 4095)) {
+                error = std::string("cpus.") + key + " must list core numbers";
+                return false;
+            }
+            cpus.push_back(cpu.get<int>());
+        }
+    }
+    else if (!it->is_string() || !parse_cpu_list(it->get<std::string>(), cpus)) {
+        error = std::string("cpus.") + key + " must list core numbers";
+        return false;
+    }
+    out = std::move(cpus);
+    return true;
+}
+
+// Rejects keys we don't know, so a typo doesn't silently keep a default
+inline bool known_keys(const nlohmann::json& section, std::initializer_list<const char*> keys,
+                       const std::string& path, std::string& error) {
+    if (!section.is_object()) {
+        error = (path.empty() ? std::string("config") : path.substr(0, path.size() - 1)) + " must be an object";
+        return false;
+    }
+    for (const auto& item : section.items()) {
+        bool found = false;
+        for (const char* key : keys) found = found || item.key() == key;
+        if (!found) {
+            error = "unknown setting " + path + item.key();
+            return false;
+        }
+    }
+    return true;
+}
+
+}   // namespace config_detail
+
+// Applies the settings present in `j` on top of `config`.
+inline bool config_from_json(const nlohmann::json& j, PipelineConfig& config, std::string& error) {
+    using namespace config_detail;
+    if (!known_keys(j, {"feeds", "conninfo", "sink", "threads", "stages", "queue", "batch", "pipeline", "journal",
+                        "metrics", "cpus"},
+                    "", error)) {
+        return false;
+    }
+
+    if (auto it = j.find("feeds"); it != j.end()) {
+        if (!it->is_array() || it->empty()) {
+            error = "feeds must be a non-empty array";
+            return false;
+        }
+        std::vector<FeedConfig> feeds;
+        for (const auto& f : *it) {
+            FeedConfig feed;
+            bool ok = false;
+            if (f.is_string()) {
+                ok = parse_feed(f.get<std::string>(), feed);
+            }
+            else if (f.is_object()) {
+                if (!known_keys(f, {"host", "port"}, "feeds[].", error)) return false;
+                auto port = f.find("port");
+                feed.host = "127.0.0.1";
+                ok = read_value(f, "host", feed.host, "feeds[].", error) && port != f.end() &&
+                     is_count(*port, 65535) && port->get<int>() > 0 && !feed.host.empty();
+                if (!error.empty()) return false;
+                if (ok) feed.port = port->get<int>();
+            }
+            if (!ok) {
+                error = "bad feed " + f.dump();
+                return false;
+            }
+            feeds.push_back(std::move(feed));
+        }
+        config.feeds = std::move(feeds);
+    }
+
+    if (!read_value(j, "conninfo", config.conninfo, "", error)) return false;
+    if (auto it = j.find("sink"); it != j.end()) {
+        if (!it->is_string() || !parse_trade_sink(it->get<std::string>(), config.sink)) {
+            error = "unknown sink " + it->dump();
+            return false;
+        }
+    }
+
+    if (auto it = j.find("threads"); it != j.end()) {
+        if (!known_keys(*it, {"consumers", "db_connections", "async_writer_connections"}, "threads.", error) ||
+            !read_value(*it, "consumers", config.consumers, "threads.", error) ||
+            !read_value(*it, "db_connections", config.db_connections, "threads.", error) ||
+            !read_value(*it, "async_writer_connections", config.async_writer_connections, "threads.", error)) {
+            return false;
+        }
+    }
+
+    if (auto it = j.find("stages"); it != j.end()) {
+        if (!known_keys(*it, {"enabled", "parse_threads", "enrich_threads"}, "stages.", error) ||
+            !read_value(*it, "parse_threads", config.parse_threads, "stages.", error) ||
+            !read_value(*it, "enrich_threads", config.enrich_threads, "stages.", error)) {
+            return false;
+        }
+        if (auto enabled = it->find("enabled"); enabled != it->end()) {
+            if (!enabled->is_boolean()) {
+                error = "stages.enabled must be true or false";
+                return false;
+            }
+            config.staged = enabled->get<bool>();
+        }
+    }
+
+    if (auto it = j.find("queue"); it != j.end()) {
+        if (!known_keys(*it, {"capacity", "node", "high_watermark", "low_watermark", "overload"}, "queue.", error) ||
+            !read_value(*it, "capacity", config.queue_capacity, "queue.", error) ||
+            !read_value(*it, "high_watermark", config.high_watermark, "queue.", error) ||
+            !read_value(*it, "low_watermark", config.low_watermark, "queue.", error)) {
+            return false;
+        }
+        if (auto overload = it->find("overload"); overload != it->end()) {
+            if (!overload->is_string() || !parse_overload_policy(overload->get<std::string>(), config.overload)) {
+                error = "queue.overload must be \"pause\" or \"shed\"";
+                return false;
+            }
+        }
+        if (auto node = it->find("node"); node != it->end()) {
+            bool ok = is_count(*node, 1023) ||
+                      (node->is_string() && parse_node(node->get<std::string>(), config.queue_node));
+            if (!ok) {
+                error = "queue.node must be a node number or \"auto\"";
+                return false;
+            }
+            if (node->is_number()) config.queue_node = node->get<int>();
+        }
+    }
+
+    if (auto it = j.find("batch"); it != j.end()) {
+        size_t slo_us = static_cast<size_t>(config.latency_slo.count());
+        if (!known_keys(*it, {"min", "max", "latency_slo_us"}, "batch.", error) ||
+            !read_value(*it, "min", config.batch_min, "batch.", error) ||
+            !read_value(*it, "max", config.batch_max, "batch.", error) ||
+            !read_value(*it, "latency_slo_us", slo_us, "batch.", error)) {
+            return false;
+        }
+        config.latency_slo = std::chrono::microseconds(slo_us);
+    }
+
+    if (auto it = j.find("pipeline"); it != j.end()) {
+        if (!known_keys(*it, {"max_in_flight"}, "pipeline.", error) ||
+            !read_value(*it, "max_in_flight", config.pipeline_max_in_flight, "pipeline.", error)) {
+            return false;
+        }
+    }
+
+    if (auto it = j.find("journal"); it != j.end()) {
+        if (!known_keys(*it, {"dir"}, "journal.", error) ||
+            !read_value(*it, "dir", config.journal_dir, "journal.", error)) {
+            return false;
+        }
+    }
+
+    if (auto it = j.find("metrics"); it != j.end()) {
+        if (!known_keys(*it, {"port", "address"}, "metrics.", error) ||
+            !read_value(*it, "port", config.metrics_port, "metrics.", error) ||
+            !read_value(*it, "address", config.metrics_address, "metrics.", error)) {
+            return false;
+        }
+    }
+
+    if (auto it = j.find("cpus"); it != j.end()) {
+        if (!known_keys(*it, {"producers", "consumers", "background", "parse", "enrich"}, "cpus.", error) ||
+            !read_cpus(*it, "parse", config.parse_cpus, error) ||
+            !read_cpus(*it, "enrich", config.enrich_cpus, error) ||
+            !read_cpus(*it, "producers", config.producer_cpus, error) ||
+            !read_cpus(*it, "consumers", config.consumer_cpus, error) ||
+            !read_cpus(*it, "background", config.background_cpus, error)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The whole config in the layout config_from_json() reads.
+inline nlohmann::json config_to_json(const PipelineConfig& config) {
+    nlohmann::json feeds = nlohmann::json::array();
+    for (const FeedConfig& feed : config.feeds) feeds.push_back({{"host", feed.host}, {"port", feed.port}});
+    return {
+        {"feeds", feeds},
+        {"conninfo", config.conninfo},
+        {"sink", trade_sink_name(config.sink)},
+        {"threads", {{"consumers", config.consumers},
+                     {"db_connections", config.db_connections},
+                     {"async_writer_connections", config.async_writer_connections}}},
+        {"stages", {{"enabled", config.staged},
+                    {"parse_threads", config.parse_threads},
+                    {"enrich_threads", config.enrich_threads}}},
+        {"queue", {{"capacity", config.queue_capacity},
+                   {"node", config.queue_node < 0 ? nlohmann::json("auto") : nlohmann::json(config.queue_node)},
+                   {"high_watermark", config.high_watermark},
+                   {"low_watermark", config.low_watermark},
+                   {"overload", overload_policy_name(config.overload)}}},
+        {"batch", {{"min", config.batch_min},
+                   {"max", config.batch_max},
+                   {"latency_slo_us", config.latency_slo.count()}}},
+        {"pipeline", {{"max_in_flight", config.pipeline_max_in_flight}}},
+        {"journal", {{"dir", config.journal_dir}}},
+        {"metrics", {{"port", config.metrics_port}, {"address", config.metrics_address}}},
+        {"cpus", {{"producers", config.producer_cpus},
+                  {"consumers", config.consumer_cpus},
+                  {"background", config.background_cpus},
+                  {"parse", config.parse_cpus},
+                  {"enrich", config.enrich_cpus}}},
+    };
+}
+
+inline bool load_config_file(const std::string& path, PipelineConfig& config, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "can't open " + path;
+        return false;
+    }
+    nlohmann::json j = nlohmann::json::parse(in, nullptr, false, true);
+    if (j.is_discarded()) {
+        error = path + " is not valid JSON";
+        return false;
+    }
+    if (!config_from_json(j, config, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    return true;
+}
+
+// Checks settings against each other and against the compiled capacities
+// of the queue and of the issuer snapshot, which every producer and every
+// enrich thread holds a reader slot in.
+inline bool validate_config(const PipelineConfig& config, size_t max_queue_capacity, size_t max_issuer_readers,
+                            std::string& error) {
+    size_t issuer_readers = config.feeds.size() + (config.staged ? config.enrich_threads : 0);
+    if (config.feeds.empty()) error = "no feeds";
+    else if (issuer_readers > max_issuer_readers) {
+        error = "at most " + std::to_string(max_issuer_readers) + " feeds" +
+                (config.staged ? " plus enrich threads" : "") + " (got " + std::to_string(issuer_readers) + ")";
+    }
+    else if (config.consumers == 0) error = "need at least one consumer";
+    else if (config.staged && (config.parse_threads == 0 || config.enrich_threads == 0)) {
+        error = "each stage needs at least one thread";
+    }
+    else if (config.db_connections == 0 || config.async_writer_connections == 0) error = "need at least one connection";
+    else if (config.queue_capacity == 0 || config.queue_capacity > max_queue_capacity) {
+        error = "queue capacity must be between 1 and " + std::to_string(max_queue_capacity);
+    }
+    else if (config.low_watermark >= config.high_watermark || config.high_watermark > 100) {
+        error = "need low watermark < high watermark <= 100 (percent of queue capacity)";
+    }
+    else if (config.batch_min == 0 || config.batch_min > config.batch_max) error = "need 0 < batch min <= batch max";
+    else if (config.latency_slo.count() <= 0) error = "latency SLO must be positive";
+    else if (config.pipeline_max_in_flight == 0) error = "pipeline needs at least one insert in flight";
+    else if (config.metrics_port > 65535) error = "metrics port must be at most 65535";
+    return error.empty();
+}
+
+inline const char* config_usage() {
+    return "Options:\n"
+           "  --config FILE            JSON config; flags below override it\n"
+           "  --feed HOST:PORT         TRACE feed to read (repeat for several; replaces the defaults)\n"
+           "  --conninfo STRING        libpq connection string\n"
+           "  --sink NAME              insert, pipeline, copy, async or journal\n"
+           "  --consumers N            consumer threads\n"
+           "  --staged                 parse and enrich on their own thread pools\n"
+           "  --parse-threads N        parse stage threads (with --staged)\n"
+           "  --enrich-threads N       enrich stage threads (with --staged)\n"
+           "  --db-connections N       connections shared by consumers\n"
+           "  --async-connections N    connections for the async writer\n"
+           "  --queue-capacity N       trades queued before producers wait\n"
+           "  --queue-node N|auto      NUMA node for the queue's memory\n"
+           "  --high-watermark PCT     queue fill at which producers stop reading feeds\n"
+           "  --low-watermark PCT      queue fill at which they start again\n"
+           "  --overload NAME          pause (stop reading) or shed (drop trades) when overloaded\n"
+           "  --batch-min N            smallest COPY batch target\n"
+           "  --batch-max N            largest COPY batch\n"
+           "  --latency-slo-us N       longest a trade may wait for its batch\n"
+           "  --pipeline-in-flight N   inserts outstanding per pipelined connection\n"
+           "  --journal-dir DIR        journal directory for the journal sink\n"
+           "  --metrics-port N         serve Prometheus metrics at http://ADDRESS:N/metrics (0: off)\n"
+           "  --metrics-address IP     address for the metrics listener (default 127.0.0.1)\n"
+           "  --producer-cpus LIST     cores for producer threads, e.g. 0,1,2\n"
+           "  --consumer-cpus LIST     cores for consumer threads\n"
+           "  --background-cpus LIST   cores shared by logger, reloader and other background threads\n"
+           "  --parse-cpus LIST        cores for parse stage threads\n"
+           "  --enrich-cpus LIST       cores for enrich stage threads\n"
+           "  --print-config           print the resulting config as JSON and exit\n"
+           "  --help                   show this message\n";
+}
+
+// What the command line asked for besides settings
+enum class ConfigAction {
+    Run,
+    PrintConfig,
+    Help
+};
+
+// Parses argv into `config`. A --config file is read first wherever it
+// appears, so flags always win over the file.
+inline bool parse_config_args(int argc, const char* const* argv, PipelineConfig& config, ConfigAction& action,
+                              std::string& error) {
+    using namespace config_detail;
+    action = ConfigAction::Run;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::string_view(argv[i]) != "--config") continue;
+        if (i + 1 >= argc) {
+            error = "--config needs a value";
+            return false;
+        }
+        if (!load_config_file(argv[i + 1], config, error)) return false;
+    }
+
+    bool feedsGiven = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view flag = argv[i];
+        if (flag == "--help" || flag == "-h") {
+            action = ConfigAction::Help;
+            continue;
+        }
+        if (flag == "--print-config") {
+            action = ConfigAction::PrintConfig;
+            continue;
+        }
+        if (flag == "--staged") {
+            config.staged = true;
+            continue;
+        }
+
+        std::string_view value;
+        bool ok = true;
+        auto size = [&](size_t& out) { return parse_size(value, out); };
+        if (i + 1 < argc) value = argv[i + 1];
+        if (flag == "--config") {
+            // Already read
+        }
+        else if (flag == "--feed") {
+            if (!feedsGiven) config.feeds.clear();
+            feedsGiven = true;
+            FeedConfig feed;
+            ok = parse_feed(value, feed);
+            if (ok) config.feeds.push_back(std::move(feed));
+        }
+        else if (flag == "--conninfo") {
+            ok = !value.empty();
+            config.conninfo.assign(value);
+        }
+        else if (flag == "--sink") ok = parse_trade_sink(value, config.sink);
+        else if (flag == "--consumers") ok = size(config.consumers);
+        else if (flag == "--parse-threads") ok = size(config.parse_threads);
+        else if (flag == "--enrich-threads") ok = size(config.enrich_threads);
+        else if (flag == "--db-connections") ok = size(config.db_connections);
+        else if (flag == "--async-connections") ok = size(config.async_writer_connections);
+        else if (flag == "--queue-capacity") ok = size(config.queue_capacity);
+        else if (flag == "--high-watermark") ok = size(config.high_watermark);
+        else if (flag == "--low-watermark") ok = size(config.low_watermark);
+        else if (flag == "--overload") ok = parse_overload_policy(value, config.overload);
+        else if (flag == "--batch-min") ok = size(config.batch_min);
+        else if (flag == "--batch-max") ok = size(config.batch_max);
+        else if (flag == "--latency-slo-us") {
+            size_t us = 0;
+            ok = size(us);
+            config.latency_slo = std::chrono::microseconds(us);
+        }
+        else if (flag == "--pipeline-in-flight") ok = size(config.pipeline_max_in_flight);
+        else if (flag == "--journal-dir") {
+            ok = !value.empty();
+            config.journal_dir.assign(value);
+        }
+        else if (flag == "--metrics-port") ok = size(config.metrics_port);
+        else if (flag == "--metrics-address") {
+            ok = !value.empty();
+            config.metrics_address.assign(value);
+        }
+        else if (flag == "--producer-cpus") ok = parse_cpu_list(value, config.producer_cpus);
+        else if (flag == "--consumer-cpus") ok = parse_cpu_list(value, config.consumer_cpus);
+        else if (flag == "--background-cpus") ok = parse_cpu_list(value, config.background_cpus);
+        else if (flag == "--parse-cpus") ok = parse_cpu_list(value, config.parse_cpus);
+        else if (flag == "--enrich-cpus") ok = parse_cpu_list(value, config.enrich_cpus);
+        else if (flag == "--queue-node") ok = parse_node(value, config.queue_node);
+        else {
+            error = "unknown option " + std::string(flag);
+            return false;
+        }
+        if (i + 1 >= argc) {
+            error = std::string(flag) + " needs a value";
+            return false;
+        }
+        if (!ok) {
+            error = "bad value for " + std::string(flag) + ": " + std::string(value);
+            return false;
+        }
+        ++i;
+    }
+    return true;
+}
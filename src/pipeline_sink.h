@@ -0,0 +1,244 @@
+#pragma once
+#include <libpq-fe.h>
+#include <sys/select.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "trade.h"
+#include "trade_params.h"
+
+// -------------------------------------
+// Pipelined per-trade inserts (libpq 14+)
+// -------------------------------------
+// Sends the prepared trade insert in pipeline mode, so up to max_in_flight
+// inserts are on the wire at once and the consumer never waits a full
+// round-trip per trade. Every insert is followed by its own sync point,
+// which makes each trade its own transaction: a failing trade is reported
+// on its own and doesn't roll back or abort its neighbours.
+//
+// Results come back in send order, so the in-flight trades are kept in a
+// ring and each result is matched to the oldest one. The connection runs in
+// non-blocking mode, as libpq recommends for pipelines, so a full socket
+// buffer in either direction can't deadlock us against the server.
+//
+// add() and drain() block on the socket when they must. An event loop that
+// multiplexes several sinks instead checks full(), waits on socket() itself
+// (for writing too while wants_write()) and calls poll().
+class PipelineSink {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Called once per trade when its insert completes. error is nullptr on
+    // success. latency runs from add() to the server's reply.
+    using OnComplete = std::function<void(const Trade& trade, const char* error, Clock::duration latency)>;
+
+    PipelineSink(PGconn* conn, size_t max_in_flight, OnComplete on_complete = nullptr)
+        : conn(conn), ring(max_in_flight > 0 ? max_in_flight : 1), on_complete(std::move(on_complete)) {}
+
+    PipelineSink(const PipelineSink&) = delete;
+    PipelineSink& operator=(const PipelineSink&) = delete;
+
+    ~PipelineSink() {
+        if (active) {
+            drain();
+            PQexitPipelineMode(conn);
+            PQsetnonblocking(conn, 0);
+        }
+    }
+
+    // Prepares the insert (pass false if the connection already has it) and
+    // switches the connection into pipeline mode.
+    bool start(bool prepare = true) {
+        if (!conn) return false;
+
+        bool prepared = true;
+        if (prepare) {
+            PGresult* res = PQprepare(conn, INSERT_TRADE_STATEMENT, insert_trade_sql().c_str(),
+                                      TRADE_COLUMN_COUNT, TRADE_PARAM_TYPES);
+            prepared = PQresultStatus(res) == PGRES_COMMAND_OK;
+            PQclear(res);
+        }
+        if (!prepared || PQsetnonblocking(conn, 1) != 0 || PQenterPipelineMode(conn) != 1) {
+            std::cerr << "Failed to start insert pipeline: " << PQerrorMessage(conn) << "\n";
+            return false;
+        }
+        active = true;
+        return true;
+    }
+
+    // Queues one insert, first waiting for results if the pipeline is full.
+    // Returns false if the trade couldn't be sent. Failures reported by the
+    // server arrive later and are logged against their trade.
+    bool add(const Trade& trade) {
+        if (!active) return false;
+
+        TradeParams params;
+        std::string error;
+        if (!params.encode(trade, error)) {
+            complete(trade, error.c_str(), Clock::duration::zero());
+            return false;
+        }
+
+        while (count == ring.size()) {
+            if (!wait()) return false;
+        }
+
+        if (PQsendQueryPrepared(conn, INSERT_TRADE_STATEMENT, TRADE_COLUMN_COUNT,
+                                params.values, params.lengths, params.formats, 0) != 1 ||
+            PQpipelineSync(conn) != 1) {
+            complete(trade, PQerrorMessage(conn), Clock::duration::zero());
+            return false;
+        }
+
+        InFlight& slot = ring[(head + count) % ring.size()];
+        slot.trade = trade;
+        slot.error.clear();
+        slot.sent = Clock::now();
+        ++count;
+        return poll();
+    }
+
+    // Sends what's buffered and handles any results that have arrived,
+    // without blocking. Call it whenever the consumer is idle.
+    bool poll() {
+        if (!active) return false;
+        int flushed = PQflush(conn);
+        pending_write = flushed == 1;
+        return flushed >= 0 && read_results();
+    }
+
+    // Blocks until every in-flight insert has a result.
+    bool drain() {
+        while (count > 0) {
+            if (!wait()) return false;
+        }
+        return true;
+    }
+
+    bool alive() const { return active; }
+    bool full() const { return count == ring.size(); }
+    bool wants_write() const { return pending_write; }
+    int socket() const { return PQsocket(conn); }
+    size_t in_flight() const { return count; }
+    uint64_t inserted() const { return trades_inserted; }
+    uint64_t failed() const { return trades_failed; }
+
+    // Default failure log line, also used by callers with their own hook.
+    static void report(const Trade& trade, const char* error) {
+        std::cerr << "Insert failed for trade " << trade.control_id.view() << " (" << trade.side.view()
+                  << " " << trade.cusip.view() << "): " << error;
+        std::string_view text(error);
+        if (text.empty() || text.back() != '\n') std::cerr << "\n";
+    }
+
+private:
+    struct InFlight {
+        Trade trade;
+        std::string error;   // Set once the trade's insert has failed
+        Clock::time_point sent;
+    };
+
+    // Waits until the socket can make progress (or a second passes), then
+    // processes whatever arrived.
+    bool wait() {
+        int flushed = PQflush(conn);
+        if (flushed < 0) return false;
+
+        int sock = PQsocket(conn);
+        if (sock < 0) return false;
+
+        fd_set readable;
+        fd_set writable;
+        FD_ZERO(&readable);
+        FD_ZERO(&writable);
+        FD_SET(sock, &readable);
+        if (flushed == 1) FD_SET(sock, &writable);
+
+        timeval timeout{1, 0};
+        if (select(sock + 1, &readable, &writable, nullptr, &timeout) < 0) return false;
+
+        return poll();
+    }
+
+    bool read_results() {
+        if (PQconsumeInput(conn) != 1) {
+            fail_all(PQerrorMessage(conn));
+            return false;
+        }
+
+        bool after_end = false;
+        while (count > 0 && PQisBusy(conn) == 0) {
+            PGresult* res = PQgetResult(conn);
+            if (!res) {
+                // End of one insert's results, its sync is next. Two in a
+                // row means libpq has nothing more for us yet.
+                if (after_end) break;
+                after_end = true;
+                continue;
+            }
+            after_end = false;
+
+            InFlight& front = ring[head];
+            switch (PQresultStatus(res)) {
+                case PGRES_COMMAND_OK:
+                    break;
+                case PGRES_PIPELINE_SYNC:
+                    finish(front);
+                    break;
+                case PGRES_PIPELINE_ABORTED:
+                    front.error = "pipeline aborted";
+                    break;
+                default:
+                    front.error = PQresultErrorMessage(res);
+                    break;
+            }
+            PQclear(res);
+        }
+        return true;
+    }
+
+    void finish(InFlight& slot) {
+        complete(slot.trade, slot.error.empty() ? nullptr : slot.error.c_str(), Clock::now() - slot.sent);
+        head = (head + 1) % ring.size();
+        --count;
+    }
+
+    void complete(const Trade& trade, const char* error, Clock::duration latency) {
+        if (error) {
+            ++trades_failed;
+        }
+        else {
+            ++trades_inserted;
+        }
+        if (on_complete) {
+            on_complete(trade, error, latency);
+        }
+        else if (error) {
+            report(trade, error);
+        }
+    }
+
+    // The connection is gone, so nothing in flight will get a result.
+    void fail_all(const char* reason) {
+        while (count > 0) {
+            ring[head].error = reason;
+            finish(ring[head]);
+        }
+        active = false;
+    }
+
+    PGconn* conn;
+    std::vector<InFlight> ring;
+    size_t head = 0;
+    size_t count = 0;
+    OnComplete on_complete;
+    bool active = false;
+    bool pending_write = false;
+    uint64_t trades_inserted = 0;
+    uint64_t trades_failed = 0;
+};
@@ -0,0 +1,219 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "cpu_topology.h"
+#include "mpmc_queue.h"
+
+// What one stage has done, summed over its threads. Counters only grow;
+// subtract an earlier snapshot to get an interval.
+struct StageStats {
+    std::string name;
+    size_t threads = 0;
+    uint64_t items = 0;        // Taken from the stage's queue (or handled, for a meter)
+    uint64_t dropped = 0;      // Of those, rejected by the handler
+    uint64_t busy_ns = 0;      // Time spent in the handler
+    uint64_t full_waits = 0;   // Pushes that found the queue full and waited
+    size_t depth = 0;          // Queued when the snapshot was taken
+    size_t capacity = 0;
+
+    StageStats since(const StageStats& earlier) const {
+        StageStats d = *this;
+        d.items -= earlier.items;
+        d.dropped -= earlier.dropped;
+        d.busy_ns -= earlier.busy_ns;
+        d.full_waits -= earlier.full_waits;
+        return d;
+    }
+};
+
+// One line per stage interval: throughput, how busy its threads were, the
+// cost per item and how full its queue is.
+inline void print_stage_stats(std::ostream& os, const StageStats& s, std::chrono::nanoseconds interval) {
+    double seconds = std::max(1e-9, std::chrono::duration<double>(interval).count());
+    double capacity_ns = static_cast<double>(interval.count()) * static_cast<double>(std::max<size_t>(s.threads, 1));
+    double busy = static_cast<double>(s.busy_ns) / capacity_ns;
+    os << "[Stage " << s.name << "] " << s.threads << " threads, " << static_cast<uint64_t>(s.items / seconds)
+       << " items/s, " << s.dropped << " dropped, busy " << std::fixed << std::setprecision(1) << 100 * busy
+       << "%, " << std::setprecision(2) << (s.items ? s.busy_ns / 1000.0 / s.items : 0.0) << " us/item";
+    os.unsetf(std::ios::fixed);
+    if (s.capacity > 0) os << ", queue " << s.depth << "/" << s.capacity << ", " << s.full_waits << " full waits";
+}
+
+// ----------------------
+// Per-thread stage meter
+// ----------------------
+// Counters for a stage's threads, one cache line each so threads never
+// write to the same line. Each thread updates only its own with relaxed
+// atomics; snapshot() sums them for reports.
+class StageMeter {
+public:
+    struct alignas(64) Counters {
+        std::atomic<uint64_t> items{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> busy_ns{0};
+
+        // Counts one item that took `busy`, rejected or not
+        void record(std::chrono::nanoseconds busy, bool kept = true) { record_batch(1, busy, kept ? 0 : 1); }
+
+        // Counts `n` items handled together in `busy`, `rejected` of them dropped
+        void record_batch(uint64_t n, std::chrono::nanoseconds busy, uint64_t rejected = 0) {
+            items.store(items.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+            if (rejected) dropped.store(dropped.load(std::memory_order_relaxed) + rejected, std::memory_order_relaxed);
+            busy_ns.store(busy_ns.load(std::memory_order_relaxed) + static_cast<uint64_t>(busy.count()),
+                          std::memory_order_relaxed);
+        }
+    };
+
+    StageMeter(std::string name, size_t threads)
+        : stage_name(std::move(name)), counters(std::max<size_t>(threads, 1)) {}
+
+    // Counters for thread `i`; only that thread may record into them.
+    Counters& thread(size_t i) { return counters[i]; }
+
+    const std::string& name() const { return stage_name; }
+    size_t threads() const { return counters.size(); }
+
+    StageStats snapshot() const {
+        StageStats s;
+        s.name = stage_name;
+        s.threads = counters.size();
+        for (const Counters& c : counters) {
+            s.items += c.items.load(std::memory_order_relaxed);
+            s.dropped += c.dropped.load(std::memory_order_relaxed);
+            s.busy_ns += c.busy_ns.load(std::memory_order_relaxed);
+        }
+        return s;
+    }
+
+private:
+    std::string stage_name;
+    std::vector<Counters> counters;
+};
+
+// --------------
+// Pipeline stage
+// --------------
+// A bounded MPMCQueue of work items and a pool of threads draining it. Each
+// thread runs a handler that does the stage's work on one item and passes
+// the result on, usually by pushing it to the next stage. Stages chain into
+// a pipeline whose parts can be scaled separately:
+//
+//   PipelineStage<FeedLine, 4096> parse("parse", 2, makeParser);
+//   PipelineStage<Trade, 4096> enrich("enrich", 1, makeEnricher);
+//
+// The handler factory is called once on each worker thread, after it's
+// pinned, so per-thread state (readers, scratch buffers) lives in the
+// handler and is allocated on the worker's own NUMA node. A handler
+// returns false to drop its item, which is counted.
+//
+// Workers spin briefly on an empty queue and then sleep 50 us at a time.
+// stop() lets them finish what's queued before joining.
+template<typename T, size_t Capacity>
+class PipelineStage {
+public:
+    using Handler = std::function<bool(T&)>;
+    using HandlerFactory = std::function<Handler(size_t worker)>;
+    using Clock = std::chrono::steady_clock;
+
+    // `cpus[i]` pins worker i; `node` places the queue (-1 for no preference).
+    PipelineStage(std::string name, size_t threads, HandlerFactory factory, std::vector<int> cpus = {},
+                  int node = -1)
+        : meter(std::move(name), threads), factory(std::move(factory)), cpus(std::move(cpus)) {
+        queue.create(node);
+    }
+
+    PipelineStage(const PipelineStage&) = delete;
+    PipelineStage& operator=(const PipelineStage&) = delete;
+
+    ~PipelineStage() { stop(); }
+
+    void start() {
+        if (running.exchange(true)) return;
+        for (size_t i = 0; i < meter.threads(); ++i) workers.emplace_back(&PipelineStage::run, this, i);
+    }
+
+    // Lets the workers drain the queue, then joins them.
+    void stop() {
+        if (!running.exchange(false)) return;
+        for (auto& w : workers) w.join();
+        workers.clear();
+    }
+
+    bool try_push(const T& item) { return queue->enqueue(item); }
+
+    // Waits for room, for callers that would rather stall than drop.
+    void push(const T& item) {
+        if (queue->enqueue(item)) return;
+        full_waits.fetch_add(1, std::memory_order_relaxed);
+        while (!queue->enqueue(item)) std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    size_t depth() const { return queue->size_approx(); }
+    static constexpr size_t capacity() { return Capacity; }
+    const std::string& name() const { return meter.name(); }
+
+    StageStats stats() const {
+        StageStats s = meter.snapshot();
+        s.full_waits = full_waits.load(std::memory_order_relaxed);
+        s.depth = depth();
+        s.capacity = Capacity;
+        return s;
+    }
+
+private:
+    void run(size_t worker) {
+        std::string thread_name = name() + " " + std::to_string(worker);
+        pthread_setname_np(pthread_self(), thread_name.substr(0, 15).c_str());
+        if (worker < cpus.size()) {
+            std::string error;
+            if (!pin_current_thread(cpus[worker], error)) {
+                std::cerr << "[Stage " << name() << "] " << error << ", running unpinned\n";
+            }
+        }
+        Handler handle = factory(worker);
+        StageMeter::Counters& counters = meter.thread(worker);
+
+        T item;
+        int idle = 0;
+        while (true) {
+            if (!queue->dequeue(item)) {
+                if (!running.load(std::memory_order_acquire)) {
+                    // Stopped: one last look in case an item landed meanwhile
+                    if (!queue->dequeue(item)) break;
+                }
+                else if (++idle < 64) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                else {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    continue;
+                }
+            }
+            idle = 0;
+            auto start = Clock::now();
+            bool kept = handle(item);
+            counters.record(Clock::now() - start, kept);
+        }
+    }
+
+    NodeLocal<MPMCQueue<T, Capacity>> queue;
+    StageMeter meter;
+    HandlerFactory factory;
+    std::vector<int> cpus;
+    std::vector<std::thread> workers;
+    std::atomic<bool> running{false};
+    std::atomic<uint64_t> full_waits{0};
+};
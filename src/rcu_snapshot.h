@@ -0,0 +1,144 @@
+#pragma once
+#include <atomic>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+// Read-copy-update holder for an immutable snapshot of T.
+//
+// Readers pin the current snapshot with a couple of atomic stores and one
+// atomic load, and never block or take a lock. A writer builds a brand new T
+// off to the side, swaps the pointer, and then waits for a grace period
+// (every reader that could still see the old snapshot has finished) before
+// deleting it.
+//
+// Grace periods are tracked with epochs. Each reader owns a cache-line
+// isolated slot. When a read begins the reader stores the current global
+// epoch in its slot, and when it ends it stores 0 (quiescent). After swapping
+// the pointer the writer bumps the epoch and waits until every slot is either
+// quiescent or holds the new epoch. A reader that stored an older epoch may
+// have loaded the old pointer, anyone newer is guaranteed to see the new one.
+//
+// Reader slots are claimed by a Reader handle, normally one per thread for
+// the lifetime of that thread. A Reader must not have more than one Guard
+// alive at a time.
+template<typename T, size_t MaxReaders = 64>
+class RcuSnapshot {
+    static_assert(MaxReaders > 0, "MaxReaders must be > 0");
+
+    static constexpr size_t cache_line = 64;
+
+    struct alignas(cache_line) ReaderSlot {
+        std::atomic<uint64_t> epoch{0};      // 0 means not inside a read
+        std::atomic<bool> claimed{false};
+    };
+
+public:
+    static constexpr size_t max_readers = MaxReaders;
+
+    // Keeps one snapshot alive for the duration of a read.
+    class Guard {
+    public:
+        ~Guard() {
+            slot.epoch.store(0, std::memory_order_release);
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+        const T* get() const { return snapshot; }
+        const T* operator->() const { return snapshot; }
+        const T& operator*() const { return *snapshot; }
+        explicit operator bool() const { return snapshot != nullptr; }
+
+    private:
+        friend class RcuSnapshot;
+
+        Guard(ReaderSlot& s, const T* p) : slot(s), snapshot(p) {}
+
+        ReaderSlot& slot;
+        const T* snapshot;
+    };
+
+    // Owns one reader slot. Construct it once per reading thread.
+    class Reader {
+    public:
+        explicit Reader(RcuSnapshot& owner) : rcu(owner), slot(owner.claim_slot()) {}
+
+        ~Reader() {
+            slot.epoch.store(0, std::memory_order_release);
+            slot.claimed.store(false, std::memory_order_release);
+        }
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        Guard read() {
+            // Both operations are seq_cst so the writer, which swaps the
+            // pointer before reading our slot, either sees our epoch or we
+            // see its new pointer.
+            slot.epoch.store(rcu.epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            return Guard(slot, rcu.current.load(std::memory_order_seq_cst));
+        }
+
+    private:
+        RcuSnapshot& rcu;
+        ReaderSlot& slot;
+    };
+
+    explicit RcuSnapshot(std::unique_ptr<const T> initial = nullptr)
+        : current(initial.release()) {}
+
+    ~RcuSnapshot() {
+        delete current.load(std::memory_order_relaxed);
+    }
+
+    RcuSnapshot(const RcuSnapshot&) = delete;
+    RcuSnapshot& operator=(const RcuSnapshot&) = delete;
+
+    // Replaces the snapshot and frees the old one once no reader can see it.
+    // Blocks the calling (writer) thread for the grace period.
+    void publish(std::unique_ptr<const T> next) {
+        std::lock_guard<std::mutex> lock(writer_mutex);
+
+        const T* old = current.exchange(next.release(), std::memory_order_seq_cst);
+        uint64_t new_epoch = epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+
+        for (ReaderSlot& slot : slots) {
+            while (true) {
+                uint64_t seen = slot.epoch.load(std::memory_order_seq_cst);
+                if (seen == 0 || seen >= new_epoch) break;
+                std::this_thread::yield();
+            }
+        }
+
+        delete old;
+        published.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Number of snapshots published so far.
+    uint64_t version() const {
+        return published.load(std::memory_order_relaxed);
+    }
+
+private:
+    ReaderSlot& claim_slot() {
+        for (ReaderSlot& slot : slots) {
+            bool expected = false;
+            if (slot.claimed.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                return slot;
+            }
+        }
+        throw std::runtime_error("RcuSnapshot: no free reader slots");
+    }
+
+    std::atomic<const T*> current;
+    alignas(cache_line) std::atomic<uint64_t> epoch{1};
+    std::atomic<uint64_t> published{0};
+    std::array<ReaderSlot, MaxReaders> slots;
+    std::mutex writer_mutex;
+};
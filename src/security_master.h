@@ -0,0 +1,247 @@
+#pragma once
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// ---------------------
+// CUSIP check digits
+// ---------------------
+// A CUSIP is 8 base characters plus a check digit. Each base character has a
+// value (0-9 for digits, 10-35 for A-Z, 36/37/38 for '*', '@', '#'). Values in
+// odd positions (0-based) are doubled, the decimal digits of all values are
+// summed, and the check digit is (10 - sum % 10) % 10. This matches
+// cusip_check_digit() in fake_trace_generator.py. Only uppercase letters are
+// accepted since that's how CUSIPs are issued.
+
+// Reference implementation, one character at a time.
+// Returns -1 if any base character is invalid.
+inline int cusip_check_digit_scalar(std::string_view base) {
+    if (base.size() != 8) return -1;
+
+    int total = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        char c = base[i];
+        int v;
+        if (c >= '0' && c <= '9') v = c - '0';
+        else if (c >= 'A' && c <= 'Z') v = c - 'A' + 10;
+        else if (c == '*') v = 36;
+        else if (c == '@') v = 37;
+        else if (c == '#') v = 38;
+        else return -1;
+
+        if (i % 2 == 1) v *= 2;
+        total += v / 10 + v % 10;
+    }
+    return (10 - total % 10) % 10;
+}
+
+// Validates a full 9-character CUSIP.
+// With SSE2 all 8 base characters are classified, converted, weighted and
+// digit-summed in parallel lanes, which avoids the per-character branches of
+// the scalar version on the producer hot path.
+inline bool is_valid_cusip(std::string_view cusip) {
+    if (cusip.size() != 9) return false;
+    char check = cusip[8];
+    if (check < '0' || check > '9') return false;
+
+#if defined(__SSE2__)
+    alignas(16) char buf[16] = {};
+    std::memcpy(buf, cusip.data(), 8);
+    const __m128i c = _mm_load_si128(reinterpret_cast<const __m128i*>(buf));
+
+    // Classify every lane. ASCII is < 128 so signed byte compares are fine.
+    auto in_range = [](__m128i x, char lo, char hi) {
+        return _mm_and_si128(_mm_cmpgt_epi8(x, _mm_set1_epi8(lo - 1)),
+                             _mm_cmplt_epi8(x, _mm_set1_epi8(hi + 1)));
+    };
+    const __m128i digit = in_range(c, '0', '9');
+    const __m128i upper = in_range(c, 'A', 'Z');
+    const __m128i star = _mm_cmpeq_epi8(c, _mm_set1_epi8('*'));
+    const __m128i at = _mm_cmpeq_epi8(c, _mm_set1_epi8('@'));
+    const __m128i hash = _mm_cmpeq_epi8(c, _mm_set1_epi8('#'));
+
+    const __m128i known = _mm_or_si128(_mm_or_si128(digit, upper), _mm_or_si128(star, _mm_or_si128(at, hash)));
+    if ((_mm_movemask_epi8(known) & 0xFF) != 0xFF) return false;
+
+    // Character values, selected per lane by the class masks.
+    __m128i v = _mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0')));
+    v = _mm_or_si128(v, _mm_and_si128(upper, _mm_sub_epi8(c, _mm_set1_epi8('A' - 10))));
+    v = _mm_or_si128(v, _mm_and_si128(star, _mm_set1_epi8(36)));
+    v = _mm_or_si128(v, _mm_and_si128(at, _mm_set1_epi8(37)));
+    v = _mm_or_si128(v, _mm_and_si128(hash, _mm_set1_epi8(38)));
+
+    // Widen to 16 bits, double odd positions, then take the digit sum of each
+    // lane as v - 9 * (v / 10). Division by 10 is (v * 205) >> 11, exact for
+    // v <= 76 which covers the largest doubled value.
+    __m128i w = _mm_unpacklo_epi8(v, _mm_setzero_si128());
+    w = _mm_mullo_epi16(w, _mm_setr_epi16(1, 2, 1, 2, 1, 2, 1, 2));
+    const __m128i tens = _mm_srli_epi16(_mm_mullo_epi16(w, _mm_set1_epi16(205)), 11);
+    const __m128i digit_sums = _mm_sub_epi16(w, _mm_mullo_epi16(tens, _mm_set1_epi16(9)));
+
+    // Horizontal sum of the eight 16-bit lanes.
+    __m128i sum = _mm_madd_epi16(digit_sums, _mm_set1_epi16(1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    int total = _mm_cvtsi128_si32(sum);
+
+    return (10 - total % 10) % 10 == check - '0';
+#else
+    return cusip_check_digit_scalar(cusip.substr(0, 8)) == check - '0';
+#endif
+}
+
+// ------------------------
+// In-memory security master
+// ------------------------
+
+// Static terms of one security. Maturity is kept in its ISO text form
+// (YYYY-MM-DD) since that's what both the feed and Postgres use.
+struct SecurityRecord {
+    double coupon = 0.0;
+    char maturity[10] = {};
+
+    std::string_view maturity_view() const { return std::string_view(maturity, sizeof(maturity)); }
+};
+
+// Result of checking a trade's static fields against the master.
+enum class SecurityCheck {
+    Learned,    // First sighting, the trade's terms are now the reference
+    Matched,    // Known security and the terms agree
+    Mismatch,   // Known security but the trade disagrees with the reference
+    Untracked   // Couldn't be stored (bad input or table full)
+};
+
+// CUSIP -> static terms, shared by every producer.
+//
+// Entries are only ever added, either loaded from Postgres at startup or
+// learned from the first trade seen for a CUSIP. Both go through
+// check_or_learn(), so whichever source comes first becomes the reference;
+// load reference data before feeding trades in.
+// Never erasing lets the table be a fixed-size open-addressing array with
+// lock-free inserts:
+// - A valid CUSIP packs into a 64-bit key (9 chars x 6 bits), so claiming a
+//   slot is a single compare_exchange on the key.
+// - The winner writes the record, then publishes it with a release store on
+//   `ready`. Readers that find the key wait for `ready` with acquire.
+// Capacity is a power of 2 and fixed at construction. Once the table is
+// half full, new securities are no longer learned.
+class SecurityMaster {
+public:
+    explicit SecurityMaster(size_t capacity = 1 << 20) : slots(round_up(capacity)) {}
+
+    // Compares a trade's coupon and maturity with the reference terms for its
+    // CUSIP, learning them if this is the first trade for the security.
+    SecurityCheck check_or_learn(std::string_view cusip, double coupon, std::string_view maturity) {
+        uint64_t key = pack(cusip);
+        if (key == 0 || maturity.size() != sizeof(SecurityRecord::maturity)) return SecurityCheck::Untracked;
+
+        size_t mask = slots.size() - 1;
+        size_t start = mix(key) & mask;
+        for (size_t probe = 0; probe <= mask; ++probe) {
+            Slot& slot = slots[(start + probe) & mask];
+            uint64_t existing = slot.key.load(std::memory_order_acquire);
+
+            if (existing == 0) {
+                if (count.load(std::memory_order_relaxed) * 2 >= slots.size()) {
+                    return SecurityCheck::Untracked;
+                }
+                if (slot.key.compare_exchange_strong(existing, key, std::memory_order_acq_rel)) {
+                    slot.record.coupon = coupon;
+                    std::memcpy(slot.record.maturity, maturity.data(), sizeof(slot.record.maturity));
+                    slot.ready.store(true, std::memory_order_release);
+                    count.fetch_add(1, std::memory_order_relaxed);
+                    return SecurityCheck::Learned;
+                }
+                // Lost the race. `existing` now holds the winner's key.
+            }
+
+            if (existing == key) {
+                const SecurityRecord& record = wait_ready(slot);
+                bool same = std::fabs(record.coupon - coupon) < 1e-9 && record.maturity_view() == maturity;
+                if (!same) mismatches.fetch_add(1, std::memory_order_relaxed);
+                return same ? SecurityCheck::Matched : SecurityCheck::Mismatch;
+            }
+        }
+        return SecurityCheck::Untracked;
+    }
+
+    // Returns nullptr for unknown securities.
+    const SecurityRecord* find(std::string_view cusip) const {
+        uint64_t key = pack(cusip);
+        if (key == 0) return nullptr;
+
+        size_t mask = slots.size() - 1;
+        size_t start = mix(key) & mask;
+        for (size_t probe = 0; probe <= mask; ++probe) {
+            const Slot& slot = slots[(start + probe) & mask];
+            uint64_t existing = slot.key.load(std::memory_order_acquire);
+            if (existing == 0) return nullptr;
+            if (existing == key) return &wait_ready(slot);
+        }
+        return nullptr;
+    }
+
+    size_t size() const { return count.load(std::memory_order_relaxed); }
+    size_t mismatch_count() const { return mismatches.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> key{0};   // 0 marks an empty slot
+        std::atomic<bool> ready{false};
+        SecurityRecord record;
+    };
+
+    // Packs the 9 characters into 6 bits each. The top bit is always set so a
+    // valid key is never 0. Returns 0 for anything that isn't a CUSIP.
+    static uint64_t pack(std::string_view cusip) {
+        if (cusip.size() != 9) return 0;
+        uint64_t key = 1ull << 63;
+        for (size_t i = 0; i < 9; ++i) {
+            char c = cusip[i];
+            uint64_t v;
+            if (c >= '0' && c <= '9') v = static_cast<uint64_t>(c - '0');
+            else if (c >= 'A' && c <= 'Z') v = static_cast<uint64_t>(c - 'A' + 10);
+            else if (c == '*') v = 36;
+            else if (c == '@') v = 37;
+            else if (c == '#') v = 38;
+            else return 0;
+            key |= v << (6 * i);
+        }
+        return key;
+    }
+
+    static size_t round_up(size_t capacity) {
+        size_t cap = 16;
+        while (cap < capacity) cap <<= 1;
+        return cap;
+    }
+
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xFF51AFD7ED558CCDull;
+        x ^= x >> 33;
+        return x;
+    }
+
+    // The slot was claimed, but the record may still be mid-write on another
+    // thread. That window is a couple of stores, so spinning is fine.
+    static const SecurityRecord& wait_ready(const Slot& slot) {
+        while (!slot.ready.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        return slot.record;
+    }
+
+    std::vector<Slot> slots;
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> mismatches{0};
+};
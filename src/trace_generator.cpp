@@ -0,0 +1,213 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "command_line.h"
+#include "trace_generator.h"
+
+// ----------------------
+// Synthetic TRACE feeds
+// ----------------------
+// fake_trace_generator.py's feed at pipeline speeds: each feed is a thread
+// serving one client on its own port (port, port + 1, ...), re-accepting
+// when the client goes away, like the script. Trades are generated and
+// written in batches of about 64 KB, so a feed isn't limited by sleeping or
+// by a send per message.
+//
+//   trace_generator --feeds 4 --port 5555 --rate 0       # As fast as the reader takes them
+//   trace_generator --rate 50000 --pairs --burst 100000 --burst-interval 10
+//   trace_generator --count 1000000 --out-file trades.jsonl
+namespace {
+
+struct GeneratorArgs {
+    size_t feeds = 1;
+    std::string host = "127.0.0.1";
+    int port = 5555;
+    double rate = 1.0;            // Per feed per second; 0 for no limit
+    double rate_jitter = 0.0;
+    bool pairs = false;
+    double pair_prob = 0.3;
+    size_t burst = 0;
+    long burst_interval = 60;
+    uint64_t count = 0;           // Per feed; 0 for no limit
+    uint64_t seed = 0;
+    std::string out_file;         // Write here instead of serving TCP; - for stdout
+};
+
+const char* usage() {
+    return "Options:\n"
+           "  --feeds N                feeds to serve, on ports PORT to PORT+N-1\n"
+           "  --host IP                address to listen on (default 127.0.0.1)\n"
+           "  --port N                 first feed's port (default 5555)\n"
+           "  --rate N                 messages per second per feed; 0 for as fast as possible\n"
+           "  --rate-jitter F          vary the rate by up to this fraction (0.0-1.0)\n"
+           "  --pairs                  emit both legs of some trades\n"
+           "  --pair-prob F            probability of a paired trade (default 0.3)\n"
+           "  --burst N                extra messages in each burst\n"
+           "  --burst-interval S       seconds between bursts (default 60)\n"
+           "  --count N                stop each feed after N messages\n"
+           "  --seed N                 random seed, for repeatable feeds\n"
+           "  --out-file FILE          write one feed's messages to FILE (- for stdout) instead of serving TCP\n"
+           "  --help                   show this message\n";
+}
+
+bool parse_args(int argc, char** argv, GeneratorArgs& args, bool& help, std::string& error) {
+    auto on_switch = [&](std::string_view flag) {
+        if (flag != "--pairs") return false;
+        args.pairs = true;
+        return true;
+    };
+    auto on_value = [&](std::string_view flag, std::string_view value, bool& ok) {
+        if (flag == "--feeds") ok = parse_count(value, args.feeds) && args.feeds > 0;
+        else if (flag == "--host") args.host.assign(value);
+        else if (flag == "--port") ok = parse_count(value, args.port) && args.port > 0 && args.port < 65536;
+        else if (flag == "--rate") ok = parse_number(value, args.rate);
+        else if (flag == "--rate-jitter") ok = parse_number(value, args.rate_jitter) && args.rate_jitter <= 1.0;
+        else if (flag == "--pair-prob") ok = parse_number(value, args.pair_prob) && args.pair_prob <= 1.0;
+        else if (flag == "--burst") ok = parse_count(value, args.burst);
+        else if (flag == "--burst-interval") ok = parse_count(value, args.burst_interval) && args.burst_interval > 0;
+        else if (flag == "--count") ok = parse_count(value, args.count);
+        else if (flag == "--seed") ok = parse_count(value, args.seed);
+        else if (flag == "--out-file") args.out_file.assign(value);
+        else return false;
+        return true;
+    };
+    if (!parse_flags(argc, argv, help, error, on_switch, on_value)) return false;
+    if (args.port + static_cast<int>(args.feeds) - 1 > 65535) error = "feed ports run past 65535";
+    return error.empty();
+}
+
+std::atomic<uint64_t> totalSent{0};
+
+RatePacer make_pacer(const GeneratorArgs& args, uint64_t seed) {
+    return RatePacer(args.rate, args.rate_jitter, args.burst, std::chrono::seconds(args.burst_interval), seed);
+}
+
+TraceGeneratorOptions generator_options(const GeneratorArgs& args, size_t feed) {
+    TraceGeneratorOptions options;
+    options.pair_prob = args.pairs ? args.pair_prob : 0.0;
+    options.seed = args.seed ? args.seed + feed : 0;
+    return options;
+}
+
+void serve_feed(const GeneratorArgs& args, size_t feed) {
+    std::string name = "Feed " + std::to_string(feed);
+    pthread_setname_np(pthread_self(), name.c_str());
+    int port = args.port + static_cast<int>(feed);
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    if (inet_pton(AF_INET, args.host.c_str(), &addr.sin_addr) != 1 || listen_fd < 0 ||
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+        bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listen_fd, 1) < 0) {
+        std::cerr << "[TRACE FEED] Can't listen on " << args.host << ":" << port << ": " << std::strerror(errno)
+                  << std::endl;
+        std::exit(1);
+    }
+    std::cerr << "[TRACE FEED] Starting TCP server on " << args.host << ":" << port << std::endl;
+
+    TraceGenerator generator(generator_options(args, feed));
+    RatePacer pacer = make_pacer(args, args.seed + feed + 1);
+    uint64_t sent = 0;
+    while (args.count == 0 || sent < args.count) {
+        int client = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            if (errno != EINTR) std::cerr << "[TRACE FEED] Accept failed: " << std::strerror(errno) << std::endl;
+            continue;
+        }
+        std::cerr << "[TRACE FEED] Client connected on port " << port << std::endl;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        auto keep_going = [] { return true; };
+        auto write = [&](const std::string& lines, size_t n) {
+            totalSent.fetch_add(n, std::memory_order_relaxed);
+            return send_all(client, lines);
+        };
+        if (!write_trade_lines(generator, pacer, sent, args.count, keep_going, write)) {
+            std::cerr << "[TRACE FEED] Client disconnected from port " << port << std::endl;
+        }
+        ::close(client);
+    }
+    ::close(listen_fd);
+}
+
+void write_file(const GeneratorArgs& args) {
+    FILE* out = args.out_file == "-" ? stdout : std::fopen(args.out_file.c_str(), "w");
+    if (!out) {
+        std::cerr << "[TRACE FEED] Can't open " << args.out_file << ": " << std::strerror(errno) << std::endl;
+        std::exit(1);
+    }
+    TraceGenerator generator(generator_options(args, 0));
+    RatePacer pacer = make_pacer(args, args.seed + 1);
+    uint64_t sent = 0;
+    auto write = [&](const std::string& lines, size_t n) {
+        totalSent.fetch_add(n, std::memory_order_relaxed);
+        return std::fwrite(lines.data(), 1, lines.size(), out) == lines.size() &&
+               (!pacer.limited() || std::fflush(out) == 0);
+    };
+    write_trade_lines(generator, pacer, sent, args.count, [] { return true; }, write);
+    if (out != stdout) std::fclose(out);
+    else std::fflush(out);
+}
+
+}   // namespace
+
+int main(int argc, char** argv) {
+    GeneratorArgs args;
+    bool help = false;
+    std::string error;
+    if (!parse_args(argc, argv, args, help, error)) {
+        std::cerr << argv[0] << ": " << error << "\n\n" << usage();
+        return 2;
+    }
+    if (help) {
+        std::cout << "Usage: " << argv[0] << " [options]\n\n" << usage();
+        return 0;
+    }
+
+    std::cerr << "[TRACE FEED] Generating ";
+    if (args.rate > 0) std::cerr << args.rate;
+    else std::cerr << "unlimited";
+    std::cerr << " msg/sec per feed | Feeds=" << (args.out_file.empty() ? std::to_string(args.feeds) : "file")
+              << " | Pairs=" << (args.pairs ? "on" : "off") << " | Burst=" << args.burst << " every "
+              << args.burst_interval << "s | PairProb=" << args.pair_prob << " | RateJitter=" << args.rate_jitter
+              << std::endl;
+
+    std::atomic<bool> done{false};
+    std::thread reporter([&]() {
+        pthread_setname_np(pthread_self(), "Reporter");
+        uint64_t last = 0;
+        while (!done.load()) {
+            for (int i = 0; i < 10 && !done.load(); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            uint64_t now = totalSent.load(std::memory_order_relaxed);
+            if (now != last) std::cerr << "[TRACE FEED] " << (now - last) << " msg/s, " << now << " sent" << std::endl;
+            last = now;
+        }
+    });
+
+    if (!args.out_file.empty()) write_file(args);
+    else {
+        std::vector<std::thread> feeds;
+        for (size_t i = 0; i < args.feeds; ++i) feeds.emplace_back(serve_feed, std::cref(args), i);
+        for (auto& t : feeds) t.join();
+    }
+    done = true;
+    reporter.join();
+    std::cerr << "[TRACE FEED] Done, " << totalSent.load() << " messages" << std::endl;
+    return 0;
+}
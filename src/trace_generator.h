@@ -0,0 +1,430 @@
+#pragma once
+#include <sys/socket.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "security_master.h"
+#include "trade.h"
+
+// ---------------------
+// Synthetic TRACE feed
+// ---------------------
+// The trades fake_trace_generator.py's make_trade() produces, fast enough
+// to saturate the pipeline: each leg has a fresh CUSIP with a valid check
+// digit, a random issuer from the same list, an exec_time up to 10 minutes
+// back and a report_time up to 30 minutes after it, with modifier3 "Z" when
+// the report is more than 15 minutes late. With pairs on, a trade gets a
+// second leg with the same control_id, CUSIP and exec_time, the other side
+// and another dealer, sent 100-500 ms later like the script's.
+//
+// Trades are built straight into a Trade, so they can be queued without
+// parsing for in-process benchmarks, or written out as the JSON lines the
+// feed sends with append_trade_json().
+
+namespace trace_generator_detail {
+
+constexpr const char* issuers[] = {
+    "3M", "Amgen", "Apple", "American Express", "Boeing", "Caterpillar",
+    "Chevron", "Cisco Systems", "Coca-Cola", "Disney", "Dow Inc.", "Goldman Sachs",
+    "Home Depot", "Honeywell", "IBM", "Intel", "Johnson & Johnson", "JPMorgan Chase",
+    "Merck", "Microsoft", "Nike", "Procter & Gamble", "Salesforce",
+    "Travelers", "Verizon", "Visa", "Walgreens Boots Alliance", "Walmart"};
+constexpr size_t issuer_count = sizeof(issuers) / sizeof(issuers[0]);
+
+constexpr char id_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+constexpr int64_t on_time_seconds = 15 * 60;
+
+// Year, month and day of a day count since 1970-01-01 (Howard Hinnant's
+// civil_from_days), so formatting needs no gmtime() call or lock.
+inline void civil_from_days(int64_t days, int& year, unsigned& month, unsigned& day) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    auto doe = static_cast<unsigned>(days - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = static_cast<int>(yoe) + static_cast<int>(era) * 400 + (month <= 2);
+}
+
+inline char* put_digits(char* p, uint64_t v, int width) {
+    for (int i = width - 1; i >= 0; --i) {
+        p[i] = static_cast<char>('0' + v % 10);
+        v /= 10;
+    }
+    return p + width;
+}
+
+inline char* put_date(char* p, int64_t days) {
+    int year;
+    unsigned month, day;
+    civil_from_days(days, year, month, day);
+    p = put_digits(p, static_cast<uint64_t>(year), 4);
+    *p++ = '-';
+    p = put_digits(p, month, 2);
+    *p++ = '-';
+    return put_digits(p, day, 2);
+}
+
+// "2025-01-31T14:05:09.123456Z", as Python's isoformat() with +00:00 as Z
+template<size_t N>
+void assign_iso_time(FixedString<N>& out, int64_t epoch_us) {
+    int64_t seconds = epoch_us >= 0 ? epoch_us / 1000000 : (epoch_us - 999999) / 1000000;
+    int64_t days = seconds >= 0 ? seconds / 86400 : (seconds - 86399) / 86400;
+    auto second_of_day = static_cast<uint64_t>(seconds - days * 86400);
+    auto micros = static_cast<uint64_t>(epoch_us - seconds * 1000000);
+    char buf[32];
+    char* p = put_date(buf, days);
+    *p++ = 'T';
+    p = put_digits(p, second_of_day / 3600, 2);
+    *p++ = ':';
+    p = put_digits(p, second_of_day / 60 % 60, 2);
+    *p++ = ':';
+    p = put_digits(p, second_of_day % 60, 2);
+    if (micros != 0) {
+        *p++ = '.';
+        p = put_digits(p, micros, 6);
+    }
+    *p++ = 'Z';
+    out.assign(std::string_view(buf, static_cast<size_t>(p - buf)));
+}
+
+// A decimal with at most `places` places, as Python prints round(x, places):
+// 101.25, 100.0
+inline void append_decimal(std::string& out, double value, int places) {
+    uint64_t scale = 1;
+    for (int i = 0; i < places; ++i) scale *= 10;
+    auto fixed = static_cast<uint64_t>(std::llround(std::fabs(value) * static_cast<double>(scale)));
+    if (value < 0) out += '-';
+    out += std::to_string(fixed / scale);
+    out += '.';
+    uint64_t frac = fixed % scale;
+    char digits[20];
+    put_digits(digits, frac, places);
+    int n = places;
+    while (n > 1 && digits[n - 1] == '0') --n;
+    out.append(digits, static_cast<size_t>(n));
+}
+
+inline void append_json_string(std::string& out, std::string_view s) {
+    out += '"';
+    size_t start = 0;
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] != '"' && s[i] != '\\') continue;
+        out.append(s.substr(start, i - start));
+        out += '\\';
+        start = i;
+    }
+    out.append(s.substr(start));
+    out += '"';
+}
+
+}   // namespace trace_generator_detail
+
+struct TraceGeneratorOptions {
+    double pair_prob = 0.0;   // Chance a trade also gets its second leg
+    std::chrono::milliseconds pair_delay_min{100};
+    std::chrono::milliseconds pair_delay_max{500};
+    uint64_t seed = 0;        // 0 for a random seed
+};
+
+class TraceGenerator {
+public:
+    using Clock = std::chrono::system_clock;
+
+    explicit TraceGenerator(TraceGeneratorOptions options = {})
+        : options(options), state(options.seed ? options.seed : std::random_device{}()) {}
+
+    // The next leg to send at `now`: a paired leg that has come due, or a
+    // new trade.
+    void next(Trade& trade, Clock::time_point now = Clock::now()) {
+        int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
+        if (!pending.empty() && pending.top().due_us <= now_us) {
+            trade = pending.top().trade;
+            pending.pop();
+            return;
+        }
+        make_trade(trade, now_us);
+        if (options.pair_prob > 0 && uniform() < options.pair_prob) {
+            PendingLeg leg;
+            make_pair_leg(trade, leg.trade, now_us);
+            leg.due_us = now_us + between(options.pair_delay_min.count(), options.pair_delay_max.count()) * 1000;
+            pending.push(leg);
+        }
+    }
+
+    // Second legs generated but not yet due
+    size_t pending_legs() const { return pending.size(); }
+
+    // A fresh CUSIP: 8 random letters and digits and their check digit
+    void random_cusip(FixedString<12>& cusip) {
+        char buf[9];
+        random_id(buf, 8);
+        buf[8] = static_cast<char>('0' + cusip_check_digit_scalar(std::string_view(buf, 8)));
+        cusip.assign(std::string_view(buf, 9));
+    }
+
+private:
+    struct PendingLeg {
+        int64_t due_us = 0;
+        Trade trade;
+        bool operator<(const PendingLeg& other) const { return due_us > other.due_us; }   // Soonest first
+    };
+
+    // splitmix64: plenty random for test data, and a few cycles per number
+    uint64_t next_random() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in [0, n), by multiplying rather than dividing (Lemire), for n
+    // well under 2^32
+    uint64_t below(uint64_t n) { return ((next_random() >> 32) * n) >> 32; }
+
+    // Uniform in [lo, hi]
+    int64_t between(int64_t lo, int64_t hi) {
+        return lo + static_cast<int64_t>(below(static_cast<uint64_t>(hi - lo + 1)));
+    }
+
+    double uniform() { return static_cast<double>(next_random() >> 11) * 0x1.0p-53; }
+
+    void random_id(char* out, size_t n) {
+        for (size_t i = 0; i < n; ++i) out[i] = trace_generator_detail::id_chars[below(36)];
+    }
+
+    void make_trade(Trade& t, int64_t now_us) {
+        using namespace trace_generator_detail;
+        t = Trade();
+        char id[10];
+        random_id(id, sizeof(id));
+        t.control_id.assign(std::string_view(id, sizeof(id)));
+        random_cusip(t.cusip);
+        t.side.assign(next_random() & 1 ? "SELL" : "BUY");
+        t.dealer_id = static_cast<int32_t>(between(1000, 9999));
+        first_exec_us = now_us - between(0, 600) * 1000000;
+        fill_leg(t, first_exec_us, now_us);
+    }
+
+    // The other side of `first`, the trade just made, as make_trade(cusip=,
+    // exec_time=, pair_id=, side=, dealer_id=) builds it
+    void make_pair_leg(const Trade& first, Trade& t, int64_t now_us) {
+        t = Trade();
+        t.control_id = first.control_id;
+        t.cusip = first.cusip;
+        t.side.assign(first.side.view() == "SELL" ? "BUY" : "SELL");
+        t.dealer_id = static_cast<int32_t>(between(1000, 9999));
+        fill_leg(t, first_exec_us, now_us);
+    }
+
+    // Everything make_trade() draws for each leg
+    void fill_leg(Trade& t, int64_t exec_us, int64_t now_us) {
+        using namespace trace_generator_detail;
+        int64_t delay = between(0, 1800);
+        t.issuer.assign(issuers[below(issuer_count)]);
+        assign_iso_time(t.exec_time, exec_us);
+        assign_iso_time(t.report_time, exec_us + delay * 1000000);
+        t.modifier3.assign(delay > on_time_seconds ? "Z" : "");
+        t.price = static_cast<double>(between(90000, 110000)) / 1000;
+        t.volume = between(100000, 5000000);
+        t.reporting_capacity.assign(next_random() & 1 ? "A" : "P");
+        t.coupon = static_cast<double>(between(100, 600)) / 100;
+        char date[10];
+        int64_t today = (now_us >= 0 ? now_us : now_us - 86399999999) / 86400000000;
+        put_date(date, today + between(365, 3650));
+        t.maturity.assign(std::string_view(date, sizeof(date)));
+        t.has_price = t.has_volume = t.has_dealer_id = t.has_coupon = true;
+    }
+
+    TraceGeneratorOptions options;
+    uint64_t state;
+    std::priority_queue<PendingLeg> pending;
+    int64_t first_exec_us = 0;   // exec_time of the last new trade, for its pair leg
+};
+
+// Appends `t` as one feed line, without the newline, with the keys in
+// make_trade()'s order and Python's json.dumps() spacing.
+inline void append_trade_json(std::string& out, const Trade& t) {
+    using namespace trace_generator_detail;
+    out += "{\"control_id\": ";
+    append_json_string(out, t.control_id.view());
+    out += ", \"cusip\": ";
+    append_json_string(out, t.cusip.view());
+    out += ", \"issuer\": ";
+    append_json_string(out, t.issuer.view());
+    out += ", \"exec_time\": ";
+    append_json_string(out, t.exec_time.view());
+    out += ", \"report_time\": ";
+    append_json_string(out, t.report_time.view());
+    out += ", \"price\": ";
+    append_decimal(out, t.price, 3);
+    out += ", \"volume\": ";
+    out += std::to_string(t.volume);
+    out += ", \"side\": ";
+    append_json_string(out, t.side.view());
+    out += ", \"dealer_id\": ";
+    out += std::to_string(t.dealer_id);
+    out += ", \"reporting_capacity\": ";
+    append_json_string(out, t.reporting_capacity.view());
+    out += ", \"modifier3\": ";
+    append_json_string(out, t.modifier3.view());
+    out += ", \"coupon\": ";
+    append_decimal(out, t.coupon, 2);
+    out += ", \"maturity\": ";
+    append_json_string(out, t.maturity.view());
+    out += '}';
+}
+
+// ----------
+// Rate pacer
+// ----------
+// Says how many messages may go out now to hold `rate` per second, with the
+// script's options: each interval's rate varied by up to +/- `jitter` (a
+// fraction) and a burst of `burst` extra messages every `burst_interval`.
+// Sending is done in batches, since sleeping between single messages can't
+// reach millions per second. A rate of 0 means as fast as possible.
+//
+// A sender that falls behind (its socket blocked) catches up by at most
+// a tenth of a second's worth, plus any burst, instead of flooding.
+class RatePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    RatePacer(double rate, double jitter = 0.0, size_t burst = 0,
+              std::chrono::seconds burst_interval = std::chrono::seconds(60), uint64_t seed = 1)
+        : rate(rate), jitter(std::clamp(jitter, 0.0, 1.0)), burst(burst), burst_interval(burst_interval),
+          random(seed), last(Clock::now()), last_burst(last) {}
+
+    // Messages that may be sent now, waiting until there is at least one
+    // but never more than `max_batch`.
+    size_t wait(size_t max_batch = 4096) {
+        if (!limited()) return max_batch;
+        while (true) {
+            size_t n = take(Clock::now(), max_batch);
+            if (n > 0) return n;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+
+    // Non-blocking form of wait() for a given time, for tests
+    size_t take(Clock::time_point now, size_t max_batch = 4096) {
+        if (!limited()) return max_batch;
+        double seconds = std::chrono::duration<double>(now - last).count();
+        last = now;
+        if (seconds > 0) {
+            double factor = 1.0;
+            if (jitter > 0) factor += std::uniform_real_distribution<double>(-jitter, jitter)(random);
+            credit = std::min(credit + rate * factor * seconds, rate * 0.1 + static_cast<double>(burst) + 1);
+        }
+        if (burst > 0 && now - last_burst >= burst_interval) {
+            credit += static_cast<double>(burst);
+            last_burst = now;
+        }
+        auto n = static_cast<size_t>(std::min(credit, static_cast<double>(max_batch)));
+        credit -= static_cast<double>(n);
+        return n;
+    }
+
+    bool limited() const { return rate > 0; }
+
+private:
+    double rate;
+    double jitter;
+    size_t burst;
+    std::chrono::seconds burst_interval;
+    std::mt19937_64 random;
+    Clock::time_point last;
+    Clock::time_point last_burst;
+    double credit = 0;
+};
+
+// -----------------
+// Feed line batches
+// -----------------
+// Generates feed lines at the pacer's rate and hands them to
+// `write(lines, n)` about 64 KB at a time, or after every pacer batch when
+// the rate is limited so a slow feed isn't held back. Stops once `sent`
+// reaches `count` (0 for no limit) or keep_going() returns false. Returns
+// false if a write failed.
+template<typename KeepGoing, typename Write>
+bool write_trade_lines(TraceGenerator& generator, RatePacer& pacer, uint64_t& sent, uint64_t count,
+                       KeepGoing keep_going, Write write) {
+    constexpr size_t batch_bytes = 64 * 1024;
+    std::string buffer;
+    buffer.reserve(batch_bytes + 1024);
+    size_t lines = 0;
+    Trade trade;
+    while ((count == 0 || sent < count) && keep_going()) {
+        size_t n = pacer.wait(256);
+        if (count) n = static_cast<size_t>(std::min<uint64_t>(n, count - sent));
+        auto now = TraceGenerator::Clock::now();
+        for (size_t i = 0; i < n; ++i) {
+            generator.next(trade, now);
+            append_trade_json(buffer, trade);
+            buffer += '\n';
+        }
+        sent += n;
+        lines += n;
+        if (buffer.size() >= batch_bytes || pacer.limited()) {
+            if (!write(buffer, lines)) return false;
+            buffer.clear();
+            lines = 0;
+        }
+    }
+    return lines == 0 || write(buffer, lines);
+}
+
+// Writes all of `data` to a connected socket, for write_trade_lines()
+// writers feeding over TCP. Returns false once the peer has gone.
+inline bool send_all(int fd, const std::string& data) {
+    const char* p = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+        ssize_t n = ::send(fd, p, left, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// ------------------
+// In-process feeding
+// ------------------
+// Generates `count` trades (0 for no limit) at the pacer's rate straight
+// into `queue`, for benchmarks that skip sockets and parsing. `stamp`, if
+// given, is called on each trade just before it's queued. Waits while the
+// queue is full, and stops early when `keep_going()` returns false.
+template<typename Queue, typename KeepGoing, typename Stamp = void (*)(Trade&)>
+uint64_t inject_trades(TraceGenerator& generator, RatePacer& pacer, Queue& queue, uint64_t count,
+                       KeepGoing keep_going, Stamp stamp = [](Trade&) {}) {
+    uint64_t sent = 0;
+    Trade trade;
+    while ((count == 0 || sent < count) && keep_going()) {
+        size_t batch = pacer.wait();
+        if (count) batch = static_cast<size_t>(std::min<uint64_t>(batch, count - sent));
+        auto now = TraceGenerator::Clock::now();
+        for (size_t i = 0; i < batch; ++i) {
+            generator.next(trade, now);
+            stamp(trade);
+            while (!queue.enqueue(trade)) {
+                if (!keep_going()) return sent;
+                std::this_thread::yield();
+            }
+            ++sent;
+        }
+    }
+    return sent;
+}
@@ -0,0 +1,146 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <nlohmann/json.hpp>
+
+// Fixed-capacity string stored inline. Trades are copied through the queue
+// by value, so a string field is a length byte and a small buffer instead
+// of a heap allocation.
+template<size_t N>
+struct FixedString {
+    static_assert(N < 256, "length is stored in one byte");
+
+    char chars[N] = {};
+    uint8_t length = 0;
+
+    // Returns false (leaving the string unchanged) if `s` doesn't fit.
+    bool assign(std::string_view s) {
+        if (s.size() > N) return false;
+        if (!s.empty()) std::memcpy(chars, s.data(), s.size());
+        length = static_cast<uint8_t>(s.size());
+        return true;
+    }
+
+    std::string_view view() const { return std::string_view(chars, length); }
+    bool empty() const { return length == 0; }
+    static constexpr size_t capacity() { return N; }
+};
+
+// When a trade passed each point of the pipeline, in TscClock ticks. 0 is
+// "not stamped", as for trades replayed from the journal. Stamps are never
+// written to the database or the journal.
+struct TradeStamps {
+    uint64_t received = 0;   // Its line came off the socket
+    uint64_t parsed = 0;
+    uint64_t enqueued = 0;   // Into the trade queue, after enrichment
+    uint64_t dequeued = 0;   // Taken by a consumer
+};
+
+// One TRACE trade leg, as it travels from the producers to the database.
+//
+// Strings are fixed-size and inline so a Trade is trivially copyable and
+// never touches the allocator after parsing. Empty strings are stored as
+// '' like the feed sends them. Numeric fields that were missing are NULL in
+// the database, tracked by the has_* flags.
+struct Trade {
+    FixedString<16> control_id;
+    FixedString<12> cusip;
+    FixedString<64> issuer;
+    FixedString<16> rating;
+    FixedString<48> industry;
+    FixedString<32> exec_time;     // ISO-8601 as sent by the feed
+    FixedString<32> report_time;
+    FixedString<10> maturity;      // YYYY-MM-DD
+    FixedString<4> modifier3;
+    FixedString<4> side;
+    FixedString<4> reporting_capacity;
+
+    double coupon = 0;
+    double price = 0;
+    int64_t volume = 0;
+    int32_t dealer_id = 0;
+
+    bool has_coupon = false;
+    bool has_price = false;
+    bool has_volume = false;
+    bool has_dealer_id = false;
+
+    TradeStamps stamps;   // Kept last; see TRADE_RECORD_BYTES
+};
+
+// Bytes of a Trade that make up the trade itself, without its stamps
+constexpr size_t TRADE_RECORD_BYTES = offsetof(Trade, stamps);
+
+// Column list shared by every statement that writes trades, in the order
+// the sinks send values.
+constexpr const char* TRADE_COLUMNS =
+    "control_id, coupon, cusip, dealer_id, exec_time, industry, issuer, maturity, "
+    "modifier3, price, rating, report_time, reporting_capacity, side, volume";
+
+constexpr size_t TRADE_COLUMN_COUNT = 15;
+
+namespace trade_detail {
+
+template<size_t N>
+bool read_string(const nlohmann::json& msg, const char* field, FixedString<N>& out, std::string& error) {
+    auto it = msg.find(field);
+    if (it == msg.end() || it->is_null()) return true;
+    if (!it->is_string() || !out.assign(it->get_ref<const std::string&>())) {
+        error = std::string("bad ") + field;
+        return false;
+    }
+    return true;
+}
+
+template<typename T>
+bool read_number(const nlohmann::json& msg, const char* field, T& out, bool& present, std::string& error) {
+    auto it = msg.find(field);
+    if (it == msg.end() || it->is_null()) return true;
+    if (!it->is_number()) {
+        error = std::string("bad ") + field;
+        return false;
+    }
+    out = it->get<T>();
+    present = true;
+    return true;
+}
+
+}   // namespace trade_detail
+
+// Converts a parsed feed message. Returns false (with the offending field
+// in `error`) if a field has the wrong type or doesn't fit.
+inline bool trade_from_json(const nlohmann::json& msg, Trade& trade, std::string& error) {
+    using namespace trade_detail;
+    if (!msg.is_object()) {
+        error = "not an object";
+        return false;
+    }
+    return read_string(msg, "control_id", trade.control_id, error) &&
+           read_string(msg, "cusip", trade.cusip, error) &&
+           read_string(msg, "issuer", trade.issuer, error) &&
+           read_string(msg, "rating", trade.rating, error) &&
+           read_string(msg, "industry", trade.industry, error) &&
+           read_string(msg, "exec_time", trade.exec_time, error) &&
+           read_string(msg, "report_time", trade.report_time, error) &&
+           read_string(msg, "maturity", trade.maturity, error) &&
+           read_string(msg, "modifier3", trade.modifier3, error) &&
+           read_string(msg, "side", trade.side, error) &&
+           read_string(msg, "reporting_capacity", trade.reporting_capacity, error) &&
+           read_number(msg, "coupon", trade.coupon, trade.has_coupon, error) &&
+           read_number(msg, "price", trade.price, trade.has_price, error) &&
+           read_number(msg, "volume", trade.volume, trade.has_volume, error) &&
+           read_number(msg, "dealer_id", trade.dealer_id, trade.has_dealer_id, error);
+}
+
+// Compact one-line rendering for logs.
+inline std::ostream& operator<<(std::ostream& os, const Trade& t) {
+    os << "{control_id=" << t.control_id.view() << " cusip=" << t.cusip.view()
+       << " issuer=" << t.issuer.view() << " side=" << t.side.view();
+    if (t.has_price) os << " price=" << t.price;
+    if (t.has_volume) os << " volume=" << t.volume;
+    return os << " exec_time=" << t.exec_time.view() << "}";
+}
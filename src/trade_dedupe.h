@@ -0,0 +1,180 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include "flat_string_map.h"
+#include "trade.h"
+
+// Identity of one trade leg. Paired legs share control_id, so side and
+// dealer_id tell them apart.
+struct DedupeKey {
+    char control_id[16];
+    char side[4];
+    int32_t dealer_id;
+    uint8_t control_length;
+    uint8_t side_length;
+    uint8_t reserved[2];   // Zeroed, so there are no padding bytes to hash
+
+    static DedupeKey from(const Trade& t) {
+        DedupeKey k{};
+        std::memcpy(k.control_id, t.control_id.chars, t.control_id.length);
+        std::memcpy(k.side, t.side.chars, t.side.length);
+        k.control_length = t.control_id.length;
+        k.side_length = t.side.length;
+        k.dealer_id = t.has_dealer_id ? t.dealer_id : -1;
+        return k;
+    }
+
+    bool operator==(const DedupeKey& o) const { return std::memcmp(this, &o, sizeof(DedupeKey)) == 0; }
+
+    uint64_t hash() const {
+        return hash_string(std::string_view(reinterpret_cast<const char*>(this), sizeof(DedupeKey)));
+    }
+};
+
+static_assert(sizeof(DedupeKey) == 28, "DedupeKey is hashed and compared as bytes, so it must have no padding");
+
+// --------------------------------------------
+// Time-windowed duplicate filter for trades
+// --------------------------------------------
+// Reconnects and redundant feeds deliver some trades twice. first_seen()
+// returns false for a trade whose control_id, side and dealer_id were
+// already seen within the window, so the duplicate never costs a queue slot
+// or a database write.
+//
+// Keys are kept exactly (no false positives) in open-addressing sets, split
+// over shards by hash so producers rarely contend on one lock. Each shard
+// has two generations. New keys go into the current one, lookups check
+// both, and every window / 2 the older generation is dropped. A key is
+// therefore remembered for between window / 2 and window after it was
+// last inserted.
+//
+// Trades without a control_id aren't deduplicated.
+class TradeDedupe {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit TradeDedupe(Clock::duration window, size_t expected_per_generation = 1 << 14)
+        : half_window(std::max<Clock::duration>(window / 2, std::chrono::milliseconds(1))) {
+        for (auto& shard : shards) {
+            shard.current.reserve(expected_per_generation / shard_count);
+            shard.previous.reserve(expected_per_generation / shard_count);
+        }
+    }
+
+    TradeDedupe(const TradeDedupe&) = delete;
+    TradeDedupe& operator=(const TradeDedupe&) = delete;
+
+    // Returns true the first time a trade is seen within the window and
+    // records it. Safe to call from any number of threads.
+    bool first_seen(const Trade& trade, Clock::time_point now = Clock::now()) {
+        if (trade.control_id.empty()) return true;
+
+        DedupeKey key = DedupeKey::from(trade);
+        uint64_t h = key.hash() | (1ull << 63);   // 0 marks an empty slot
+        Shard& shard = shards[(h >> 58) % shard_count];
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (now - shard.rotated_at >= 2 * half_window) {
+            // Idle for a whole window (or first use): nothing is recent
+            shard.current.clear();
+            shard.previous.clear();
+            shard.rotated_at = now;
+        }
+        else if (now - shard.rotated_at >= half_window) {
+            std::swap(shard.previous, shard.current);
+            shard.current.clear();
+            shard.rotated_at += half_window;
+        }
+
+        if (shard.current.contains(h, key) || shard.previous.contains(h, key)) {
+            duplicates.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        shard.current.insert(h, key);
+        return true;
+    }
+
+    uint64_t duplicate_count() const { return duplicates.load(std::memory_order_relaxed); }
+
+private:
+    // Insert-only open-addressing set, cleared wholesale on rotation.
+    class KeySet {
+    public:
+        void reserve(size_t count) {
+            size_t capacity = 16;
+            while (capacity < count * 2) capacity <<= 1;
+            if (capacity > slots.size()) rehash(capacity);
+        }
+
+        bool contains(uint64_t h, const DedupeKey& key) const {
+            if (slots.empty()) return false;
+            size_t mask = slots.size() - 1;
+            for (size_t i = h & mask;; i = (i + 1) & mask) {
+                const Slot& s = slots[i];
+                if (s.hash == 0) return false;
+                if (s.hash == h && s.key == key) return true;
+            }
+        }
+
+        void insert(uint64_t h, const DedupeKey& key) {
+            if ((count + 1) * 2 > slots.size()) rehash(slots.empty() ? 16 : slots.size() * 2);
+            place(h, key);
+            ++count;
+        }
+
+        // Keeps the table's capacity, since the next generation is likely
+        // to need the same room.
+        void clear() {
+            if (count == 0) return;
+            for (Slot& s : slots) s.hash = 0;
+            count = 0;
+        }
+
+        size_t size() const { return count; }
+
+    private:
+        struct Slot {
+            uint64_t hash = 0;
+            DedupeKey key;
+        };
+
+        void place(uint64_t h, const DedupeKey& key) {
+            size_t mask = slots.size() - 1;
+            size_t i = h & mask;
+            while (slots[i].hash != 0) i = (i + 1) & mask;
+            slots[i].hash = h;
+            slots[i].key = key;
+        }
+
+        void rehash(size_t capacity) {
+            std::vector<Slot> old(capacity);
+            old.swap(slots);
+            for (const Slot& s : old) {
+                if (s.hash != 0) place(s.hash, s.key);
+            }
+        }
+
+        std::vector<Slot> slots;
+        size_t count = 0;
+    };
+
+    static constexpr size_t shard_count = 16;
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        KeySet current;
+        KeySet previous;
+        Clock::time_point rotated_at{};
+    };
+
+    Clock::duration half_window;
+    Shard shards[shard_count];
+    std::atomic<uint64_t> duplicates{0};
+};
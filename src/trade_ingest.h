@@ -0,0 +1,316 @@
+#pragma once
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "async_logger.h"
+#include "backpressure.h"
+#include "issuer_table.h"
+#include "latency_histogram.h"
+#include "metrics.h"
+#include "pipeline_stage.h"
+#include "rcu_snapshot.h"
+#include "security_master.h"
+#include "trade.h"
+#include "trade_dedupe.h"
+
+// ---------------
+// Ingest counters
+// ---------------
+// Counted on whichever thread does the work, into that thread's own block
+// (ThreadCounters), and only summed when read. Feed counters are indexed
+// feed * FEED_COUNTERS + counter, with feeds numbered from 0.
+enum FeedCounter : size_t {
+    FEED_MESSAGES,      // Lines read
+    FEED_BYTES,
+    FEED_ERRORS,        // Lines that weren't a usable trade
+    FEED_ENRICH_MISSES, // Trades whose issuer wasn't in the issuer table
+    FEED_DUPLICATES,    // Trades dropped as already queued
+    FEED_COUNTERS
+};
+
+enum IngestCounter : size_t {
+    QUEUE_FULL,         // Enqueues that found the trade queue full and waited
+    INGEST_COUNTERS
+};
+
+// A feed line copied into a fixed-size slot, so stage queues don't allocate
+struct FeedLine {
+    static constexpr size_t max_length = 1008;
+
+    int producer = 0;
+    uint32_t length = 0;
+    uint64_t received = 0;   // TscClock stamp of the read it came from
+    char text[max_length];
+
+    std::string_view view() const { return {text, length}; }
+};
+
+struct ParsedTrade {
+    int producer = 0;
+    Trade trade;
+};
+
+// ------------
+// Trade ingest
+// ------------
+// The path every feed line takes to the trade queue: split off the socket,
+// parsed, checked against the security master, enriched with issuer info,
+// deduplicated and queued. Producers (numbered from 1) do all of it in
+// read_feed(), or with start_stages() only split lines and hand them to a
+// parse stage and an enrich stage, each on its own thread pool, so parsing
+// scales separately from socket reads and persistence.
+//
+// Before each read a producer checks how full the queues after it are.
+// Past the high watermark it stops reading until they drain to the low one,
+// so a slow sink ends up stalling the feed's sender through TCP flow
+// control. With OverloadPolicy::Shed it keeps reading and drops lines.
+//
+// main and pipeline_bench both ingest through this, with their own queue,
+// reference data, counters and logger, so the benchmark measures the code
+// that runs in production.
+template<typename Queue>
+class TradeIngest {
+public:
+    static constexpr size_t stage_capacity = 4096;
+    using ParseStage = PipelineStage<FeedLine, stage_capacity>;
+    using EnrichStage = PipelineStage<ParsedTrade, stage_capacity>;
+    using IssuerReader = RcuSnapshot<IssuerTable>::Reader;
+
+    // `feed_counters` has FEED_COUNTERS per feed and `ingest_counters`
+    // INGEST_COUNTERS. Producers wait once `queue` holds `queue_capacity`.
+    TradeIngest(Queue& queue, size_t queue_capacity, SecurityMaster& securities, RcuSnapshot<IssuerTable>& issuers,
+                TradeDedupe& dedupe, Backpressure& backpressure, ThreadCounters& feed_counters,
+                ThreadCounters& ingest_counters, AsyncLogger& logger)
+        : queue(queue), queue_capacity(queue_capacity), securities(securities), issuers(issuers), dedupe(dedupe),
+          backpressure(backpressure), feed_counters(feed_counters), ingest_counters(ingest_counters),
+          logger(logger) {}
+
+    TradeIngest(const TradeIngest&) = delete;
+    TradeIngest& operator=(const TradeIngest&) = delete;
+
+    ~TradeIngest() { stop_stages(); }
+
+    // Starts the parse and enrich stages; read_feed() hands lines to them
+    // from then on. `node` places their queues.
+    void start_stages(size_t parse_threads, size_t enrich_threads, std::vector<int> parse_cpus = {},
+                      std::vector<int> enrich_cpus = {}, int node = -1) {
+        enrich = std::make_unique<EnrichStage>(
+            "enrich", enrich_threads, [this](size_t) { return make_enricher(); }, std::move(enrich_cpus), node);
+        parse = std::make_unique<ParseStage>(
+            "parse", parse_threads, [this](size_t) { return make_parser(); }, std::move(parse_cpus), node);
+        enrich->start();
+        parse->start();
+    }
+
+    // Lets the stages finish what's queued. Call once no producer is left.
+    void stop_stages() {
+        if (parse) parse->stop();
+        if (enrich) enrich->stop();
+    }
+
+    ParseStage* parse_stage() const { return parse.get(); }
+    EnrichStage* enrich_stage() const { return enrich.get(); }
+
+    void count_feed(int producer, FeedCounter counter, uint64_t n = 1) {
+        feed_counters.add(static_cast<size_t>(producer - 1) * FEED_COUNTERS + counter, n);
+    }
+
+    // Fill of the fullest ingest queue, as a fraction of its capacity
+    double fill() const {
+        double f = static_cast<double>(queue.size_approx()) / static_cast<double>(queue_capacity);
+        if (parse) f = std::max(f, static_cast<double>(parse->depth()) / ParseStage::capacity());
+        if (enrich) f = std::max(f, static_cast<double>(enrich->depth()) / EnrichStage::capacity());
+        return f;
+    }
+
+    // Parses one feed line. Returns false, having logged why, if it isn't a
+    // usable trade.
+    bool parse_trade(std::string_view line, int producer, Trade& trade) {
+        try {
+            auto msg = nlohmann::json::parse(line);
+            std::string error;
+            if (!trade_from_json(msg, trade, error)) {
+                static LogSite malformed("[Producer {}] Malformed trade ({}), dropping");
+                logger.warn(malformed, producer, error);
+                return false;
+            }
+        }
+        catch (nlohmann::json::parse_error& e) {
+            static LogSite parseError("[Producer {}] JSON parse error: {}");
+            logger.warn(parseError, producer, e.what());
+            return false;
+        }
+
+        // Drop trades with a malformed CUSIP
+        if (!is_valid_cusip(trade.cusip.view())) {
+            static LogSite badCusip("[Producer {}] Invalid CUSIP {}, dropping trade");
+            logger.warn(badCusip, producer, trade.cusip);
+            return false;
+        }
+        return true;
+    }
+
+    // Validates static terms, adds issuer info and drops repeats. Returns
+    // false for a trade we've already queued.
+    bool enrich_trade(Trade& trade, int producer, IssuerReader& issuer_reader) {
+        check_security_terms(trade, producer);
+
+        if (!trade.issuer.empty()) {
+            auto table = issuer_reader.read();
+            const IssuerCodes* codes = table ? table->find(trade.issuer.view()) : nullptr;
+            if (codes) {
+                trade.rating.assign(table->rating(*codes));
+                trade.industry.assign(table->industry(*codes));
+            }
+            else {
+                count_feed(producer, FEED_ENRICH_MISSES);
+            }
+        }
+
+        if (dedupe.first_seen(trade)) return true;
+        count_feed(producer, FEED_DUPLICATES);
+        return false;
+    }
+
+    // Waits for room within queue_capacity. The trade's enqueue stamp is
+    // taken first, so time spent waiting counts as time in the queue.
+    void enqueue_trade(Trade& trade) {
+        trade.stamps.enqueued = TscClock::now();
+        bool waited = false;
+        while (queue.size_approx() >= queue_capacity || !queue.enqueue(trade)) {
+            if (!waited) ingest_counters.add(QUEUE_FULL);
+            waited = true;
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    // Reads feed lines from `sock` until the connection closes, and ingests
+    // each, inline or through the stages. Stop reading while the queues are
+    // overloaded; the socket's receive buffer then fills and TCP holds the
+    // sender back.
+    void read_feed(int sock, int producer) {
+        IssuerReader issuer_reader(issuers);
+        auto feed_line = std::make_unique<FeedLine>();
+        feed_line->producer = producer;
+
+        size_t feed = static_cast<size_t>(producer - 1);
+        bool shed = backpressure.policy() == OverloadPolicy::Shed;
+        auto current_fill = [this]() { return fill(); };
+
+        std::string buffer;
+        char read_buf[1024];
+        while (true) {
+            if (!shed) backpressure.wait_for_room(feed, current_fill);
+            ssize_t n = ::read(sock, read_buf, sizeof(read_buf));
+            if (n <= 0) break;
+            uint64_t received = TscClock::now();
+            count_feed(producer, FEED_BYTES, static_cast<uint64_t>(n));
+
+            buffer.append(read_buf, static_cast<size_t>(n));
+
+            size_t pos;
+            while ((pos = buffer.find('\n')) != std::string::npos) {
+                std::string_view line(buffer.data(), pos);
+                count_feed(producer, FEED_MESSAGES);
+
+                if (shed && backpressure.overloaded(fill())) {
+                    backpressure.record_shed(feed);
+                }
+                else if (parse) {
+                    // Hand the line to the parse stage
+                    if (line.size() > FeedLine::max_length) {
+                        static LogSite tooLong("[Producer {}] Line of {} bytes is too long, dropping");
+                        logger.warn(tooLong, producer, line.size());
+                        count_feed(producer, FEED_ERRORS);
+                    }
+                    else {
+                        feed_line->length = static_cast<uint32_t>(line.size());
+                        feed_line->received = received;
+                        std::memcpy(feed_line->text, line.data(), line.size());
+                        parse->push(*feed_line);
+                    }
+                }
+                else {
+                    Trade trade;
+                    trade.stamps.received = received;
+                    if (parse_trade(line, producer, trade)) {
+                        trade.stamps.parsed = TscClock::now();
+                        if (enrich_trade(trade, producer, issuer_reader)) enqueue_trade(trade);
+                    }
+                    else {
+                        count_feed(producer, FEED_ERRORS);
+                    }
+                }
+                buffer.erase(0, pos + 1);
+            }
+        }
+    }
+
+private:
+    // Trades for known securities that are missing coupon or maturity get
+    // them copied from the master. Trades that disagree with it are reported
+    // but kept as-is, since the feed is the record of what was actually
+    // reported.
+    void check_security_terms(Trade& trade, int producer) {
+        if (!trade.has_coupon || trade.maturity.empty()) {
+            if (const SecurityRecord* record = securities.find(trade.cusip.view())) {
+                trade.coupon = record->coupon;
+                trade.has_coupon = true;
+                trade.maturity.assign(record->maturity_view());
+            }
+            return;
+        }
+
+        SecurityCheck check = securities.check_or_learn(trade.cusip.view(), trade.coupon, trade.maturity.view());
+        if (check == SecurityCheck::Mismatch) {
+            static LogSite termsMismatch("[Producer {}] Coupon/maturity for CUSIP {} disagree with security master");
+            logger.warn(termsMismatch, producer, trade.cusip);
+        }
+    }
+
+    typename ParseStage::Handler make_parser() {
+        return [this, parsed = ParsedTrade()](FeedLine& line) mutable {
+            parsed.producer = line.producer;
+            parsed.trade = Trade();
+            parsed.trade.stamps.received = line.received;
+            if (!parse_trade(line.view(), line.producer, parsed.trade)) {
+                count_feed(line.producer, FEED_ERRORS);
+                return false;
+            }
+            parsed.trade.stamps.parsed = TscClock::now();
+            enrich->push(parsed);
+            return true;
+        };
+    }
+
+    // Each enrich worker holds its own issuer reader
+    typename EnrichStage::Handler make_enricher() {
+        auto issuer_reader = std::make_shared<IssuerReader>(issuers);
+        return [this, issuer_reader](ParsedTrade& parsed) {
+            if (!enrich_trade(parsed.trade, parsed.producer, *issuer_reader)) return false;
+            enqueue_trade(parsed.trade);
+            return true;
+        };
+    }
+
+    Queue& queue;
+    size_t queue_capacity;
+    SecurityMaster& securities;
+    RcuSnapshot<IssuerTable>& issuers;
+    TradeDedupe& dedupe;
+    Backpressure& backpressure;
+    ThreadCounters& feed_counters;
+    ThreadCounters& ingest_counters;
+    AsyncLogger& logger;
+    std::unique_ptr<ParseStage> parse;
+    std::unique_ptr<EnrichStage> enrich;
+};
@@ -0,0 +1,549 @@
+#pragma once
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "flat_string_map.h"
+#include "trade.h"
+
+// Durable local spool for trades.
+//
+// Consumers append trades to the journal and only wait for fdatasync(), so
+// ingest keeps going at disk speed while the database is slow or down. A
+// replayer reads committed trades back in order and writes them to
+// Postgres, then records how far it got in a checkpoint file.
+//
+// The journal is a directory of numbered segment files:
+//
+//   00000000000000000001.journal
+//   00000000000000000002.journal
+//   ...
+//   checkpoint
+//
+// Each segment starts with a JournalSegmentHeader and then holds fixed-size
+// records: a JournalRecordHeader followed by the raw bytes of one Trade.
+// A new segment is started once the current one reaches segment_bytes, and
+// the replayer deletes segments it has fully consumed.
+//
+// Commits are grouped: whichever waiting thread finds no sync in progress
+// writes everything appended so far and calls fdatasync() once for all of
+// it. Under load one disk flush covers many trades from many consumers.
+//
+// After a crash the last segment may end in a torn record. open() truncates
+// it at the last record whose checksum verifies. Replay is at-least-once,
+// since trades after the checkpoint are sent again after a restart.
+
+constexpr uint32_t TRADE_JOURNAL_VERSION = 1;
+
+struct JournalSegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;   // TRADE_RECORD_BYTES when written
+    uint64_t segment;
+};
+
+struct JournalRecordHeader {
+    uint32_t size;
+    uint32_t reserved;
+    uint64_t checksum;   // hash_string() of the payload
+};
+
+// A place in the journal: a byte offset inside one segment.
+struct JournalPosition {
+    uint64_t segment = 0;
+    uint64_t offset = 0;
+};
+
+inline bool operator<(const JournalPosition& a, const JournalPosition& b) {
+    return a.segment < b.segment || (a.segment == b.segment && a.offset < b.offset);
+}
+
+inline bool operator==(const JournalPosition& a, const JournalPosition& b) {
+    return a.segment == b.segment && a.offset == b.offset;
+}
+
+namespace trade_journal_detail {
+
+static_assert(std::is_trivially_copyable<Trade>::value && std::is_standard_layout<Trade>::value,
+              "trades are journaled as raw bytes");
+
+constexpr char magic[8] = {'T', 'R', 'J', 'O', 'U', 'R', 'N', 'L'};
+// Pipeline timestamps aren't journaled, so the record is the same size it
+// always was
+constexpr size_t record_bytes = sizeof(JournalRecordHeader) + TRADE_RECORD_BYTES;
+constexpr size_t first_record = sizeof(JournalSegmentHeader);
+constexpr uint64_t checksum_seed = 0x4A524E4C;
+
+inline std::string segment_path(const std::string& dir, uint64_t segment) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%020llu.journal", static_cast<unsigned long long>(segment));
+    return dir + "/" + name;
+}
+
+// Segment ids present in `dir`, ascending.
+inline std::vector<uint64_t> list_segments(const std::string& dir) {
+    std::vector<uint64_t> segments;
+    DIR* d = opendir(dir.c_str());
+    if (!d) return segments;
+    while (dirent* entry = readdir(d)) {
+        std::string_view name(entry->d_name);
+        if (name.size() != 28 || name.substr(20) != ".journal") continue;
+        uint64_t id = 0;
+        bool digits = true;
+        for (char c : name.substr(0, 20)) {
+            if (c < '0' || c > '9') digits = false;
+            id = id * 10 + static_cast<uint64_t>(c - '0');
+        }
+        if (digits) segments.push_back(id);
+    }
+    closedir(d);
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+inline bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+inline bool read_all(int fd, char* data, size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t n = ::pread(fd, data, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+// Makes a file creation or rename inside `dir` durable.
+inline bool sync_dir(const std::string& dir) {
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+inline void encode_record(char* out, const Trade& trade) {
+    std::memcpy(out + sizeof(JournalRecordHeader), &trade, TRADE_RECORD_BYTES);
+    JournalRecordHeader header{};
+    header.size = TRADE_RECORD_BYTES;
+    header.checksum =
+        hash_string(std::string_view(out + sizeof(JournalRecordHeader), TRADE_RECORD_BYTES), checksum_seed);
+    std::memcpy(out, &header, sizeof(header));
+}
+
+inline bool decode_record(const char* in, Trade& trade) {
+    JournalRecordHeader header;
+    std::memcpy(&header, in, sizeof(header));
+    std::string_view payload(in + sizeof(JournalRecordHeader), TRADE_RECORD_BYTES);
+    if (header.size != TRADE_RECORD_BYTES || header.checksum != hash_string(payload, checksum_seed)) return false;
+    std::memcpy(static_cast<void*>(&trade), payload.data(), TRADE_RECORD_BYTES);
+    trade.stamps = TradeStamps();
+    return true;
+}
+
+inline bool header_ok(const JournalSegmentHeader& h, uint64_t segment) {
+    return std::memcmp(h.magic, magic, sizeof(magic)) == 0 && h.version == TRADE_JOURNAL_VERSION &&
+           h.record_size == TRADE_RECORD_BYTES && h.segment == segment;
+}
+
+}   // namespace trade_journal_detail
+
+// ----------------
+// Journal writer
+// ----------------
+// append() and wait_durable() are safe to call from any number of threads.
+class TradeJournal {
+public:
+    explicit TradeJournal(std::string dir, uint64_t segment_bytes = 64ull << 20)
+        : dir(std::move(dir)), segment_bytes(std::max<uint64_t>(segment_bytes, trade_journal_detail::first_record + trade_journal_detail::record_bytes)) {}
+
+    ~TradeJournal() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    TradeJournal(const TradeJournal&) = delete;
+    TradeJournal& operator=(const TradeJournal&) = delete;
+
+    // Creates the directory if needed and recovers the last segment,
+    // truncating a torn tail. Appends continue after the last good record.
+    bool open(std::string& error) {
+        namespace detail = trade_journal_detail;
+        if (mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST) {
+            error = dir + ": " + std::strerror(errno);
+            return false;
+        }
+
+        std::vector<uint64_t> segments = detail::list_segments(dir);
+        if (segments.empty()) return start_fresh(1, error);
+
+        uint64_t last = segments.back();
+        std::string path = detail::segment_path(dir, last);
+        fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+        if (fd < 0) {
+            error = path + ": " + std::strerror(errno);
+            return false;
+        }
+
+        // A segment whose header never made it to disk holds no records
+        JournalSegmentHeader header;
+        if (!detail::read_all(fd, reinterpret_cast<char*>(&header), sizeof(header), 0) ||
+            !detail::header_ok(header, last)) {
+            ::close(fd);
+            fd = -1;
+            if (::unlink(path.c_str()) < 0) {
+                error = path + ": " + std::strerror(errno);
+                return false;
+            }
+            return start_fresh(last, error);
+        }
+
+        uint64_t offset = detail::first_record;
+        std::vector<char> record(detail::record_bytes);
+        Trade scratch;
+        while (detail::read_all(fd, record.data(), record.size(), offset) && detail::decode_record(record.data(), scratch)) {
+            offset += detail::record_bytes;
+            ++recovered_records;
+        }
+
+        if (ftruncate(fd, static_cast<off_t>(offset)) < 0 || fdatasync(fd) < 0 ||
+            lseek(fd, static_cast<off_t>(offset), SEEK_SET) < 0) {
+            error = path + ": " + std::strerror(errno);
+            return false;
+        }
+        write_pos = {last, offset};
+        durable_pos = write_pos;
+        return true;
+    }
+
+    // Buffers a trade and returns a ticket to pass to wait_durable().
+    uint64_t append(const Trade& trade) {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t at = pending.size();
+        pending.resize(at + trade_journal_detail::record_bytes);
+        trade_journal_detail::encode_record(pending.data() + at, trade);
+        return ++appended;
+    }
+
+    // Blocks until the trade behind `ticket` is on disk. Returns false if
+    // the journal can no longer be written.
+    bool wait_durable(uint64_t ticket) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (durable_ticket < ticket && !broken) {
+            if (syncing) {
+                synced.wait(lock);
+                continue;
+            }
+
+            // Nobody is writing: lead a group commit of everything appended so far
+            syncing = true;
+            uint64_t batch_end = appended;
+            writing.swap(pending);
+            lock.unlock();
+
+            std::string error;
+            bool ok = write_batch(error);
+            writing.clear();
+
+            lock.lock();
+            syncing = false;
+            if (ok) {
+                durable_ticket = batch_end;
+                durable_pos = write_pos;
+                ++syncs;
+            }
+            else {
+                broken = true;
+                last_error = error;
+            }
+            synced.notify_all();
+        }
+        return durable_ticket >= ticket;
+    }
+
+    bool append_durable(const Trade& trade) { return wait_durable(append(trade)); }
+
+    // Everything before this position is safe to replay.
+    JournalPosition durable() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return durable_pos;
+    }
+
+    uint64_t sync_count() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return syncs;
+    }
+
+    std::string error() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return last_error;
+    }
+
+    // Records kept from the previous run by open().
+    uint64_t recovered() const { return recovered_records; }
+    const std::string& directory() const { return dir; }
+
+private:
+    bool start_fresh(uint64_t segment, std::string& error) {
+        if (!start_segment(segment, error)) return false;
+        durable_pos = write_pos;
+        return true;
+    }
+
+    bool start_segment(uint64_t segment, std::string& error) {
+        namespace detail = trade_journal_detail;
+        std::string path = detail::segment_path(dir, segment);
+        int next = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (next < 0) {
+            error = path + ": " + std::strerror(errno);
+            return false;
+        }
+
+        JournalSegmentHeader header{};
+        std::memcpy(header.magic, detail::magic, sizeof(header.magic));
+        header.version = TRADE_JOURNAL_VERSION;
+        header.record_size = TRADE_RECORD_BYTES;
+        header.segment = segment;
+        if (!detail::write_all(next, reinterpret_cast<const char*>(&header), sizeof(header)) ||
+            fdatasync(next) < 0 || !detail::sync_dir(dir)) {
+            error = path + ": " + std::strerror(errno);
+            ::close(next);
+            return false;
+        }
+
+        if (fd >= 0) ::close(fd);
+        fd = next;
+        write_pos = {segment, detail::first_record};
+        return true;
+    }
+
+    // Runs on the group-commit leader only. Fills the current segment up to
+    // segment_bytes, rotating as needed, and syncs each file it touched.
+    bool write_batch(std::string& error) {
+        namespace detail = trade_journal_detail;
+        const char* data = writing.data();
+        size_t left = writing.size();
+        while (left > 0) {
+            if (write_pos.offset + detail::record_bytes > segment_bytes) {
+                if (fdatasync(fd) < 0) {
+                    error = std::string("journal sync: ") + std::strerror(errno);
+                    return false;
+                }
+                if (!start_segment(write_pos.segment + 1, error)) return false;
+            }
+
+            uint64_t room = (segment_bytes - write_pos.offset) / detail::record_bytes * detail::record_bytes;
+            size_t chunk = static_cast<size_t>(std::min<uint64_t>(room, left));
+            if (!detail::write_all(fd, data, chunk)) {
+                error = std::string("journal write: ") + std::strerror(errno);
+                return false;
+            }
+            data += chunk;
+            left -= chunk;
+            write_pos.offset += chunk;
+        }
+
+        if (fdatasync(fd) < 0) {
+            error = std::string("journal sync: ") + std::strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    std::string dir;
+    uint64_t segment_bytes;
+    int fd = -1;
+    JournalPosition write_pos;     // Leader only
+    uint64_t recovered_records = 0;
+
+    mutable std::mutex mutex;
+    std::condition_variable synced;
+    std::vector<char> pending;     // Appended, not yet handed to a leader
+    std::vector<char> writing;     // Being written by the current leader
+    uint64_t appended = 0;
+    uint64_t durable_ticket = 0;
+    JournalPosition durable_pos;
+    bool syncing = false;
+    bool broken = false;
+    uint64_t syncs = 0;
+    std::string last_error;
+};
+
+// ----------------
+// Journal reader
+// ----------------
+// Reads records in order from a starting position, never past a limit the
+// caller gets from TradeJournal::durable(). Single-threaded.
+class JournalReader {
+public:
+    JournalReader(std::string dir, JournalPosition start) : dir(std::move(dir)), pos(start) {}
+
+    ~JournalReader() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    JournalReader(const JournalReader&) = delete;
+    JournalReader& operator=(const JournalReader&) = delete;
+
+    // Reads the next record before `limit` into `trade`. Returns false when
+    // caught up, or on a damaged record (then error() says why).
+    bool next(Trade& trade, JournalPosition limit) {
+        namespace detail = trade_journal_detail;
+        while (pos < limit) {
+            if (!open_segment()) return false;
+
+            if (pos.segment >= limit.segment) {
+                if (pos.offset + detail::record_bytes > limit.offset) return false;
+            }
+            else if (pos.offset + detail::record_bytes > segment_size && !refresh_size()) {
+                // The writer has moved on, so this segment is complete
+                pos = {pos.segment + 1, 0};
+                continue;
+            }
+
+            char record[detail::record_bytes];
+            if (!detail::read_all(fd, record, sizeof(record), pos.offset) || !detail::decode_record(record, trade)) {
+                failure = detail::segment_path(dir, pos.segment) + ": damaged record at offset " + std::to_string(pos.offset);
+                return false;
+            }
+            pos.offset += detail::record_bytes;
+            return true;
+        }
+        return false;
+    }
+
+    // Position just after the last record returned.
+    JournalPosition position() const { return pos; }
+
+    void seek(JournalPosition to) {
+        pos = to;
+        failure.clear();
+    }
+
+    const std::string& error() const { return failure; }
+
+private:
+    // Opens pos.segment, skipping to the first segment that still exists
+    // if the replayer already removed it.
+    bool open_segment() {
+        namespace detail = trade_journal_detail;
+        if (fd >= 0 && open_id == pos.segment) {
+            if (pos.offset < detail::first_record) pos.offset = detail::first_record;
+            return true;
+        }
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+
+        std::vector<uint64_t> segments = detail::list_segments(dir);
+        auto it = std::lower_bound(segments.begin(), segments.end(), pos.segment);
+        if (it == segments.end()) return false;
+        if (*it != pos.segment) pos = {*it, 0};
+
+        std::string path = detail::segment_path(dir, pos.segment);
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st{};
+        JournalSegmentHeader header;
+        if (fd < 0 || fstat(fd, &st) < 0 ||
+            !detail::read_all(fd, reinterpret_cast<char*>(&header), sizeof(header), 0) ||
+            !detail::header_ok(header, pos.segment)) {
+            failure = path + ": unreadable segment";
+            if (fd >= 0) ::close(fd);
+            fd = -1;
+            return false;
+        }
+        open_id = pos.segment;
+        segment_size = static_cast<uint64_t>(st.st_size);
+        if (pos.offset < detail::first_record) pos.offset = detail::first_record;
+        return true;
+    }
+
+    // The segment may have grown since we opened it. Returns true if there
+    // is now room for another record.
+    bool refresh_size() {
+        struct stat st{};
+        if (fstat(fd, &st) == 0) segment_size = static_cast<uint64_t>(st.st_size);
+        return pos.offset + trade_journal_detail::record_bytes <= segment_size;
+    }
+
+    std::string dir;
+    JournalPosition pos;
+    int fd = -1;
+    uint64_t open_id = 0;
+    uint64_t segment_size = 0;
+    std::string failure;
+};
+
+// ------------
+// Checkpoints
+// ------------
+// The replayer's progress, saved atomically as "segment offset".
+
+inline JournalPosition load_journal_checkpoint(const std::string& dir) {
+    JournalPosition pos;
+    std::string path = dir + "/checkpoint";
+    if (FILE* f = std::fopen(path.c_str(), "r")) {
+        unsigned long long segment = 0;
+        unsigned long long offset = 0;
+        if (std::fscanf(f, "%llu %llu", &segment, &offset) == 2) {
+            pos = {segment, offset};
+        }
+        std::fclose(f);
+    }
+    return pos;
+}
+
+inline bool save_journal_checkpoint(const std::string& dir, JournalPosition pos, std::string& error) {
+    namespace detail = trade_journal_detail;
+    std::string path = dir + "/checkpoint";
+    std::string tmp = path + ".tmp";
+    std::string text = std::to_string(pos.segment) + " " + std::to_string(pos.offset) + "\n";
+
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || !detail::write_all(fd, text.data(), text.size()) || fdatasync(fd) < 0) {
+        error = tmp + ": " + std::strerror(errno);
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+    ::close(fd);
+    if (std::rename(tmp.c_str(), path.c_str()) < 0) {
+        error = path + ": " + std::strerror(errno);
+        return false;
+    }
+    detail::sync_dir(dir);
+    return true;
+}
+
+// Deletes segments wholly before `pos`, which the replayer has finished
+// with. Returns how many were removed.
+inline size_t remove_journal_segments_before(const std::string& dir, JournalPosition pos) {
+    size_t removed = 0;
+    for (uint64_t segment : trade_journal_detail::list_segments(dir)) {
+        if (segment >= pos.segment) break;
+        if (::unlink(trade_journal_detail::segment_path(dir, segment).c_str()) == 0) ++removed;
+    }
+    return removed;
+}
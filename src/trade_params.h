@@ -0,0 +1,266 @@
+#pragma once
+#include <libpq-fe.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include "trade.h"
+
+// ---------------------------------------------
+// Binary parameters for the prepared trade insert
+// ---------------------------------------------
+// Postgres' binary wire format is big-endian. Timestamps are int64
+// microseconds and dates int32 days, both counted from 2000-01-01. Sending
+// values this way skips number formatting on our side and text parsing on
+// the server's, and string parameters point straight into the Trade with no
+// copies at all.
+
+// Type OIDs from pg_type. They are fixed across server versions, but the
+// server headers that name them are not part of libpq.
+constexpr Oid PG_INT4_OID = 23;
+constexpr Oid PG_INT8_OID = 20;
+constexpr Oid PG_TEXT_OID = 25;
+constexpr Oid PG_FLOAT8_OID = 701;
+constexpr Oid PG_DATE_OID = 1082;
+constexpr Oid PG_TIMESTAMPTZ_OID = 1184;
+
+// Parameter types for TRADE_COLUMNS order. INSERT casts each one to the
+// column's type, so float8 works for numeric columns too.
+constexpr Oid TRADE_PARAM_TYPES[TRADE_COLUMN_COUNT] = {
+    PG_TEXT_OID,          // control_id
+    PG_FLOAT8_OID,        // coupon
+    PG_TEXT_OID,          // cusip
+    PG_INT4_OID,          // dealer_id
+    PG_TIMESTAMPTZ_OID,   // exec_time
+    PG_TEXT_OID,          // industry
+    PG_TEXT_OID,          // issuer
+    PG_DATE_OID,          // maturity
+    PG_TEXT_OID,          // modifier3
+    PG_FLOAT8_OID,        // price
+    PG_TEXT_OID,          // rating
+    PG_TIMESTAMPTZ_OID,   // report_time
+    PG_TEXT_OID,          // reporting_capacity
+    PG_TEXT_OID,          // side
+    PG_INT8_OID           // volume
+};
+
+constexpr int64_t PG_EPOCH_DAYS = 10957;   // 1970-01-01 to 2000-01-01
+constexpr int64_t MICROS_PER_DAY = 86400LL * 1000000;
+
+inline void store_be32(char* out, uint32_t v) {
+    for (int i = 3; i >= 0; --i, v >>= 8) out[i] = static_cast<char>(v & 0xFF);
+}
+
+inline void store_be64(char* out, uint64_t v) {
+    for (int i = 7; i >= 0; --i, v >>= 8) out[i] = static_cast<char>(v & 0xFF);
+}
+
+inline void store_float8(char* out, double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    store_be64(out, bits);
+}
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar.
+inline int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = static_cast<unsigned>(y - era * 400);
+    unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+namespace trade_params_detail {
+
+// Reads exactly `width` digits starting at s[pos].
+inline bool read_digits(std::string_view s, size_t pos, size_t width, int& out) {
+    if (pos + width > s.size()) return false;
+    out = 0;
+    for (size_t i = pos; i < pos + width; ++i) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        out = out * 10 + (s[i] - '0');
+    }
+    return true;
+}
+
+inline bool valid_date(int y, int m, int d) {
+    static const int days_in_month[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (m < 1 || m > 12 || d < 1) return false;
+    bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    return d <= days_in_month[m - 1] + (m == 2 && leap);
+}
+
+}   // namespace trade_params_detail
+
+// Parses YYYY-MM-DD into days since 2000-01-01.
+inline bool parse_pg_date(std::string_view s, int32_t& days) {
+    using namespace trade_params_detail;
+    int y, m, d;
+    if (s.size() != 10 || s[4] != '-' || s[7] != '-' ||
+        !read_digits(s, 0, 4, y) || !read_digits(s, 5, 2, m) || !read_digits(s, 8, 2, d) ||
+        !valid_date(y, m, d)) {
+        return false;
+    }
+    days = static_cast<int32_t>(days_from_civil(y, m, d) - PG_EPOCH_DAYS);
+    return true;
+}
+
+// Parses an ISO-8601 timestamp into microseconds since 2000-01-01 UTC.
+// Accepts YYYY-MM-DD[T ]HH:MM:SS, an optional fraction (rounded to
+// microseconds like Postgres does) and Z, +HH, +HHMM or +HH:MM. A timestamp
+// without an offset is taken as UTC, which is what the feed sends.
+inline bool parse_pg_timestamptz(std::string_view s, int64_t& micros) {
+    using namespace trade_params_detail;
+    int32_t days;
+    int hh, mm, ss;
+    if (s.size() < 19 || !parse_pg_date(s.substr(0, 10), days) || (s[10] != 'T' && s[10] != ' ') ||
+        !read_digits(s, 11, 2, hh) || s[13] != ':' || !read_digits(s, 14, 2, mm) || s[16] != ':' ||
+        !read_digits(s, 17, 2, ss) || hh > 23 || mm > 59 || ss > 59) {
+        return false;
+    }
+
+    size_t pos = 19;
+    int64_t fraction = 0;
+    if (pos < s.size() && s[pos] == '.') {
+        int64_t scale = 100000;
+        size_t digits = 0;
+        for (++pos; pos < s.size() && s[pos] >= '0' && s[pos] <= '9'; ++pos, ++digits) {
+            if (digits < 6) {
+                fraction += (s[pos] - '0') * scale;
+                scale /= 10;
+            }
+            else if (digits == 6 && s[pos] >= '5') {
+                ++fraction;
+            }
+        }
+        if (digits == 0) return false;
+    }
+
+    int64_t offset_minutes = 0;
+    if (pos < s.size()) {
+        if (s[pos] == 'Z') {
+            ++pos;
+        }
+        else if (s[pos] == '+' || s[pos] == '-') {
+            int sign = s[pos] == '-' ? -1 : 1;
+            int oh, om = 0;
+            if (!read_digits(s, pos + 1, 2, oh)) return false;
+            pos += 3;
+            if (pos < s.size()) {
+                if (s[pos] == ':') ++pos;
+                if (!read_digits(s, pos, 2, om)) return false;
+                pos += 2;
+            }
+            if (oh > 15 || om > 59) return false;
+            offset_minutes = sign * (oh * 60 + om);
+        }
+        if (pos != s.size()) return false;
+    }
+
+    micros = static_cast<int64_t>(days) * MICROS_PER_DAY +
+             ((hh * 60 + mm - offset_minutes) * 60 + ss) * int64_t(1000000) + fraction;
+    return true;
+}
+
+// Parameter arrays for one PQexecPrepared call of the trade insert. Text
+// values point into `trade`, which must outlive this object's use, and
+// numbers are encoded into a small inline buffer. Missing numbers and empty
+// timestamps or dates go as NULL.
+struct TradeParams {
+    const char* values[TRADE_COLUMN_COUNT];
+    int lengths[TRADE_COLUMN_COUNT];
+    int formats[TRADE_COLUMN_COUNT];
+
+    // Returns false (naming the field in `error`) if a timestamp or date
+    // can't be parsed.
+    bool encode(const Trade& t, std::string& error) {
+        for (size_t i = 0; i < TRADE_COLUMN_COUNT; ++i) formats[i] = 1;
+        char* next = scratch;
+
+        auto text = [&](size_t i, std::string_view v) {
+            values[i] = v.data();
+            lengths[i] = static_cast<int>(v.size());
+        };
+        auto null = [&](size_t i) {
+            values[i] = nullptr;
+            lengths[i] = 0;
+        };
+        auto be32 = [&](size_t i, uint32_t v) {
+            store_be32(next, v);
+            values[i] = next;
+            lengths[i] = 4;
+            next += 4;
+        };
+        auto be64 = [&](size_t i, uint64_t v) {
+            store_be64(next, v);
+            values[i] = next;
+            lengths[i] = 8;
+            next += 8;
+        };
+        auto float8 = [&](size_t i, double v, bool present) {
+            if (!present) return null(i);
+            store_float8(next, v);
+            values[i] = next;
+            lengths[i] = 8;
+            next += 8;
+        };
+        auto timestamp = [&](size_t i, std::string_view v, const char* field) {
+            int64_t micros;
+            if (v.empty()) {
+                null(i);
+                return true;
+            }
+            if (!parse_pg_timestamptz(v, micros)) {
+                error = std::string("bad ") + field;
+                return false;
+            }
+            be64(i, static_cast<uint64_t>(micros));
+            return true;
+        };
+
+        text(0, t.control_id.view());
+        float8(1, t.coupon, t.has_coupon);
+        text(2, t.cusip.view());
+        if (t.has_dealer_id) be32(3, static_cast<uint32_t>(t.dealer_id)); else null(3);
+        if (!timestamp(4, t.exec_time.view(), "exec_time")) return false;
+        text(5, t.industry.view());
+        text(6, t.issuer.view());
+        int32_t days;
+        if (t.maturity.empty()) {
+            null(7);
+        }
+        else if (parse_pg_date(t.maturity.view(), days)) {
+            be32(7, static_cast<uint32_t>(days));
+        }
+        else {
+            error = "bad maturity";
+            return false;
+        }
+        text(8, t.modifier3.view());
+        float8(9, t.price, t.has_price);
+        text(10, t.rating.view());
+        if (!timestamp(11, t.report_time.view(), "report_time")) return false;
+        text(12, t.reporting_capacity.view());
+        text(13, t.side.view());
+        if (t.has_volume) be64(14, static_cast<uint64_t>(t.volume)); else null(14);
+        return true;
+    }
+
+private:
+    // Room for every fixed-width value: 2 float8, 2 timestamptz, 1 int8,
+    // 1 int4 and 1 date
+    char scratch[5 * 8 + 2 * 4];
+};
+
+// Name and text of the prepared insert. Prepare it once per connection.
+// With a unique index on trades, a trade that's already stored is skipped
+// rather than reported as an error, so replays are harmless.
+constexpr const char* INSERT_TRADE_STATEMENT = "insert_trade";
+
+inline std::string insert_trade_sql() {
+    return std::string("INSERT INTO trades (") + TRADE_COLUMNS + ") "
+           "VALUES ($1,$2,$3,$4,$5,$6,$7,$8,$9,$10,$11,$12,$13,$14,$15) "
+           "ON CONFLICT DO NOTHING;";
+}
@@ -0,0 +1,97 @@
+#include "flat_string_map.h"
+#include "issuer_table.h"
+#include "perfect_string_map.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+// ------------------------
+// Issuer lookup benchmarks
+// ------------------------
+// Google Benchmark cases for the enrichment lookup: the original
+// std::unordered_map (with a std::string key built per lookup, as
+// tcpReader() used to do), FlatStringMap and PerfectStringMap. Keys follow
+// the feed generator, a uniform choice over its issuer list, and each
+// iteration looks up one key. Reports lookups per second:
+//
+//   lookup_bench --benchmark_filter='Perfect'
+namespace {
+
+// Same issuer universe as ISSUERS in fake_trace_generator.py
+const std::vector<std::string> kIssuers = {
+    "3M", "Amgen", "Apple", "American Express", "Boeing", "Caterpillar",
+    "Chevron", "Cisco Systems", "Coca-Cola", "Disney", "Dow Inc.", "Goldman Sachs",
+    "Home Depot", "Honeywell", "IBM", "Intel", "Johnson & Johnson", "JPMorgan Chase",
+    "Merck", "Microsoft", "Nike", "Procter & Gamble", "Salesforce",
+    "Travelers", "Verizon", "Visa", "Walgreens Boots Alliance", "Walmart"
+};
+
+constexpr size_t KEY_COUNT = 1 << 16;
+
+// A fixed, repeatable sequence of keys to cycle through
+const std::vector<std::string_view>& lookupKeys() {
+    static const std::vector<std::string_view> keys = []() {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<size_t> pick(0, kIssuers.size() - 1);
+        std::vector<std::string_view> out;
+        out.reserve(KEY_COUNT);
+        for (size_t i = 0; i < KEY_COUNT; ++i) out.emplace_back(kIssuers[pick(rng)]);
+        return out;
+    }();
+    return keys;
+}
+
+IssuerCodes codesFor(size_t i) {
+    return {static_cast<uint16_t>(i % 7), static_cast<uint16_t>(i % 5)};
+}
+
+template<typename Find>
+void runLookups(benchmark::State& state, Find find) {
+    const auto& keys = lookupKeys();
+    size_t i = 0;
+    for (auto _ : state) {
+        const IssuerCodes* codes = find(keys[i++ & (KEY_COUNT - 1)]);
+        benchmark::DoNotOptimize(codes);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+void BM_UnorderedMap(benchmark::State& state) {
+    std::unordered_map<std::string, IssuerCodes> map;
+    for (size_t i = 0; i < kIssuers.size(); ++i) map[kIssuers[i]] = codesFor(i);
+    runLookups(state, [&map](std::string_view key) -> const IssuerCodes* {
+        auto it = map.find(std::string(key));
+        return it == map.end() ? nullptr : &it->second;
+    });
+}
+
+void BM_FlatStringMap(benchmark::State& state) {
+    FlatStringMap<IssuerCodes> map;
+    for (size_t i = 0; i < kIssuers.size(); ++i) map.insert_or_assign(kIssuers[i], codesFor(i));
+    runLookups(state, [&map](std::string_view key) { return map.find(key); });
+}
+
+void BM_PerfectStringMap(benchmark::State& state) {
+    PerfectStringMap<IssuerCodes> map;
+    for (size_t i = 0; i < kIssuers.size(); ++i) map.insert(kIssuers[i], codesFor(i));
+    if (!map.build()) {
+        state.SkipWithError("perfect hash build failed");
+        return;
+    }
+    runLookups(state, [&map](std::string_view key) { return map.find(key); });
+}
+
+BENCHMARK(BM_UnorderedMap);
+BENCHMARK(BM_FlatStringMap);
+BENCHMARK(BM_PerfectStringMap);
+
+}   // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,345 @@
+#include "mpmc_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include <benchmark/benchmark.h>
+#include <nlohmann/json.hpp>
+
+#include "cpu_topology.h"
+#include "latency_histogram.h"
+#include "trade.h"
+
+// ----------------------------
+// MPMCQueue contention matrix
+// ----------------------------
+// Google Benchmark cases for the queue across the parameters that decide
+// how it should be sized on a host: producer and consumer thread counts,
+// capacity, payload type and how a thread waits when the queue is full or
+// empty. Each case reports items per second and the percentiles of each
+// item's time from enqueue to dequeue, in TscClock nanoseconds.
+//
+// Worker threads are started once per case and pinned round-robin over the
+// CPUs this process may use, producers first. Every iteration moves one
+// round of 65536 items through the queue, timed from releasing the workers
+// to the last one finishing, so thread start-up isn't measured.
+//
+// The default matrix is the full producer x consumer grid for size_t at
+// capacity 1024, plus sweeps of capacity, payload and wait strategy at a
+// few thread counts. --matrix=full runs every combination, which takes
+// hours; narrow it with --benchmark_filter:
+//
+//   queue_bench --benchmark_filter='size_t/cap:1024/backoff'
+//   queue_bench --matrix=full --benchmark_filter='Trade/.*/p:8/' --benchmark_format=json
+namespace {
+
+constexpr size_t ROUND_ITEMS = 65536;
+constexpr size_t THREAD_COUNTS[] = {1, 2, 4, 8, 16, 32, 64};
+constexpr size_t SWEEP_THREADS[] = {1, 4, 16};
+
+// --------
+// Payloads
+// --------
+// Each payload carries the TscClock stamp of its enqueue.
+struct Bytes64 {
+    uint64_t stamp = 0;
+    char bytes[56] = {};
+};
+static_assert(sizeof(Bytes64) == 64, "64-byte payload");
+
+template<typename T>
+struct Payload;
+
+template<>
+struct Payload<size_t> {
+    static constexpr const char* name = "size_t";
+    static size_t make(uint64_t stamp) { return stamp; }
+    static uint64_t stamp(const size_t& v) { return v; }
+};
+
+template<>
+struct Payload<Bytes64> {
+    static constexpr const char* name = "64B";
+    static Bytes64 make(uint64_t stamp) {
+        Bytes64 b;
+        b.stamp = stamp;
+        return b;
+    }
+    static uint64_t stamp(const Bytes64& v) { return v.stamp; }
+};
+
+// A feed message as parsed JSON, so every copy allocates
+template<>
+struct Payload<nlohmann::json> {
+    static constexpr const char* name = "json";
+    static nlohmann::json make(uint64_t stamp) {
+        static const nlohmann::json prototype = {{"control_id", "AB12CD34EF"}, {"cusip", "037833100"},
+                                                 {"issuer", "Apple"},          {"price", 101.25},
+                                                 {"volume", 2500000},          {"side", "BUY"}};
+        nlohmann::json j = prototype;
+        j["stamp"] = stamp;
+        return j;
+    }
+    static uint64_t stamp(const nlohmann::json& v) { return v["stamp"].get<uint64_t>(); }
+};
+
+template<>
+struct Payload<Trade> {
+    static constexpr const char* name = "Trade";
+    static Trade make(uint64_t stamp) {
+        Trade t;
+        t.stamps.enqueued = stamp;
+        return t;
+    }
+    static uint64_t stamp(const Trade& v) { return v.stamps.enqueued; }
+};
+
+// --------------
+// Wait strategies
+// --------------
+// What a thread does each time the queue is full (producer) or empty
+// (consumer). Sleep is what the pipeline's producers and consumers do;
+// backoff spins, then yields, then sleeps.
+enum class WaitStrategy {
+    Spin,
+    Yield,
+    Sleep,
+    Backoff
+};
+
+const char* wait_strategy_name(WaitStrategy w) {
+    switch (w) {
+        case WaitStrategy::Spin: return "spin";
+        case WaitStrategy::Yield: return "yield";
+        case WaitStrategy::Sleep: return "sleep";
+        case WaitStrategy::Backoff: return "backoff";
+    }
+    return "unknown";
+}
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#endif
+}
+
+class Waiter {
+public:
+    explicit Waiter(WaitStrategy strategy) : strategy(strategy) {}
+
+    void wait() {
+        switch (strategy) {
+            case WaitStrategy::Spin: cpu_relax(); break;
+            case WaitStrategy::Yield: std::this_thread::yield(); break;
+            case WaitStrategy::Sleep: sleep(); break;
+            case WaitStrategy::Backoff:
+                if (++misses < 64) cpu_relax();
+                else if (misses < 128) std::this_thread::yield();
+                else sleep();
+                break;
+        }
+    }
+
+    void reset() { misses = 0; }
+
+private:
+    static void sleep() { std::this_thread::sleep_for(std::chrono::microseconds(50)); }
+
+    WaitStrategy strategy;
+    int misses = 0;
+};
+
+// ---------
+// Harness
+// ---------
+struct alignas(64) ConsumerCount {
+    std::atomic<uint64_t> items{0};
+};
+
+template<typename T, size_t Capacity>
+void queue_case(benchmark::State& state, WaitStrategy strategy, size_t producers, size_t consumers) {
+    using Queue = MPMCQueue<T, Capacity>;
+    auto queue = std::make_unique<Queue>();
+    LatencyRecorder latency({"queue"}, consumers);
+    std::vector<ConsumerCount> counts(consumers);
+    size_t per_producer = (ROUND_ITEMS + producers - 1) / producers;
+    uint64_t round_items = per_producer * producers;
+
+    std::atomic<uint64_t> round{0};
+    std::atomic<size_t> finished{0};
+    std::atomic<bool> quit{false};
+
+    // Waits for the next round; false when it's time to exit
+    auto next_round = [&](uint64_t& seen) {
+        while (round.load(std::memory_order_acquire) == seen) std::this_thread::yield();
+        seen = round.load(std::memory_order_acquire);
+        return !quit.load(std::memory_order_acquire);
+    };
+    auto consumed = [&]() {
+        uint64_t sum = 0;
+        for (const ConsumerCount& c : counts) sum += c.items.load(std::memory_order_acquire);
+        return sum;
+    };
+
+    std::vector<int> cpus = current_thread_cpus();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < producers + consumers; ++i) {
+        int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        threads.emplace_back([&, i, cpu]() {
+            std::string error;
+            if (cpu >= 0) pin_current_thread(cpu, error);
+            Waiter waiter(strategy);
+            uint64_t seen = 0;
+            if (i < producers) {
+                while (next_round(seen)) {
+                    for (size_t n = 0; n < per_producer; ++n) {
+                        T item = Payload<T>::make(TscClock::now());
+                        waiter.reset();
+                        while (!queue->enqueue(item)) waiter.wait();
+                    }
+                    finished.fetch_add(1, std::memory_order_acq_rel);
+                }
+                return;
+            }
+            size_t c = i - producers;
+            LatencyHistogram& histogram = latency.at(c, 0);
+            std::atomic<uint64_t>& mine = counts[c].items;
+            T item;
+            while (next_round(seen)) {
+                while (true) {
+                    if (queue->dequeue(item)) {
+                        histogram.record(TscClock::elapsed_ns(Payload<T>::stamp(item), TscClock::now()));
+                        mine.store(mine.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+                        waiter.reset();
+                    }
+                    else if (consumed() >= round_items * seen) {
+                        break;
+                    }
+                    else {
+                        waiter.wait();
+                    }
+                }
+                finished.fetch_add(1, std::memory_order_acq_rel);
+            }
+        });
+    }
+
+    for (auto _ : state) {
+        finished.store(0, std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        round.fetch_add(1, std::memory_order_acq_rel);
+        while (finished.load(std::memory_order_acquire) < producers + consumers) std::this_thread::yield();
+        state.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    quit.store(true, std::memory_order_release);
+    round.fetch_add(1, std::memory_order_acq_rel);
+    for (auto& t : threads) t.join();
+
+    LatencySnapshot s = latency.snapshot(0);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(round_items));
+    state.counters["p50_ns"] = static_cast<double>(s.percentile(0.5));
+    state.counters["p99_ns"] = static_cast<double>(s.percentile(0.99));
+    state.counters["p999_ns"] = static_cast<double>(s.percentile(0.999));
+    state.counters["max_ns"] = static_cast<double>(s.max_ns);
+    state.counters["cpus"] = static_cast<double>(cpus.size());
+}
+
+// ------------
+// Registration
+// ------------
+struct Case {
+    std::string payload;
+    size_t capacity;
+    WaitStrategy wait;
+    size_t producers;
+    size_t consumers;
+};
+
+std::set<std::string> registered;
+
+template<typename T, size_t Capacity>
+void register_case(const Case& c) {
+    std::string name = std::string(Payload<T>::name) + "/cap:" + std::to_string(Capacity) + "/" +
+                       wait_strategy_name(c.wait) + "/p:" + std::to_string(c.producers) +
+                       "/c:" + std::to_string(c.consumers);
+    if (!registered.insert(name).second) return;
+    benchmark::RegisterBenchmark(name.c_str(), queue_case<T, Capacity>, c.wait, c.producers, c.consumers)
+        ->UseManualTime()
+        ->MeasureProcessCPUTime()
+        ->Unit(benchmark::kMillisecond);
+}
+
+template<typename T>
+void register_capacity(const Case& c) {
+    switch (c.capacity) {
+        case 64: register_case<T, 64>(c); break;
+        case 1024: register_case<T, 1024>(c); break;
+        case 16384: register_case<T, 16384>(c); break;
+        case 65536: register_case<T, 65536>(c); break;
+    }
+}
+
+void register_payload(const Case& c) {
+    if (c.payload == "size_t") register_capacity<size_t>(c);
+    else if (c.payload == "64B") register_capacity<Bytes64>(c);
+    else if (c.payload == "json") register_capacity<nlohmann::json>(c);
+    else if (c.payload == "Trade") register_capacity<Trade>(c);
+}
+
+const char* const PAYLOADS[] = {"size_t", "64B", "json", "Trade"};
+constexpr size_t CAPACITIES[] = {64, 1024, 16384, 65536};
+constexpr WaitStrategy WAITS[] = {WaitStrategy::Spin, WaitStrategy::Yield, WaitStrategy::Sleep, WaitStrategy::Backoff};
+
+void register_matrix(bool full) {
+    if (full) {
+        for (const char* payload : PAYLOADS)
+            for (size_t capacity : CAPACITIES)
+                for (WaitStrategy wait : WAITS)
+                    for (size_t p : THREAD_COUNTS)
+                        for (size_t c : THREAD_COUNTS) register_payload({payload, capacity, wait, p, c});
+        return;
+    }
+
+    // Contention grid, then one axis at a time
+    for (size_t p : THREAD_COUNTS)
+        for (size_t c : THREAD_COUNTS) register_payload({"size_t", 1024, WaitStrategy::Backoff, p, c});
+    for (size_t n : SWEEP_THREADS) {
+        for (size_t capacity : CAPACITIES) register_payload({"size_t", capacity, WaitStrategy::Backoff, n, n});
+        for (const char* payload : PAYLOADS) register_payload({payload, 1024, WaitStrategy::Backoff, n, n});
+        for (WaitStrategy wait : WAITS) register_payload({"size_t", 1024, wait, n, n});
+    }
+}
+
+}   // namespace
+
+int main(int argc, char** argv) {
+    // Take --matrix before Google Benchmark sees the arguments
+    bool full = false;
+    std::vector<char*> args;
+    for (int i = 0; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--matrix=full") full = true;
+        else if (arg == "--matrix=default") full = false;
+        else args.push_back(argv[i]);
+    }
+    int count = static_cast<int>(args.size());
+
+    TscClock::calibrate();
+    register_matrix(full);
+    benchmark::Initialize(&count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(count, args.data())) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
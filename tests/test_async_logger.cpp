@@ -0,0 +1,145 @@
+#include "async_logger.h"
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "trade.h"
+
+namespace {
+
+std::vector<std::string> lines(const std::string& text) {
+    std::vector<std::string> out;
+    std::istringstream is(text);
+    std::string line;
+    while (std::getline(is, line)) out.push_back(line);
+    return out;
+}
+
+// The message part of a line, after "HH:MM:SS.uuuuuu L "
+std::string message(const std::string& line) {
+    return line.size() > 18 ? line.substr(18) : "";
+}
+
+}   // namespace
+
+// Test arguments of mixed types are formatted into one line with a level letter
+TEST(AsyncLoggerTest, FormatsArguments) {
+    std::ostringstream out;
+    AsyncLogger logger(out);
+    FixedString<8> side;
+    side.assign("SELL");
+    logger.warn("[Producer ", 3, "] price ", 101.25, ' ', side, ' ', true, ' ', std::string("ok"));
+    logger.flush();
+
+    auto got = lines(out.str());
+    ASSERT_EQ(got.size(), 1u);
+    EXPECT_EQ(got[0][16], 'W');
+    EXPECT_EQ(message(got[0]), "[Producer 3] price 101.25 SELL true ok");
+}
+
+// Test types without a fast path fall back to their operator<<
+TEST(AsyncLoggerTest, FallsBackToStreamOperator) {
+    std::ostringstream out;
+    AsyncLogger logger(out);
+    Trade t;
+    t.control_id.assign("C1");
+    t.cusip.assign("037833100");
+    logger.info("Got trade: ", t);
+    logger.flush();
+
+    std::ostringstream expected;
+    expected << "Got trade: " << t;
+    auto got = lines(out.str());
+    ASSERT_EQ(got.size(), 1u);
+    EXPECT_EQ(message(got[0]), expected.str());
+}
+
+// Test lines below the level are skipped and the level can change at run time
+TEST(AsyncLoggerTest, Levels) {
+    std::ostringstream out;
+    AsyncLogger logger(out, LogLevel::Warn);
+    logger.debug("d");
+    logger.info("i");
+    logger.error("e");
+    logger.set_level(LogLevel::Debug);
+    logger.debug("d2");
+    logger.flush();
+
+    auto got = lines(out.str());
+    ASSERT_EQ(got.size(), 2u);
+    EXPECT_EQ(message(got[0]), "e");
+    EXPECT_EQ(message(got[1]), "d2");
+}
+
+// Test long lines are cut at the slot size and marked
+TEST(AsyncLoggerTest, TruncatesLongLines) {
+    std::ostringstream out;
+    AsyncLogger logger(out);
+    logger.info(std::string(1000, 'x'));
+    logger.flush();
+
+    auto got = lines(out.str());
+    ASSERT_EQ(got.size(), 1u);
+    EXPECT_EQ(message(got[0]), std::string(AsyncLogger::line_capacity, 'x') + "...");
+}
+
+// Test a full ring drops lines instead of blocking the caller
+TEST(AsyncLoggerTest, DropsWhenFull) {
+    std::ostringstream out;
+    AsyncLogger logger(out, LogLevel::Info, 4);
+    logger.stop();
+    for (int i = 0; i < 10; ++i) logger.info("line ", i);
+    EXPECT_EQ(logger.dropped(), 6u);
+    EXPECT_EQ(logger.written(), 0u);
+}
+
+// Test every line from many threads is written, in order per thread
+TEST(AsyncLoggerTest, ManyThreads) {
+    std::ostringstream out;
+    AsyncLogger logger(out, LogLevel::Info, 1 << 14);
+    constexpr int threads = 8;
+    constexpr int perThread = 2000;
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; ++t) {
+        writers.emplace_back([&, t]() {
+            for (int i = 0; i < perThread; ++i) logger.info(t, ' ', i);
+        });
+    }
+    for (auto& w : writers) w.join();
+    logger.flush();
+
+    EXPECT_EQ(logger.dropped(), 0u);
+    std::vector<int> next(threads, 0);
+    for (const std::string& line : lines(out.str())) {
+        std::istringstream is(message(line));
+        int t, i;
+        ASSERT_TRUE(is >> t >> i) << line;
+        ASSERT_EQ(i, next[t]) << "thread " << t;
+        ++next[t];
+    }
+    for (int t = 0; t < threads; ++t) EXPECT_EQ(next[t], perThread);
+}
+
+// Test a finished thread's ring is reused by the next one
+TEST(AsyncLoggerTest, ReusesRings) {
+    std::ostringstream out;
+    AsyncLogger logger(out);
+    for (int i = 0; i < 20; ++i) {
+        std::thread([&]() { logger.info("from thread"); }).join();
+        logger.flush();
+    }
+    EXPECT_EQ(logger.ring_count(), 1u);
+    EXPECT_EQ(logger.written(), 20u);
+}
+
+// Test the sampler lets through the first of every n calls
+TEST(AsyncLoggerTest, Sampler) {
+    LogSampler every3(3);
+    std::vector<bool> got;
+    for (int i = 0; i < 7; ++i) got.push_back(every3.sample());
+    EXPECT_EQ(got, (std::vector<bool>{true, false, false, true, false, false, true}));
+}
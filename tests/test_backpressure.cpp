@@ -0,0 +1,159 @@
+#include "backpressure.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "mpmc_queue.h"
+
+using namespace std::chrono_literals;
+
+// Test overload starts at the high watermark and lasts until the low one
+TEST(BackpressureTest, Hysteresis) {
+    Backpressure bp(0.9, 0.5, OverloadPolicy::Pause, 1);
+    EXPECT_FALSE(bp.overloaded(0.0));
+    EXPECT_FALSE(bp.overloaded(0.89));
+    EXPECT_TRUE(bp.overloaded(0.9));
+    EXPECT_TRUE(bp.overloaded(0.7));    // Still draining
+    EXPECT_TRUE(bp.overloaded(0.51));
+    EXPECT_FALSE(bp.overloaded(0.5));
+    EXPECT_FALSE(bp.overloaded(0.7));   // Below high again, stays open
+    EXPECT_TRUE(bp.overloaded(1.0));
+    EXPECT_EQ(bp.stats().episodes, 2u);
+    EXPECT_EQ(bp.stats().pauses, 0u);
+}
+
+// Test many producers crossing the watermark together count one episode
+TEST(BackpressureTest, EpisodeCountedOnce) {
+    Backpressure bp(0.8, 0.2, OverloadPolicy::Pause, 8);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < 1000; ++j) EXPECT_TRUE(bp.overloaded(0.95));
+        });
+    }
+    for (auto& t : threads) t.join();
+    EXPECT_EQ(bp.stats().episodes, 1u);
+}
+
+// Test a producer waits until consumers drain the queue to the low watermark
+TEST(BackpressureTest, WaitForRoom) {
+    MPMCQueue<int, 128> queue;
+    Backpressure bp(0.75, 0.25, OverloadPolicy::Pause, 2);
+    auto fill = [&]() { return static_cast<double>(queue.size_approx()) / 128; };
+    for (int i = 0; i < 100; ++i) ASSERT_TRUE(queue.enqueue(i));
+
+    std::atomic<bool> resumed{false};
+    std::thread producer([&]() {
+        bp.wait_for_room(1, fill, 50us);
+        resumed = true;
+        EXPECT_LE(queue.size_approx(), 32u);
+    });
+
+    std::this_thread::sleep_for(20ms);
+    EXPECT_FALSE(resumed.load());
+    int v;
+    while (queue.size_approx() > 20) {
+        ASSERT_TRUE(queue.dequeue(v));
+        std::this_thread::sleep_for(100us);
+    }
+    producer.join();
+    EXPECT_TRUE(resumed.load());
+
+    // Not overloaded any more, so this returns at once and counts nothing
+    bp.wait_for_room(0, fill);
+
+    BackpressureStats s = bp.stats();
+    EXPECT_EQ(s.episodes, 1u);
+    EXPECT_EQ(s.pauses, 1u);
+    EXPECT_GE(s.paused_ns, 20000000u);
+    EXPECT_EQ(bp.feed(1).pauses.load(), 1u);
+    EXPECT_EQ(bp.feed(0).pauses.load(), 0u);
+}
+
+// Test a paused reader holds the sender back through the socket buffer, and
+// that the sender gets everything through once the reader resumes
+TEST(BackpressureTest, PausedReaderStallsSender) {
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    int size = 16384;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    std::atomic<double> queueFill{1.0};
+    Backpressure bp(0.9, 0.5, OverloadPolicy::Pause, 1);
+    constexpr size_t total = 4 << 20;
+    std::atomic<size_t> received{0};
+    std::thread reader([&]() {
+        char buf[4096];
+        while (true) {
+            bp.wait_for_room(0, [&]() { return queueFill.load(); }, 100us);
+            ssize_t n = read(fds[1], buf, sizeof(buf));
+            if (n <= 0) break;
+            received += static_cast<size_t>(n);
+        }
+    });
+
+    while (!bp.is_overloaded()) std::this_thread::sleep_for(100us);
+
+    // While paused, a non-blocking sender runs out of buffer well short of the total
+    std::vector<char> chunk(4096, 'x');
+    size_t sent = 0;
+    while (sent < total) {
+        ssize_t n = send(fds[0], chunk.data(), chunk.size(), MSG_DONTWAIT);
+        if (n < 0) {
+            ASSERT_TRUE(errno == EAGAIN || errno == EWOULDBLOCK);
+            break;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    EXPECT_LT(sent, total);
+    EXPECT_EQ(received.load(), 0u);
+
+    // Resume and finish with blocking sends
+    queueFill = 0.0;
+    while (sent < total) {
+        ssize_t n = send(fds[0], chunk.data(), std::min(chunk.size(), total - sent), 0);
+        ASSERT_GT(n, 0);
+        sent += static_cast<size_t>(n);
+    }
+    close(fds[0]);
+    reader.join();
+    close(fds[1]);
+    EXPECT_EQ(received.load(), total);
+    EXPECT_EQ(bp.stats().pauses, 1u);
+}
+
+// Test shed lines are counted per feed and summed, and the report reads well
+TEST(BackpressureTest, ShedCounters) {
+    Backpressure bp(0.5, 0.1, OverloadPolicy::Shed, 3);
+    EXPECT_EQ(bp.policy(), OverloadPolicy::Shed);
+    for (int i = 0; i < 5; ++i) bp.record_shed(0);
+    for (int i = 0; i < 7; ++i) bp.record_shed(2);
+    BackpressureStats before = bp.stats();
+    bp.record_shed(1);
+
+    BackpressureStats s = bp.stats();
+    EXPECT_EQ(s.shed, 13u);
+    EXPECT_EQ(bp.feed(2).shed.load(), 7u);
+    EXPECT_EQ(s.since(before).shed, 1u);
+
+    std::ostringstream out;
+    out << s;
+    EXPECT_EQ(out.str(), "0 overloads, 0 pauses for 0 ms, 13 shed");
+
+    OverloadPolicy policy;
+    EXPECT_TRUE(parse_overload_policy("pause", policy));
+    EXPECT_EQ(policy, OverloadPolicy::Pause);
+    EXPECT_FALSE(parse_overload_policy("drop", policy));
+    EXPECT_STREQ(overload_policy_name(OverloadPolicy::Shed), "shed");
+}
@@ -0,0 +1,121 @@
+#include "batch_controller.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using namespace std::chrono_literals;
+using Clock = BatchController::Clock;
+
+// Adds `count` trades one microsecond apart, returning the time of the last
+Clock::time_point addTrades(BatchController& c, size_t count, Clock::time_point start) {
+    for (size_t i = 0; i < count; ++i) c.on_add(start + std::chrono::microseconds(i));
+    return start + std::chrono::microseconds(count);
+}
+
+}   // namespace
+
+// Test a batch is sent as soon as it reaches the target
+TEST(BatchControllerTest, FlushesWhenFull) {
+    BatchController c(4, 100, 20ms);
+    auto t = Clock::now();
+    addTrades(c, 3, t);
+    EXPECT_EQ(c.check(10, t), FlushReason::None);
+    c.on_add(t);
+    EXPECT_EQ(c.check(10, t), FlushReason::Full);
+}
+
+// Test a backlog doubles the target each flush, up to the maximum
+TEST(BatchControllerTest, GrowsWithQueueDepth) {
+    BatchController c(4, 100, 1s);
+    auto t = Clock::now();
+    size_t expected = 4;
+    for (int i = 0; i < 10; ++i) {
+        t = addTrades(c, c.target(), t);
+        ASSERT_EQ(c.check(1000, t), FlushReason::Full);
+        c.on_flush(FlushReason::Full, 100us, 1000);
+        expected = std::min<size_t>(expected * 2, 100);
+        EXPECT_EQ(c.target(), expected);
+    }
+}
+
+// Test partial batches go once the queue is empty and quiet, and shrink the target
+TEST(BatchControllerTest, IdleFlushShrinks) {
+    BatchController c(2, 1000, 1s, 1ms);
+    auto t = Clock::now();
+    for (int i = 0; i < 5; ++i) {
+        t = addTrades(c, c.target(), t);
+        c.on_flush(FlushReason::Full, 10us, 10000);
+    }
+    ASSERT_EQ(c.target(), 64u);
+
+    c.on_add(t);
+    EXPECT_EQ(c.check(5, t + 5ms), FlushReason::None);   // More is coming
+    EXPECT_EQ(c.check(0, t + 500us), FlushReason::None);  // Not quiet long enough
+    EXPECT_EQ(c.check(0, t + 1ms), FlushReason::Idle);
+    c.on_flush(FlushReason::Idle, 10us, 0);
+    EXPECT_EQ(c.target(), 32u);
+}
+
+// Test the oldest trade is sent early enough to meet the SLO including the flush itself
+TEST(BatchControllerTest, DeadlineAllowsForFlushTime) {
+    BatchController c(100, 1000, 20ms);
+    auto t = Clock::now();
+    addTrades(c, 10, t);
+    c.on_flush(FlushReason::Full, 5ms, 0);   // Teaches a 5 ms flush
+
+    c.on_add(t);
+    EXPECT_EQ(c.check(3, t + 14ms), FlushReason::None);
+    EXPECT_EQ(c.check(3, t + 15ms), FlushReason::Deadline);
+}
+
+// Test a slow database caps the target so a full batch still meets the SLO
+TEST(BatchControllerTest, SloCapsTarget) {
+    BatchController c(1, 100000, 20ms);
+    auto t = Clock::now();
+    for (int i = 0; i < 30; ++i) {
+        size_t n = c.target();
+        t = addTrades(c, n, t);
+        // 100 us per trade: half the SLO holds 100 trades
+        c.on_flush(FlushReason::Full, std::chrono::microseconds(100 * n), 1000000);
+    }
+    EXPECT_LE(c.target(), 100u);
+    EXPECT_GE(c.target(), 64u);
+}
+
+// Test stats count flushes by reason and batch sizes by bucket
+TEST(BatchControllerTest, Stats) {
+    BatchController c(1, 1000, 1s);
+    auto t = Clock::now();
+    t = addTrades(c, 1, t);
+    c.on_flush(FlushReason::Full, 10us, 0);
+    t = addTrades(c, 5, t);
+    c.on_flush(FlushReason::Deadline, 10us, 0);
+    t = addTrades(c, 7, t);
+    c.on_flush(FlushReason::Idle, 10us, 0);
+
+    const BatchStats& s = c.statistics();
+    EXPECT_EQ(s.trades, 13u);
+    EXPECT_EQ(s.batches, 3u);
+    EXPECT_EQ(s.flushes[static_cast<size_t>(FlushReason::Full)], 1u);
+    EXPECT_EQ(s.flushes[static_cast<size_t>(FlushReason::Deadline)], 1u);
+    EXPECT_EQ(s.flushes[static_cast<size_t>(FlushReason::Idle)], 1u);
+    EXPECT_EQ(s.sizes[0], 1u);   // 1
+    EXPECT_EQ(s.sizes[2], 2u);   // 5 and 7
+    EXPECT_EQ(s.largest, 7u);
+
+    std::ostringstream os;
+    os << s;
+    EXPECT_NE(os.str().find("13 trades in 3 batches"), std::string::npos) << os.str();
+    EXPECT_NE(os.str().find("deadline 1"), std::string::npos) << os.str();
+    EXPECT_NE(os.str().find("4+:2"), std::string::npos) << os.str();
+
+    c.reset_stats();
+    EXPECT_EQ(c.statistics().batches, 0u);
+    EXPECT_EQ(c.statistics().target, c.target());
+}
@@ -0,0 +1,136 @@
+#include "async_logger.h"
+#include "binary_log.h"
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "trade.h"
+
+namespace {
+
+std::vector<std::string> messages(const std::string& text) {
+    std::vector<std::string> out;
+    std::istringstream is(text);
+    std::string line;
+    while (std::getline(is, line)) out.push_back(line.size() > 18 ? line.substr(18) : "");
+    return out;
+}
+
+size_t occurrences(const std::string& haystack, const std::string& needle) {
+    size_t count = 0;
+    for (size_t pos = haystack.find(needle); pos != std::string::npos; pos = haystack.find(needle, pos + 1)) ++count;
+    return count;
+}
+
+LogSite tradeSite("[Consumer {}] Got trade {} side {} at {} x{} late={} grade {}");
+LogSite shortSite("only {} and {}");
+LogSite plainSite("no placeholders");
+
+// Logs the same lines through `logger`, whatever its output
+void logSample(AsyncLogger& logger) {
+    Trade t;
+    t.control_id.assign("C42");
+    t.cusip.assign("037833100");
+    t.side.assign("BUY");
+    t.price = 101.25;
+    t.has_price = true;
+    logger.info(tradeSite, 3, t.control_id, t.side, t.price, int64_t(-5), true, 'A');
+    logger.warn(shortSite, 1);                      // Too few arguments
+    logger.warn(shortSite, 1, 2u, "extra", 2.5);    // Too many
+    logger.error(plainSite);
+    logger.info("plain ", 7, " line\n");            // No site, trailing newline
+    logger.info("trade ", t);                       // operator<< fallback
+    logger.info(tradeSite, 1, t, "x", 0.1, uint8_t(200), false, '-');
+}
+
+}   // namespace
+
+// Test a decoded binary log reads exactly like the text log of the same calls
+TEST(BinaryLogTest, MatchesTextOutput) {
+    std::ostringstream text;
+    {
+        AsyncLogger logger(text);
+        logSample(logger);
+    }
+
+    std::stringstream binary;
+    {
+        AsyncLogger logger(binary, LogLevel::Info, 1024, LogOutput::Binary);
+        logSample(logger);
+    }
+
+    std::ostringstream decoded;
+    std::string error;
+    ASSERT_TRUE(decode_binary_log(binary, decoded, error)) << error;
+    auto want = messages(text.str());
+    ASSERT_EQ(want.size(), 7u);
+    EXPECT_EQ(want[0], "[Consumer 3] Got trade C42 side BUY at 101.25 x-5 late=true grade A");
+    EXPECT_EQ(want[1], "only 1 and {}");
+    EXPECT_EQ(want[2], "only 1 and 2 extra 2.5");
+    EXPECT_EQ(messages(decoded.str()), want);
+}
+
+// Test each format is stored once however often its site logs
+TEST(BinaryLogTest, FormatWrittenOnce) {
+    LogSite site("tick {} of many");
+    std::stringstream binary;
+    {
+        AsyncLogger logger(binary, LogLevel::Info, 1024, LogOutput::Binary);
+        for (int i = 0; i < 100; ++i) logger.info(site, i);
+    }
+    EXPECT_EQ(occurrences(binary.str(), "tick {} of many"), 1u);
+
+    std::ostringstream decoded;
+    std::string error;
+    ASSERT_TRUE(decode_binary_log(binary, decoded, error)) << error;
+    auto got = messages(decoded.str());
+    ASSERT_EQ(got.size(), 100u);
+    EXPECT_EQ(got[99], "tick 99 of many");
+}
+
+// Test arguments that overflow the record are cut and marked
+TEST(BinaryLogTest, TruncatedArguments) {
+    LogSite site("{} then {}");
+    std::stringstream binary;
+    {
+        AsyncLogger logger(binary, LogLevel::Info, 1024, LogOutput::Binary);
+        logger.info(site, std::string(500, 'y'), 1);
+    }
+    std::ostringstream decoded;
+    std::string error;
+    ASSERT_TRUE(decode_binary_log(binary, decoded, error)) << error;
+    auto got = messages(decoded.str());
+    ASSERT_EQ(got.size(), 1u);
+    EXPECT_EQ(got[0], std::string(AsyncLogger::line_capacity - 3, 'y') + " then {}...");
+}
+
+// Test a log cut off mid-record decodes up to the damage and reports it
+TEST(BinaryLogTest, TornTail) {
+    LogSite site("record {}");
+    std::stringstream binary;
+    {
+        AsyncLogger logger(binary, LogLevel::Info, 1024, LogOutput::Binary);
+        for (int i = 0; i < 3; ++i) logger.info(site, i);
+    }
+    std::string bytes = binary.str();
+    std::istringstream torn(bytes.substr(0, bytes.size() - 4));
+
+    std::ostringstream decoded;
+    std::string error;
+    EXPECT_FALSE(decode_binary_log(torn, decoded, error));
+    EXPECT_NE(error.find("mid-frame"), std::string::npos) << error;
+    EXPECT_EQ(messages(decoded.str()), (std::vector<std::string>{"record 0", "record 1"}));
+}
+
+// Test files that aren't binary logs are rejected
+TEST(BinaryLogTest, RejectsOtherFiles) {
+    std::istringstream text("12:00:00.000000 I hello\n");
+    std::ostringstream decoded;
+    std::string error;
+    EXPECT_FALSE(decode_binary_log(text, decoded, error));
+    EXPECT_EQ(error, "not a binary log");
+}
@@ -0,0 +1,70 @@
+#include "command_line.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+struct Args {
+    bool verbose = false;
+    size_t count = 0;
+    double rate = 0;
+};
+
+bool parse(std::vector<const char*> flags, Args& args, bool& help, std::string& error) {
+    flags.insert(flags.begin(), "tool");
+    auto on_switch = [&](std::string_view flag) {
+        if (flag != "--verbose") return false;
+        args.verbose = true;
+        return true;
+    };
+    auto on_value = [&](std::string_view flag, std::string_view value, bool& ok) {
+        if (flag == "--count") ok = parse_count(value, args.count);
+        else if (flag == "--rate") ok = parse_number(value, args.rate);
+        else return false;
+        return true;
+    };
+    return parse_flags(static_cast<int>(flags.size()), const_cast<char**>(flags.data()), help, error, on_switch,
+                       on_value);
+}
+
+}   // namespace
+
+// Test numbers must be non-negative and counts whole
+TEST(CommandLineTest, Numbers) {
+    double d = 0;
+    EXPECT_TRUE(parse_number("2.5", d));
+    EXPECT_DOUBLE_EQ(d, 2.5);
+    EXPECT_FALSE(parse_number("-1", d));
+    EXPECT_FALSE(parse_number("", d));
+    EXPECT_FALSE(parse_number("3x", d));
+
+    size_t n = 0;
+    EXPECT_TRUE(parse_count("1e3", n));
+    EXPECT_EQ(n, 1000u);
+    EXPECT_FALSE(parse_count("1.5", n));
+}
+
+// Test switches, values, help and each kind of bad flag
+TEST(CommandLineTest, Flags) {
+    Args args;
+    bool help = false;
+    std::string error;
+    ASSERT_TRUE(parse({"--count", "4", "--verbose", "--rate", "0.5"}, args, help, error)) << error;
+    EXPECT_TRUE(args.verbose);
+    EXPECT_EQ(args.count, 4u);
+    EXPECT_DOUBLE_EQ(args.rate, 0.5);
+    EXPECT_FALSE(help);
+
+    EXPECT_TRUE(parse({"-h"}, args, help, error));
+    EXPECT_TRUE(help);
+
+    EXPECT_FALSE(parse({"--count"}, args, help, error));
+    EXPECT_EQ(error, "--count needs a value");
+    EXPECT_FALSE(parse({"--count", "two"}, args, help, error));
+    EXPECT_EQ(error, "bad value for --count: two");
+    EXPECT_FALSE(parse({"--colour", "red"}, args, help, error));
+    EXPECT_EQ(error, "unknown option --colour");
+}
@@ -0,0 +1,59 @@
+#include "connection_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// Nothing listens on port 1, so connects are refused straight away
+constexpr const char* UNREACHABLE = "host=127.0.0.1 port=1 connect_timeout=1";
+
+}   // namespace
+
+// Test an empty lease is safe to use and reports no connection
+TEST(ConnectionPoolTest, EmptyLease) {
+    ConnectionPool::Lease lease;
+    EXPECT_FALSE(lease);
+    EXPECT_EQ(lease.get(), nullptr);
+    EXPECT_EQ(lease.session(), 0u);
+    EXPECT_FALSE(lease.prepare("s", "SELECT 1", 0, nullptr));
+    lease.discard();
+    lease.release();
+}
+
+// Test acquire gives up after its timeout while the database is unreachable
+TEST(ConnectionPoolTest, AcquireTimesOutWhenDown) {
+    ConnectionPool pool(UNREACHABLE, 2, 200ms);
+    EXPECT_EQ(pool.size(), 2u);
+    EXPECT_EQ(pool.connect_all(), 0u);
+
+    auto start = std::chrono::steady_clock::now();
+    ConnectionPool::Lease lease = pool.acquire(150ms);
+    auto waited = std::chrono::steady_clock::now() - start;
+    EXPECT_FALSE(lease);
+    EXPECT_GE(waited, 150ms);
+    EXPECT_LT(waited, 5s);
+    EXPECT_EQ(pool.reconnect_count(), 0u);
+}
+
+// Test many threads waiting on a dead pool all return, none hang
+TEST(ConnectionPoolTest, ConcurrentAcquireWhenDown) {
+    ConnectionPool pool(UNREACHABLE, 2, 50ms);
+    std::atomic<int> empty{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < 3; ++j) {
+                if (!pool.acquire(100ms)) ++empty;
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    EXPECT_EQ(empty.load(), 24);
+}
@@ -0,0 +1,130 @@
+#include "cpu_topology.h"
+
+#include <sys/stat.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+void writeFile(const std::string& path, const std::string& text) {
+    std::ofstream out(path);
+    out << text << "\n";
+}
+
+// A two-socket, two-node machine with 8 CPUs, CPUs 0-3 on node 0
+std::string fakeSysfs() {
+    std::string root = testing::TempDir() + "fake_sysfs";
+    for (const char* dir : {"", "/cpu", "/node", "/node/node0", "/node/node1"}) {
+        mkdir((root + dir).c_str(), 0755);
+    }
+    writeFile(root + "/cpu/online", "0-7");
+    for (int cpu = 0; cpu < 8; ++cpu) {
+        std::string dir = root + "/cpu/cpu" + std::to_string(cpu);
+        mkdir(dir.c_str(), 0755);
+        mkdir((dir + "/topology").c_str(), 0755);
+        writeFile(dir + "/topology/core_id", std::to_string(cpu % 4));
+        writeFile(dir + "/topology/physical_package_id", std::to_string(cpu / 4));
+    }
+    writeFile(root + "/node/online", "0-1");
+    writeFile(root + "/node/node0/cpulist", "0-3");
+    writeFile(root + "/node/node1/cpulist", "4-7");
+    return root;
+}
+
+struct Counted {
+    static int live;
+    int values[5000];
+    explicit Counted(int v) {
+        ++live;
+        values[0] = v;
+    }
+    ~Counted() { --live; }
+};
+int Counted::live = 0;
+
+}   // namespace
+
+// Test kernel CPU lists parse and format back the same
+TEST(CpuTopologyTest, CpuRanges) {
+    std::vector<int> cpus;
+    ASSERT_TRUE(parse_cpu_ranges("0-3,8,10-11\n", cpus));
+    EXPECT_EQ(cpus, (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(format_cpu_ranges(cpus), "0-3,8,10-11");
+
+    EXPECT_TRUE(parse_cpu_ranges("", cpus));
+    EXPECT_TRUE(cpus.empty());
+    EXPECT_FALSE(parse_cpu_ranges("3-1", cpus));
+    EXPECT_FALSE(parse_cpu_ranges("0,,1", cpus));
+    EXPECT_FALSE(parse_cpu_ranges("a-b", cpus));
+}
+
+// Test packages, cores and nodes are read from sysfs
+TEST(CpuTopologyTest, DetectFromSysfs) {
+    CpuTopology t = CpuTopology::detect(fakeSysfs());
+    ASSERT_EQ(t.cpus().size(), 8u);
+    EXPECT_EQ(t.nodes(), 2);
+    EXPECT_EQ(t.packages(), 2);
+    EXPECT_EQ(t.node_of(2), 0);
+    EXPECT_EQ(t.node_of(6), 1);
+    EXPECT_EQ(t.node_of(9), -1);
+    EXPECT_EQ(t.find(5)->core, 1);
+    EXPECT_EQ(t.cpus_on_node(1), (std::vector<int>{4, 5, 6, 7}));
+
+    std::ostringstream os;
+    os << t;
+    EXPECT_EQ(os.str(), "8 CPUs in 2 package(s), 2 NUMA node(s)\n  node 0: CPUs 0-3\n  node 1: CPUs 4-7");
+}
+
+// Test a missing sysfs falls back to one node holding every online CPU
+TEST(CpuTopologyTest, DetectWithoutSysfs) {
+    CpuTopology t = CpuTopology::detect(testing::TempDir() + "no_such_sysfs");
+    EXPECT_EQ(t.nodes(), 1);
+    EXPECT_FALSE(t.cpus().empty());
+    EXPECT_EQ(t.cpus_on_node(0).size(), t.cpus().size());
+}
+
+// Test a thread pinned to a CPU runs only there
+TEST(CpuTopologyTest, PinThread) {
+    std::vector<int> allowed = current_thread_cpus();
+    ASSERT_FALSE(allowed.empty());
+    int target = allowed.back();
+
+    std::vector<int> seen;
+    bool pinned = false;
+    std::string error;
+    std::thread t([&]() {
+        pinned = pin_current_thread(target, error);
+        seen = current_thread_cpus();
+    });
+    t.join();
+    ASSERT_TRUE(pinned) << error;
+    EXPECT_EQ(seen, std::vector<int>{target});
+
+    EXPECT_FALSE(pin_current_thread(-1, error));
+    EXPECT_FALSE(error.empty());
+}
+
+// Test NodeLocal constructs and destroys its object, placed or not
+TEST(CpuTopologyTest, NodeLocal) {
+    {
+        NodeLocal<Counted> holder;
+        EXPECT_FALSE(holder);
+        ASSERT_TRUE(holder.create(0, 42));
+        EXPECT_EQ(Counted::live, 1);
+        EXPECT_EQ(holder->values[0], 42);
+        EXPECT_GE(holder.size_bytes(), sizeof(Counted));
+        EXPECT_TRUE(holder.bound() == 0 || holder.bound() == -1);
+
+        ASSERT_TRUE(holder.create(-1, 7));   // Replaces the first
+        EXPECT_EQ(Counted::live, 1);
+        EXPECT_EQ(holder.bound(), -1);
+        EXPECT_EQ((*holder).values[0], 7);
+    }
+    EXPECT_EQ(Counted::live, 0);
+}
@@ -0,0 +1,141 @@
+#include "flat_string_map.h"
+
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+// Same issuer universe as ISSUERS in fake_trace_generator.py
+const std::vector<std::string> kIssuers = {
+    "3M", "Amgen", "Apple", "American Express", "Boeing", "Caterpillar",
+    "Chevron", "Cisco Systems", "Coca-Cola", "Disney", "Dow Inc.", "Goldman Sachs",
+    "Home Depot", "Honeywell", "IBM", "Intel", "Johnson & Johnson", "JPMorgan Chase",
+    "Merck", "Microsoft", "Nike", "Procter & Gamble", "Salesforce",
+    "Travelers", "Verizon", "Visa", "Walgreens Boots Alliance", "Walmart"
+};
+
+}   // namespace
+
+// Test basic insert and lookup
+TEST(FlatStringMapTest, InsertAndFind) {
+    FlatStringMap<int> m;
+    m.insert_or_assign("Apple", 1);
+    m.insert_or_assign("IBM", 2);
+    EXPECT_EQ(m.size(), 2u);
+    ASSERT_NE(m.find("Apple"), nullptr);
+    EXPECT_EQ(*m.find("Apple"), 1);
+    ASSERT_NE(m.find("IBM"), nullptr);
+    EXPECT_EQ(*m.find("IBM"), 2);
+    EXPECT_EQ(m.find("Intel"), nullptr);
+}
+
+// Test that lookups on an empty map miss
+TEST(FlatStringMapTest, EmptyMap) {
+    FlatStringMap<int> m;
+    EXPECT_TRUE(m.empty());
+    EXPECT_EQ(m.find("Apple"), nullptr);
+    EXPECT_EQ(m.find(""), nullptr);
+}
+
+// Test that inserting an existing key overwrites its value
+TEST(FlatStringMapTest, InsertOverwrites) {
+    FlatStringMap<std::string> m;
+    m.insert_or_assign("Boeing", "AA");
+    m.insert_or_assign("Boeing", "BBB");
+    EXPECT_EQ(m.size(), 1u);
+    EXPECT_EQ(*m.find("Boeing"), "BBB");
+}
+
+// Test keys that don't fit inline are stored and compared correctly
+TEST(FlatStringMapTest, LongKeys) {
+    FlatStringMap<int, 8> m;
+    m.insert_or_assign("Walgreens Boots Alliance", 1);
+    m.insert_or_assign("Walgreens Boots Alliance Holdings", 2);
+    m.insert_or_assign("Short", 3);
+    EXPECT_EQ(*m.find("Walgreens Boots Alliance"), 1);
+    EXPECT_EQ(*m.find("Walgreens Boots Alliance Holdings"), 2);
+    EXPECT_EQ(*m.find("Short"), 3);
+    EXPECT_EQ(m.find("Walgreens Boots"), nullptr);
+}
+
+// Test lookups with a string_view that isn't null terminated
+TEST(FlatStringMapTest, HeterogeneousLookup) {
+    FlatStringMap<int> m;
+    m.insert_or_assign("Coca-Cola", 5);
+    std::string line = "Coca-Cola,Disney";
+    EXPECT_EQ(*m.find(std::string_view(line).substr(0, 9)), 5);
+    EXPECT_EQ(m.find(std::string_view(line).substr(0, 4)), nullptr);
+}
+
+// Test the empty string is a valid key
+TEST(FlatStringMapTest, EmptyKey) {
+    FlatStringMap<int> m;
+    m.insert_or_assign("", 9);
+    ASSERT_NE(m.find(""), nullptr);
+    EXPECT_EQ(*m.find(""), 9);
+}
+
+// Test growth keeps every entry reachable
+TEST(FlatStringMapTest, GrowPreservesEntries) {
+    FlatStringMap<size_t> m;
+    constexpr size_t N = 10000;
+    for (size_t i = 0; i < N; ++i) {
+        m.insert_or_assign("issuer-" + std::to_string(i), i);
+    }
+    EXPECT_EQ(m.size(), N);
+    EXPECT_LE(m.size() * 2, m.capacity());
+    for (size_t i = 0; i < N; ++i) {
+        const size_t* v = m.find("issuer-" + std::to_string(i));
+        ASSERT_NE(v, nullptr);
+        EXPECT_EQ(*v, i);
+    }
+    EXPECT_EQ(m.find("issuer-" + std::to_string(N)), nullptr);
+}
+
+// Test reserve avoids growth during inserts
+TEST(FlatStringMapTest, Reserve) {
+    FlatStringMap<int> m(1000);
+    size_t cap = m.capacity();
+    for (int i = 0; i < 1000; ++i) {
+        m.insert_or_assign(std::to_string(i), i);
+    }
+    EXPECT_EQ(m.capacity(), cap);
+}
+
+// Test lookups over the generator's issuer distribution agree with
+// std::unordered_map. Their speed is measured by lookup_bench.
+TEST(FlatStringMapTest, LookupsMatchUnorderedMap) {
+    constexpr size_t LOOKUPS = 10'000;
+
+    struct Info {
+        std::string rating;
+        std::string industry;
+    };
+
+    std::unordered_map<std::string, Info> stdMap;
+    FlatStringMap<Info> flatMap;
+    for (const auto& issuer : kIssuers) {
+        stdMap[issuer] = {"AA", "Industrials"};
+        flatMap.insert_or_assign(issuer, {"AA", "Industrials"});
+    }
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> pick(0, kIssuers.size() - 1);
+    size_t stdHits = 0;
+    size_t flatHits = 0;
+    for (size_t i = 0; i < LOOKUPS; ++i) {
+        std::string_view key = kIssuers[pick(rng)];
+        auto it = stdMap.find(std::string(key));
+        if (it != stdMap.end()) stdHits += it->second.rating.size();
+        const Info* info = flatMap.find(key);
+        if (info) flatHits += info->rating.size();
+    }
+
+    EXPECT_EQ(stdHits, flatHits);
+    EXPECT_EQ(flatHits, LOOKUPS * 2);
+}
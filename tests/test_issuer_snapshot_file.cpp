@@ -0,0 +1,159 @@
+#include "issuer_snapshot_file.h"
+#include "issuer_table.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+std::string snapshotPath(const std::string& name) {
+    return testing::TempDir() + name;
+}
+
+std::unique_ptr<IssuerTable> makeTable(size_t issuers) {
+    const char* ratings[] = {"AAA", "AA+", "AA", "A-", "BBB"};
+    const char* industries[] = {"Technology", "Industrials", "Financials", "Health Care"};
+    auto table = std::make_unique<IssuerTable>(IssuerIndexMode::PerfectHash, issuers);
+    for (size_t i = 0; i < issuers; ++i) {
+        table->add("Issuer " + std::to_string(i), ratings[i % 5], industries[i % 4]);
+    }
+    EXPECT_TRUE(table->finalize());
+    return table;
+}
+
+std::vector<char> readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), {});
+}
+
+void writeFile(const std::string& path, const std::vector<char>& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+}   // namespace
+
+// Test a snapshot maps back to a table with identical lookups
+TEST(IssuerSnapshotFileTest, RoundTrip) {
+    std::string path = snapshotPath("roundtrip.snapshot");
+    auto original = makeTable(5000);
+    std::string error;
+    ASSERT_TRUE(write_issuer_snapshot(*original, path, error)) << error;
+
+    auto mapped = map_issuer_snapshot(path, error);
+    ASSERT_NE(mapped, nullptr) << error;
+    EXPECT_TRUE(mapped->is_attached());
+    EXPECT_EQ(mapped->size(), original->size());
+
+    for (size_t i = 0; i < 5000; ++i) {
+        std::string issuer = "Issuer " + std::to_string(i);
+        const IssuerCodes* a = original->find(issuer);
+        const IssuerCodes* b = mapped->find(issuer);
+        ASSERT_NE(a, nullptr);
+        ASSERT_NE(b, nullptr);
+        EXPECT_EQ(original->rating(*a), mapped->rating(*b));
+        EXPECT_EQ(original->industry(*a), mapped->industry(*b));
+    }
+    EXPECT_EQ(mapped->find("Issuer 5000"), nullptr);
+    std::remove(path.c_str());
+}
+
+// Test an empty table survives a round trip
+TEST(IssuerSnapshotFileTest, EmptyTable) {
+    std::string path = snapshotPath("empty.snapshot");
+    auto original = makeTable(0);
+    std::string error;
+    ASSERT_TRUE(write_issuer_snapshot(*original, path, error)) << error;
+    auto mapped = map_issuer_snapshot(path, error);
+    ASSERT_NE(mapped, nullptr) << error;
+    EXPECT_EQ(mapped->size(), 0u);
+    EXPECT_EQ(mapped->find("Apple"), nullptr);
+    std::remove(path.c_str());
+}
+
+// Test a mapped table stays usable after the file is replaced or deleted
+TEST(IssuerSnapshotFileTest, MappingOutlivesFile) {
+    std::string path = snapshotPath("replaced.snapshot");
+    std::string error;
+    ASSERT_TRUE(write_issuer_snapshot(*makeTable(100), path, error)) << error;
+    auto mapped = map_issuer_snapshot(path, error);
+    ASSERT_NE(mapped, nullptr) << error;
+
+    ASSERT_TRUE(write_issuer_snapshot(*makeTable(10), path, error)) << error;
+    std::remove(path.c_str());
+    EXPECT_EQ(mapped->size(), 100u);
+    EXPECT_NE(mapped->find("Issuer 99"), nullptr);
+}
+
+// Test flat tables are refused since their layout isn't snapshot-friendly
+TEST(IssuerSnapshotFileTest, FlatTableNotWritten) {
+    IssuerTable flat(IssuerIndexMode::Flat);
+    flat.add("Apple", "AA+", "Technology");
+    ASSERT_TRUE(flat.finalize());
+    std::string error;
+    EXPECT_FALSE(write_issuer_snapshot(flat, snapshotPath("flat.snapshot"), error));
+    EXPECT_FALSE(error.empty());
+}
+
+// Test missing files are reported, not fatal
+TEST(IssuerSnapshotFileTest, MissingFile) {
+    std::string error;
+    EXPECT_EQ(map_issuer_snapshot(snapshotPath("does-not-exist.snapshot"), error), nullptr);
+    EXPECT_FALSE(error.empty());
+}
+
+// Test corrupted, truncated and wrong-version files are all rejected
+TEST(IssuerSnapshotFileTest, RejectsDamagedFiles) {
+    std::string path = snapshotPath("damaged.snapshot");
+    std::string error;
+    ASSERT_TRUE(write_issuer_snapshot(*makeTable(1000), path, error)) << error;
+    std::vector<char> good = readFile(path);
+    ASSERT_GT(good.size(), sizeof(IssuerSnapshotHeader));
+
+    // Flip one payload byte
+    std::vector<char> corrupt = good;
+    corrupt[corrupt.size() / 2] ^= 0x40;
+    writeFile(path, corrupt);
+    EXPECT_EQ(map_issuer_snapshot(path, error), nullptr);
+    EXPECT_NE(error.find("checksum"), std::string::npos) << error;
+
+    // Cut off the tail
+    std::vector<char> truncated(good.begin(), good.end() - 16);
+    writeFile(path, truncated);
+    EXPECT_EQ(map_issuer_snapshot(path, error), nullptr);
+
+    // Cut into the header
+    std::vector<char> headerOnly(good.begin(), good.begin() + 10);
+    writeFile(path, headerOnly);
+    EXPECT_EQ(map_issuer_snapshot(path, error), nullptr);
+
+    // Future format version
+    std::vector<char> future = good;
+    IssuerSnapshotHeader header;
+    std::memcpy(&header, future.data(), sizeof(header));
+    header.version = ISSUER_SNAPSHOT_VERSION + 1;
+    std::memcpy(future.data(), &header, sizeof(header));
+    writeFile(path, future);
+    EXPECT_EQ(map_issuer_snapshot(path, error), nullptr);
+    EXPECT_NE(error.find("version"), std::string::npos) << error;
+
+    // A section pointing past the end
+    std::vector<char> outOfBounds = good;
+    std::memcpy(&header, outOfBounds.data(), sizeof(header));
+    header.keys.size = good.size();
+    std::memcpy(outOfBounds.data(), &header, sizeof(header));
+    writeFile(path, outOfBounds);
+    EXPECT_EQ(map_issuer_snapshot(path, error), nullptr);
+
+    // The original still maps fine
+    writeFile(path, good);
+    EXPECT_NE(map_issuer_snapshot(path, error), nullptr) << error;
+    std::remove(path.c_str());
+}
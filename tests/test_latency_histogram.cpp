@@ -0,0 +1,126 @@
+#include "latency_histogram.h"
+
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+// Test every value lands in a bucket whose top is within 1/32 above it
+TEST(LatencyHistogramTest, Buckets) {
+    using namespace latency_detail;
+    size_t previous = 0;
+    for (uint64_t v = 0; v < (uint64_t{1} << 40); v = v < 200 ? v + 1 : v + v / 7) {
+        size_t b = bucket_of(v);
+        ASSERT_LT(b, bucket_count);
+        ASSERT_GE(b, previous) << v;
+        ASSERT_GE(bucket_top(b), v);
+        ASSERT_LE(bucket_top(b) - v, v / 32) << v;
+        if (b > 0) {
+            ASSERT_LT(bucket_top(b - 1), v) << v;
+        }
+        previous = b;
+    }
+    EXPECT_EQ(bucket_of(63), 63u);
+    EXPECT_EQ(bucket_of(64), 64u);
+    EXPECT_EQ(bucket_of(UINT64_MAX), bucket_count - 1);
+}
+
+// Test percentiles of a uniform spread are within a bucket of the truth
+TEST(LatencyHistogramTest, Percentiles) {
+    LatencyHistogram h;
+    for (uint64_t v = 1; v <= 100000; ++v) h.record(v * 10);
+    LatencySnapshot s = h.snapshot();
+
+    EXPECT_EQ(s.count, 100000u);
+    EXPECT_EQ(s.max_ns, 1000000u);
+    EXPECT_NEAR(s.mean_ns(), 500005.0, 1.0);
+    EXPECT_NEAR(static_cast<double>(s.percentile(0.5)), 500000.0, 500000.0 / 32);
+    EXPECT_NEAR(static_cast<double>(s.percentile(0.99)), 990000.0, 990000.0 / 32);
+    EXPECT_NEAR(static_cast<double>(s.percentile(0.999)), 999000.0, 999000.0 / 32);
+    EXPECT_GE(s.percentile(0.5), 500000u);
+    EXPECT_EQ(s.percentile(1.0), 1000000u);
+    EXPECT_EQ(LatencySnapshot().percentile(0.99), 0u);
+}
+
+// Test interval snapshots see only what was recorded since the last one
+TEST(LatencyHistogramTest, Since) {
+    LatencyHistogram h;
+    for (int i = 0; i < 1000; ++i) h.record(5000000);
+    LatencySnapshot before = h.snapshot();
+    for (int i = 0; i < 1000; ++i) h.record(1000);
+
+    LatencySnapshot d = h.snapshot().since(before);
+    EXPECT_EQ(d.count, 1000u);
+    EXPECT_EQ(d.percentile(0.99), latency_detail::bucket_top(latency_detail::bucket_of(1000)));
+    EXPECT_LT(d.max_ns, 1100u);
+    EXPECT_EQ(h.snapshot().max_ns, 5000000u);
+}
+
+// Test per-thread histograms merge while being written, and add up
+TEST(LatencyHistogramTest, RecorderMergesThreads) {
+    constexpr size_t threads = 4;
+    constexpr uint64_t perThread = 200000;
+    LatencyRecorder recorder({"queue", "total"}, threads);
+    ASSERT_EQ(recorder.stages().size(), 2u);
+
+    std::vector<std::thread> writers;
+    for (size_t t = 0; t < threads; ++t) {
+        writers.emplace_back([&recorder, t]() {
+            for (uint64_t i = 0; i < perThread; ++i) {
+                recorder.at(t, 0).record(100 * (t + 1));
+                recorder.at(t, 1).record(i);
+            }
+        });
+    }
+    uint64_t seen = 0;
+    while (seen < threads * perThread) {
+        uint64_t now = recorder.snapshot(0).count;
+        EXPECT_GE(now, seen);
+        seen = now;
+    }
+    for (auto& w : writers) w.join();
+
+    LatencySnapshot queue = recorder.snapshot(0);
+    EXPECT_EQ(queue.count, threads * perThread);
+    EXPECT_EQ(queue.max_ns, 400u);
+    EXPECT_EQ(queue.sum_ns, perThread * (100 + 200 + 300 + 400));
+    EXPECT_LE(queue.percentile(0.25), 100u + 100 / 32);
+    EXPECT_EQ(recorder.snapshot(1).count, threads * perThread);
+
+    LatencySnapshot merged;
+    merged.merge(queue);
+    merged.merge(queue);
+    EXPECT_EQ(merged.count, 2 * queue.count);
+    EXPECT_EQ(merged.percentile(0.5), queue.percentile(0.5));
+}
+
+// Test TSC stamps convert to roughly the wall time between them
+TEST(LatencyHistogramTest, TscClock) {
+    TscClock::calibrate();
+    EXPECT_GT(TscClock::ticks_per_ns(), 0.0);
+    uint64_t start = TscClock::now();
+    std::this_thread::sleep_for(20ms);
+    uint64_t end = TscClock::now();
+    uint64_t ns = TscClock::elapsed_ns(start, end);
+    EXPECT_GE(ns, 19000000u);
+    EXPECT_LT(ns, 200000000u);
+    EXPECT_EQ(TscClock::elapsed_ns(0, end), 0u);
+    EXPECT_EQ(TscClock::elapsed_ns(end, start), 0u);
+}
+
+// Test the summary line's units
+TEST(LatencyHistogramTest, Summary) {
+    LatencyHistogram h;
+    for (int i = 0; i < 98; ++i) h.record(800);
+    h.record(25000);
+    h.record(42000000);
+
+    std::ostringstream out;
+    print_latency_summary(out, "total", h.snapshot());
+    EXPECT_EQ(out.str(), "[Latency total] 100 trades, p50 815 ns, p99 25.1 us, p99.9 42.0 ms, max 42.0 ms");
+}
@@ -0,0 +1,170 @@
+#include "metrics.h"
+#include "metrics_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+// Sends `request` to the loopback listener and returns the whole response
+std::string httpRequest(int port, const std::string& request) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return "";
+    }
+    send(fd, request.data(), request.size(), 0);
+    std::string response;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) response.append(buf, static_cast<size_t>(n));
+    close(fd);
+    return response;
+}
+
+}   // namespace
+
+// Test counters added on many threads sum correctly, also while being read
+TEST(MetricsTest, ThreadCounters) {
+    constexpr size_t threads = 8;
+    constexpr uint64_t perThread = 100000;
+    ThreadCounters counters(3);
+    std::vector<std::thread> writers;
+    for (size_t t = 0; t < threads; ++t) {
+        writers.emplace_back([&counters]() {
+            for (uint64_t i = 0; i < perThread; ++i) {
+                counters.add(0);
+                counters.add(2, 10);
+            }
+        });
+    }
+    uint64_t seen = 0;
+    while (seen < threads * perThread) {
+        uint64_t now = counters.total(0);
+        EXPECT_GE(now, seen);
+        seen = now;
+    }
+    for (auto& w : writers) w.join();
+
+    EXPECT_EQ(counters.total(0), threads * perThread);
+    EXPECT_EQ(counters.total(1), 0u);
+    EXPECT_EQ(counters.total(2), 10 * threads * perThread);
+    EXPECT_EQ(counters.threads(), threads);
+
+    // A second set on the same thread gets its own block
+    ThreadCounters other(1);
+    other.add(0, 5);
+    counters.add(1, 7);
+    EXPECT_EQ(other.total(0), 5u);
+    EXPECT_EQ(counters.total(1), 7u);
+
+    // Counters past the first cache line of a block
+    ThreadCounters wide(20);
+    for (size_t i = 0; i < wide.size(); ++i) wide.add(i, i);
+    for (size_t i = 0; i < wide.size(); ++i) EXPECT_EQ(wide.total(i), i);
+}
+
+// Test a busy thread shows up by name with the CPU time it used
+TEST(MetricsTest, ThreadCpuTimes) {
+    std::atomic<bool> done{false};
+    std::thread busy([&done]() {
+        pthread_setname_np(pthread_self(), "cpu-burner");
+        auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(200);
+        volatile uint64_t x = 0;
+        while (std::chrono::steady_clock::now() < end) x = x + 1;
+        done = true;
+        while (done) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+    while (!done) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    bool found = false;
+    for (const ThreadCpu& t : thread_cpu_times()) {
+        if (t.name != "cpu-burner") continue;
+        found = true;
+        EXPECT_GT(t.seconds, 0.05);
+        EXPECT_LT(t.seconds, 5.0);
+    }
+    done = false;
+    busy.join();
+    EXPECT_TRUE(found);
+}
+
+// Test samples, labels and histograms come out in exposition format
+TEST(MetricsTest, Writer) {
+    std::ostringstream out;
+    MetricsWriter w(out);
+    w.family("trace_feed_bytes_total", "counter", "Bytes read");
+    w.sample("trace_feed_bytes_total", {{"feed", "1"}, {"source", "a\"b\\c"}}, 1234567890);
+    w.sample("trace_up", 0.25);
+    EXPECT_EQ(out.str(),
+              "# HELP trace_feed_bytes_total Bytes read\n"
+              "# TYPE trace_feed_bytes_total counter\n"
+              "trace_feed_bytes_total{feed=\"1\",source=\"a\\\"b\\\\c\"} 1234567890\n"
+              "trace_up 0.25\n");
+
+    LatencyHistogram h;
+    for (int i = 0; i < 3; ++i) h.record(500000);     // 0.5 ms
+    h.record(20000000);                               // 20 ms
+    out.str("");
+    w.histogram("flush_seconds", {{"sink", "copy"}}, h.snapshot(), {0.001, 0.01, 0.1}, 1e9);
+    EXPECT_EQ(out.str(),
+              "flush_seconds_bucket{sink=\"copy\",le=\"0.001\"} 3\n"
+              "flush_seconds_bucket{sink=\"copy\",le=\"0.01\"} 3\n"
+              "flush_seconds_bucket{sink=\"copy\",le=\"0.1\"} 4\n"
+              "flush_seconds_bucket{sink=\"copy\",le=\"+Inf\"} 4\n"
+              "flush_seconds_sum{sink=\"copy\"} 0.0215\n"
+              "flush_seconds_count{sink=\"copy\"} 4\n");
+
+    out.str("");
+    w.summary("latency_seconds", {}, h.snapshot(), {0.5}, 1e9);
+    EXPECT_NE(out.str().find("latency_seconds{quantile=\"0.5\"} 0.000507"), std::string::npos) << out.str();
+    EXPECT_NE(out.str().find("latency_seconds_count 4\n"), std::string::npos);
+}
+
+// Test the listener serves /metrics over loopback and nothing else
+TEST(MetricsTest, Server) {
+    std::atomic<int> renders{0};
+    MetricsServer server([&renders](std::ostream& out) {
+        ++renders;
+        MetricsWriter w(out);
+        w.family("trace_up", "gauge", "Always 1");
+        w.sample("trace_up", 1);
+    });
+    std::string error;
+    ASSERT_TRUE(server.start("127.0.0.1", 0, error)) << error;
+    ASSERT_GT(server.port(), 0);
+
+    std::string ok = httpRequest(server.port(), "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    EXPECT_EQ(ok.rfind("HTTP/1.0 200 OK\r\n", 0), 0u) << ok;
+    EXPECT_NE(ok.find("Content-Type: text/plain; version=0.0.4"), std::string::npos);
+    EXPECT_NE(ok.find("\r\n\r\n# HELP trace_up Always 1\n# TYPE trace_up gauge\ntrace_up 1\n"), std::string::npos);
+
+    std::string missing = httpRequest(server.port(), "GET / HTTP/1.1\r\n\r\n");
+    EXPECT_EQ(missing.rfind("HTTP/1.0 404", 0), 0u) << missing;
+    std::string post = httpRequest(server.port(), "POST /metrics HTTP/1.1\r\n\r\n");
+    EXPECT_EQ(post.rfind("HTTP/1.0 405", 0), 0u) << post;
+
+    EXPECT_EQ(renders.load(), 1);
+    EXPECT_EQ(server.scrapes(), 1u);
+    server.stop();
+    EXPECT_EQ(httpRequest(server.port(), "GET /metrics HTTP/1.1\r\n\r\n"), "");
+
+    MetricsServer bad([](std::ostream&) {});
+    EXPECT_FALSE(bad.start("localhost", 0, error));
+}
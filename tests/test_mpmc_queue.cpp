@@ -1,7 +1,6 @@
 #include "mpmc_queue.h"
 
 #include <atomic>
-#include <chrono>
 #include <thread>
 #include <vector>
 
@@ -32,6 +31,22 @@ TEST(MPMCQueueTest, FullCapacity) {
     EXPECT_FALSE(q.enqueue(6)); // Queue full again
 }
 
+// Test the approximate size tracks enqueues and dequeues when quiescent
+TEST(MPMCQueueTest, SizeApprox) {
+    MPMCQueue<int, 4> q;
+    EXPECT_EQ(q.size_approx(), 0u);
+    q.enqueue(1);
+    q.enqueue(2);
+    EXPECT_EQ(q.size_approx(), 2u);
+    int v;
+    q.dequeue(v);
+    EXPECT_EQ(q.size_approx(), 1u);
+    q.enqueue(3);
+    q.enqueue(4);
+    q.enqueue(5);
+    EXPECT_EQ(q.size_approx(), 4u);
+}
+
 // Test that the queue correctly wraps around using ints
 TEST(MPMCQueueTest, WrapAround) {
     MPMCQueue<int, 4> q;
@@ -95,44 +110,3 @@ TEST(MPMCQueueTest, RealWorldTest) {
     EXPECT_EQ(produced.load(), PRODUCERS * ITEMS_PER);
     EXPECT_EQ(consumed.load(), PRODUCERS * ITEMS_PER);
 }
-
-// This test will always pass in Github actions,
-// but it can be changed and run for benchmarking purposes.
-TEST(MPMCQueueTest, BenchmarkPerformance) {
-    constexpr size_t QUEUE_SIZE = 1024;
-    constexpr size_t BIG_NUMBER = 1'000'000;
-
-    MPMCQueue<size_t, QUEUE_SIZE> q;
-    std::atomic<bool> start{false};
-    std::atomic<size_t> consumed{0};
-
-    auto producer = [&]() {
-        while (!start.load());
-        for (size_t i = 0; i < BIG_NUMBER; ++i) {
-            while (!q.enqueue(i)) {}
-        }
-    };
-
-    auto consumer = [&]() {
-        size_t value;
-        while (!start.load());
-        while (consumed < BIG_NUMBER) {
-            if (q.dequeue(value)) {
-                ++consumed;
-            }
-        }
-    };
-
-    std::thread p(producer), c(consumer);
-    auto t0 = std::chrono::steady_clock::now();
-    start.store(true);
-    p.join();
-    c.join();
-    auto t1 = std::chrono::steady_clock::now();
-
-    std::chrono::duration<double> duration = t1 - t0;
-    std::cout << "Benchmark: " << BIG_NUMBER << " ops in " << duration.count() << " seconds ("
-              << (BIG_NUMBER / duration.count()) << " ops/sec)\n";
-
-    EXPECT_EQ(consumed.load(), BIG_NUMBER);
-}
\ No newline at end of file
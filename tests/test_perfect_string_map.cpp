@@ -0,0 +1,176 @@
+#include "flat_string_map.h"
+#include "issuer_table.h"
+#include "perfect_string_map.h"
+
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+// Same issuer universe as ISSUERS in fake_trace_generator.py
+const std::vector<std::string> kIssuers = {
+    "3M", "Amgen", "Apple", "American Express", "Boeing", "Caterpillar",
+    "Chevron", "Cisco Systems", "Coca-Cola", "Disney", "Dow Inc.", "Goldman Sachs",
+    "Home Depot", "Honeywell", "IBM", "Intel", "Johnson & Johnson", "JPMorgan Chase",
+    "Merck", "Microsoft", "Nike", "Procter & Gamble", "Salesforce",
+    "Travelers", "Verizon", "Visa", "Walgreens Boots Alliance", "Walmart"
+};
+
+}   // namespace
+
+// Test lookups before build() miss
+TEST(PerfectStringMapTest, EmptyBeforeBuild) {
+    PerfectStringMap<int> m;
+    m.insert("Apple", 1);
+    EXPECT_EQ(m.find("Apple"), nullptr);
+    EXPECT_EQ(m.size(), 0u);
+    ASSERT_TRUE(m.build());
+    EXPECT_EQ(*m.find("Apple"), 1);
+}
+
+// Test building over zero keys
+TEST(PerfectStringMapTest, BuildEmpty) {
+    PerfectStringMap<int> m;
+    EXPECT_TRUE(m.build());
+    EXPECT_TRUE(m.empty());
+    EXPECT_EQ(m.find("Apple"), nullptr);
+}
+
+// Test every issuer maps to its own value and strangers miss
+TEST(PerfectStringMapTest, IssuerUniverse) {
+    PerfectStringMap<size_t> m;
+    for (size_t i = 0; i < kIssuers.size(); ++i) {
+        m.insert(kIssuers[i], i);
+    }
+    ASSERT_TRUE(m.build());
+    EXPECT_EQ(m.size(), kIssuers.size());
+    for (size_t i = 0; i < kIssuers.size(); ++i) {
+        const size_t* v = m.find(kIssuers[i]);
+        ASSERT_NE(v, nullptr) << kIssuers[i];
+        EXPECT_EQ(*v, i);
+    }
+    EXPECT_EQ(m.find("Tesla"), nullptr);
+    EXPECT_EQ(m.find(""), nullptr);
+    EXPECT_EQ(m.find("Apple Inc."), nullptr);
+}
+
+// Test a repeated key keeps the last value and doesn't take a second slot
+TEST(PerfectStringMapTest, DuplicateKeysKeepLast) {
+    PerfectStringMap<int> m;
+    m.insert("Boeing", 1);
+    m.insert("Nike", 2);
+    m.insert("Boeing", 3);
+    ASSERT_TRUE(m.build());
+    EXPECT_EQ(m.size(), 2u);
+    EXPECT_EQ(*m.find("Boeing"), 3);
+    EXPECT_EQ(*m.find("Nike"), 2);
+}
+
+// Test inserting after a build and rebuilding keeps the old keys
+TEST(PerfectStringMapTest, InsertAfterBuild) {
+    PerfectStringMap<int> m;
+    m.insert("Visa", 1);
+    ASSERT_TRUE(m.build());
+    m.insert("Merck", 2);
+    ASSERT_TRUE(m.build());
+    EXPECT_EQ(*m.find("Visa"), 1);
+    EXPECT_EQ(*m.find("Merck"), 2);
+}
+
+// Test a large key set is minimal (one slot per key) and complete
+TEST(PerfectStringMapTest, LargeKeySet) {
+    constexpr size_t N = 100000;
+    PerfectStringMap<uint32_t> m;
+    m.reserve(N);
+    for (size_t i = 0; i < N; ++i) {
+        m.insert("issuer-" + std::to_string(i), static_cast<uint32_t>(i));
+    }
+    ASSERT_TRUE(m.build());
+    EXPECT_EQ(m.size(), N);
+    for (size_t i = 0; i < N; ++i) {
+        const uint32_t* v = m.find("issuer-" + std::to_string(i));
+        ASSERT_NE(v, nullptr);
+        EXPECT_EQ(*v, i);
+    }
+    EXPECT_EQ(m.find("issuer-" + std::to_string(N)), nullptr);
+}
+
+// Test both index modes of IssuerTable give the same enrichment
+TEST(IssuerTableTest, ModesAgree) {
+    IssuerTable flat(IssuerIndexMode::Flat);
+    IssuerTable perfect(IssuerIndexMode::PerfectHash);
+    const char* ratings[] = {"AAA", "AA", "A", "BBB"};
+    const char* industries[] = {"Technology", "Industrials", "Financials"};
+    for (size_t i = 0; i < kIssuers.size(); ++i) {
+        ASSERT_TRUE(flat.add(kIssuers[i], ratings[i % 4], industries[i % 3]));
+        ASSERT_TRUE(perfect.add(kIssuers[i], ratings[i % 4], industries[i % 3]));
+    }
+    ASSERT_TRUE(flat.finalize());
+    ASSERT_TRUE(perfect.finalize());
+    EXPECT_EQ(flat.size(), kIssuers.size());
+    EXPECT_EQ(perfect.size(), kIssuers.size());
+
+    for (size_t i = 0; i < kIssuers.size(); ++i) {
+        const IssuerCodes* a = flat.find(kIssuers[i]);
+        const IssuerCodes* b = perfect.find(kIssuers[i]);
+        ASSERT_NE(a, nullptr);
+        ASSERT_NE(b, nullptr);
+        EXPECT_EQ(flat.rating(*a), ratings[i % 4]);
+        EXPECT_EQ(perfect.rating(*b), ratings[i % 4]);
+        EXPECT_EQ(flat.industry(*a), industries[i % 3]);
+        EXPECT_EQ(perfect.industry(*b), industries[i % 3]);
+    }
+    EXPECT_EQ(flat.find("Tesla"), nullptr);
+    EXPECT_EQ(perfect.find("Tesla"), nullptr);
+}
+
+// Test ratings and industries are interned into shared dictionaries
+TEST(IssuerTableTest, InternsDictionaries) {
+    IssuerTable table;
+    ASSERT_TRUE(table.add("Apple", "AA", "Technology"));
+    ASSERT_TRUE(table.add("Intel", "A", "Technology"));
+    ASSERT_TRUE(table.add("Boeing", "A", "Industrials"));
+    ASSERT_TRUE(table.finalize());
+    EXPECT_EQ(table.find("Apple")->industry_id, table.find("Intel")->industry_id);
+    EXPECT_EQ(table.find("Intel")->rating_id, table.find("Boeing")->rating_id);
+    EXPECT_NE(table.find("Apple")->rating_id, table.find("Intel")->rating_id);
+}
+
+// Test lookups over the generator's issuer distribution agree across the
+// std, flat and perfect-hash maps. Their speed is measured by lookup_bench.
+TEST(PerfectStringMapTest, LookupsMatchFlatAndStdMaps) {
+    constexpr size_t LOOKUPS = 10'000;
+
+    std::unordered_map<std::string, IssuerCodes> stdMap;
+    FlatStringMap<IssuerCodes> flatMap;
+    PerfectStringMap<IssuerCodes> perfectMap;
+    for (size_t i = 0; i < kIssuers.size(); ++i) {
+        IssuerCodes codes{static_cast<uint16_t>(i % 7), static_cast<uint16_t>(i % 5)};
+        stdMap[kIssuers[i]] = codes;
+        flatMap.insert_or_assign(kIssuers[i], codes);
+        perfectMap.insert(kIssuers[i], codes);
+    }
+    ASSERT_TRUE(perfectMap.build());
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> pick(0, kIssuers.size() - 1);
+    size_t stdSum = 0, flatSum = 0, perfectSum = 0;
+    for (size_t i = 0; i < LOOKUPS; ++i) {
+        std::string_view key = kIssuers[pick(rng)];
+        auto it = stdMap.find(std::string(key));
+        if (it != stdMap.end()) stdSum += it->second.rating_id + 1;
+        const IssuerCodes* flat = flatMap.find(key);
+        if (flat) flatSum += flat->rating_id + 1;
+        const IssuerCodes* perfect = perfectMap.find(key);
+        if (perfect) perfectSum += perfect->rating_id + 1;
+    }
+
+    EXPECT_GT(stdSum, 0u);
+    EXPECT_EQ(stdSum, flatSum);
+    EXPECT_EQ(flatSum, perfectSum);
+}
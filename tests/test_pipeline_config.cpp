@@ -0,0 +1,210 @@
+#include "pipeline_config.h"
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+bool parseArgs(std::vector<const char*> args, PipelineConfig& config, std::string& error) {
+    args.insert(args.begin(), "main");
+    ConfigAction action;
+    return parse_config_args(static_cast<int>(args.size()), args.data(), config, action, error);
+}
+
+}   // namespace
+
+// Test the defaults are the pipeline's long-standing settings and valid
+TEST(PipelineConfigTest, Defaults) {
+    PipelineConfig config;
+    std::string error;
+    EXPECT_TRUE(validate_config(config, 65536, 64, error)) << error;
+    ASSERT_EQ(config.feeds.size(), 3u);
+    EXPECT_EQ(config.feeds[0].port, 5555);
+    EXPECT_EQ(config.sink, TradeSink::Copy);
+    EXPECT_EQ(config.consumers, 2u);
+    EXPECT_EQ(config.queue_capacity, 16384u);
+    EXPECT_TRUE(config.producer_cpus.empty());
+}
+
+// Test every section of a JSON config is applied
+TEST(PipelineConfigTest, FromJson) {
+    auto j = nlohmann::json::parse(R"({
+        "feeds": ["10.0.0.5:7000", {"port": 7001}, {"host": "10.0.0.6", "port": 7002}],
+        "conninfo": "dbname=test",
+        "sink": "journal",
+        "threads": {"consumers": 8, "db_connections": 4, "async_writer_connections": 6},
+        "stages": {"enabled": true, "parse_threads": 3, "enrich_threads": 2},
+        "queue": {"capacity": 4096, "node": 1, "high_watermark": 80, "low_watermark": 40, "overload": "shed"},
+        "batch": {"min": 32, "max": 1000, "latency_slo_us": 5000},
+        "pipeline": {"max_in_flight": 64},
+        "journal": {"dir": "/tmp/j"},
+        "metrics": {"port": 9464, "address": "0.0.0.0"},
+        "cpus": {"producers": [0, 1, 2], "consumers": "4,5", "background": [6], "parse": [7, 8], "enrich": [9]}
+    })");
+    PipelineConfig config;
+    std::string error;
+    ASSERT_TRUE(config_from_json(j, config, error)) << error;
+
+    ASSERT_EQ(config.feeds.size(), 3u);
+    EXPECT_EQ(config.feeds[0].host, "10.0.0.5");
+    EXPECT_EQ(config.feeds[0].port, 7000);
+    EXPECT_EQ(config.feeds[1].host, "127.0.0.1");
+    EXPECT_EQ(config.feeds[2].host, "10.0.0.6");
+    EXPECT_EQ(config.conninfo, "dbname=test");
+    EXPECT_EQ(config.sink, TradeSink::Journal);
+    EXPECT_EQ(config.consumers, 8u);
+    EXPECT_EQ(config.db_connections, 4u);
+    EXPECT_EQ(config.async_writer_connections, 6u);
+    EXPECT_TRUE(config.staged);
+    EXPECT_EQ(config.parse_threads, 3u);
+    EXPECT_EQ(config.enrich_threads, 2u);
+    EXPECT_EQ(config.queue_capacity, 4096u);
+    EXPECT_EQ(config.queue_node, 1);
+    EXPECT_EQ(config.high_watermark, 80u);
+    EXPECT_EQ(config.low_watermark, 40u);
+    EXPECT_EQ(config.overload, OverloadPolicy::Shed);
+    EXPECT_EQ(config.batch_min, 32u);
+    EXPECT_EQ(config.batch_max, 1000u);
+    EXPECT_EQ(config.latency_slo.count(), 5000);
+    EXPECT_EQ(config.pipeline_max_in_flight, 64u);
+    EXPECT_EQ(config.journal_dir, "/tmp/j");
+    EXPECT_EQ(config.metrics_port, 9464u);
+    EXPECT_EQ(config.metrics_address, "0.0.0.0");
+    EXPECT_EQ(config.producer_cpus, (std::vector<int>{0, 1, 2}));
+    EXPECT_EQ(config.consumer_cpus, (std::vector<int>{4, 5}));
+    EXPECT_EQ(config.background_cpus, (std::vector<int>{6}));
+    EXPECT_EQ(config.parse_cpus, (std::vector<int>{7, 8}));
+    EXPECT_EQ(config.enrich_cpus, (std::vector<int>{9}));
+}
+
+// Test config_to_json() writes what config_from_json() reads
+TEST(PipelineConfigTest, JsonRoundTrip) {
+    PipelineConfig config;
+    config.feeds = {{"10.1.1.1", 9000}};
+    config.sink = TradeSink::Pipeline;
+    config.batch_max = 123;
+    config.consumer_cpus = {3, 7};
+
+    PipelineConfig copy;
+    std::string error;
+    ASSERT_TRUE(config_from_json(config_to_json(config), copy, error)) << error;
+    EXPECT_EQ(config_to_json(copy), config_to_json(config));
+}
+
+// Test mistakes in a config are reported rather than ignored
+TEST(PipelineConfigTest, RejectsBadJson) {
+    const char* bad[] = {
+        R"({"threds": {"consumers": 2}})",
+        R"({"threads": {"consumer": 2}})",
+        R"({"threads": {"consumers": -1}})",
+        R"({"sink": "kafka"})",
+        R"({"feeds": []})",
+        R"({"feeds": ["localhost:99999"]})",
+        R"({"feeds": [{"host": "10.0.0.1"}]})",
+        R"({"cpus": {"producers": "0,x"}})",
+        R"({"batch": {"min": "16"}})",
+        R"({"queue": {"node": "near"}})",
+        R"({"stages": {"enabled": 1}})",
+        R"({"queue": {"overload": "drop"}})",
+        R"([1, 2])",
+    };
+    for (const char* text : bad) {
+        PipelineConfig config;
+        std::string error;
+        EXPECT_FALSE(config_from_json(nlohmann::json::parse(text), config, error)) << text;
+        EXPECT_FALSE(error.empty()) << text;
+    }
+}
+
+// Test settings that don't fit together fail validation
+TEST(PipelineConfigTest, Validate) {
+    std::string error;
+    PipelineConfig config;
+    config.queue_capacity = 1 << 20;
+    EXPECT_FALSE(validate_config(config, 65536, 64, error));
+
+    error.clear();
+    config = PipelineConfig{};
+    config.batch_min = 100;
+    config.batch_max = 10;
+    EXPECT_FALSE(validate_config(config, 65536, 64, error));
+
+    error.clear();
+    config = PipelineConfig{};
+    config.consumers = 0;
+    EXPECT_FALSE(validate_config(config, 65536, 64, error));
+
+    error.clear();
+    config = PipelineConfig{};
+    config.low_watermark = config.high_watermark;
+    EXPECT_FALSE(validate_config(config, 65536, 64, error));
+
+    // Each feed and each enrich thread takes an issuer snapshot reader
+    error.clear();
+    config = PipelineConfig{};
+    config.feeds.assign(65, FeedConfig{});
+    EXPECT_FALSE(validate_config(config, 65536, 64, error));
+    EXPECT_NE(error.find("at most 64"), std::string::npos) << error;
+
+    error.clear();
+    config.feeds.resize(60);
+    EXPECT_TRUE(validate_config(config, 65536, 64, error)) << error;
+    config.staged = true;
+    config.enrich_threads = 5;
+    EXPECT_FALSE(validate_config(config, 65536, 64, error));
+}
+
+// Test flags override the config file wherever --config appears
+TEST(PipelineConfigTest, FlagsOverrideFile) {
+    std::string path = testing::TempDir() + "pipeline_config_test.json";
+    {
+        std::ofstream out(path);
+        out << R"({"threads": {"consumers": 3, "db_connections": 5}, "sink": "insert"})";
+    }
+
+    PipelineConfig config;
+    std::string error;
+    ASSERT_TRUE(parseArgs({"--consumers", "7", "--config", path.c_str(), "--feed", "10.0.0.9:6000", "--feed",
+                           "6001", "--producer-cpus", "2,3", "--latency-slo-us", "1500", "--queue-node", "auto", "--staged", "--parse-threads", "4"},
+                          config, error))
+        << error;
+    EXPECT_EQ(config.consumers, 7u);        // Flag beats file
+    EXPECT_EQ(config.db_connections, 5u);   // File beats default
+    EXPECT_EQ(config.sink, TradeSink::Insert);
+    ASSERT_EQ(config.feeds.size(), 2u);     // --feed replaces the defaults
+    EXPECT_EQ(config.feeds[0].host, "10.0.0.9");
+    EXPECT_EQ(config.feeds[1].port, 6001);
+    EXPECT_EQ(config.producer_cpus, (std::vector<int>{2, 3}));
+    EXPECT_EQ(config.latency_slo.count(), 1500);
+    EXPECT_TRUE(config.staged);
+    EXPECT_EQ(config.parse_threads, 4u);
+    std::remove(path.c_str());
+}
+
+// Test bad command lines name the problem
+TEST(PipelineConfigTest, RejectsBadFlags) {
+    std::vector<std::vector<const char*>> bad = {
+        {"--consumers"},
+        {"--consumers", "two"},
+        {"--sink", "kafka"},
+        {"--threads", "4"},
+        {"--config", "/nonexistent/config.json"},
+    };
+    for (const auto& args : bad) {
+        PipelineConfig config;
+        std::string error;
+        EXPECT_FALSE(parseArgs(args, config, error)) << args[0];
+        EXPECT_FALSE(error.empty()) << args[0];
+    }
+
+    PipelineConfig config;
+    ConfigAction action;
+    std::string error;
+    const char* help[] = {"main", "--help"};
+    ASSERT_TRUE(parse_config_args(2, help, config, action, error));
+    EXPECT_EQ(action, ConfigAction::Help);
+}
@@ -0,0 +1,127 @@
+#include "pipeline_stage.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using namespace std::chrono_literals;
+
+// Test two chained stages deliver every item exactly once
+TEST(PipelineStageTest, ChainedStages) {
+    constexpr uint64_t count = 100000;
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> seen{0};
+
+    PipelineStage<uint64_t, 1024> second("second", 3, [&](size_t) {
+        return [&](uint64_t& v) {
+            sum.fetch_add(v, std::memory_order_relaxed);
+            seen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        };
+    });
+    PipelineStage<uint64_t, 1024> first("first", 2, [&](size_t) {
+        return [&](uint64_t& v) {
+            second.push(v * 2);
+            return true;
+        };
+    });
+    second.start();
+    first.start();
+
+    for (uint64_t i = 1; i <= count; ++i) first.push(i);
+    first.stop();
+    second.stop();
+
+    EXPECT_EQ(seen.load(), count);
+    EXPECT_EQ(sum.load(), count * (count + 1));
+    EXPECT_EQ(first.stats().items, count);
+    EXPECT_EQ(second.stats().items, count);
+    EXPECT_EQ(second.stats().threads, 3u);
+    EXPECT_EQ(first.depth(), 0u);
+}
+
+// Test items a handler rejects are counted as dropped
+TEST(PipelineStageTest, CountsDrops) {
+    PipelineStage<int, 256> stage("odd", 2, [](size_t) { return [](int& v) { return v % 2 == 0; }; });
+    stage.start();
+    for (int i = 0; i < 1000; ++i) stage.push(i);
+    stage.stop();
+
+    StageStats s = stage.stats();
+    EXPECT_EQ(s.items, 1000u);
+    EXPECT_EQ(s.dropped, 500u);
+    EXPECT_EQ(s.name, "odd");
+}
+
+// Test each worker builds its handler once, on its own thread
+TEST(PipelineStageTest, HandlerPerWorker) {
+    std::mutex mutex;
+    std::set<size_t> workers;
+    std::set<std::thread::id> threads;
+    PipelineStage<int, 64> stage("workers", 4, [&](size_t worker) {
+        std::lock_guard<std::mutex> lock(mutex);
+        workers.insert(worker);
+        threads.insert(std::this_thread::get_id());
+        return [](int&) { return true; };
+    });
+    stage.start();
+    stage.stop();
+
+    EXPECT_EQ(workers, (std::set<size_t>{0, 1, 2, 3}));
+    EXPECT_EQ(threads.size(), 4u);
+    EXPECT_EQ(threads.count(std::this_thread::get_id()), 0u);
+}
+
+// Test a full queue makes push() wait, and the wait is counted
+TEST(PipelineStageTest, PushWaitsWhenFull) {
+    std::atomic<bool> release{false};
+    std::atomic<int> handled{0};
+    PipelineStage<int, 4> stage("slow", 1, [&](size_t) {
+        return [&](int&) {
+            while (!release.load()) std::this_thread::sleep_for(1ms);
+            handled.fetch_add(1);
+            return true;
+        };
+    });
+    stage.start();
+
+    // One item in the handler and four queued fill the stage
+    stage.push(0);
+    while (stage.depth() != 0) std::this_thread::sleep_for(1ms);
+    for (int i = 1; i <= 4; ++i) ASSERT_TRUE(stage.try_push(i));
+    EXPECT_FALSE(stage.try_push(5));
+
+    std::thread pusher([&]() { stage.push(6); });
+    std::this_thread::sleep_for(20ms);
+    release = true;
+    pusher.join();
+    stage.stop();
+
+    EXPECT_EQ(handled.load(), 6);
+    EXPECT_EQ(stage.stats().full_waits, 1u);
+}
+
+// Test meters sum their threads' counters and report an interval
+TEST(PipelineStageTest, MeterAndReport) {
+    StageMeter meter("persist", 2);
+    meter.thread(0).record(2us);
+    meter.thread(0).record(2us, false);
+    meter.thread(1).record_batch(6, 16us);
+
+    StageStats before;
+    StageStats s = meter.snapshot().since(before);
+    EXPECT_EQ(s.items, 8u);
+    EXPECT_EQ(s.dropped, 1u);
+    EXPECT_EQ(s.busy_ns, 20000u);
+
+    std::ostringstream os;
+    print_stage_stats(os, s, 1ms);
+    EXPECT_EQ(os.str(), "[Stage persist] 2 threads, 8000 items/s, 1 dropped, busy 1.0%, 2.50 us/item");
+}
@@ -97,4 +97,16 @@ TEST(PrintTupleTest, PrintDeeplyNestedTupleWithPairAndMixedTypes) {
     std::ostringstream oss;
     utils::tuple::print(oss, tup);
     EXPECT_EQ(oss.str(), "(42, (inner, (Z, 9.81), 7), 3.14, (100, end))");
-}
\ No newline at end of file
+}
+
+// Test for_each visits every element in order with its own type
+TEST(PrintTupleTest, ForEach) {
+    std::tuple<int, std::string, double> tup{1, "two", 3.5};
+    std::ostringstream oss;
+    utils::tuple::for_each(tup, [&oss](const auto& v) { oss << v << ';'; });
+    EXPECT_EQ(oss.str(), "1;two;3.5;");
+
+    int calls = 0;
+    utils::tuple::for_each(std::tuple<>{}, [&calls](const auto&) { ++calls; });
+    EXPECT_EQ(calls, 0);
+}
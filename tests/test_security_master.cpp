@@ -0,0 +1,143 @@
+#include "security_master.h"
+
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+const std::string kCusipChars = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ*@#";
+
+std::string randomBase(std::mt19937& rng) {
+    std::uniform_int_distribution<size_t> pick(0, kCusipChars.size() - 1);
+    std::string base;
+    for (int i = 0; i < 8; ++i) base += kCusipChars[pick(rng)];
+    return base;
+}
+
+std::string withCheckDigit(const std::string& base) {
+    return base + static_cast<char>('0' + cusip_check_digit_scalar(base));
+}
+
+}   // namespace
+
+// Test a few real CUSIPs
+TEST(CusipTest, KnownCusips) {
+    EXPECT_TRUE(is_valid_cusip("037833100"));   // Apple
+    EXPECT_TRUE(is_valid_cusip("594918104"));   // Microsoft
+    EXPECT_TRUE(is_valid_cusip("38259P508"));   // Google
+    EXPECT_FALSE(is_valid_cusip("037833101"));
+    EXPECT_FALSE(is_valid_cusip("594918105"));
+}
+
+// Test malformed input is rejected
+TEST(CusipTest, MalformedCusips) {
+    EXPECT_FALSE(is_valid_cusip(""));
+    EXPECT_FALSE(is_valid_cusip("03783310"));
+    EXPECT_FALSE(is_valid_cusip("0378331000"));
+    EXPECT_FALSE(is_valid_cusip("03783310X"));   // Check digit must be a digit
+    EXPECT_FALSE(is_valid_cusip("38259p508"));   // Lowercase
+    EXPECT_FALSE(is_valid_cusip("0378-3100"));
+    EXPECT_EQ(cusip_check_digit_scalar("0378-310"), -1);
+}
+
+// Test the vectorized validator agrees with the scalar reference, covering
+// every character class and every wrong check digit
+TEST(CusipTest, VectorizedMatchesScalar) {
+    std::mt19937 rng(7);
+    for (int i = 0; i < 20000; ++i) {
+        std::string base = randomBase(rng);
+        int check = cusip_check_digit_scalar(base);
+        ASSERT_GE(check, 0);
+        for (int d = 0; d <= 9; ++d) {
+            std::string cusip = base + static_cast<char>('0' + d);
+            EXPECT_EQ(is_valid_cusip(cusip), d == check) << cusip;
+        }
+    }
+}
+
+// Test that the first sighting is learned and later trades are compared
+TEST(SecurityMasterTest, LearnThenMatch) {
+    SecurityMaster master(64);
+    std::string cusip = "037833100";
+    EXPECT_EQ(master.find(cusip), nullptr);
+    EXPECT_EQ(master.check_or_learn(cusip, 4.25, "2031-05-15"), SecurityCheck::Learned);
+    EXPECT_EQ(master.check_or_learn(cusip, 4.25, "2031-05-15"), SecurityCheck::Matched);
+    EXPECT_EQ(master.check_or_learn(cusip, 4.5, "2031-05-15"), SecurityCheck::Mismatch);
+    EXPECT_EQ(master.check_or_learn(cusip, 4.25, "2032-05-15"), SecurityCheck::Mismatch);
+    EXPECT_EQ(master.size(), 1u);
+    EXPECT_EQ(master.mismatch_count(), 2u);
+
+    const SecurityRecord* record = master.find(cusip);
+    ASSERT_NE(record, nullptr);
+    EXPECT_DOUBLE_EQ(record->coupon, 4.25);
+    EXPECT_EQ(record->maturity_view(), "2031-05-15");
+}
+
+// Test input the master can't store
+TEST(SecurityMasterTest, Untracked) {
+    SecurityMaster master(64);
+    EXPECT_EQ(master.check_or_learn("bad", 1.0, "2031-05-15"), SecurityCheck::Untracked);
+    EXPECT_EQ(master.check_or_learn("037833100", 1.0, "2031-5-15"), SecurityCheck::Untracked);
+    EXPECT_EQ(master.size(), 0u);
+}
+
+// Test learning stops at half capacity instead of degrading probes
+TEST(SecurityMasterTest, StopsLearningWhenHalfFull) {
+    SecurityMaster master(16);
+    std::mt19937 rng(1);
+    size_t learned = 0, untracked = 0;
+    for (int i = 0; i < 32; ++i) {
+        SecurityCheck c = master.check_or_learn(withCheckDigit(randomBase(rng)), 1.0, "2030-01-01");
+        if (c == SecurityCheck::Learned) ++learned;
+        if (c == SecurityCheck::Untracked) ++untracked;
+    }
+    EXPECT_EQ(learned, 8u);
+    EXPECT_EQ(untracked, 24u);
+}
+
+// Test many producers racing to learn the same securities, each CUSIP must
+// be learned exactly once and every other sighting must match
+TEST(SecurityMasterTest, ConcurrentLearning) {
+    constexpr size_t SECURITIES = 2000;
+    constexpr size_t THREADS = 8;
+
+    std::mt19937 rng(3);
+    std::vector<std::string> cusips;
+    for (size_t i = 0; i < SECURITIES; ++i) {
+        cusips.push_back(withCheckDigit(randomBase(rng)));
+    }
+
+    SecurityMaster master(1 << 14);
+    std::atomic<size_t> learned{0}, matched{0}, other{0};
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&, t]() {
+            for (size_t i = 0; i < SECURITIES; ++i) {
+                const std::string& cusip = cusips[(i + t * 97) % SECURITIES];
+                switch (master.check_or_learn(cusip, 3.5, "2035-12-01")) {
+                    case SecurityCheck::Learned: ++learned; break;
+                    case SecurityCheck::Matched: ++matched; break;
+                    default: ++other; break;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    // Random CUSIPs can repeat, so count the distinct ones.
+    SecurityMaster distinct(1 << 14);
+    size_t unique = 0;
+    for (const auto& cusip : cusips) {
+        if (distinct.check_or_learn(cusip, 0.0, "2000-01-01") == SecurityCheck::Learned) ++unique;
+    }
+
+    EXPECT_EQ(learned.load(), unique);
+    EXPECT_EQ(master.size(), unique);
+    EXPECT_EQ(matched.load(), SECURITIES * THREADS - unique);
+    EXPECT_EQ(other.load(), 0u);
+}
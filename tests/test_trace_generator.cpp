@@ -0,0 +1,248 @@
+#include "trace_generator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <regex>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "mpmc_queue.h"
+#include "security_master.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+TraceGenerator::Clock::time_point at(const char* iso) {
+    std::tm tm{};
+    strptime(iso, "%Y-%m-%dT%H:%M:%S", &tm);
+    return TraceGenerator::Clock::from_time_t(timegm(&tm));
+}
+
+}   // namespace
+
+// Test every trade has the fields make_trade() fills, in its ranges
+TEST(TraceGeneratorTest, TradeFields) {
+    TraceGeneratorOptions options;
+    options.seed = 42;
+    TraceGenerator generator(options);
+    std::regex iso(R"(2025-0[23]-\d\dT\d\d:\d\d:\d\d(\.\d{6})?Z)");
+    auto now = at("2025-03-01T00:05:00");
+    Trade t;
+    for (int i = 0; i < 10000; ++i) {
+        generator.next(t, now);
+        ASSERT_EQ(t.control_id.view().size(), 10u);
+        ASSERT_TRUE(is_valid_cusip(t.cusip.view())) << t.cusip.view();
+        ASSERT_FALSE(t.issuer.empty());
+        ASSERT_TRUE(std::regex_match(std::string(t.exec_time.view()), iso)) << t.exec_time.view();
+        ASSERT_TRUE(std::regex_match(std::string(t.report_time.view()), iso)) << t.report_time.view();
+        ASSERT_LE(t.exec_time.view(), "2025-03-01T00:05:00Z");
+        ASSERT_GE(t.exec_time.view(), "2025-02-28T23:55:00Z");
+        ASSERT_GE(t.report_time.view(), t.exec_time.view());
+        ASSERT_TRUE(t.side.view() == "BUY" || t.side.view() == "SELL");
+        ASSERT_TRUE(t.reporting_capacity.view() == "P" || t.reporting_capacity.view() == "A");
+        ASSERT_GE(t.price, 90.0);
+        ASSERT_LE(t.price, 110.0);
+        ASSERT_GE(t.volume, 100000);
+        ASSERT_LE(t.volume, 5000000);
+        ASSERT_GE(t.dealer_id, 1000);
+        ASSERT_LE(t.dealer_id, 9999);
+        ASSERT_GE(t.coupon, 1.0);
+        ASSERT_LE(t.coupon, 6.0);
+        ASSERT_GE(t.maturity.view(), "2026-03-01");
+        ASSERT_LE(t.maturity.view(), "2035-02-27");
+    }
+}
+
+// Test modifier3 is Z exactly when the report came more than 15 minutes late
+TEST(TraceGeneratorTest, LateTradesMarked) {
+    TraceGenerator generator;
+    auto now = at("2025-06-30T23:59:59");
+    int late = 0;
+    Trade t;
+    for (int i = 0; i < 10000; ++i) {
+        generator.next(t, now);
+        std::tm exec{}, report{};
+        strptime(std::string(t.exec_time.view()).c_str(), "%Y-%m-%dT%H:%M:%S", &exec);
+        strptime(std::string(t.report_time.view()).c_str(), "%Y-%m-%dT%H:%M:%S", &report);
+        long delay = static_cast<long>(timegm(&report) - timegm(&exec));
+        ASSERT_GE(delay, 0);
+        ASSERT_LE(delay, 1800);
+        ASSERT_EQ(t.modifier3.view(), delay > 900 ? "Z" : "") << delay;
+        late += delay > 900;
+    }
+    // About half the delays are over 15 minutes
+    EXPECT_GT(late, 4500);
+    EXPECT_LT(late, 5500);
+}
+
+// Test a paired trade's second leg comes after its delay, with the same
+// control_id, CUSIP and exec_time and the other side
+TEST(TraceGeneratorTest, PairedLegs) {
+    TraceGeneratorOptions options;
+    options.pair_prob = 1.0;
+    options.seed = 7;
+    TraceGenerator generator(options);
+    auto now = at("2025-01-15T12:00:00");
+
+    Trade first, second, next;
+    generator.next(first, now);
+    EXPECT_EQ(generator.pending_legs(), 1u);
+    generator.next(next, now + 50ms);    // Too soon for the pair leg
+    EXPECT_NE(next.control_id.view(), first.control_id.view());
+    EXPECT_EQ(generator.pending_legs(), 2u);
+
+    generator.next(second, now + 501ms);
+    EXPECT_EQ(second.control_id.view(), first.control_id.view());
+    EXPECT_EQ(second.cusip.view(), first.cusip.view());
+    EXPECT_EQ(second.exec_time.view(), first.exec_time.view());
+    EXPECT_NE(second.side.view(), first.side.view());
+
+    // Once every pending leg has been sent, each control_id has two legs
+    std::map<std::string, int> legs{{std::string(first.control_id.view()), 2},
+                                    {std::string(next.control_id.view()), 1}};
+    Trade t;
+    for (int i = 0; i < 1000; ++i) {
+        generator.next(t, now + 1s + i * 1ms);
+        ++legs[std::string(t.control_id.view())];
+    }
+    while (generator.pending_legs() > 0) {
+        generator.next(t, now + 10s);
+        ++legs[std::string(t.control_id.view())];
+    }
+    for (const auto& [id, n] : legs) EXPECT_EQ(n, 2) << id;
+}
+
+// Test feed lines come out as json.dumps() writes them and parse back into
+// the same trade
+TEST(TraceGeneratorTest, JsonLines) {
+    Trade t;
+    t.control_id.assign("AB12CD34EF");
+    t.cusip.assign("037833100");
+    t.issuer.assign("Johnson & Johnson");
+    t.exec_time.assign("2025-03-14T15:09:26.535897Z");
+    t.report_time.assign("2025-03-14T15:30:00Z");
+    t.price = 100.0;
+    t.volume = 2500000;
+    t.side.assign("BUY");
+    t.dealer_id = 4321;
+    t.reporting_capacity.assign("P");
+    t.modifier3.assign("Z");
+    t.coupon = 3.4;
+    t.maturity.assign("2031-06-30");
+    std::string line;
+    append_trade_json(line, t);
+    EXPECT_EQ(line,
+              R"({"control_id": "AB12CD34EF", "cusip": "037833100", "issuer": "Johnson & Johnson", )"
+              R"("exec_time": "2025-03-14T15:09:26.535897Z", "report_time": "2025-03-14T15:30:00Z", )"
+              R"("price": 100.0, "volume": 2500000, "side": "BUY", "dealer_id": 4321, "reporting_capacity": "P", )"
+              R"("modifier3": "Z", "coupon": 3.4, "maturity": "2031-06-30"})");
+
+    TraceGenerator generator;
+    for (int i = 0; i < 1000; ++i) {
+        generator.next(t);
+        line.clear();
+        append_trade_json(line, t);
+        Trade parsed;
+        std::string error;
+        ASSERT_TRUE(trade_from_json(nlohmann::json::parse(line), parsed, error)) << error;
+        ASSERT_EQ(parsed.control_id.view(), t.control_id.view());
+        ASSERT_EQ(parsed.exec_time.view(), t.exec_time.view());
+        ASSERT_EQ(parsed.maturity.view(), t.maturity.view());
+        ASSERT_DOUBLE_EQ(parsed.price, t.price);
+        ASSERT_DOUBLE_EQ(parsed.coupon, t.coupon);
+        ASSERT_EQ(parsed.volume, t.volume);
+        ASSERT_EQ(parsed.dealer_id, t.dealer_id);
+    }
+}
+
+// Test the pacer holds the rate, caps catch-up and adds bursts on schedule
+TEST(TraceGeneratorTest, RatePacer) {
+    RatePacer pacer(1000, 0.0, 500, 10s);
+    auto t0 = RatePacer::Clock::now();
+    size_t sent = 0;
+    for (int ms = 1; ms <= 1000; ++ms) sent += pacer.take(t0 + ms * 1ms);
+    EXPECT_NEAR(static_cast<double>(sent), 1000.0, 2.0);
+
+    // Five idle seconds earn a tenth of a second's worth, not five seconds'
+    EXPECT_LE(pacer.take(t0 + 6s), 101u + 500u);
+
+    // The burst comes once the interval has passed
+    pacer.take(t0 + 9999ms);
+    EXPECT_GE(pacer.take(t0 + 10s + 1ms), 500u);
+    EXPECT_EQ(pacer.take(t0 + 10s + 1ms), 0u);
+
+    RatePacer unlimited(0);
+    EXPECT_FALSE(unlimited.limited());
+    EXPECT_EQ(unlimited.wait(64), 64u);
+
+    RatePacer jittery(1000, 0.5, 0, 60s, 3);
+    sent = 0;
+    for (int ms = 1; ms <= 2000; ++ms) sent += jittery.take(t0 + ms * 1ms);
+    EXPECT_NEAR(static_cast<double>(sent), 2000.0, 200.0);
+}
+
+// Test feed lines are written in batches of about 64 KB, a batch at a time
+// when paced, and stop at the count or when told to
+TEST(TraceGeneratorTest, WriteTradeLines) {
+    TraceGenerator generator;
+    RatePacer unlimited(0);
+    uint64_t sent = 0;
+    size_t lines = 0, writes = 0;
+    std::string all;
+    auto write = [&](const std::string& batch, size_t n) {
+        EXPECT_LT(batch.size(), 128u * 1024);
+        EXPECT_EQ(static_cast<size_t>(std::count(batch.begin(), batch.end(), '\n')), n);
+        all += batch;
+        lines += n;
+        ++writes;
+        return true;
+    };
+    EXPECT_TRUE(write_trade_lines(generator, unlimited, sent, 5000, [] { return true; }, write));
+    EXPECT_EQ(sent, 5000u);
+    EXPECT_EQ(lines, 5000u);
+    EXPECT_GT(writes, 10u);
+    EXPECT_LT(writes, 50u);
+    EXPECT_EQ(all.back(), '\n');
+
+    // Paced: every pacer batch is written at once. Batches are capped at
+    // 256 lines, so however much credit has built up, 1000 lines take at
+    // least four writes.
+    RatePacer paced(100000);
+    sent = lines = writes = 0;
+    EXPECT_TRUE(write_trade_lines(generator, paced, sent, 1000, [] { return true; }, write));
+    EXPECT_EQ(lines, 1000u);
+    EXPECT_GE(writes, 4u);
+
+    // A failed write ends it; so does keep_going()
+    sent = 0;
+    EXPECT_FALSE(write_trade_lines(generator, unlimited, sent, 0, [] { return true; },
+                                   [](const std::string&, size_t) { return false; }));
+    int checks = 0;
+    sent = 0;
+    EXPECT_TRUE(write_trade_lines(generator, unlimited, sent, 0, [&] { return ++checks <= 3; }, write));
+    EXPECT_EQ(sent, 3u * 256u);
+}
+
+// Test injection fills a queue directly, stamping each trade
+TEST(TraceGeneratorTest, InjectTrades) {
+    MPMCQueue<Trade, 1024> queue;
+    TraceGenerator generator;
+    RatePacer pacer(0);
+    uint64_t stamped = 0;
+    uint64_t sent = inject_trades(generator, pacer, queue, 1000, [] { return true; },
+                                  [&](Trade& t) { t.stamps.enqueued = ++stamped; });
+    EXPECT_EQ(sent, 1000u);
+    EXPECT_EQ(queue.size_approx(), 1000u);
+    Trade t;
+    ASSERT_TRUE(queue.dequeue(t));
+    EXPECT_EQ(t.stamps.enqueued, 1u);
+    EXPECT_TRUE(is_valid_cusip(t.cusip.view()));
+
+    // A full queue with nothing draining it stops at the keep-going check
+    int checks = 0;
+    sent = inject_trades(generator, pacer, queue, 0, [&] { return ++checks < 100; });
+    EXPECT_EQ(sent, 25u);
+}
@@ -0,0 +1,181 @@
+#include "copy_sink.h"
+#include "mpmc_queue.h"
+#include "trade.h"
+
+#include <string>
+#include <type_traits>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using json = nlohmann::json;
+
+// A message shaped like fake_trace_generator.py's make_trade()
+json sampleMessage() {
+    return json::parse(R"({
+        "control_id": "AB12CD34EF",
+        "cusip": "037833100",
+        "issuer": "Apple",
+        "exec_time": "2025-03-14T15:09:26.535897Z",
+        "report_time": "2025-03-14T15:30:00.000000Z",
+        "price": 101.25,
+        "volume": 2500000,
+        "side": "BUY",
+        "dealer_id": 4321,
+        "reporting_capacity": "P",
+        "modifier3": "Z",
+        "coupon": 3.45,
+        "maturity": "2031-06-30"
+    })");
+}
+
+}   // namespace
+
+// Test trades can be copied through the queue without the allocator
+TEST(TradeTest, TriviallyCopyable) {
+    EXPECT_TRUE(std::is_trivially_copyable<Trade>::value);
+}
+
+// Test every feed field lands in the trade
+TEST(TradeTest, FromJson) {
+    Trade t;
+    std::string error;
+    ASSERT_TRUE(trade_from_json(sampleMessage(), t, error)) << error;
+    EXPECT_EQ(t.control_id.view(), "AB12CD34EF");
+    EXPECT_EQ(t.cusip.view(), "037833100");
+    EXPECT_EQ(t.issuer.view(), "Apple");
+    EXPECT_EQ(t.exec_time.view(), "2025-03-14T15:09:26.535897Z");
+    EXPECT_EQ(t.report_time.view(), "2025-03-14T15:30:00.000000Z");
+    EXPECT_EQ(t.side.view(), "BUY");
+    EXPECT_EQ(t.reporting_capacity.view(), "P");
+    EXPECT_EQ(t.modifier3.view(), "Z");
+    EXPECT_EQ(t.maturity.view(), "2031-06-30");
+    EXPECT_TRUE(t.rating.empty());
+    EXPECT_DOUBLE_EQ(t.price, 101.25);
+    EXPECT_DOUBLE_EQ(t.coupon, 3.45);
+    EXPECT_EQ(t.volume, 2500000);
+    EXPECT_EQ(t.dealer_id, 4321);
+    EXPECT_TRUE(t.has_price && t.has_coupon && t.has_volume && t.has_dealer_id);
+}
+
+// Test missing numbers are flagged rather than defaulted
+TEST(TradeTest, MissingFields) {
+    json msg = sampleMessage();
+    msg.erase("coupon");
+    msg.erase("maturity");
+    msg["volume"] = nullptr;
+
+    Trade t;
+    std::string error;
+    ASSERT_TRUE(trade_from_json(msg, t, error)) << error;
+    EXPECT_FALSE(t.has_coupon);
+    EXPECT_FALSE(t.has_volume);
+    EXPECT_TRUE(t.maturity.empty());
+}
+
+// Test wrong types and oversized strings are rejected with the field name
+TEST(TradeTest, RejectsBadFields) {
+    Trade t;
+    std::string error;
+
+    json msg = sampleMessage();
+    msg["price"] = "101.25";
+    EXPECT_FALSE(trade_from_json(msg, t, error));
+    EXPECT_NE(error.find("price"), std::string::npos);
+
+    msg = sampleMessage();
+    msg["cusip"] = std::string(40, '9');
+    EXPECT_FALSE(trade_from_json(msg, t, error));
+    EXPECT_NE(error.find("cusip"), std::string::npos);
+
+    EXPECT_FALSE(trade_from_json(json::array(), t, error));
+}
+
+// Test a full row in COPY text format
+TEST(CopyFormatTest, Row) {
+    Trade t;
+    std::string error;
+    ASSERT_TRUE(trade_from_json(sampleMessage(), t, error)) << error;
+    t.rating.assign("AA+");
+    t.industry.assign("Technology");
+
+    std::string out;
+    append_copy_row(out, t);
+    EXPECT_EQ(out,
+              "AB12CD34EF\t3.45\t037833100\t4321\t2025-03-14T15:09:26.535897Z\tTechnology\tApple\t"
+              "2031-06-30\tZ\t101.25\tAA+\t2025-03-14T15:30:00.000000Z\tP\tBUY\t2500000\n");
+}
+
+// Test NULLs, empty strings and escaping
+TEST(CopyFormatTest, NullsAndEscapes) {
+    Trade t;
+    t.issuer.assign("Tab\tNew\nLine\\Back\rCR");
+    t.has_price = true;
+    t.price = 0.1;
+
+    std::string out;
+    append_copy_row(out, t);
+    EXPECT_EQ(out,
+              "\t\\N\t\t\\N\t\t\t"
+              "Tab\\tNew\\nLine\\\\Back\\rCR\t"
+              "\t\t0.1\t\t\t\t\t\\N\n");
+}
+
+// Test a batch with no connection to go to is held rather than dropped
+TEST(CopyFormatTest, SinkHoldsBatchWithoutConnection) {
+    CopySink sink(nullptr, 10, std::chrono::microseconds::max());
+    Trade t;
+    std::string error;
+    ASSERT_TRUE(trade_from_json(sampleMessage(), t, error)) << error;
+    for (int i = 0; i < 3; ++i) sink.add(t);
+
+    EXPECT_FALSE(sink.flush());
+    EXPECT_EQ(sink.pending(), 3u);
+    EXPECT_EQ(sink.failed(), 0u);
+    EXPECT_EQ(sink.written(), 0u);
+}
+
+// Test a batch held over a dead connection can be dropped before the
+// connection is finished, leaving nothing for the destructor to flush
+TEST(CopyFormatTest, SinkDiscardsBatchOnDeadConnection) {
+    // Nothing listens on port 1, so the connect is refused straight away
+    PGconn* conn = PQconnectdb("host=127.0.0.1 port=1 connect_timeout=1");
+    ASSERT_NE(PQstatus(conn), CONNECTION_OK);
+
+    Trade t;
+    std::string error;
+    ASSERT_TRUE(trade_from_json(sampleMessage(), t, error)) << error;
+    {
+        CopySink sink(conn, 10, std::chrono::microseconds::max());
+        for (int i = 0; i < 3; ++i) sink.add(t);
+
+        EXPECT_FALSE(sink.flush());
+        EXPECT_EQ(sink.pending(), 3u);
+        EXPECT_EQ(sink.failed(), 0u);
+
+        sink.discard();
+        sink.use(nullptr, 0);
+        PQfinish(conn);
+        EXPECT_EQ(sink.pending(), 0u);
+        EXPECT_TRUE(sink.flush());
+        EXPECT_EQ(sink.failed(), 0u);
+        EXPECT_EQ(sink.batch_count(), 0u);
+    }
+}
+
+// Test trades survive a trip through the queue unchanged
+TEST(TradeTest, ThroughQueue) {
+    MPMCQueue<Trade, 4> queue;
+    Trade in;
+    std::string error;
+    ASSERT_TRUE(trade_from_json(sampleMessage(), in, error)) << error;
+    ASSERT_TRUE(queue.enqueue(in));
+
+    Trade out;
+    ASSERT_TRUE(queue.dequeue(out));
+    std::string a, b;
+    append_copy_row(a, in);
+    append_copy_row(b, out);
+    EXPECT_EQ(a, b);
+}
@@ -0,0 +1,111 @@
+#include "trade_dedupe.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using namespace std::chrono_literals;
+
+Trade makeTrade(const std::string& controlId, const char* side = "BUY", int dealer = 7) {
+    Trade t;
+    t.control_id.assign(controlId);
+    t.side.assign(side);
+    t.dealer_id = dealer;
+    t.has_dealer_id = true;
+    return t;
+}
+
+}   // namespace
+
+// Test a repeat within the window is reported, the first sighting isn't
+TEST(TradeDedupeTest, DropsRepeat) {
+    TradeDedupe dedupe(10min);
+    auto now = TradeDedupe::Clock::now();
+    EXPECT_TRUE(dedupe.first_seen(makeTrade("A1"), now));
+    EXPECT_FALSE(dedupe.first_seen(makeTrade("A1"), now + 1s));
+    EXPECT_TRUE(dedupe.first_seen(makeTrade("A2"), now + 1s));
+    EXPECT_EQ(dedupe.duplicate_count(), 1u);
+}
+
+// Test both legs of a paired trade survive, since they differ in side and dealer
+TEST(TradeDedupeTest, PairedLegsAreDistinct) {
+    TradeDedupe dedupe(10min);
+    auto now = TradeDedupe::Clock::now();
+    EXPECT_TRUE(dedupe.first_seen(makeTrade("P1", "BUY", 1), now));
+    EXPECT_TRUE(dedupe.first_seen(makeTrade("P1", "SELL", 2), now));
+    EXPECT_TRUE(dedupe.first_seen(makeTrade("P1", "SELL", 3), now));
+    EXPECT_FALSE(dedupe.first_seen(makeTrade("P1", "SELL", 2), now));
+
+    Trade noDealer = makeTrade("P1", "BUY");
+    noDealer.has_dealer_id = false;
+    EXPECT_TRUE(dedupe.first_seen(noDealer, now));
+    EXPECT_FALSE(dedupe.first_seen(noDealer, now));
+}
+
+// Test a key survives one rotation and is forgotten after the next
+TEST(TradeDedupeTest, WindowExpiry) {
+    TradeDedupe dedupe(10s);
+    auto start = TradeDedupe::Clock::now();
+    ASSERT_TRUE(dedupe.first_seen(makeTrade("W1"), start));
+    EXPECT_FALSE(dedupe.first_seen(makeTrade("W1"), start + 4s));
+
+    // Rotated at 5s: W1 is now in the previous generation
+    EXPECT_FALSE(dedupe.first_seen(makeTrade("W1"), start + 7s));
+
+    // Rotated again at 10s, dropping W1; repeats don't refresh a key
+    EXPECT_TRUE(dedupe.first_seen(makeTrade("W1"), start + 12s));
+}
+
+// Test a long quiet spell clears everything at once
+TEST(TradeDedupeTest, IdleGapForgetsAll) {
+    TradeDedupe dedupe(10s);
+    auto start = TradeDedupe::Clock::now();
+    for (int i = 0; i < 100; ++i) ASSERT_TRUE(dedupe.first_seen(makeTrade("I" + std::to_string(i)), start));
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(dedupe.first_seen(makeTrade("I" + std::to_string(i)), start + 1h)) << i;
+    }
+}
+
+// Test trades without a control_id are never dropped
+TEST(TradeDedupeTest, EmptyControlIdPasses) {
+    TradeDedupe dedupe(10min);
+    Trade t = makeTrade("");
+    EXPECT_TRUE(dedupe.first_seen(t));
+    EXPECT_TRUE(dedupe.first_seen(t));
+    EXPECT_EQ(dedupe.duplicate_count(), 0u);
+}
+
+// Test growth well past the initial reservation keeps every key
+TEST(TradeDedupeTest, ManyKeys) {
+    TradeDedupe dedupe(10min, 64);
+    auto now = TradeDedupe::Clock::now();
+    constexpr int count = 100000;
+    for (int i = 0; i < count; ++i) ASSERT_TRUE(dedupe.first_seen(makeTrade("M" + std::to_string(i)), now));
+    for (int i = 0; i < count; ++i) ASSERT_FALSE(dedupe.first_seen(makeTrade("M" + std::to_string(i)), now));
+    EXPECT_EQ(dedupe.duplicate_count(), static_cast<uint64_t>(count));
+}
+
+// Test racing producers let exactly one copy of each trade through
+TEST(TradeDedupeTest, ConcurrentProducers) {
+    TradeDedupe dedupe(10min);
+    constexpr int threads = 8;
+    constexpr int keys = 20000;
+    std::atomic<int> passed{0};
+    std::vector<std::thread> producers;
+    for (int p = 0; p < threads; ++p) {
+        producers.emplace_back([&]() {
+            for (int i = 0; i < keys; ++i) {
+                if (dedupe.first_seen(makeTrade("C" + std::to_string(i)))) ++passed;
+            }
+        });
+    }
+    for (auto& p : producers) p.join();
+    EXPECT_EQ(passed.load(), keys);
+    EXPECT_EQ(dedupe.duplicate_count(), static_cast<uint64_t>((threads - 1) * keys));
+}
@@ -0,0 +1,152 @@
+#include "trade_ingest.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "mpmc_queue.h"
+#include "trace_generator.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+using Queue = MPMCQueue<Trade, 1024>;
+
+// One feed's worth of ingest, with the generator's first issuer in the
+// issuer table and every other issuer missing from it
+struct IngestFixture {
+    Queue queue;
+    SecurityMaster securities{1024};
+    RcuSnapshot<IssuerTable> issuers;
+    TradeDedupe dedupe{10min};
+    Backpressure backpressure{0.9, 0.5, OverloadPolicy::Pause, 1};
+    ThreadCounters feed{FEED_COUNTERS};
+    ThreadCounters counters{INGEST_COUNTERS};
+    std::ostringstream log;
+    AsyncLogger logger{log};
+    TradeIngest<Queue> ingest{queue, 1024, securities, issuers, dedupe, backpressure, feed, counters, logger};
+
+    IngestFixture() {
+        auto table = std::make_unique<IssuerTable>();
+        table->add(trace_generator_detail::issuers[0], "AA", "Technology");
+        table->finalize();
+        issuers.publish(std::move(table));
+    }
+
+    // Feeds `lines` to read_feed() over a socket pair and returns once
+    // they've all been read
+    void feed_lines(const std::string& lines) {
+        int fds[2];
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+        std::thread reader([&]() { ingest.read_feed(fds[0], 1); });
+        ASSERT_TRUE(send_all(fds[1], lines));
+        close(fds[1]);
+        reader.join();
+        close(fds[0]);
+    }
+};
+
+std::string tradeLine(const Trade& t) {
+    std::string line;
+    append_trade_json(line, t);
+    return line + "\n";
+}
+
+}   // namespace
+
+// Test a feed read inline queues good trades enriched and counts the rest
+TEST(TradeIngestTest, ReadFeedInline) {
+    IngestFixture f;
+    TraceGeneratorOptions options;
+    options.seed = 7;
+    TraceGenerator generator(options);
+    Trade known;
+    do {
+        generator.next(known, TraceGenerator::Clock::now());
+    } while (known.issuer.view() != trace_generator_detail::issuers[0]);
+    Trade unknown;
+    do {
+        generator.next(unknown, TraceGenerator::Clock::now());
+    } while (unknown.issuer.view() == trace_generator_detail::issuers[0]);
+
+    std::string lines = tradeLine(known) + tradeLine(known) + "not json\n" + tradeLine(unknown);
+    f.feed_lines(lines);
+
+    Trade t;
+    ASSERT_TRUE(f.queue.dequeue(t));
+    EXPECT_EQ(t.control_id.view(), known.control_id.view());
+    EXPECT_EQ(t.rating.view(), "AA");
+    EXPECT_EQ(t.industry.view(), "Technology");
+    EXPECT_NE(t.stamps.received, 0u);
+    EXPECT_GE(t.stamps.enqueued, t.stamps.parsed);
+    ASSERT_TRUE(f.queue.dequeue(t));
+    EXPECT_EQ(t.control_id.view(), unknown.control_id.view());
+    EXPECT_TRUE(t.rating.empty());
+    EXPECT_FALSE(f.queue.dequeue(t));
+
+    EXPECT_EQ(f.feed.total(FEED_MESSAGES), 4u);
+    EXPECT_EQ(f.feed.total(FEED_BYTES), lines.size());
+    EXPECT_EQ(f.feed.total(FEED_ERRORS), 1u);
+    EXPECT_EQ(f.feed.total(FEED_DUPLICATES), 1u);
+    EXPECT_EQ(f.feed.total(FEED_ENRICH_MISSES), 1u);
+    f.logger.flush();
+    EXPECT_NE(f.log.str().find("JSON parse error"), std::string::npos) << f.log.str();
+}
+
+// Test staged ingest delivers every line through the parse and enrich stages
+TEST(TradeIngestTest, ReadFeedStaged) {
+    constexpr size_t count = 500;
+    IngestFixture f;
+    f.ingest.start_stages(2, 2);
+    ASSERT_NE(f.ingest.parse_stage(), nullptr);
+    ASSERT_NE(f.ingest.enrich_stage(), nullptr);
+
+    TraceGeneratorOptions options;
+    options.seed = 11;
+    TraceGenerator generator(options);
+    std::string lines;
+    Trade t;
+    for (size_t i = 0; i < count; ++i) {
+        generator.next(t, TraceGenerator::Clock::now());
+        lines += tradeLine(t);
+    }
+    lines += std::string(FeedLine::max_length + 1, 'x') + "\n";
+    f.feed_lines(lines);
+    f.ingest.stop_stages();
+
+    size_t queued = 0;
+    while (f.queue.dequeue(t)) ++queued;
+    EXPECT_EQ(queued, count);
+    EXPECT_EQ(f.feed.total(FEED_MESSAGES), count + 1);
+    EXPECT_EQ(f.feed.total(FEED_ERRORS), 1u);   // The line too long for a stage slot
+    EXPECT_EQ(f.ingest.parse_stage()->stats().items, count);
+}
+
+// Test producers wait for room once the queue holds its capacity
+TEST(TradeIngestTest, EnqueueWaitsAtCapacity) {
+    IngestFixture f;
+    TradeIngest<Queue> small(f.queue, 2, f.securities, f.issuers, f.dedupe, f.backpressure, f.feed, f.counters,
+                             f.logger);
+    Trade t;
+    small.enqueue_trade(t);
+    small.enqueue_trade(t);
+    EXPECT_DOUBLE_EQ(small.fill(), 1.0);
+
+    std::thread producer([&]() {
+        Trade third;
+        small.enqueue_trade(third);
+    });
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(f.queue.size_approx(), 2u);
+    ASSERT_TRUE(f.queue.dequeue(t));
+    producer.join();
+    EXPECT_EQ(f.queue.size_approx(), 2u);
+    EXPECT_EQ(f.counters.total(QUEUE_FULL), 1u);
+}
@@ -0,0 +1,226 @@
+#include "trade_journal.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+// Fresh, empty journal directory per test
+std::string journalDir(const std::string& name) {
+    std::string dir = testing::TempDir() + "journal_" + name;
+    for (uint64_t segment : trade_journal_detail::list_segments(dir)) {
+        std::remove(trade_journal_detail::segment_path(dir, segment).c_str());
+    }
+    std::remove((dir + "/checkpoint").c_str());
+    return dir;
+}
+
+Trade makeTrade(int i) {
+    Trade t;
+    t.control_id.assign("C" + std::to_string(i));
+    t.cusip.assign("037833100");
+    t.side.assign(i % 2 ? "SELL" : "BUY");
+    t.volume = i;
+    t.has_volume = true;
+    t.stamps.received = 1000 + static_cast<uint64_t>(i);
+    return t;
+}
+
+// Reads everything durable and returns the volumes in order
+std::vector<int64_t> readAll(TradeJournal& journal, JournalPosition from = {}) {
+    JournalReader reader(journal.directory(), from);
+    std::vector<int64_t> volumes;
+    Trade t;
+    while (reader.next(t, journal.durable())) volumes.push_back(t.volume);
+    EXPECT_TRUE(reader.error().empty()) << reader.error();
+    return volumes;
+}
+
+off_t fileSize(const std::string& path) {
+    struct stat st{};
+    stat(path.c_str(), &st);
+    return st.st_size;
+}
+
+}   // namespace
+
+// Test trades come back in order with every field intact
+TEST(TradeJournalTest, AppendAndRead) {
+    TradeJournal journal(journalDir("basic"));
+    std::string error;
+    ASSERT_TRUE(journal.open(error)) << error;
+
+    for (int i = 0; i < 100; ++i) ASSERT_TRUE(journal.append_durable(makeTrade(i)));
+
+    JournalReader reader(journal.directory(), {});
+    Trade t;
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_TRUE(reader.next(t, journal.durable()));
+        EXPECT_EQ(t.control_id.view(), "C" + std::to_string(i));
+        EXPECT_EQ(t.volume, i);
+        EXPECT_EQ(t.stamps.received, 0u);   // Stamps aren't journaled
+    }
+    EXPECT_FALSE(reader.next(t, journal.durable()));
+    EXPECT_TRUE(reader.error().empty());
+}
+
+// Test appended but uncommitted trades aren't visible to the reader
+TEST(TradeJournalTest, ReaderStopsAtDurable) {
+    TradeJournal journal(journalDir("durable"));
+    std::string error;
+    ASSERT_TRUE(journal.open(error)) << error;
+
+    uint64_t first = journal.append(makeTrade(1));
+    ASSERT_TRUE(journal.wait_durable(first));
+    journal.append(makeTrade(2));
+    EXPECT_EQ(readAll(journal), std::vector<int64_t>{1});
+}
+
+// Test rotation across many small segments
+TEST(TradeJournalTest, RotatesSegments) {
+    std::string dir = journalDir("rotate");
+    uint64_t segmentBytes = trade_journal_detail::first_record + 3 * trade_journal_detail::record_bytes;
+    TradeJournal journal(dir, segmentBytes);
+    std::string error;
+    ASSERT_TRUE(journal.open(error)) << error;
+
+    std::vector<int64_t> expected;
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_TRUE(journal.append_durable(makeTrade(i)));
+        expected.push_back(i);
+    }
+    EXPECT_EQ(trade_journal_detail::list_segments(dir).size(), 7u);
+    EXPECT_EQ(readAll(journal), expected);
+}
+
+// Test a reader that opened a segment before it filled still sees the rest
+TEST(TradeJournalTest, ReaderFollowsWriter) {
+    std::string dir = journalDir("follow");
+    uint64_t segmentBytes = trade_journal_detail::first_record + 3 * trade_journal_detail::record_bytes;
+    TradeJournal journal(dir, segmentBytes);
+    std::string error;
+    ASSERT_TRUE(journal.open(error)) << error;
+
+    JournalReader reader(dir, {});
+    Trade t;
+    ASSERT_TRUE(journal.append_durable(makeTrade(0)));
+    ASSERT_TRUE(reader.next(t, journal.durable()));
+    EXPECT_FALSE(reader.next(t, journal.durable()));
+
+    for (int i = 1; i < 6; ++i) ASSERT_TRUE(journal.append_durable(makeTrade(i)));
+    for (int i = 1; i < 6; ++i) {
+        ASSERT_TRUE(reader.next(t, journal.durable())) << i;
+        EXPECT_EQ(t.volume, i);
+    }
+    EXPECT_FALSE(reader.next(t, journal.durable()));
+}
+
+// Test a torn final record is dropped and appends resume after it
+TEST(TradeJournalTest, RecoversTornTail) {
+    std::string dir = journalDir("torn");
+    {
+        TradeJournal journal(dir);
+        std::string error;
+        ASSERT_TRUE(journal.open(error)) << error;
+        for (int i = 0; i < 10; ++i) ASSERT_TRUE(journal.append_durable(makeTrade(i)));
+    }
+
+    // Cut the last record in half, as a crash mid-write would
+    std::string segment = trade_journal_detail::segment_path(dir, 1);
+    ASSERT_EQ(truncate(segment.c_str(), fileSize(segment) - static_cast<off_t>(trade_journal_detail::record_bytes / 2)), 0);
+
+    TradeJournal journal(dir);
+    std::string error;
+    ASSERT_TRUE(journal.open(error)) << error;
+    EXPECT_EQ(journal.recovered(), 9u);
+    ASSERT_TRUE(journal.append_durable(makeTrade(100)));
+    EXPECT_EQ(readAll(journal), (std::vector<int64_t>{0, 1, 2, 3, 4, 5, 6, 7, 8, 100}));
+}
+
+// Test a flipped bit stops recovery at the damaged record
+TEST(TradeJournalTest, RecoveryStopsAtCorruption) {
+    std::string dir = journalDir("corrupt");
+    {
+        TradeJournal journal(dir);
+        std::string error;
+        ASSERT_TRUE(journal.open(error)) << error;
+        for (int i = 0; i < 5; ++i) ASSERT_TRUE(journal.append_durable(makeTrade(i)));
+    }
+
+    std::string segment = trade_journal_detail::segment_path(dir, 1);
+    FILE* f = std::fopen(segment.c_str(), "r+b");
+    ASSERT_NE(f, nullptr);
+    long third = static_cast<long>(trade_journal_detail::first_record + 3 * trade_journal_detail::record_bytes + 40);
+    std::fseek(f, third, SEEK_SET);
+    int c = std::fgetc(f);
+    std::fseek(f, third, SEEK_SET);
+    std::fputc(c ^ 0x01, f);
+    std::fclose(f);
+
+    TradeJournal journal(dir);
+    std::string error;
+    ASSERT_TRUE(journal.open(error)) << error;
+    EXPECT_EQ(journal.recovered(), 3u);
+    EXPECT_EQ(readAll(journal), (std::vector<int64_t>{0, 1, 2}));
+}
+
+// Test the replayer's checkpoint and segment cleanup
+TEST(TradeJournalTest, CheckpointAndCleanup) {
+    std::string dir = journalDir("checkpoint");
+    uint64_t segmentBytes = trade_journal_detail::first_record + 2 * trade_journal_detail::record_bytes;
+    TradeJournal journal(dir, segmentBytes);
+    std::string error;
+    ASSERT_TRUE(journal.open(error)) << error;
+    for (int i = 0; i < 9; ++i) ASSERT_TRUE(journal.append_durable(makeTrade(i)));
+
+    EXPECT_EQ(load_journal_checkpoint(dir), JournalPosition{});
+
+    // Consume six trades, checkpoint, and drop finished segments
+    JournalReader reader(dir, load_journal_checkpoint(dir));
+    Trade t;
+    for (int i = 0; i < 6; ++i) ASSERT_TRUE(reader.next(t, journal.durable()));
+    ASSERT_TRUE(save_journal_checkpoint(dir, reader.position(), error)) << error;
+    EXPECT_EQ(remove_journal_segments_before(dir, reader.position()), 2u);
+
+    // A restarted replayer picks up exactly where the checkpoint left off
+    EXPECT_EQ(readAll(journal, load_journal_checkpoint(dir)), (std::vector<int64_t>{6, 7, 8}));
+}
+
+// Test concurrent writers share fdatasync calls and lose nothing
+TEST(TradeJournalTest, GroupCommit) {
+    TradeJournal journal(journalDir("group"));
+    std::string error;
+    ASSERT_TRUE(journal.open(error)) << error;
+
+    constexpr int threads = 8;
+    constexpr int perThread = 200;
+    std::atomic<int> failures{0};
+    std::vector<std::thread> writers;
+    for (int w = 0; w < threads; ++w) {
+        writers.emplace_back([&, w]() {
+            for (int i = 0; i < perThread; ++i) {
+                if (!journal.append_durable(makeTrade(w * perThread + i))) ++failures;
+            }
+        });
+    }
+    for (auto& w : writers) w.join();
+    EXPECT_EQ(failures.load(), 0);
+
+    std::vector<int64_t> volumes = readAll(journal);
+    ASSERT_EQ(volumes.size(), static_cast<size_t>(threads * perThread));
+    std::vector<bool> seen(volumes.size(), false);
+    for (int64_t v : volumes) {
+        ASSERT_FALSE(seen[v]);
+        seen[v] = true;
+    }
+    EXPECT_LE(journal.sync_count(), static_cast<uint64_t>(threads * perThread));
+    std::cout << "Group commit: " << threads * perThread << " trades in " << journal.sync_count() << " syncs\n";
+}
@@ -0,0 +1,148 @@
+#include "trade_params.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+uint64_t loadBe(const char* p, int length) {
+    uint64_t v = 0;
+    for (int i = 0; i < length; ++i) v = (v << 8) | static_cast<unsigned char>(p[i]);
+    return v;
+}
+
+Trade sampleTrade() {
+    Trade t;
+    t.control_id.assign("AB12CD34EF");
+    t.cusip.assign("037833100");
+    t.issuer.assign("Apple");
+    t.rating.assign("AA+");
+    t.industry.assign("Technology");
+    t.exec_time.assign("2025-03-14T15:09:26.535897Z");
+    t.report_time.assign("2025-03-14T10:09:26-05:00");
+    t.maturity.assign("2031-06-30");
+    t.modifier3.assign("");
+    t.side.assign("SELL");
+    t.reporting_capacity.assign("A");
+    t.coupon = 3.45;
+    t.price = 101.25;
+    t.volume = 2500000;
+    t.dealer_id = 4321;
+    t.has_coupon = t.has_price = t.has_volume = t.has_dealer_id = true;
+    return t;
+}
+
+}   // namespace
+
+// Test dates count from the Postgres epoch
+TEST(PgBinaryTest, Dates) {
+    int32_t days = 1;
+    EXPECT_TRUE(parse_pg_date("2000-01-01", days));
+    EXPECT_EQ(days, 0);
+    EXPECT_TRUE(parse_pg_date("2031-06-30", days));
+    EXPECT_EQ(days, 11503);
+    EXPECT_TRUE(parse_pg_date("1969-07-20", days));
+    EXPECT_EQ(days, -11122);
+    EXPECT_TRUE(parse_pg_date("2024-02-29", days));
+
+    EXPECT_FALSE(parse_pg_date("2023-02-29", days));
+    EXPECT_FALSE(parse_pg_date("2025-13-01", days));
+    EXPECT_FALSE(parse_pg_date("2025-1-01", days));
+    EXPECT_FALSE(parse_pg_date("2025-01-01T", days));
+    EXPECT_FALSE(parse_pg_date("", days));
+}
+
+// Test timestamps in the formats the feed and Postgres produce
+TEST(PgBinaryTest, Timestamps) {
+    int64_t micros = 1;
+    EXPECT_TRUE(parse_pg_timestamptz("2000-01-01T00:00:00Z", micros));
+    EXPECT_EQ(micros, 0);
+    EXPECT_TRUE(parse_pg_timestamptz("2025-03-14T15:09:26.535897Z", micros));
+    EXPECT_EQ(micros, 795280166535897);
+    EXPECT_TRUE(parse_pg_timestamptz("2025-03-14 15:09:26.535897+00", micros));
+    EXPECT_EQ(micros, 795280166535897);
+    EXPECT_TRUE(parse_pg_timestamptz("2025-03-14T10:09:26-05:00", micros));
+    EXPECT_EQ(micros, 795280166000000);
+    EXPECT_TRUE(parse_pg_timestamptz("2025-03-14T10:09:26-0500", micros));
+    EXPECT_EQ(micros, 795280166000000);
+    EXPECT_TRUE(parse_pg_timestamptz("2025-03-14T15:09:26", micros));
+    EXPECT_EQ(micros, 795280166000000);
+    EXPECT_TRUE(parse_pg_timestamptz("1999-12-31T23:59:59.5Z", micros));
+    EXPECT_EQ(micros, -500000);
+
+    // Fractions past microseconds round
+    EXPECT_TRUE(parse_pg_timestamptz("2000-01-01T00:00:00.0000015Z", micros));
+    EXPECT_EQ(micros, 2);
+    EXPECT_TRUE(parse_pg_timestamptz("2000-01-01T00:00:00.0000014999Z", micros));
+    EXPECT_EQ(micros, 1);
+
+    EXPECT_FALSE(parse_pg_timestamptz("2025-03-14", micros));
+    EXPECT_FALSE(parse_pg_timestamptz("2025-03-14T24:00:00Z", micros));
+    EXPECT_FALSE(parse_pg_timestamptz("2025-03-14T15:09:26.Z", micros));
+    EXPECT_FALSE(parse_pg_timestamptz("2025-03-14T15:09:26Zjunk", micros));
+    EXPECT_FALSE(parse_pg_timestamptz("2025-03-14T15:09:26+5", micros));
+}
+
+// Test every parameter's encoding and that strings aren't copied
+TEST(TradeParamsTest, Encode) {
+    Trade t = sampleTrade();
+    TradeParams p;
+    std::string error;
+    ASSERT_TRUE(p.encode(t, error)) << error;
+
+    for (int format : p.formats) EXPECT_EQ(format, 1);
+
+    EXPECT_EQ(p.values[0], t.control_id.chars);
+    EXPECT_EQ(p.lengths[0], 10);
+    EXPECT_EQ(p.values[2], t.cusip.chars);
+    EXPECT_EQ(std::string(p.values[13], p.lengths[13]), "SELL");
+    EXPECT_NE(p.values[8], nullptr);   // '' is not NULL
+    EXPECT_EQ(p.lengths[8], 0);
+
+    double coupon;
+    uint64_t bits = loadBe(p.values[1], 8);
+    std::memcpy(&coupon, &bits, sizeof(coupon));
+    EXPECT_EQ(coupon, 3.45);
+    EXPECT_EQ(p.lengths[1], 8);
+
+    EXPECT_EQ(p.lengths[3], 4);
+    EXPECT_EQ(loadBe(p.values[3], 4), 4321u);
+    EXPECT_EQ(loadBe(p.values[4], 8), 795280166535897u);
+    EXPECT_EQ(loadBe(p.values[7], 4), 11503u);
+    EXPECT_EQ(loadBe(p.values[11], 8), 795280166000000u);
+    EXPECT_EQ(loadBe(p.values[14], 8), 2500000u);
+}
+
+// Test missing values go as NULL
+TEST(TradeParamsTest, Nulls) {
+    Trade t = sampleTrade();
+    t.has_coupon = t.has_price = t.has_volume = t.has_dealer_id = false;
+    t.maturity.assign("");
+    t.report_time.assign("");
+
+    TradeParams p;
+    std::string error;
+    ASSERT_TRUE(p.encode(t, error)) << error;
+    for (int i : {1, 3, 7, 9, 11, 14}) {
+        EXPECT_EQ(p.values[i], nullptr) << i;
+    }
+    EXPECT_NE(p.values[4], nullptr);
+}
+
+// Test unparseable timestamps and dates fail with the field name
+TEST(TradeParamsTest, RejectsBadTimes) {
+    Trade t = sampleTrade();
+    t.exec_time.assign("yesterday");
+    TradeParams p;
+    std::string error;
+    EXPECT_FALSE(p.encode(t, error));
+    EXPECT_NE(error.find("exec_time"), std::string::npos);
+
+    t = sampleTrade();
+    t.maturity.assign("2031-02-30");
+    EXPECT_FALSE(p.encode(t, error));
+    EXPECT_NE(error.find("maturity"), std::string::npos);
+}
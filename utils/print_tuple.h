@@ -49,5 +49,15 @@ void print_tuple(std::ostream& os, const std::tuple<Ts...>& tup) {
     }
 }
 
+// Calls f on each tuple element in order, e.g. to serialize the elements
+// instead of printing them
+template<std::size_t Index = 0, typename F, typename... Ts>
+void for_each(const std::tuple<Ts...>& tup, F&& f) {
+    if constexpr (Index < sizeof...(Ts)) {
+        f(std::get<Index>(tup));
+        for_each<Index + 1>(tup, std::forward<F>(f));
+    }
+}
+
 }   // namespace tuple
 }   // namespace utils
\ No newline at end of file